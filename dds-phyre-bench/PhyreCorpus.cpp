@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cstring>
+
+#include "PhyreCorpus.h"
+
+namespace phyre
+{
+    namespace
+    {
+        constexpr uint32_t PHYRE_MAGIC = 0x50485952UL;
+        constexpr uint32_t PLATFORM_DX11 = 0x44583131UL;
+
+        struct _tClass
+        {
+            const char* name;
+            uint32_t baseClassId;
+            std::vector<std::pair<const char*, uint32_t>> members;
+        };
+
+        void append(std::vector<char>& out, uint32_t value)
+        {
+            const size_t offset = out.size();
+            out.resize(offset + sizeof(value));
+            std::memcpy(out.data() + offset, &value, sizeof(value));
+        }
+
+        void append(std::vector<char>& out, const std::vector<char>& data)
+        {
+            out.insert(out.end(), data.begin(), data.end());
+        }
+    }
+
+    std::vector<PhyreCorpus::_tEntry> PhyreCorpus::entries(const std::vector<std::pair<uint32_t, uint32_t>>& sizes)
+    {
+        std::vector<_tEntry> ret;
+        for (uint32_t format = 0; format < PhyreTextureFormat::formatCount; format++)
+        {
+            for (const auto& size : sizes)
+            {
+                const auto textureFormat = static_cast<PhyreTextureFormat::_eFormat>(format);
+                ret.push_back({ textureFormat, size.first, size.second, 1 });
+                const uint32_t mipLevels = fullMipLevels(size.first, size.second);
+                if (mipLevels > 1)
+                    ret.push_back({ textureFormat, size.first, size.second, mipLevels });
+            }
+        }
+        return ret;
+    }
+
+    std::vector<char> PhyreCorpus::generate(const _tEntry& entry, uint32_t seed)
+    {
+        const std::string formatName = PhyreTextureFormat::traits(entry.format).name;
+
+        // Class ids are 1 based, PTexture2D derives from PTexture2DBase which derives from PTextureCommonBase.
+        const std::vector<_tClass> classes =
+        {
+            { "PTextureCommonBase", 0, { { "m_mipmapCount", 8 }, { "m_maxMipLevel", 12 }, { "m_textureFlags", 16 } } },
+            { "PTexture2DBase", 1, { { "m_width", 0 }, { "m_height", 4 } } },
+            { "PTexture2D", 2, {} },
+            { "PFiller", 0, { { "m_filler", 0 } } },
+        };
+        const uint32_t texture2DId = 3;
+        const uint32_t fillerId = 4;
+        const std::vector<const char*> types = { "int", "PTextureFormatBase", "PString" };
+        const uint32_t formatTypeId = 1;
+        const uint32_t stringTypeId = 2;
+
+        std::vector<char> strings;
+        auto addString = [&strings](const char* text)
+        {
+            const uint32_t offset = static_cast<uint32_t>(strings.size());
+            strings.insert(strings.end(), text, text + std::strlen(text) + 1);
+            return offset;
+        };
+
+        std::vector<char> tables;
+        for (const char* type : types)
+            append(tables, addString(type));
+        uint32_t memberCount = 0;
+        for (const auto& phyreClass : classes)
+        {
+            append(tables, phyreClass.baseClassId);
+            append(tables, 0);
+            append(tables, addString(phyreClass.name));
+            append(tables, static_cast<uint32_t>(phyreClass.members.size()));
+            for (int i = 0; i < 5; i++)
+                append(tables, 0);
+            memberCount += static_cast<uint32_t>(phyreClass.members.size());
+        }
+        for (const auto& phyreClass : classes)
+        {
+            for (const auto& member : phyreClass.members)
+            {
+                append(tables, addString(member.first));
+                append(tables, 0);
+                append(tables, member.second);
+                append(tables, sizeof(uint32_t));
+                append(tables, 0);
+                append(tables, 0);
+            }
+        }
+
+        std::vector<char> phyreNamespace;
+        append(phyreNamespace, PHYRE_MAGIC);
+        append(phyreNamespace, static_cast<uint32_t>(8 * sizeof(uint32_t) + tables.size() + strings.size()));
+        append(phyreNamespace, static_cast<uint32_t>(types.size()));
+        append(phyreNamespace, static_cast<uint32_t>(classes.size()));
+        append(phyreNamespace, memberCount);
+        append(phyreNamespace, static_cast<uint32_t>(strings.size()));
+        append(phyreNamespace, 0);
+        append(phyreNamespace, 0);
+        append(phyreNamespace, tables);
+        append(phyreNamespace, strings);
+
+        // A filler object in front keeps the texture object off offset 0.
+        const uint32_t fillerSize = 12;
+        const uint32_t textureSize = 32;
+        std::vector<char> instances;
+        for (const uint32_t instance : { fillerId, texture2DId })
+        {
+            const uint32_t objectSize = instance == fillerId ? fillerSize : textureSize;
+            append(instances, instance);
+            append(instances, 1);
+            append(instances, objectSize);
+            append(instances, objectSize);
+            for (int i = 0; i < 5; i++)
+                append(instances, 0);
+        }
+
+        std::vector<char> instanceData(fillerSize, '\xAA');
+        const uint32_t mipmapCount = entry.mipLevels ? entry.mipLevels - 1 : 0;
+        for (const uint32_t value : { entry.width, entry.height, mipmapCount, mipmapCount, 0u, 0u, 0u, 0u })
+            append(instanceData, value);
+
+        // The format is not the first user fixup, as in real files.
+        const std::string firstFixup = "texture";
+        std::vector<char> fixupData(firstFixup.begin(), firstFixup.end());
+        fixupData.push_back('\0');
+        fixupData.insert(fixupData.end(), formatName.begin(), formatName.end());
+        fixupData.push_back('\0');
+
+        std::vector<char> fixups;
+        append(fixups, stringTypeId);
+        append(fixups, static_cast<uint32_t>(firstFixup.size() + 1));
+        append(fixups, 0);
+        append(fixups, formatTypeId);
+        append(fixups, static_cast<uint32_t>(formatName.size() + 1));
+        append(fixups, static_cast<uint32_t>(firstFixup.size() + 1));
+
+        const size_t payloadSize = static_cast<size_t>(PhyreTextureFormat::chainSize(entry.format, entry.width, entry.height, entry.mipLevels));
+
+        std::vector<char> ret;
+        ret.reserve(21 * sizeof(uint32_t) + phyreNamespace.size() + instances.size() + instanceData.size() + fixupData.size() + fixups.size() + payloadSize);
+        const uint32_t header[21] =
+        {
+            PHYRE_MAGIC, 21 * sizeof(uint32_t), static_cast<uint32_t>(phyreNamespace.size()), PLATFORM_DX11,
+            2, 0, 0, 0, 0, 0, 0, 0,
+            2, static_cast<uint32_t>(fixupData.size()), static_cast<uint32_t>(instanceData.size()),
+            0, 0, 0, 0, 0,
+            static_cast<uint32_t>(PhyreTextureFormat::surfaceSize(entry.format, entry.width, entry.height))
+        };
+        for (const uint32_t value : header)
+            append(ret, value);
+        append(ret, phyreNamespace);
+        append(ret, instances);
+        append(ret, instanceData);
+        append(ret, fixupData);
+        append(ret, fixups);
+
+        // xorshift32, cheap enough not to dominate generating large files.
+        uint32_t state = seed ? seed : 1;
+        const size_t payloadOffset = ret.size();
+        ret.resize(payloadOffset + payloadSize);
+        for (size_t i = 0; i < payloadSize; i += sizeof(state))
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            std::memcpy(ret.data() + payloadOffset + i, &state, std::min(sizeof(state), payloadSize - i));
+        }
+        return ret;
+    }
+
+    std::string PhyreCorpus::fileName(const _tEntry& entry)
+    {
+        return std::string(PhyreTextureFormat::traits(entry.format).name) + "_" + std::to_string(entry.width) + "x" +
+            std::to_string(entry.height) + "_" + std::to_string(entry.mipLevels) + ".phyre";
+    }
+
+    uint32_t PhyreCorpus::fullMipLevels(uint32_t width, uint32_t height)
+    {
+        uint32_t ret = 1;
+        while ((width >> ret) || (height >> ret))
+            ret++;
+        return ret;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PhyreTextureFormat.h"
+
+namespace phyre
+{
+    /*
+    * Generator for synthetic DX11 phyre files. Every file has a minimal
+    * but complete namespace with the texture classes, a filler object in
+    * front of the texture object, a second user fixup in front of the
+    * format string and a payload of pseudo random bytes covering the
+    * whole mip chain. The output is reproducible for a given seed.
+    */
+    class PhyreCorpus
+    {
+    public:
+        struct _tEntry
+        {
+            PhyreTextureFormat::_eFormat format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mipLevels;
+        };
+
+        PhyreCorpus() = delete;
+
+        // Every format at every size, once with a single level and once with the full mip chain.
+        static std::vector<_tEntry> entries(const std::vector<std::pair<uint32_t, uint32_t>>& sizes);
+
+        static std::vector<char> generate(const _tEntry& entry, uint32_t seed = 1);
+
+        // File name that describes the entry, e.g. DXT1_256x256_9.phyre.
+        static std::string fileName(const _tEntry& entry);
+
+        static uint32_t fullMipLevels(uint32_t width, uint32_t height);
+    };
+}
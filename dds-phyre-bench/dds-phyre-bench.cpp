@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "PhyreContainer.h"
+#include "PhyreCorpus.h"
+#include "PhyreException.h"
+#include "PhyreMappedFile.h"
+#include "PhyrePlatformDX11.h"
+#include "PhyreSchema.h"
+#include "PhyreTextureFlip.h"
+
+namespace fs = std::filesystem;
+using phyre::PhyreTextureFormat;
+
+namespace
+{
+    /*
+    * Stages of a conversion, timed separately so a regression shows up
+    * in the stage that caused it:
+    *   probe      magic, platform and size checks on the mapped file
+    *   parse      _getPhyreInfo, with the schema cache warm after the first run
+    *   read       mapping the file and touching every payload byte
+    *   flip       flipping the payload in place, no I/O
+    *   write      writing the finished DDS to disk
+    *   d2p        DDS back to phyre in memory, same format
+    *   d2p-format DDS of another format, goes through _setTextureFormat
+    */
+    const char* const STAGES[] = { "probe", "parse", "read", "flip", "write", "d2p", "d2p-format" };
+    constexpr size_t STAGE_COUNT = sizeof(STAGES) / sizeof(STAGES[0]);
+
+    struct _tOptions
+    {
+        std::vector<fs::path> inputs;
+        fs::path generateDirectory;
+        std::vector<std::pair<uint32_t, uint32_t>> sizes = { { 64, 64 }, { 300, 200 }, { 1024, 1024 } };
+        std::vector<PhyreTextureFormat::_eFormat> formats;
+        size_t iterations = 5;
+        fs::path csvPath;
+        fs::path baselinePath;
+        double threshold = 10.0;
+    };
+
+    struct _tResult
+    {
+        std::string name;
+        size_t fileSize = 0;
+        size_t payloadSize = 0;
+        // Median nanoseconds per stage, negative if the stage was skipped.
+        double stages[STAGE_COUNT];
+        // Why the remaining stages were skipped.
+        std::string error;
+    };
+
+    template<typename F>
+    double median(size_t iterations, F&& run)
+    {
+        std::vector<double> times;
+        for (size_t i = 0; i < iterations; i++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            run();
+            times.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+        }
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    // Library messages are plain ASCII, stderr stays byte oriented for the rest of the output.
+    std::string narrow(const std::wstring& text)
+    {
+        std::string ret;
+        for (const wchar_t ch : text)
+            ret.push_back(ch < 0x80 ? static_cast<char>(ch) : '?');
+        return ret;
+    }
+
+    // Keeps the compiler from dropping reads whose result is otherwise unused.
+    volatile uint64_t sink;
+
+    // Another format with a name of a different length, so the fixup data really shifts.
+    PhyreTextureFormat::_eFormat partnerFormat(PhyreTextureFormat::_eFormat format)
+    {
+        return std::strlen(PhyreTextureFormat::traits(format).name) == 4 ? PhyreTextureFormat::formatRGBA16F : PhyreTextureFormat::formatDXT1;
+    }
+
+    void benchStages(_tResult& result, const fs::path& phyrePath, const fs::path& scratchDirectory, size_t iterations)
+    {
+        const phyre::PhyreMappedFile mapping(phyrePath);
+        const phyre::PhyreView phyreView = mapping.view();
+        result.fileSize = phyreView.size();
+
+        std::unique_ptr<phyre::PhyrePlatform> platform(new phyre::PhyrePlatformDX11);
+
+        result.stages[0] = median(iterations, [&]()
+        {
+            sink = phyreView.size() >= 16 && std::memcmp(phyreView.data(), "RYHP", 4) == 0 && platform->isFormatSupported(phyreView);
+        });
+
+        phyre::PhyreSchema::clearCache();
+        phyre::PhyrePlatform::_tDocument document{};
+        result.stages[1] = median(iterations, [&]()
+        {
+            document = platform->parseDocument(phyreView);
+        });
+
+        const auto& textureInfo = document.textureInfo;
+        result.payloadSize = textureInfo.dataSize;
+        if (textureInfo.format == PhyreTextureFormat::formatUnknown || textureInfo.dataSize == 0)
+            throw phyre::PhyreExceptionData(L"No texture data of a known format");
+
+        result.stages[2] = median(iterations, [&]()
+        {
+            const phyre::PhyreMappedFile file(phyrePath);
+            const char* data = file.view().at<char>(textureInfo.dataOffset, textureInfo.dataSize);
+            uint64_t sum = 0;
+            for (size_t i = 0; i + sizeof(uint64_t) <= textureInfo.dataSize; i += sizeof(uint64_t))
+            {
+                uint64_t word;
+                std::memcpy(&word, data + i, sizeof(word));
+                sum += word;
+            }
+            sink = sum;
+        });
+
+        // Flipping twice restores the data, the copy is only made once.
+        const phyre::PhyreTextureFlip flip(textureInfo.format, textureInfo.width, textureInfo.height, textureInfo.mipmapCount + 1);
+        std::vector<char> payload(phyreView.data() + textureInfo.dataOffset, phyreView.data() + textureInfo.dataOffset + textureInfo.dataSize);
+        result.stages[3] = median(iterations, [&]()
+        {
+            flip.flipInPlace(payload.data(), payload.size());
+        });
+
+        phyre::PhyreContainer container(phyreView);
+        const phyre::PhyreArena::Buffer dds = container.ConvertPhyre2DDS();
+        const fs::path ddsPath = scratchDirectory / (phyrePath.stem().string() + ".dds");
+        result.stages[4] = median(iterations, [&]()
+        {
+            std::ofstream ddsFile(ddsPath, std::ios::binary | std::ios::trunc);
+            ddsFile.write(dds.data(), dds.size());
+            ddsFile.close();
+            if (!ddsFile)
+                throw phyre::PhyreExceptionIO(L"Cannot write DDS file: " + ddsPath.wstring());
+        });
+        fs::remove(ddsPath);
+
+        const phyre::PhyreView ddsView(dds.data(), dds.size());
+        result.stages[5] = median(iterations, [&]()
+        {
+            sink = container.ConvertDDS2Phyre(ddsView).size();
+        });
+
+        // A texture of the same size in the partner format supplies the DDS.
+        const PhyreTextureFormat::_eFormat otherFormat = partnerFormat(textureInfo.format);
+        const std::vector<char> otherPhyre = phyre::PhyreCorpus::generate({ otherFormat, textureInfo.width, textureInfo.height, textureInfo.mipmapCount + 1 });
+        const phyre::PhyreArena::Buffer otherDDS = phyre::PhyreContainer(phyre::PhyreView(otherPhyre.data(), otherPhyre.size())).ConvertPhyre2DDS();
+        const phyre::PhyreView otherDDSView(otherDDS.data(), otherDDS.size());
+        result.stages[6] = median(iterations, [&]()
+        {
+            sink = container.ConvertDDS2Phyre(otherDDSView).size();
+        });
+    }
+
+    // Stages run in order, a file some stage can't handle still gets the ones before it.
+    _tResult benchFile(const fs::path& phyrePath, const fs::path& scratchDirectory, size_t iterations)
+    {
+        _tResult result{};
+        result.name = phyrePath.filename().string();
+        std::fill(std::begin(result.stages), std::end(result.stages), -1.0);
+        try
+        {
+            benchStages(result, phyrePath, scratchDirectory, iterations);
+        }
+        catch (phyre::PhyreException& e)
+        {
+            result.error = narrow(e.what());
+        }
+        return result;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> parseSizes(const std::string& text)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> ret;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            unsigned width = 0;
+            unsigned height = 0;
+            if (std::sscanf(item.c_str(), "%ux%u", &width, &height) != 2 || !width || !height)
+                throw std::invalid_argument("Invalid size: " + item);
+            ret.emplace_back(width, height);
+        }
+        return ret;
+    }
+
+    std::vector<PhyreTextureFormat::_eFormat> parseFormats(const std::string& text)
+    {
+        std::vector<PhyreTextureFormat::_eFormat> ret;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            const auto format = PhyreTextureFormat::fromName(item);
+            if (format == PhyreTextureFormat::formatUnknown)
+                throw std::invalid_argument("Unknown format: " + item);
+            ret.push_back(format);
+        }
+        return ret;
+    }
+
+    std::vector<fs::path> writeCorpus(const _tOptions& options, const fs::path& directory)
+    {
+        fs::create_directories(directory);
+        std::vector<fs::path> ret;
+        for (const auto& entry : phyre::PhyreCorpus::entries(options.sizes))
+        {
+            if (!options.formats.empty() && std::find(options.formats.begin(), options.formats.end(), entry.format) == options.formats.end())
+                continue;
+
+            const std::vector<char> data = phyre::PhyreCorpus::generate(entry);
+            const fs::path path = directory / phyre::PhyreCorpus::fileName(entry);
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(data.data(), data.size());
+            if (!file)
+                throw phyre::PhyreExceptionIO(L"Cannot write corpus file: " + path.wstring());
+            ret.push_back(path);
+        }
+        return ret;
+    }
+
+    std::vector<fs::path> collectInputs(const std::vector<fs::path>& inputs)
+    {
+        std::vector<fs::path> ret;
+        for (const auto& input : inputs)
+        {
+            if (!fs::is_directory(input))
+            {
+                ret.push_back(input);
+                continue;
+            }
+            for (const auto& entry : fs::recursive_directory_iterator(input))
+                if (entry.is_regular_file() && entry.path().extension() == ".phyre")
+                    ret.push_back(entry.path());
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    }
+
+    void writeCsv(const fs::path& csvPath, const std::vector<_tResult>& results)
+    {
+        std::ofstream csv(csvPath, std::ios::trunc);
+        csv << "file,bytes,stage,ns\n";
+        for (const auto& result : results)
+            for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+                if (result.stages[stage] >= 0)
+                    csv << result.name << "," << result.fileSize << "," << STAGES[stage] << "," << static_cast<uint64_t>(result.stages[stage]) << "\n";
+        if (!csv)
+            throw phyre::PhyreExceptionIO(L"Cannot write CSV file: " + csvPath.wstring());
+    }
+
+    /*
+    * Sums every stage over the files both runs have in common and reports
+    * the stages that got slower by more than threshold percent. Returns
+    * false if there was any.
+    */
+    bool compareBaseline(const fs::path& baselinePath, const std::vector<_tResult>& results, double threshold)
+    {
+        std::ifstream csv(baselinePath);
+        if (!csv)
+            throw phyre::PhyreExceptionIO(L"Cannot read baseline: " + baselinePath.wstring());
+
+        std::map<std::pair<std::string, std::string>, double> baseline;
+        std::string line;
+        std::getline(csv, line);
+        while (std::getline(csv, line))
+        {
+            std::stringstream stream(line);
+            std::string name, bytes, stage, ns;
+            if (std::getline(stream, name, ',') && std::getline(stream, bytes, ',') && std::getline(stream, stage, ',') && std::getline(stream, ns))
+                baseline[{ name, stage }] = std::strtod(ns.c_str(), nullptr);
+        }
+
+        bool ret = true;
+        std::printf("\n%-12s %14s %14s %9s\n", "stage", "baseline ms", "current ms", "change");
+        for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+        {
+            double before = 0;
+            double after = 0;
+            for (const auto& result : results)
+            {
+                const auto found = baseline.find({ result.name, STAGES[stage] });
+                if (found == baseline.end() || result.stages[stage] < 0)
+                    continue;
+                before += found->second;
+                after += result.stages[stage];
+            }
+            if (before <= 0)
+                continue;
+
+            const double change = (after - before) / before * 100.0;
+            const bool regressed = change > threshold;
+            std::printf("%-12s %14.3f %14.3f %+8.1f%%%s\n", STAGES[stage], before / 1e6, after / 1e6, change, regressed ? "  REGRESSION" : "");
+            ret = ret && !regressed;
+        }
+        return ret;
+    }
+
+    void printUsage()
+    {
+        std::cerr << "Usage: dds-phyre-bench [options] [files or directories]\n"
+            "Without inputs a synthetic corpus of every format is generated and benchmarked.\n"
+            "  --generate DIR     write the synthetic corpus to DIR and exit\n"
+            "  --sizes WxH,...    sizes of the synthetic corpus (default 64x64,300x200,1024x1024)\n"
+            "  --formats F,...    restrict the synthetic corpus to these formats\n"
+            "  --iterations N     runs per stage, the median is reported (default 5)\n"
+            "  --csv FILE         write the results as CSV\n"
+            "  --baseline FILE    compare with the CSV of an earlier run, exit code 2 on a regression\n"
+            "  --threshold PCT    slowdown per stage counted as a regression (default 10)\n";
+    }
+
+    _tOptions parseOptions(int argc, char* argv[])
+    {
+        _tOptions options;
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (arg == "--generate" && hasValue)
+                options.generateDirectory = argv[++i];
+            else if (arg == "--sizes" && hasValue)
+                options.sizes = parseSizes(argv[++i]);
+            else if (arg == "--formats" && hasValue)
+                options.formats = parseFormats(argv[++i]);
+            else if (arg == "--iterations" && hasValue)
+                options.iterations = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--csv" && hasValue)
+                options.csvPath = argv[++i];
+            else if (arg == "--baseline" && hasValue)
+                options.baselinePath = argv[++i];
+            else if (arg == "--threshold" && hasValue)
+                options.threshold = std::strtod(argv[++i], nullptr);
+            else if (arg.rfind("--", 0) == 0)
+                throw std::invalid_argument("Unknown option: " + arg);
+            else
+                options.inputs.push_back(arg);
+        }
+        return options;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const _tOptions options = parseOptions(argc, argv);
+
+        if (!options.generateDirectory.empty())
+        {
+            const auto files = writeCorpus(options, options.generateDirectory);
+            std::cout << "Generated " << files.size() << " files in " << options.generateDirectory.string() << "\n";
+            return EXIT_SUCCESS;
+        }
+
+        const fs::path scratchDirectory = fs::temp_directory_path() / "dds-phyre-bench";
+        fs::create_directories(scratchDirectory);
+        const bool synthetic = options.inputs.empty();
+        const std::vector<fs::path> files = synthetic ? writeCorpus(options, scratchDirectory / "corpus") : collectInputs(options.inputs);
+
+        std::printf("%-32s %12s", "file", "bytes");
+        for (const char* stage : STAGES)
+            std::printf(" %11s", stage);
+        std::printf("\n");
+
+        std::vector<_tResult> results;
+        double totals[STAGE_COUNT] = {};
+        double payloadBytes[STAGE_COUNT] = {};
+        for (const auto& file : files)
+        {
+            const _tResult result = benchFile(file, scratchDirectory, options.iterations);
+            std::printf("%-32s %12zu", result.name.c_str(), result.fileSize);
+            for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+            {
+                if (result.stages[stage] < 0)
+                {
+                    std::printf(" %11s", "-");
+                    continue;
+                }
+                std::printf(" %9.3fms", result.stages[stage] / 1e6);
+                totals[stage] += result.stages[stage];
+                payloadBytes[stage] += result.payloadSize;
+            }
+            std::printf("%s%s\n", result.error.empty() ? "" : "  ", result.error.c_str());
+            results.push_back(result);
+        }
+
+        // Throughput over the payload bytes. The header stages and the format change, which
+        // converts a payload of another size, only get a total time.
+        std::printf("\n%-12s %14s %12s\n", "stage", "total ms", "MB/s");
+        for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+        {
+            if (stage < 2 || stage == STAGE_COUNT - 1)
+                std::printf("%-12s %14.3f %12s\n", STAGES[stage], totals[stage] / 1e6, "-");
+            else
+                std::printf("%-12s %14.3f %12.1f\n", STAGES[stage], totals[stage] / 1e6, totals[stage] > 0 ? payloadBytes[stage] / (totals[stage] / 1e9) / 1e6 : 0.0);
+        }
+
+        if (synthetic)
+            fs::remove_all(scratchDirectory / "corpus");
+
+        if (!options.csvPath.empty())
+            writeCsv(options.csvPath, results);
+
+        if (!options.baselinePath.empty() && !compareBaseline(options.baselinePath, results, options.threshold))
+            return 2;
+
+        return EXIT_SUCCESS;
+    }
+    catch (phyre::PhyreException& e)
+    {
+        std::cerr << "Error: " << narrow(e.what()) << "\n";
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        printUsage();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+    }
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstring>
+
+#include "PhyreArena.h"
+#include "PhyreStats.h"
+
+namespace phyre
+{
+    PhyreArena::Buffer::Buffer(PhyreArena* arena, std::unique_ptr<char[]>&& data, size_t capacity, size_t size)
+        : _arena(arena)
+        , _data(std::move(data))
+        , _capacity(capacity)
+        , _size(size)
+    {
+    }
+
+    PhyreArena::Buffer::Buffer(Buffer&& other) noexcept
+        : _arena(other._arena)
+        , _data(std::move(other._data))
+        , _capacity(other._capacity)
+        , _size(other._size)
+    {
+        other._capacity = other._size = 0;
+    }
+
+    PhyreArena::Buffer& PhyreArena::Buffer::operator=(Buffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            _arena = other._arena;
+            _data = std::move(other._data);
+            _capacity = other._capacity;
+            _size = other._size;
+            other._capacity = other._size = 0;
+        }
+        return *this;
+    }
+
+    PhyreArena::Buffer::~Buffer()
+    {
+        reset();
+    }
+
+    void PhyreArena::Buffer::reset()
+    {
+        if (_data && _arena)
+            _arena->_release(std::move(_data), _capacity);
+        _data.reset();
+        _capacity = _size = 0;
+    }
+
+    void PhyreArena::Buffer::reserve(size_t capacity)
+    {
+        if (capacity <= _capacity)
+            return;
+
+        // Grows geometrically, the old block goes back to the arena once its bytes are moved.
+        Buffer grown = (_arena ? *_arena : local()).acquire(std::max(capacity, _capacity * 2));
+        if (_size)
+            std::memcpy(grown.data(), data(), _size);
+        grown._size = _size;
+        *this = std::move(grown);
+    }
+
+    void PhyreArena::Buffer::resize(size_t size)
+    {
+        reserve(size);
+        _size = size;
+    }
+
+    void PhyreArena::Buffer::assign(const char* data, size_t size)
+    {
+        _size = 0;
+        resize(size);
+        if (size)
+            std::memcpy(_data.get(), data, size);
+    }
+
+    PhyreArena& PhyreArena::local()
+    {
+        static thread_local PhyreArena arena;
+        return arena;
+    }
+
+    PhyreArena::Buffer PhyreArena::acquire(size_t size)
+    {
+        // The smallest cached block that fits, so large ones stay free for large requests.
+        auto best = _blocks.end();
+        for (auto it = _blocks.begin(); it != _blocks.end(); ++it)
+        {
+            if (it->capacity >= size && (best == _blocks.end() || it->capacity < best->capacity))
+                best = it;
+        }
+        if (best != _blocks.end())
+        {
+            _tBlock block = std::move(*best);
+            _blocks.erase(best);
+            return Buffer(this, std::move(block.data), block.capacity, size);
+        }
+
+        // Nothing fits. The largest block is too small as well, it is replaced by the new one.
+        if (!_blocks.empty())
+        {
+            const auto largest = std::max_element(_blocks.begin(), _blocks.end(),
+                [](const _tBlock& a, const _tBlock& b) { return a.capacity < b.capacity; });
+            _blocks.erase(largest);
+        }
+
+        const size_t capacity = std::max<size_t>((size + BLOCK_GRANULARITY - 1) / BLOCK_GRANULARITY * BLOCK_GRANULARITY, BLOCK_GRANULARITY);
+        PhyreStats::addAllocated(capacity);
+        return Buffer(this, std::unique_ptr<char[]>(new char[capacity]), capacity, size);
+    }
+
+    void PhyreArena::_release(std::unique_ptr<char[]>&& data, size_t capacity)
+    {
+        _blocks.push_back({ std::move(data), capacity });
+        if (_blocks.size() > MAX_CACHED_BLOCKS)
+        {
+            const auto smallest = std::min_element(_blocks.begin(), _blocks.end(),
+                [](const _tBlock& a, const _tBlock& b) { return a.capacity < b.capacity; });
+            _blocks.erase(smallest);
+        }
+    }
+
+    size_t PhyreArena::cachedBytes() const
+    {
+        size_t ret = 0;
+        for (const auto& block : _blocks)
+            ret += block.capacity;
+        return ret;
+    }
+
+    void PhyreArena::trim()
+    {
+        _blocks.clear();
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "PhyreView.h"
+
+namespace phyre
+{
+    /*
+    * Per-thread pool of scratch memory for every stage of a conversion.
+    * A buffer is leased for as long as a stage needs it and goes back to
+    * the pool of its thread afterwards, so the next file reuses memory
+    * that is already allocated and faulted in. The pool grows to the
+    * largest set of buffers a file needed and stays there. Buffers are
+    * not initialised, every byte below size() is whatever was last
+    * written to it.
+    */
+    class PhyreArena
+    {
+    public:
+        class Buffer
+        {
+        public:
+            Buffer() = default;
+            Buffer(Buffer&& other) noexcept;
+            Buffer& operator=(Buffer&& other) noexcept;
+            Buffer(const Buffer&) = delete;
+            Buffer& operator=(const Buffer&) = delete;
+            virtual ~Buffer();
+
+            char* data() { return _data.get(); }
+            const char* data() const { return _data.get(); }
+            size_t size() const { return _size; }
+            size_t capacity() const { return _capacity; }
+            bool empty() const { return _size == 0; }
+            PhyreView view() const { return PhyreView(_data.get(), _size); }
+
+            // Keeps the first size() bytes, anything beyond them is uninitialised.
+            void reserve(size_t capacity);
+            void resize(size_t size);
+            void assign(const char* data, size_t size);
+
+            // Hands the memory back to the arena early.
+            void reset();
+
+        private:
+            friend class PhyreArena;
+            Buffer(PhyreArena* arena, std::unique_ptr<char[]>&& data, size_t capacity, size_t size);
+
+            PhyreArena* _arena = nullptr;
+            std::unique_ptr<char[]> _data;
+            size_t _capacity = 0;
+            size_t _size = 0;
+        };
+
+        // Blocks kept for reuse, the smallest ones are dropped beyond that.
+        static constexpr size_t MAX_CACHED_BLOCKS = 8;
+        // Sizes are rounded up to this, buffers that grow a little reuse their block.
+        static constexpr size_t BLOCK_GRANULARITY = 64 * 1024;
+
+        // The arena of the calling thread. Its buffers must not outlive the thread.
+        static PhyreArena& local();
+
+        PhyreArena() = default;
+        PhyreArena(const PhyreArena&) = delete;
+        PhyreArena& operator=(const PhyreArena&) = delete;
+        virtual ~PhyreArena() = default;
+
+        Buffer acquire(size_t size);
+
+        size_t cachedBytes() const;
+        // Frees every block that isn't leased.
+        void trim();
+
+    private:
+        struct _tBlock
+        {
+            std::unique_ptr<char[]> data;
+            size_t capacity;
+        };
+
+        void _release(std::unique_ptr<char[]>&& data, size_t capacity);
+
+        std::vector<_tBlock> _blocks;
+    };
+}
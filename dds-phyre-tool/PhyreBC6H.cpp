@@ -0,0 +1,636 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "PhyreBC6H.h"
+#include "PhyreBC7.h"
+
+namespace phyre
+{
+    namespace
+    {
+        class BitReader
+        {
+        public:
+            BitReader(const uint8_t* data) : _data(data) {}
+            uint32_t read(uint32_t bits)
+            {
+                uint32_t ret = 0;
+                for (uint32_t i = 0; i < bits; i++, _pos++)
+                    ret |= ((_data[_pos >> 3] >> (_pos & 7)) & 1u) << i;
+                return ret;
+            }
+        private:
+            const uint8_t* _data;
+            uint32_t _pos = 0;
+        };
+
+        class BitWriter
+        {
+        public:
+            BitWriter(uint8_t* data) : _data(data) { std::memset(_data, 0, PhyreBC6H::BLOCK_SIZE); }
+            void write(uint32_t value, uint32_t bits)
+            {
+                for (uint32_t i = 0; i < bits; i++, _pos++)
+                    _data[_pos >> 3] |= static_cast<uint8_t>(((value >> i) & 1u) << (_pos & 7));
+            }
+        private:
+            uint8_t* _data;
+            uint32_t _pos = 0;
+        };
+
+        const uint8_t weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+        const uint8_t weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        const uint8_t* weightsFor(uint32_t bits)
+        {
+            return bits == 3 ? weights3 : weights4;
+        }
+
+        // Row of the source block that ends up in row r when the first rows rows are reversed.
+        uint32_t sourceRow(uint32_t r, uint32_t rows)
+        {
+            return r < rows ? rows - 1 - r : r;
+        }
+
+        int32_t signExtend(uint32_t value, uint32_t bits)
+        {
+            const uint32_t sign = 1u << (bits - 1);
+            return static_cast<int32_t>((value & (sign * 2 - 1)) ^ sign) - static_cast<int32_t>(sign);
+        }
+
+        // Endpoint of bits precision to the 16 bit range values are interpolated in.
+        int32_t unquantize(uint32_t stored, uint32_t bits, bool isSigned)
+        {
+            if (!isSigned)
+            {
+                const int32_t value = static_cast<int32_t>(stored);
+                if (bits >= 15 || value == 0)
+                    return value;
+                if (value == (1 << bits) - 1)
+                    return 0xFFFF;
+                return ((value << 16) + 0x8000) >> bits;
+            }
+
+            const int32_t value = signExtend(stored, bits);
+            if (bits >= 16)
+                return value;
+            const int32_t magnitude = std::abs(value);
+            int32_t ret;
+            if (magnitude == 0)
+                ret = 0;
+            else if (magnitude >= (1 << (bits - 1)) - 1)
+                ret = 0x7FFF;
+            else
+                ret = ((magnitude << 15) + 0x4000) >> (bits - 1);
+            return value < 0 ? -ret : ret;
+        }
+
+        int32_t interpolate(int32_t e0, int32_t e1, uint32_t weight)
+        {
+            return (e0 * static_cast<int32_t>(64 - weight) + e1 * static_cast<int32_t>(weight) + 32) >> 6;
+        }
+
+        // The stored endpoint of bits precision that unquantizes closest to value.
+        uint32_t quantize(float value, uint32_t bits, bool isSigned)
+        {
+            const int32_t high = isSigned ? (1 << (bits - 1)) - 1 : (1 << bits) - 1;
+            const int32_t low = isSigned ? -high : 0;
+            const float scale = isSigned ? static_cast<float>(1 << (bits - 1)) / 32768.0f : static_cast<float>(1 << bits) / 65536.0f;
+            const long guess = std::lround(std::fabs(value) * scale - 0.5f) * (value < 0 ? -1 : 1);
+            const uint32_t mask = (1u << bits) - 1;
+
+            uint32_t ret = 0;
+            int64_t best = INT64_MAX;
+            for (long q = std::max<long>(low, guess - 1); q <= std::min<long>(high, guess + 1); q++)
+            {
+                const uint32_t stored = static_cast<uint32_t>(q) & mask;
+                const int64_t error = std::llabs(static_cast<int64_t>(std::lround(value)) - unquantize(stored, bits, isSigned));
+                if (error < best)
+                {
+                    best = error;
+                    ret = stored;
+                }
+            }
+            return ret;
+        }
+
+        // Squared error of the pixels mask selects against one region, their indices are set.
+        uint64_t fitRegion(const int32_t (*values)[3], const bool* mask, const uint32_t (*endpoints)[3], uint32_t bits, uint32_t indexBits,
+            bool isSigned, uint8_t* indices)
+        {
+            int32_t palette[16][3];
+            for (uint32_t w = 0; w < (1u << indexBits); w++)
+                for (uint32_t c = 0; c < 3; c++)
+                    palette[w][c] = interpolate(unquantize(endpoints[0][c], bits, isSigned), unquantize(endpoints[1][c], bits, isSigned), weightsFor(indexBits)[w]);
+
+            uint64_t ret = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (!mask[i])
+                    continue;
+                uint64_t best = UINT64_MAX;
+                for (uint32_t w = 0; w < (1u << indexBits); w++)
+                {
+                    uint64_t error = 0;
+                    for (uint32_t c = 0; c < 3; c++)
+                    {
+                        const int64_t diff = values[i][c] - palette[w][c];
+                        error += static_cast<uint64_t>(diff * diff);
+                    }
+                    if (error < best)
+                    {
+                        best = error;
+                        indices[i] = static_cast<uint8_t>(w);
+                    }
+                }
+                ret += best;
+            }
+            return ret;
+        }
+
+        // Ends of the principal axis of the pixels mask selects.
+        void axisEndpoints(const int32_t (*values)[3], const bool* mask, float* end0, float* end1)
+        {
+            float mean[3] = {};
+            uint32_t count = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (!mask[i])
+                    continue;
+                for (uint32_t c = 0; c < 3; c++)
+                    mean[c] += static_cast<float>(values[i][c]);
+                count++;
+            }
+            for (uint32_t c = 0; c < 3; c++)
+                mean[c] /= static_cast<float>(std::max(count, 1u));
+
+            float covariance[3][3] = {};
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (!mask[i])
+                    continue;
+                for (uint32_t a = 0; a < 3; a++)
+                    for (uint32_t b = 0; b < 3; b++)
+                        covariance[a][b] += (values[i][a] - mean[a]) * (values[i][b] - mean[b]);
+            }
+
+            // Power iteration from the row of the channel that varies most, a flat region keeps the gray diagonal.
+            uint32_t start = 0;
+            for (uint32_t c = 1; c < 3; c++)
+                if (covariance[c][c] > covariance[start][start])
+                    start = c;
+            float axis[3] = { 1.0f, 1.0f, 1.0f };
+            if (covariance[start][start] > 0.0f)
+                for (uint32_t c = 0; c < 3; c++)
+                    axis[c] = covariance[start][c];
+            for (uint32_t iteration = 0; iteration < 8; iteration++)
+            {
+                float next[3] = {};
+                float largest = 0;
+                for (uint32_t a = 0; a < 3; a++)
+                {
+                    for (uint32_t b = 0; b < 3; b++)
+                        next[a] += covariance[a][b] * axis[b];
+                    largest = std::max(largest, std::fabs(next[a]));
+                }
+                if (largest <= 0.0f)
+                    break;
+                for (uint32_t c = 0; c < 3; c++)
+                    axis[c] = next[c] / largest;
+            }
+            const float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            for (uint32_t c = 0; c < 3; c++)
+                axis[c] /= length;
+
+            float low = 0, high = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (!mask[i])
+                    continue;
+                float t = 0;
+                for (uint32_t c = 0; c < 3; c++)
+                    t += (values[i][c] - mean[c]) * axis[c];
+                low = std::min(low, t);
+                high = std::max(high, t);
+            }
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                end0[c] = mean[c] + axis[c] * low;
+                end1[c] = mean[c] + axis[c] * high;
+            }
+        }
+
+        // Endpoints that minimize the squared error for the indices a fit picked.
+        bool leastSquares(const int32_t (*values)[3], const bool* mask, const uint8_t* indices, uint32_t indexBits, float* end0, float* end1)
+        {
+            float aa = 0, ab = 0, bb = 0;
+            float ax[3] = {}, bx[3] = {};
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (!mask[i])
+                    continue;
+                const float beta = weightsFor(indexBits)[indices[i]] / 64.0f;
+                const float alpha = 1.0f - beta;
+                aa += alpha * alpha;
+                ab += alpha * beta;
+                bb += beta * beta;
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    ax[c] += alpha * values[i][c];
+                    bx[c] += beta * values[i][c];
+                }
+            }
+
+            const float det = aa * bb - ab * ab;
+            if (std::fabs(det) < 1e-6f)
+                return false;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                end0[c] = (ax[c] * bb - bx[c] * ab) / det;
+                end1[c] = (bx[c] * aa - ax[c] * ab) / det;
+            }
+            return true;
+        }
+
+        // Axis endpoints quantized to bits, then refined by least squares while that helps. Returns the squared error.
+        uint64_t encodeRegion(const int32_t (*values)[3], const bool* mask, uint32_t bits, uint32_t indexBits, bool isSigned,
+            uint32_t refinements, uint32_t (*endpoints)[3], uint8_t* indices)
+        {
+            const float range = isSigned ? 32767.0f : 65535.0f;
+            float ends[2][3];
+            axisEndpoints(values, mask, ends[0], ends[1]);
+
+            uint64_t ret = UINT64_MAX;
+            for (uint32_t iteration = 0; iteration <= refinements && ret > 0; iteration++)
+            {
+                if (iteration && !leastSquares(values, mask, indices, indexBits, ends[0], ends[1]))
+                    break;
+
+                uint32_t candidate[2][3];
+                for (uint32_t e = 0; e < 2; e++)
+                    for (uint32_t c = 0; c < 3; c++)
+                        candidate[e][c] = quantize(std::clamp(ends[e][c], isSigned ? -range : 0.0f, range), bits, isSigned);
+
+                uint8_t candidateIndices[16];
+                const uint64_t error = fitRegion(values, mask, candidate, bits, indexBits, isSigned, candidateIndices);
+                if (error >= ret)
+                    break;
+                ret = error;
+                std::memcpy(endpoints, candidate, sizeof(candidate));
+                for (uint32_t i = 0; i < 16; i++)
+                    if (mask[i])
+                        indices[i] = candidateIndices[i];
+            }
+            return ret;
+        }
+    }
+
+    const PhyreBC6H::_tModeInfo PhyreBC6H::_modes[14] =
+    {
+        { 0x00, 2, 2, true, 10, { 5, 5, 5 }, 3 },
+        { 0x01, 2, 2, true, 7, { 6, 6, 6 }, 3 },
+        { 0x02, 5, 2, true, 11, { 5, 4, 4 }, 3 },
+        { 0x06, 5, 2, true, 11, { 4, 5, 4 }, 3 },
+        { 0x0A, 5, 2, true, 11, { 4, 4, 5 }, 3 },
+        { 0x0E, 5, 2, true, 9, { 5, 5, 5 }, 3 },
+        { 0x12, 5, 2, true, 8, { 6, 5, 5 }, 3 },
+        { 0x16, 5, 2, true, 8, { 5, 6, 5 }, 3 },
+        { 0x1A, 5, 2, true, 8, { 5, 5, 6 }, 3 },
+        { 0x1E, 5, 2, false, 6, { 6, 6, 6 }, 3 },
+        { 0x03, 5, 1, false, 10, { 10, 10, 10 }, 4 },
+        { 0x07, 5, 1, true, 11, { 9, 9, 9 }, 4 },
+        { 0x0B, 5, 1, true, 12, { 8, 8, 8 }, 4 },
+        { 0x0F, 5, 1, true, 16, { 4, 4, 4 }, 4 },
+    };
+
+    /*
+    * Header bits after the mode, lowest first, in the notation of the
+    * format documentation: channel, then endpoint w x y z, then the bit or
+    * a range. A range [a:b] starts with bit b, so [10:15] runs backwards.
+    * d is the partition.
+    */
+    const char* const PhyreBC6H::_layouts[14] =
+    {
+        "gy4 by4 bz4 rw[9:0] gw[9:0] bw[9:0] rx[4:0] gz4 gy[3:0] gx[4:0] bz0 gz[3:0] bx[4:0] bz1 by[3:0] ry[4:0] bz2 rz[4:0] bz3 d[4:0]",
+        "gy5 gz4 gz5 rw[6:0] bz0 bz1 by4 gw[6:0] by5 bz2 gy4 bw[6:0] bz3 bz5 bz4 rx[5:0] gy[3:0] gx[5:0] gz[3:0] bx[5:0] by[3:0] ry[5:0] rz[5:0] d[4:0]",
+        "rw[9:0] gw[9:0] bw[9:0] rx[4:0] rw10 gy[3:0] gx[3:0] gw10 bz0 gz[3:0] bx[3:0] bw10 bz1 by[3:0] ry[4:0] bz2 rz[4:0] bz3 d[4:0]",
+        "rw[9:0] gw[9:0] bw[9:0] rx[3:0] rw10 gz4 gy[3:0] gx[4:0] gw10 gz[3:0] bx[3:0] bw10 bz1 by[3:0] ry[3:0] bz0 bz2 rz[3:0] gy4 bz3 d[4:0]",
+        "rw[9:0] gw[9:0] bw[9:0] rx[3:0] rw10 by4 gy[3:0] gx[3:0] gw10 bz0 gz[3:0] bx[4:0] bw10 by[3:0] ry[3:0] bz1 bz2 rz[3:0] bz4 bz3 d[4:0]",
+        "rw[8:0] by4 gw[8:0] gy4 bw[8:0] bz4 rx[4:0] gz4 gy[3:0] gx[4:0] bz0 gz[3:0] bx[4:0] bz1 by[3:0] ry[4:0] bz2 rz[4:0] bz3 d[4:0]",
+        "rw[7:0] gz4 by4 gw[7:0] bz2 gy4 bw[7:0] bz3 bz4 rx[5:0] gy[3:0] gx[4:0] bz0 gz[3:0] bx[4:0] bz1 by[3:0] ry[5:0] rz[5:0] d[4:0]",
+        "rw[7:0] bz0 by4 gw[7:0] gy5 gy4 bw[7:0] gz5 bz4 rx[4:0] gz4 gy[3:0] gx[5:0] gz[3:0] bx[4:0] bz1 by[3:0] ry[4:0] bz2 rz[4:0] bz3 d[4:0]",
+        "rw[7:0] bz1 by4 gw[7:0] by5 gy4 bw[7:0] bz5 bz4 rx[4:0] gz4 gy[3:0] gx[4:0] bz0 gz[3:0] bx[5:0] by[3:0] ry[4:0] bz2 rz[4:0] bz3 d[4:0]",
+        "rw[5:0] gz4 bz0 bz1 by4 gw[5:0] gy5 by5 bz2 gy4 bw[5:0] gz5 bz3 bz5 bz4 rx[5:0] gy[3:0] gx[5:0] gz[3:0] bx[5:0] by[3:0] ry[5:0] rz[5:0] d[4:0]",
+        "rw[9:0] gw[9:0] bw[9:0] rx[9:0] gx[9:0] bx[9:0]",
+        "rw[9:0] gw[9:0] bw[9:0] rx[8:0] rw10 gx[8:0] gw10 bx[8:0] bw10",
+        "rw[9:0] gw[9:0] bw[9:0] rx[7:0] rw[10:11] gx[7:0] gw[10:11] bx[7:0] bw[10:11]",
+        "rw[9:0] gw[9:0] bw[9:0] rx[3:0] rw[10:15] gx[3:0] gw[10:15] bx[3:0] bw[10:15]",
+    };
+
+    const PhyreBC6H::_tHeaderBit* PhyreBC6H::_headerBits(uint32_t mode, uint32_t& count)
+    {
+        static const auto headers = []()
+        {
+            struct _tHeader { _tHeaderBit bits[80]; uint32_t count; };
+            struct _tHeaders { _tHeader modes[14]; };
+            static _tHeaders ret{};
+            for (uint32_t m = 0; m < 14; m++)
+            {
+                _tHeader& header = ret.modes[m];
+                static const char channels[] = "rgb";
+                static const char endpoints[] = "wxyz";
+                for (const char* field = _layouts[m]; *field; )
+                {
+                    const bool isPartition = *field == 'd';
+                    const uint8_t channel = static_cast<uint8_t>(isPartition ? 0 : std::strchr(channels, field[0]) - channels);
+                    const uint8_t endpoint = static_cast<uint8_t>(isPartition ? 4 : std::strchr(endpoints, field[1]) - endpoints);
+                    char* end;
+
+                    long from, to;
+                    if (field[isPartition ? 1 : 2] == '[')
+                    {
+                        to = std::strtol(field + (isPartition ? 2 : 3), &end, 10);
+                        from = std::strtol(end + 1, &end, 10);
+                        end++;
+                    }
+                    else
+                    {
+                        from = to = std::strtol(field + 2, &end, 10);
+                    }
+                    for (long bit = from; ; bit += from < to ? 1 : -1)
+                    {
+                        header.bits[header.count++] = { endpoint, channel, static_cast<uint8_t>(bit) };
+                        if (bit == to)
+                            break;
+                    }
+
+                    field = end;
+                    while (*field == ' ')
+                        field++;
+                }
+            }
+            return &ret;
+        }();
+        count = headers->modes[mode].count;
+        return headers->modes[mode].bits;
+    }
+
+    bool PhyreBC6H::_unpack(const uint8_t* src, _tBlock& block)
+    {
+        block = _tBlock{};
+        BitReader reader(src);
+        uint32_t code = reader.read(2);
+        if (code > 1)
+            code |= reader.read(3) << 2;
+
+        uint32_t mode = 0;
+        while (mode < 14 && _modes[mode].code != code)
+            mode++;
+        // The four reserved modes decode to black.
+        if (mode == 14)
+            return false;
+
+        const _tModeInfo& info = _modes[mode];
+        block.mode = static_cast<uint8_t>(mode);
+
+        uint32_t fields[4][3] = {};
+        uint32_t count;
+        const _tHeaderBit* bits = _headerBits(mode, count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t value = reader.read(1) << bits[i].bit;
+            if (bits[i].endpoint == 4)
+                block.partition = static_cast<uint8_t>(block.partition | value);
+            else
+                fields[bits[i].endpoint][bits[i].channel] |= value;
+        }
+
+        const uint32_t mask = (1u << info.endpointBits) - 1;
+        for (uint32_t e = 0; e < info.regions * 2u; e++)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                if (e == 0 || !info.transformed)
+                    block.endpoints[e][c] = fields[e][c];
+                else
+                    block.endpoints[e][c] = (fields[0][c] + static_cast<uint32_t>(signExtend(fields[e][c], info.deltaBits[c]))) & mask;
+            }
+        }
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const bool anchor = i == PhyreBC7::_anchor(info.regions, block.partition, PhyreBC7::_subset(info.regions, block.partition, i));
+            block.indices[i] = static_cast<uint8_t>(reader.read(info.indexBits - (anchor ? 1 : 0)));
+        }
+        return true;
+    }
+
+    bool PhyreBC6H::_pack(const _tBlock& block, uint8_t* dst)
+    {
+        const _tModeInfo& info = _modes[block.mode];
+        const uint32_t mask = (1u << info.endpointBits) - 1;
+
+        uint32_t fields[4][3] = {};
+        for (uint32_t e = 0; e < info.regions * 2u; e++)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                if (e == 0 || !info.transformed)
+                {
+                    fields[e][c] = block.endpoints[e][c];
+                    continue;
+                }
+                const int32_t delta = signExtend((block.endpoints[e][c] - block.endpoints[0][c]) & mask, info.endpointBits);
+                const int32_t limit = 1 << (info.deltaBits[c] - 1);
+                if (delta < -limit || delta >= limit)
+                    return false;
+                fields[e][c] = static_cast<uint32_t>(delta) & ((1u << info.deltaBits[c]) - 1);
+            }
+        }
+
+        BitWriter writer(dst);
+        writer.write(info.code, info.codeBits);
+        uint32_t count;
+        const _tHeaderBit* bits = _headerBits(block.mode, count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t value = bits[i].endpoint == 4 ? block.partition : fields[bits[i].endpoint][bits[i].channel];
+            writer.write(value >> bits[i].bit, 1);
+        }
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const bool anchor = i == PhyreBC7::_anchor(info.regions, block.partition, PhyreBC7::_subset(info.regions, block.partition, i));
+            writer.write(block.indices[i], info.indexBits - (anchor ? 1 : 0));
+        }
+        return true;
+    }
+
+    void PhyreBC6H::_decode(const _tBlock& block, bool isSigned, int32_t (*values)[3])
+    {
+        const _tModeInfo& info = _modes[block.mode];
+        int32_t endpoints[4][3];
+        for (uint32_t e = 0; e < info.regions * 2u; e++)
+            for (uint32_t c = 0; c < 3; c++)
+                endpoints[e][c] = unquantize(block.endpoints[e][c], info.endpointBits, isSigned);
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const uint32_t region = PhyreBC7::_subset(info.regions, block.partition, i);
+            for (uint32_t c = 0; c < 3; c++)
+                values[i][c] = interpolate(endpoints[region * 2][c], endpoints[region * 2 + 1][c], weightsFor(info.indexBits)[block.indices[i]]);
+        }
+    }
+
+    uint64_t PhyreBC6H::_encodeMode(const int32_t (*values)[3], bool isSigned, uint32_t mode, uint32_t partition, uint32_t refinements, _tBlock& block)
+    {
+        const _tModeInfo& info = _modes[mode];
+        block = _tBlock{};
+        block.mode = static_cast<uint8_t>(mode);
+        block.partition = static_cast<uint8_t>(info.regions > 1 ? partition : 0);
+
+        uint64_t ret = 0;
+        for (uint32_t region = 0; region < info.regions; region++)
+        {
+            bool mask[16];
+            for (uint32_t i = 0; i < 16; i++)
+                mask[i] = PhyreBC7::_subset(info.regions, block.partition, i) == region;
+            ret += encodeRegion(values, mask, info.endpointBits, info.indexBits, isSigned, refinements, block.endpoints + region * 2, block.indices);
+        }
+
+        // Anchor indices are stored without their top bit, swapping the endpoints of the region clears it.
+        const uint32_t indexMax = (1u << info.indexBits) - 1;
+        for (uint32_t region = 0; region < info.regions; region++)
+        {
+            if (!(block.indices[PhyreBC7::_anchor(info.regions, block.partition, region)] >> (info.indexBits - 1)))
+                continue;
+            std::swap(block.endpoints[region * 2], block.endpoints[region * 2 + 1]);
+            for (uint32_t i = 0; i < 16; i++)
+                if (PhyreBC7::_subset(info.regions, block.partition, i) == region)
+                    block.indices[i] = static_cast<uint8_t>(indexMax - block.indices[i]);
+        }
+        return ret;
+    }
+
+    void PhyreBC6H::_encode(const int32_t (*values)[3], bool isSigned, uint32_t partition, _tBlock& block)
+    {
+        // Without a partition the one that fits best with untransformed endpoints is kept.
+        _tBlock candidate;
+        if (partition >= 32)
+        {
+            uint64_t best = UINT64_MAX;
+            for (uint32_t p = 0; p < 32; p++)
+            {
+                const uint64_t error = _encodeMode(values, isSigned, 9, p, 0, candidate);
+                if (error < best)
+                {
+                    best = error;
+                    partition = p;
+                }
+            }
+        }
+
+        // Untransformed modes always fit, transformed ones only when the deltas came out small enough.
+        uint64_t best = UINT64_MAX;
+        for (uint32_t mode = 0; mode < 14 && best > 0; mode++)
+        {
+            uint8_t packed[BLOCK_SIZE];
+            const uint64_t error = _encodeMode(values, isSigned, mode, partition, FLIP_REFINEMENTS, candidate);
+            if (error < best && _pack(candidate, packed))
+            {
+                best = error;
+                block = candidate;
+            }
+        }
+    }
+
+    void PhyreBC6H::decodeBlock(const uint8_t* src, bool isSigned, int32_t (*values)[3])
+    {
+        _tBlock block;
+        if (_unpack(src, block))
+            _decode(block, isSigned, values);
+        else
+            std::memset(values, 0, sizeof(int32_t) * 3 * 16);
+    }
+
+    void PhyreBC6H::encodeBlock(const int32_t (*values)[3], bool isSigned, uint8_t* dst)
+    {
+        _tBlock block;
+        _encode(values, isSigned, 32, block);
+        _pack(block, dst);
+    }
+
+    bool PhyreBC6H::flipBlock(uint8_t* dst, const uint8_t* src, uint32_t rows, bool isSigned, bool reencode)
+    {
+        rows = std::min(rows, 4u);
+        _tBlock block;
+        if (rows < 2 || !_unpack(src, block))
+        {
+            std::memmove(dst, src, BLOCK_SIZE);
+            return true;
+        }
+
+        const _tModeInfo& info = _modes[block.mode];
+        _tBlock flipped = block;
+        for (uint32_t i = 0; i < 16; i++)
+            flipped.indices[i] = block.indices[sourceRow(i / 4, rows) * 4 + i % 4];
+
+        // The 32 partitions are the first two subset partitions of BC7.
+        bool exact = true;
+        if (info.regions > 1)
+        {
+            const PhyreBC7::_tPartitionFlip& partitionFlip = PhyreBC7::_partitionFlip(2, 5, block.partition, rows);
+            exact = partitionFlip.valid;
+            if (exact)
+            {
+                flipped.partition = partitionFlip.partition;
+                for (uint32_t region = 0; region < 2; region++)
+                    std::memcpy(flipped.endpoints[partitionFlip.subsetMap[region] * 2], block.endpoints[region * 2], sizeof(block.endpoints[0]) * 2);
+            }
+        }
+
+        if (exact)
+        {
+            // Anchor indices lose their top bit, restore that by swapping endpoints and inverting the region.
+            const uint32_t indexMax = (1u << info.indexBits) - 1;
+            for (uint32_t region = 0; region < info.regions; region++)
+            {
+                if (!(flipped.indices[PhyreBC7::_anchor(info.regions, flipped.partition, region)] >> (info.indexBits - 1)))
+                    continue;
+                std::swap(flipped.endpoints[region * 2], flipped.endpoints[region * 2 + 1]);
+                for (uint32_t i = 0; i < 16; i++)
+                    if (PhyreBC7::_subset(info.regions, flipped.partition, i) == region)
+                        flipped.indices[i] = static_cast<uint8_t>(indexMax - flipped.indices[i]);
+            }
+
+            // Modes of the same precision split the delta bits between the channels differently.
+            for (uint32_t m = 0; m < 14; m++)
+            {
+                const uint32_t mode = (block.mode + m) % 14;
+                const _tModeInfo& other = _modes[mode];
+                if (other.regions != info.regions || other.transformed != info.transformed || other.endpointBits != info.endpointBits)
+                    continue;
+                flipped.mode = static_cast<uint8_t>(mode);
+                if (_pack(flipped, dst))
+                    return true;
+            }
+        }
+
+        if (!reencode)
+        {
+            std::memmove(dst, src, BLOCK_SIZE);
+            return false;
+        }
+
+        int32_t values[16][3];
+        int32_t flippedValues[16][3];
+        _decode(block, isSigned, values);
+        for (uint32_t i = 0; i < 16; i++)
+            std::memcpy(flippedValues[i], values[sourceRow(i / 4, rows) * 4 + i % 4], sizeof(values[0]));
+        _encode(flippedValues, isSigned, exact ? flipped.partition : 32, flipped);
+        _pack(flipped, dst);
+        return false;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace phyre
+{
+    /*
+    * BC6H block level helpers, the HDR counterpart of PhyreBC7. Blocks
+    * are unpacked into mode, partition, endpoints at the base precision
+    * of the mode and indices, so they can be rearranged and packed again.
+    */
+    class PhyreBC6H
+    {
+    public:
+        static constexpr size_t BLOCK_SIZE = 16;
+
+        // Least squares passes for blocks flipBlock encodes again.
+        static constexpr uint32_t FLIP_REFINEMENTS = 2;
+
+        /*
+        * Vertically flips the first rows pixel rows of a block as
+        * PhyreBC7::flipBlock does. Most modes store three endpoints as
+        * deltas from the first, swapping endpoints to restore an anchor
+        * index changes those deltas. When they no longer fit, the other
+        * modes of the same precision are tried. Blocks that no mode
+        * holds exactly and blocks whose partition has no flipped
+        * counterpart are copied unflipped, or with reencode decoded,
+        * flipped and encoded again in whichever mode comes closest, which
+        * loses precision. false is returned for them either way.
+        */
+        static bool flipBlock(uint8_t* dst, const uint8_t* src, uint32_t rows, bool isSigned, bool reencode);
+
+        // Interpolated values of the 16 pixels row by row, before they become half floats. Reserved modes decode to 0.
+        static void decodeBlock(const uint8_t* src, bool isSigned, int32_t (*values)[3]);
+        // Encodes 16 such values in whichever mode and partition comes closest.
+        static void encodeBlock(const int32_t (*values)[3], bool isSigned, uint8_t* dst);
+
+    protected:
+        struct _tModeInfo
+        {
+            uint8_t code;
+            uint8_t codeBits;
+            uint8_t regions;
+            bool transformed;
+            uint8_t endpointBits;
+            uint8_t deltaBits[3];
+            uint8_t indexBits;
+        };
+
+        struct _tBlock
+        {
+            uint8_t mode;
+            uint8_t partition;
+            // Every endpoint at the base precision of the mode, deltas already applied.
+            uint32_t endpoints[4][3];
+            uint8_t indices[16];
+        };
+
+        // Where one header bit goes, endpoint 4 is the partition.
+        struct _tHeaderBit
+        {
+            uint8_t endpoint;
+            uint8_t channel;
+            uint8_t bit;
+        };
+
+        static const _tModeInfo _modes[14];
+        static const char* const _layouts[14];
+
+        static const _tHeaderBit* _headerBits(uint32_t mode, uint32_t& count);
+
+        static bool _unpack(const uint8_t* src, _tBlock& block);
+        // False when the deltas of a transformed mode don't fit its delta bits.
+        static bool _pack(const _tBlock& block, uint8_t* dst);
+
+        // Interpolated values of the 16 pixels, before they are turned into half floats.
+        static void _decode(const _tBlock& block, bool isSigned, int32_t (*values)[3]);
+        // Fits values to one mode and returns the squared error, the block may not pack if the mode is transformed.
+        static uint64_t _encodeMode(const int32_t (*values)[3], bool isSigned, uint32_t mode, uint32_t partition, uint32_t refinements, _tBlock& block);
+        // Encodes values in whichever mode comes closest, two region modes use partition or the best one for 32.
+        static void _encode(const int32_t (*values)[3], bool isSigned, uint32_t partition, _tBlock& block);
+    };
+}
@@ -0,0 +1,714 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "PhyreBC7.h"
+#include "PhyreBlockEncoder.h"
+
+namespace phyre
+{
+    namespace
+    {
+        class BitReader
+        {
+        public:
+            BitReader(const uint8_t* data) : _data(data) {}
+            uint32_t read(uint32_t bits)
+            {
+                uint32_t ret = 0;
+                for (uint32_t i = 0; i < bits; i++, _pos++)
+                    ret |= ((_data[_pos >> 3] >> (_pos & 7)) & 1u) << i;
+                return ret;
+            }
+        private:
+            const uint8_t* _data;
+            uint32_t _pos = 0;
+        };
+
+        class BitWriter
+        {
+        public:
+            BitWriter(uint8_t* data) : _data(data) { std::memset(_data, 0, PhyreBC7::BLOCK_SIZE); }
+            void write(uint32_t value, uint32_t bits)
+            {
+                for (uint32_t i = 0; i < bits; i++, _pos++)
+                    _data[_pos >> 3] |= static_cast<uint8_t>(((value >> i) & 1u) << (_pos & 7));
+            }
+        private:
+            uint8_t* _data;
+            uint32_t _pos = 0;
+        };
+
+        const uint8_t weights2[4] = { 0, 21, 43, 64 };
+        const uint8_t weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+        const uint8_t weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        const uint8_t* weightsFor(uint32_t bits)
+        {
+            return bits == 2 ? weights2 : bits == 3 ? weights3 : weights4;
+        }
+
+        uint8_t interpolate(uint32_t e0, uint32_t e1, uint32_t weight)
+        {
+            return static_cast<uint8_t>(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+        }
+
+        uint8_t unquantize(uint32_t value, uint32_t bits)
+        {
+            value <<= (8 - bits);
+            return static_cast<uint8_t>(value | (value >> bits));
+        }
+
+        // Row of the source block that ends up in row r when the first rows rows are reversed.
+        uint32_t sourceRow(uint32_t r, uint32_t rows)
+        {
+            return r < rows ? rows - 1 - r : r;
+        }
+
+        // Squared error of the pixels mask selects (all for a null mask) against one subset, their indices are set.
+        uint32_t fitSubset(const uint8_t* rgba, const bool* mask, const uint8_t* e0, const uint8_t* e1, uint32_t indexBits, uint8_t* indices)
+        {
+            uint8_t palette[16][4];
+            for (uint32_t w = 0; w < (1u << indexBits); w++)
+                for (uint32_t c = 0; c < 4; c++)
+                    palette[w][c] = interpolate(e0[c], e1[c], weightsFor(indexBits)[w]);
+
+            uint8_t fitted[16];
+            uint32_t errors[16];
+            PhyreBlockEncoder::fitPalette(rgba, palette, 1u << indexBits, fitted, errors);
+
+            uint32_t ret = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (mask && !mask[i])
+                    continue;
+                indices[i] = fitted[i];
+                ret += errors[i];
+            }
+            return ret;
+        }
+
+        /*
+        * Quantizes a pair of endpoints to endpointBits plus a p-bit each,
+        * or one shared by both, trying every p-bit combination. Channels
+        * past channels are opaque. Returns the error of the best fit.
+        */
+        uint32_t quantizeSubset(const uint8_t* rgba, const bool* mask, const float* end0, const float* end1, uint32_t channels,
+            uint32_t endpointBits, bool sharedPBit, uint32_t indexBits, uint8_t (*endpoints)[4], uint8_t* pBits, uint8_t* indices)
+        {
+            const float* ends[2] = { end0, end1 };
+            const float scale = static_cast<float>((1u << (endpointBits + 1)) - 1) / 255.0f;
+            const long maxValue = (1L << endpointBits) - 1;
+
+            uint32_t ret = UINT32_MAX;
+            for (uint32_t pair = 0; pair < 4; pair++)
+            {
+                const uint32_t p[2] = { pair & 1, sharedPBit ? pair & 1 : pair >> 1 };
+                if (sharedPBit && pair > 1)
+                    break;
+
+                uint8_t quantized[2][4], unquantized[2][4];
+                for (uint32_t e = 0; e < 2; e++)
+                {
+                    for (uint32_t c = 0; c < 4; c++)
+                    {
+                        if (c >= channels)
+                        {
+                            quantized[e][c] = 0;
+                            unquantized[e][c] = 255;
+                            continue;
+                        }
+                        const long value = std::clamp(std::lround((ends[e][c] * scale - p[e]) / 2.0f), 0L, maxValue);
+                        quantized[e][c] = static_cast<uint8_t>(value);
+                        unquantized[e][c] = unquantize((static_cast<uint32_t>(value) << 1) | p[e], endpointBits + 1);
+                    }
+                }
+
+                uint8_t candidate[16];
+                const uint32_t error = fitSubset(rgba, mask, unquantized[0], unquantized[1], indexBits, candidate);
+                if (error < ret)
+                {
+                    ret = error;
+                    std::memcpy(endpoints[0], quantized[0], 4);
+                    std::memcpy(endpoints[1], quantized[1], 4);
+                    pBits[0] = static_cast<uint8_t>(p[0]);
+                    pBits[1] = static_cast<uint8_t>(p[1]);
+                    for (uint32_t i = 0; i < 16; i++)
+                        if (!mask || mask[i])
+                            indices[i] = candidate[i];
+                }
+            }
+            return ret;
+        }
+
+        // Endpoints that minimize the squared error for the indices a fit picked.
+        bool leastSquares(const uint8_t* rgba, const bool* mask, const uint8_t* indices, uint32_t indexBits, uint32_t channels, float* end0, float* end1)
+        {
+            float aa = 0, ab = 0, bb = 0;
+            float ax[4] = {}, bx[4] = {};
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (mask && !mask[i])
+                    continue;
+                const float beta = weightsFor(indexBits)[indices[i]] / 64.0f;
+                const float alpha = 1.0f - beta;
+                aa += alpha * alpha;
+                ab += alpha * beta;
+                bb += beta * beta;
+                for (uint32_t c = 0; c < channels; c++)
+                {
+                    ax[c] += alpha * rgba[i * 4 + c];
+                    bx[c] += beta * rgba[i * 4 + c];
+                }
+            }
+
+            const float det = aa * bb - ab * ab;
+            if (std::fabs(det) < 1e-6f)
+                return false;
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                end0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+                end1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+            }
+            return true;
+        }
+
+        // Ends of the principal axis of the pixels mask selects.
+        void axisEndpoints(const uint8_t* rgba, const bool* mask, uint32_t channels, float* end0, float* end1)
+        {
+            float mean[4], axis[4];
+            PhyreBlockEncoder::principalAxis(rgba, mask, channels, mean, axis);
+            float low = 0, high = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (mask && !mask[i])
+                    continue;
+                float t = 0;
+                for (uint32_t c = 0; c < channels; c++)
+                    t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+                low = std::min(low, t);
+                high = std::max(high, t);
+            }
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                end0[c] = std::clamp(mean[c] + axis[c] * low, 0.0f, 255.0f);
+                end1[c] = std::clamp(mean[c] + axis[c] * high, 0.0f, 255.0f);
+            }
+        }
+
+        // Axis endpoints, quantized and then refined by least squares while that helps.
+        uint32_t encodeSubset(const uint8_t* rgba, const bool* mask, uint32_t channels, uint32_t endpointBits, bool sharedPBit,
+            uint32_t indexBits, uint32_t refinements, uint8_t (*endpoints)[4], uint8_t* pBits, uint8_t* indices)
+        {
+            float end0[4], end1[4];
+            axisEndpoints(rgba, mask, channels, end0, end1);
+            uint32_t ret = quantizeSubset(rgba, mask, end0, end1, channels, endpointBits, sharedPBit, indexBits, endpoints, pBits, indices);
+
+            for (uint32_t iteration = 0; iteration < refinements && ret > 0; iteration++)
+            {
+                if (!leastSquares(rgba, mask, indices, indexBits, channels, end0, end1))
+                    break;
+                uint8_t candidateEndpoints[2][4], candidatePBits[2], candidateIndices[16];
+                const uint32_t error = quantizeSubset(rgba, mask, end0, end1, channels, endpointBits, sharedPBit, indexBits,
+                    candidateEndpoints, candidatePBits, candidateIndices);
+                if (error >= ret)
+                    break;
+                ret = error;
+                std::memcpy(endpoints, candidateEndpoints, sizeof(candidateEndpoints));
+                std::memcpy(pBits, candidatePBits, sizeof(candidatePBits));
+                for (uint32_t i = 0; i < 16; i++)
+                    if (!mask || mask[i])
+                        indices[i] = candidateIndices[i];
+            }
+            return ret;
+        }
+    }
+
+    const PhyreBC7::_tModeInfo PhyreBC7::_modes[8] =
+    {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+    };
+
+    // Bit n set means pixel n belongs to the second subset.
+    const uint16_t PhyreBC7::_partitions2[64] =
+    {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+    };
+
+    const uint8_t PhyreBC7::_partitions3[64][16] =
+    {
+        { 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 },
+        { 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+        { 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 },
+        { 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+        { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 },
+        { 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+        { 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 },
+        { 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+        { 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 },
+        { 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+        { 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 },
+        { 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+        { 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 },
+        { 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+        { 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 },
+        { 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+        { 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 },
+        { 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+        { 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 },
+        { 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+        { 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 },
+        { 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+        { 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 },
+        { 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+        { 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 },
+        { 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+        { 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 },
+        { 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+        { 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 },
+        { 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+        { 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 },
+        { 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 },
+    };
+
+    const uint8_t PhyreBC7::_anchors2[64] =
+    {
+        15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+        15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+        15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+         6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+    };
+
+    const uint8_t PhyreBC7::_anchors3[2][64] =
+    {
+        {
+             3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+             3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+             8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+             3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+        },
+        {
+            15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+            15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+            15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+            15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+        },
+    };
+
+    uint8_t PhyreBC7::_subset(uint32_t subsets, uint32_t partition, uint32_t pixel)
+    {
+        if (subsets == 2)
+            return static_cast<uint8_t>((_partitions2[partition] >> pixel) & 1);
+        if (subsets == 3)
+            return _partitions3[partition][pixel];
+        return 0;
+    }
+
+    uint8_t PhyreBC7::_anchor(uint32_t subsets, uint32_t partition, uint32_t subset)
+    {
+        if (subset == 0)
+            return 0;
+        if (subsets == 2)
+            return _anchors2[partition];
+        return _anchors3[subset - 1][partition];
+    }
+
+    const PhyreBC7::_tPartitionFlip& PhyreBC7::_partitionFlip(uint32_t subsets, uint32_t partitionBits, uint32_t partition, uint32_t rows)
+    {
+        /*
+        * [table][rows - 2][partition], built once for the three partial flips
+        * a block can need. Mode 0 only addresses the first 16 three subset
+        * partitions and BC6H the first 32 two subset ones, so they get
+        * tables of their own.
+        */
+        static const auto flips = []()
+        {
+            struct _tFlips { _tPartitionFlip entries[4][3][64]; };
+            static _tFlips ret{};
+            const uint32_t tableSubsets[4] = { 2, 3, 3, 2 };
+            const uint32_t tablePartitions[4] = { 64, 64, 16, 32 };
+            for (uint32_t t = 0; t < 4; t++)
+            {
+                const uint32_t s = tableSubsets[t];
+                for (uint32_t r = 2; r <= 4; r++)
+                {
+                    for (uint32_t p = 0; p < tablePartitions[t]; p++)
+                    {
+                        uint8_t flipped[16];
+                        for (uint32_t i = 0; i < 16; i++)
+                            flipped[i] = _subset(s, p, sourceRow(i / 4, r) * 4 + i % 4);
+
+                        _tPartitionFlip& entry = ret.entries[t][r - 2][p];
+                        for (uint32_t q = 0; q < tablePartitions[t] && !entry.valid; q++)
+                        {
+                            // Rows past the image height are padding, their subsets don't matter.
+                            uint8_t subsetMap[3] = { 0xFF, 0xFF, 0xFF };
+                            bool match = true;
+                            for (uint32_t i = 0; i < r * 4 && match; i++)
+                            {
+                                const uint8_t target = _subset(s, q, i);
+                                if (subsetMap[flipped[i]] == 0xFF)
+                                    subsetMap[flipped[i]] = target;
+                                match = subsetMap[flipped[i]] == target;
+                            }
+
+                            // Subsets only present in padding take whatever label is left, the mapping has to be one to one.
+                            bool used[3] = { false, false, false };
+                            for (uint32_t k = 0; k < s && match; k++)
+                            {
+                                if (subsetMap[k] == 0xFF)
+                                    continue;
+                                match = !used[subsetMap[k]];
+                                used[subsetMap[k]] = true;
+                            }
+                            for (uint32_t k = 0; k < s && match; k++)
+                            {
+                                for (uint8_t target = 0; subsetMap[k] == 0xFF; target++)
+                                {
+                                    if (!used[target])
+                                    {
+                                        subsetMap[k] = target;
+                                        used[target] = true;
+                                    }
+                                }
+                            }
+                            if (match)
+                            {
+                                entry.partition = static_cast<uint8_t>(q);
+                                std::memcpy(entry.subsetMap, subsetMap, sizeof(subsetMap));
+                                entry.valid = true;
+                            }
+                        }
+                    }
+                }
+            }
+            return &ret;
+        }();
+        const uint32_t table = subsets == 2 ? (partitionBits == 6 ? 0 : 3) : partitionBits == 6 ? 1 : 2;
+        return flips->entries[table][rows - 2][partition];
+    }
+
+    bool PhyreBC7::_unpack(const uint8_t* src, _tBlock& block)
+    {
+        block = _tBlock{};
+        uint32_t mode = 0;
+        while (mode < 8 && !((src[0] >> mode) & 1))
+            mode++;
+        if (mode == 8)
+            return false;
+
+        const _tModeInfo& info = _modes[mode];
+        BitReader reader(src);
+        reader.read(mode + 1);
+        block.mode = static_cast<uint8_t>(mode);
+        block.partition = static_cast<uint8_t>(reader.read(info.partitionBits));
+        block.rotation = static_cast<uint8_t>(reader.read(info.rotationBits));
+        block.indexMode = static_cast<uint8_t>(reader.read(info.indexModeBits));
+
+        const uint32_t endpointCount = info.subsets * 2u;
+        for (uint32_t c = 0; c < 3; c++)
+            for (uint32_t e = 0; e < endpointCount; e++)
+                block.endpoints[e][c] = static_cast<uint8_t>(reader.read(info.colorBits));
+        if (info.alphaBits)
+            for (uint32_t e = 0; e < endpointCount; e++)
+                block.endpoints[e][3] = static_cast<uint8_t>(reader.read(info.alphaBits));
+
+        if (info.endpointPBits)
+            for (uint32_t e = 0; e < endpointCount; e++)
+                block.pBits[e] = static_cast<uint8_t>(reader.read(1));
+        if (info.sharedPBits)
+            for (uint32_t s = 0; s < info.subsets; s++)
+                block.pBits[s * 2] = block.pBits[s * 2 + 1] = static_cast<uint8_t>(reader.read(1));
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const bool anchor = i == _anchor(info.subsets, block.partition, _subset(info.subsets, block.partition, i));
+            block.indices[i] = static_cast<uint8_t>(reader.read(info.indexBits - (anchor ? 1 : 0)));
+        }
+        if (info.index2Bits)
+            for (uint32_t i = 0; i < 16; i++)
+                block.indices2[i] = static_cast<uint8_t>(reader.read(info.index2Bits - (i == 0 ? 1 : 0)));
+
+        return true;
+    }
+
+    void PhyreBC7::_pack(const _tBlock& block, uint8_t* dst)
+    {
+        const _tModeInfo& info = _modes[block.mode];
+        BitWriter writer(dst);
+        writer.write(1u << block.mode, block.mode + 1);
+        writer.write(block.partition, info.partitionBits);
+        writer.write(block.rotation, info.rotationBits);
+        writer.write(block.indexMode, info.indexModeBits);
+
+        const uint32_t endpointCount = info.subsets * 2u;
+        for (uint32_t c = 0; c < 3; c++)
+            for (uint32_t e = 0; e < endpointCount; e++)
+                writer.write(block.endpoints[e][c], info.colorBits);
+        if (info.alphaBits)
+            for (uint32_t e = 0; e < endpointCount; e++)
+                writer.write(block.endpoints[e][3], info.alphaBits);
+
+        if (info.endpointPBits)
+            for (uint32_t e = 0; e < endpointCount; e++)
+                writer.write(block.pBits[e], 1);
+        if (info.sharedPBits)
+            for (uint32_t s = 0; s < info.subsets; s++)
+                writer.write(block.pBits[s * 2], 1);
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const bool anchor = i == _anchor(info.subsets, block.partition, _subset(info.subsets, block.partition, i));
+            writer.write(block.indices[i], info.indexBits - (anchor ? 1 : 0));
+        }
+        if (info.index2Bits)
+            for (uint32_t i = 0; i < 16; i++)
+                writer.write(block.indices2[i], info.index2Bits - (i == 0 ? 1 : 0));
+    }
+
+    void PhyreBC7::decodeBlock(const uint8_t* src, uint8_t* rgba)
+    {
+        _tBlock block;
+        if (!_unpack(src, block))
+        {
+            std::memset(rgba, 0, 64);
+            return;
+        }
+
+        const _tModeInfo& info = _modes[block.mode];
+        const uint32_t pBit = (info.endpointPBits || info.sharedPBits) ? 1 : 0;
+
+        uint8_t endpoints[6][4];
+        for (uint32_t e = 0; e < info.subsets * 2u; e++)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+                endpoints[e][c] = unquantize((block.endpoints[e][c] << pBit) | (pBit ? block.pBits[e] : 0), info.colorBits + pBit);
+            endpoints[e][3] = info.alphaBits
+                ? unquantize((block.endpoints[e][3] << pBit) | (pBit ? block.pBits[e] : 0), info.alphaBits + pBit)
+                : 255;
+        }
+
+        // Modes 4 and 5 keep separate index sets for color and alpha.
+        const bool swapSets = block.indexMode != 0;
+        const uint32_t colorBits = swapSets ? info.index2Bits : info.indexBits;
+        const uint32_t alphaBits = info.index2Bits ? (swapSets ? info.indexBits : info.index2Bits) : info.indexBits;
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const uint32_t subset = _subset(info.subsets, block.partition, i);
+            const uint8_t* e0 = endpoints[subset * 2];
+            const uint8_t* e1 = endpoints[subset * 2 + 1];
+            const uint32_t colorIndex = swapSets ? block.indices2[i] : block.indices[i];
+            const uint32_t alphaIndex = info.index2Bits ? (swapSets ? block.indices[i] : block.indices2[i]) : block.indices[i];
+            uint8_t* pixel = rgba + i * 4;
+            for (uint32_t c = 0; c < 3; c++)
+                pixel[c] = interpolate(e0[c], e1[c], weightsFor(colorBits)[colorIndex]);
+            pixel[3] = interpolate(e0[3], e1[3], weightsFor(alphaBits)[alphaIndex]);
+
+            if (block.rotation)
+                std::swap(pixel[3], pixel[block.rotation - 1]);
+        }
+    }
+
+    uint32_t PhyreBC7::_encodeMode6(const uint8_t* rgba, uint32_t refinements, _tBlock& block)
+    {
+        block = _tBlock{};
+        block.mode = 6;
+        return encodeSubset(rgba, nullptr, 4, 7, false, 4, refinements, block.endpoints, block.pBits, block.indices);
+    }
+
+    uint32_t PhyreBC7::_encodeMode1(const uint8_t* rgba, uint32_t refinements, _tBlock& block)
+    {
+        // Ranks the partitions by how well unquantized axis endpoints fit each subset.
+        uint32_t estimates[64];
+        for (uint32_t partition = 0; partition < 64; partition++)
+        {
+            estimates[partition] = 0;
+            for (uint32_t s = 0; s < 2; s++)
+            {
+                bool mask[16];
+                for (uint32_t i = 0; i < 16; i++)
+                    mask[i] = _subset(2, partition, i) == s;
+
+                float end0[4], end1[4];
+                axisEndpoints(rgba, mask, 3, end0, end1);
+                uint8_t e0[4] = { 0, 0, 0, 255 }, e1[4] = { 0, 0, 0, 255 };
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    e0[c] = static_cast<uint8_t>(std::lround(end0[c]));
+                    e1[c] = static_cast<uint8_t>(std::lround(end1[c]));
+                }
+                uint8_t indices[16];
+                estimates[partition] += fitSubset(rgba, mask, e0, e1, 3, indices);
+            }
+        }
+
+        uint8_t order[64];
+        for (uint32_t partition = 0; partition < 64; partition++)
+            order[partition] = static_cast<uint8_t>(partition);
+        std::partial_sort(order, order + MODE1_CANDIDATES, order + 64,
+            [&](uint8_t a, uint8_t b) { return estimates[a] < estimates[b] || (estimates[a] == estimates[b] && a < b); });
+
+        uint32_t ret = UINT32_MAX;
+        for (uint32_t candidate = 0; candidate < MODE1_CANDIDATES; candidate++)
+        {
+            _tBlock encoded{};
+            encoded.mode = 1;
+            encoded.partition = order[candidate];
+
+            uint32_t error = 0;
+            for (uint32_t s = 0; s < 2; s++)
+            {
+                bool mask[16];
+                for (uint32_t i = 0; i < 16; i++)
+                    mask[i] = _subset(2, encoded.partition, i) == s;
+                error += encodeSubset(rgba, mask, 3, 6, true, 3, refinements, encoded.endpoints + s * 2, encoded.pBits + s * 2, encoded.indices);
+            }
+            if (error < ret)
+            {
+                ret = error;
+                block = encoded;
+            }
+        }
+        return ret;
+    }
+
+    void PhyreBC7::encodeBlock(const uint8_t* rgba, uint8_t* dst, uint32_t refinements, bool partitions)
+    {
+        _tBlock block;
+        const uint32_t error = _encodeMode6(rgba, refinements, block);
+
+        bool opaque = true;
+        for (uint32_t i = 0; i < 16; i++)
+            opaque = opaque && rgba[i * 4 + 3] == 255;
+        if (partitions && opaque && error > 0)
+        {
+            _tBlock twoSubsets;
+            if (_encodeMode1(rgba, refinements, twoSubsets) < error)
+                block = twoSubsets;
+        }
+
+        // Anchor indices are stored without their top bit, swapping the endpoints of the subset clears it.
+        const _tModeInfo& info = _modes[block.mode];
+        const uint32_t indexMax = (1u << info.indexBits) - 1;
+        for (uint32_t s = 0; s < info.subsets; s++)
+        {
+            if (!(block.indices[_anchor(info.subsets, block.partition, s)] >> (info.indexBits - 1)))
+                continue;
+            std::swap(block.endpoints[s * 2], block.endpoints[s * 2 + 1]);
+            std::swap(block.pBits[s * 2], block.pBits[s * 2 + 1]);
+            for (uint32_t i = 0; i < 16; i++)
+                if (_subset(info.subsets, block.partition, i) == s)
+                    block.indices[i] = static_cast<uint8_t>(indexMax - block.indices[i]);
+        }
+
+        _pack(block, dst);
+    }
+
+    bool PhyreBC7::flipBlock(uint8_t* dst, const uint8_t* src, uint32_t rows, bool reencode)
+    {
+        rows = std::min(rows, 4u);
+        _tBlock block;
+        if (rows < 2 || !_unpack(src, block))
+        {
+            std::memmove(dst, src, BLOCK_SIZE);
+            return true;
+        }
+
+        const _tModeInfo& info = _modes[block.mode];
+        _tBlock flipped = block;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const uint32_t from = sourceRow(i / 4, rows) * 4 + i % 4;
+            flipped.indices[i] = block.indices[from];
+            flipped.indices2[i] = block.indices2[from];
+        }
+
+        if (info.subsets > 1)
+        {
+            const _tPartitionFlip& partitionFlip = _partitionFlip(info.subsets, info.partitionBits, block.partition, rows);
+            if (!partitionFlip.valid && !reencode)
+            {
+                std::memmove(dst, src, BLOCK_SIZE);
+                return false;
+            }
+            if (!partitionFlip.valid)
+            {
+                uint8_t pixels[64];
+                uint8_t flippedPixels[64];
+                decodeBlock(src, pixels);
+                for (uint32_t r = 0; r < 4; r++)
+                    std::memcpy(flippedPixels + r * 16, pixels + sourceRow(r, rows) * 16, 16);
+                encodeBlock(flippedPixels, dst, FLIP_REFINEMENTS, true);
+                return false;
+            }
+
+            flipped.partition = partitionFlip.partition;
+            for (uint32_t s = 0; s < info.subsets; s++)
+            {
+                const uint32_t target = partitionFlip.subsetMap[s];
+                for (uint32_t e = 0; e < 2; e++)
+                {
+                    std::memcpy(flipped.endpoints[target * 2 + e], block.endpoints[s * 2 + e], 4);
+                    flipped.pBits[target * 2 + e] = block.pBits[s * 2 + e];
+                }
+            }
+        }
+
+        // Anchor indices lose their top bit, restore that by swapping endpoints and inverting the subset.
+        const uint32_t indexMax = (1u << info.indexBits) - 1;
+        for (uint32_t s = 0; s < info.subsets; s++)
+        {
+            const uint32_t anchor = _anchor(info.subsets, flipped.partition, s);
+            if (!(flipped.indices[anchor] >> (info.indexBits - 1)))
+                continue;
+
+            if (info.index2Bits)
+            {
+                // Primary indices drive color unless mode 4 swapped the sets.
+                const uint32_t first = flipped.indexMode ? 3 : 0;
+                const uint32_t last = flipped.indexMode ? 4 : 3;
+                for (uint32_t c = first; c < last; c++)
+                    std::swap(flipped.endpoints[0][c], flipped.endpoints[1][c]);
+            }
+            else
+            {
+                std::swap(flipped.endpoints[s * 2], flipped.endpoints[s * 2 + 1]);
+                std::swap(flipped.pBits[s * 2], flipped.pBits[s * 2 + 1]);
+            }
+
+            for (uint32_t i = 0; i < 16; i++)
+                if (_subset(info.subsets, flipped.partition, i) == s)
+                    flipped.indices[i] = static_cast<uint8_t>(indexMax - flipped.indices[i]);
+        }
+
+        if (info.index2Bits && (flipped.indices2[0] >> (info.index2Bits - 1)))
+        {
+            const uint32_t first = flipped.indexMode ? 0 : 3;
+            const uint32_t last = flipped.indexMode ? 3 : 4;
+            for (uint32_t c = first; c < last; c++)
+                std::swap(flipped.endpoints[0][c], flipped.endpoints[1][c]);
+
+            const uint32_t index2Max = (1u << info.index2Bits) - 1;
+            for (auto& index : flipped.indices2)
+                index = static_cast<uint8_t>(index2Max - index);
+        }
+
+        _pack(flipped, dst);
+        return true;
+    }
+}
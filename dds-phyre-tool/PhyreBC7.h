@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace phyre
+{
+    /*
+    * BC7 block level helpers. Blocks are unpacked into their logical
+    * fields (mode, partition, endpoints, indices) so they can be
+    * rearranged and packed again without going through pixels.
+    */
+    class PhyreBC7
+    {
+    public:
+        static constexpr size_t BLOCK_SIZE = 16;
+        // Mode 1 partitions encoded in full out of the ones that look best.
+        static constexpr uint32_t MODE1_CANDIDATES = 3;
+
+        // Least squares passes for blocks flipBlock encodes again.
+        static constexpr uint32_t FLIP_REFINEMENTS = 2;
+
+        /*
+        * Vertically flips the first rows pixel rows of a block (rows >= 4
+        * flips the whole block). Indices are permuted, the partition is
+        * replaced with its flipped counterpart and anchor indices are
+        * restored by swapping endpoints, the block stays exact. Not every
+        * partition has a flipped counterpart, on noisy data about one
+        * block in ten lacks one. Those blocks are copied unflipped, or with
+        * reencode decoded, flipped and encoded again with encodeBlock,
+        * which loses precision. false is returned for them either way.
+        */
+        static bool flipBlock(uint8_t* dst, const uint8_t* src, uint32_t rows, bool reencode);
+
+        // Decodes one block into 16 RGBA8 pixels, row by row.
+        static void decodeBlock(const uint8_t* src, uint8_t* rgba);
+
+        /*
+        * Encodes 16 RGBA8 pixels as mode 6 with endpoints on the principal
+        * axis, refined by up to refinements least squares passes.
+        * partitions also tries the two subset partitions of mode 1 on
+        * opaque blocks and keeps whichever block is closer.
+        */
+        static void encodeBlock(const uint8_t* rgba, uint8_t* dst, uint32_t refinements, bool partitions);
+
+    protected:
+        // Shares the partitions and their flips.
+        friend class PhyreBC6H;
+
+        struct _tModeInfo
+        {
+            uint8_t subsets;
+            uint8_t partitionBits;
+            uint8_t rotationBits;
+            uint8_t indexModeBits;
+            uint8_t colorBits;
+            uint8_t alphaBits;
+            uint8_t endpointPBits;
+            uint8_t sharedPBits;
+            uint8_t indexBits;
+            uint8_t index2Bits;
+        };
+
+        struct _tBlock
+        {
+            uint8_t mode;
+            uint8_t partition;
+            uint8_t rotation;
+            uint8_t indexMode;
+            uint8_t endpoints[6][4];
+            uint8_t pBits[6];
+            uint8_t indices[16];
+            uint8_t indices2[16];
+        };
+
+        struct _tPartitionFlip
+        {
+            uint8_t partition;
+            uint8_t subsetMap[3];
+            bool valid;
+        };
+
+        static const _tModeInfo _modes[8];
+        static const uint16_t _partitions2[64];
+        static const uint8_t _partitions3[64][16];
+        static const uint8_t _anchors2[64];
+        static const uint8_t _anchors3[2][64];
+
+        static uint8_t _subset(uint32_t subsets, uint32_t partition, uint32_t pixel);
+        static uint8_t _anchor(uint32_t subsets, uint32_t partition, uint32_t subset);
+        static const _tPartitionFlip& _partitionFlip(uint32_t subsets, uint32_t partitionBits, uint32_t partition, uint32_t rows);
+
+        // Both return the squared error of the block they fill in.
+        static uint32_t _encodeMode6(const uint8_t* rgba, uint32_t refinements, _tBlock& block);
+        static uint32_t _encodeMode1(const uint8_t* rgba, uint32_t refinements, _tBlock& block);
+
+        static bool _unpack(const uint8_t* src, _tBlock& block);
+        static void _pack(const _tBlock& block, uint8_t* dst);
+    };
+}
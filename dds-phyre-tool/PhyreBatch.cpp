@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "PhyreBatch.h"
+#include "PhyreContainer.h"
+#include "PhyreStats.h"
+
+namespace fs = std::filesystem;
+
+namespace phyre
+{
+    namespace
+    {
+        // Open files per group, well below the usual descriptor limits.
+        constexpr size_t MAX_GROUP_FILES = 256;
+        constexpr size_t FILE_ALIGNMENT = 64;
+        constexpr uint32_t PHYRE_MAGIC = 0x50485952UL;
+        constexpr uint32_t PHYRE_MAGIC_BE = 0x52594850UL;
+    }
+
+    PhyreBatch::PhyreBatch(std::unique_ptr<PhyreIO> io, size_t groupBytes)
+        : _io(std::move(io))
+        , _groupBytes(std::max<size_t>(groupBytes, HEADER_READ_SIZE))
+    {
+    }
+
+    void PhyreBatch::convertPhyre2DDS(const std::vector<_tJob>& jobs, const std::function<void(const _tResult&)>& done)
+    {
+        // The group buffer is taken from the arena and registered once, it is reused by every group.
+        if (_buffer.empty())
+        {
+            _buffer = PhyreArena::local().acquire(_groupBytes);
+            _io->registerBuffers({ { _buffer.data(), _buffer.size() } });
+        }
+
+        size_t next = 0;
+        while (next < jobs.size())
+        {
+            const size_t first = next;
+            std::vector<_tFile> files;
+            size_t used = 0;
+            for (; next < jobs.size() && files.size() < MAX_GROUP_FILES; next++)
+            {
+                _tFile file{};
+                try
+                {
+                    file.handle = PhyreIO::openFile(jobs[next].phyrePath, false);
+                    file.open = true;
+                    file.size = static_cast<size_t>(PhyreIO::fileSize(file.handle));
+                }
+                catch (PhyreException& e)
+                {
+                    file.error = e.what();
+                }
+
+                // A file that doesn't fit waits for the next group, unless it is alone in the buffer anyway.
+                const size_t slot = (file.size + FILE_ALIGNMENT - 1) & ~(FILE_ALIGNMENT - 1);
+                if (file.open && slot > _buffer.size() - used)
+                {
+                    if (!files.empty())
+                    {
+                        PhyreIO::closeFile(file.handle);
+                        break;
+                    }
+                    file.ownData = PhyreArena::local().acquire(file.size);
+                    file.data = file.ownData.data();
+                }
+                else if (file.open)
+                {
+                    file.data = _buffer.data() + used;
+                    used += slot;
+                }
+                files.push_back(std::move(file));
+            }
+
+            std::vector<_tResult> results(files.size());
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                results[i].phyrePath = jobs[first + i].phyrePath;
+                results[i].error = files[i].error;
+            }
+
+            _convertGroup(&jobs[first], results.data(), files);
+            for (const auto& result : results)
+                done(result);
+        }
+    }
+
+    void PhyreBatch::setPixelExactFlip(bool enabled, unsigned threads)
+    {
+        _pixelExactFlip = enabled;
+        _flipThreads = threads;
+    }
+
+    void PhyreBatch::_convertGroup(const _tJob* jobs, _tResult* results, std::vector<_tFile>& files)
+    {
+        std::vector<PhyreIO::_tRequest> requests;
+        std::vector<size_t> owners;
+        std::vector<fs::path> paths;
+
+        // Headers first, anything that isn't phyre is dropped before its payload is read.
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (!files[i].open)
+                continue;
+            requests.push_back({ files[i].handle, files[i].data, std::min(files[i].size, HEADER_READ_SIZE), 0, false, 0, 0 });
+            owners.push_back(i);
+            paths.push_back(jobs[i].phyrePath);
+        }
+        _run(requests, owners, paths, results, false);
+
+        requests.clear();
+        owners.clear();
+        paths.clear();
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (!files[i].open || !results[i].error.empty())
+                continue;
+
+            uint32_t magic = 0;
+            if (files[i].size >= sizeof(magic))
+                std::memcpy(&magic, files[i].data, sizeof(magic));
+            if (magic != PHYRE_MAGIC && magic != PHYRE_MAGIC_BE)
+            {
+                results[i].error = L"Invalid phyre file header";
+                continue;
+            }
+            if (files[i].size > HEADER_READ_SIZE)
+            {
+                requests.push_back({ files[i].handle, files[i].data + HEADER_READ_SIZE, files[i].size - HEADER_READ_SIZE, HEADER_READ_SIZE, false, 0, 0 });
+                owners.push_back(i);
+                paths.push_back(jobs[i].phyrePath);
+            }
+        }
+        _run(requests, owners, paths, results, false);
+
+        for (auto& file : files)
+        {
+            if (file.open)
+                PhyreIO::closeFile(file.handle);
+            file.open = false;
+        }
+
+        // Conversion runs in memory, the outputs of the whole group are then written together.
+        std::vector<PhyreArena::Buffer> outputs;
+        std::vector<size_t> outputOwners;
+        std::vector<fs::path> outputPaths;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (!results[i].error.empty())
+                continue;
+            try
+            {
+                PhyreContainer phyreFile{ PhyreView(files[i].data, files[i].size) };
+                phyreFile.SetWriteThreads(_flipThreads);
+                phyreFile.SetPixelExactFlip(_pixelExactFlip);
+                const size_t count = phyreFile.TextureCount();
+                for (size_t t = 0; t < count; t++)
+                {
+                    outputs.push_back(phyreFile.ConvertPhyre2DDS(t));
+                    outputOwners.push_back(i);
+                    outputPaths.push_back(PhyreContainer::TexturePath(jobs[i].ddsPath, t, count));
+                }
+                results[i].reencodedBlocks = phyreFile.ReencodedBlocks();
+            }
+            catch (PhyreException& e)
+            {
+                results[i].error = e.what();
+            }
+        }
+
+        if (_store)
+        {
+            for (size_t o = 0; o < outputs.size(); o++)
+            {
+                const size_t owner = outputOwners[o];
+                if (!results[owner].error.empty())
+                    continue;
+                try
+                {
+                    _store->add(outputs[o].view(), outputPaths[o]);
+                    results[owner].ddsPaths.push_back(outputPaths[o]);
+                }
+                catch (PhyreException& e)
+                {
+                    results[owner].error = e.what();
+                }
+            }
+            return;
+        }
+
+        requests.clear();
+        owners.clear();
+        paths.clear();
+        for (size_t o = 0; o < outputs.size(); o++)
+        {
+            const size_t owner = outputOwners[o];
+            if (!results[owner].error.empty())
+                continue;
+            try
+            {
+                requests.push_back({ PhyreIO::openFile(outputPaths[o], true), outputs[o].data(), outputs[o].size(), 0, true, 0, 0 });
+                owners.push_back(owner);
+                paths.push_back(outputPaths[o]);
+            }
+            catch (PhyreException& e)
+            {
+                results[owner].error = e.what();
+            }
+        }
+        _run(requests, owners, paths, results, true);
+
+        for (size_t r = 0; r < requests.size(); r++)
+        {
+            PhyreIO::closeFile(requests[r].file);
+            if (requests[r].error == 0)
+                results[owners[r]].ddsPaths.push_back(paths[r]);
+        }
+    }
+
+    void PhyreBatch::_run(std::vector<PhyreIO::_tRequest>& requests, const std::vector<size_t>& owners, const std::vector<fs::path>& paths,
+        _tResult* results, bool write)
+    {
+        if (requests.empty())
+            return;
+
+        const PhyreStats::_eStage stage = write ? PhyreStats::stageWrite : PhyreStats::stageRead;
+        PhyreStats::Timer timer(stage);
+        _io->run(requests.data(), requests.size());
+
+        uint64_t bytes = 0;
+        for (size_t r = 0; r < requests.size(); r++)
+        {
+            auto& request = requests[r];
+            bytes += request.done;
+
+            // A read can only come up short if the file shrank since its size was taken.
+            if (request.error != 0 || request.done != request.size)
+            {
+                request.error = request.error ? request.error : -1;
+                std::wstring& error = results[owners[r]].error;
+                if (error.empty())
+                    error = (write ? L"Cannot write file: " : L"Cannot read file: ") + paths[r].wstring();
+            }
+        }
+        if (write)
+            PhyreStats::addWritten(stage, bytes, requests.size());
+        else
+            PhyreStats::addRead(stage, bytes, requests.size());
+    }
+}
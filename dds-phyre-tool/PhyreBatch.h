@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PhyreArena.h"
+#include "PhyreIO.h"
+#include "PhyreStore.h"
+
+namespace phyre
+{
+    /*
+    * Converts many phyre files to DDS with their I/O in flight together.
+    * Files are taken in groups that fit the buffer. The headers of a
+    * group are read in one batch, then the payloads of the files that
+    * look like phyre, and after the conversion in memory all DDS files
+    * of the group are written in one batch. The platform code converts
+    * between buffers and never learns which backend moved the bytes.
+    */
+    class PhyreBatch
+    {
+    public:
+        struct _tJob
+        {
+            std::filesystem::path phyrePath;
+            // Several textures are numbered after it, as in ConvertAllPhyre2DDS.
+            std::filesystem::path ddsPath;
+        };
+
+        struct _tResult
+        {
+            std::filesystem::path phyrePath;
+            std::vector<std::filesystem::path> ddsPaths;
+            // Empty when every texture was written.
+            std::wstring error;
+            // Blocks a pixel exact flip encoded again, with some loss.
+            uint64_t reencodedBlocks = 0;
+        };
+
+        static constexpr size_t DEFAULT_GROUP_BYTES = 64 * 1024 * 1024;
+        // Read first to tell phyre files from anything else before the rest is read.
+        static constexpr size_t HEADER_READ_SIZE = 4096;
+
+        PhyreBatch(std::unique_ptr<PhyreIO> io = PhyreIO::create(), size_t groupBytes = DEFAULT_GROUP_BYTES);
+        PhyreBatch(const PhyreBatch&) = delete;
+        PhyreBatch& operator=(const PhyreBatch&) = delete;
+        virtual ~PhyreBatch() = default;
+
+        // done is called for every job once its files are written or it failed, in job order.
+        void convertPhyre2DDS(const std::vector<_tJob>& jobs, const std::function<void(const _tResult&)>& done);
+
+        const PhyreIO& io() const { return *_io; }
+
+        // DDS files are added to the store instead of written in the batch, nullptr writes them again.
+        void setStore(PhyreStore* store) { _store = store; }
+        // Flips pixel exact as PhyreContainer::SetPixelExactFlip does, blocks are encoded again on threads threads.
+        void setPixelExactFlip(bool enabled, unsigned threads = 1);
+
+    private:
+        struct _tFile
+        {
+            PhyreIO::_tHandle handle;
+            bool open;
+            size_t size;
+            char* data;
+            // Only for files that don't fit the group buffer.
+            PhyreArena::Buffer ownData;
+            std::wstring error;
+        };
+
+        void _convertGroup(const _tJob* jobs, _tResult* results, std::vector<_tFile>& files);
+        // Runs the requests and puts an error into the results they belong to where one failed.
+        void _run(std::vector<PhyreIO::_tRequest>& requests, const std::vector<size_t>& owners, const std::vector<std::filesystem::path>& paths,
+            _tResult* results, bool write);
+
+        std::unique_ptr<PhyreIO> _io;
+        size_t _groupBytes;
+        PhyreArena::Buffer _buffer;
+        PhyreStore* _store = nullptr;
+        bool _pixelExactFlip = false;
+        unsigned _flipThreads = 1;
+    };
+}
@@ -0,0 +1,668 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PHYRE_ENCODE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "PhyreBlockEncoder.h"
+#include "PhyreBC7.h"
+#include "PhyreException.h"
+#include "PhyreParallel.h"
+#include "PhyreTextureDecoder.h"
+
+namespace phyre
+{
+    namespace
+    {
+        // Blocks a thread takes at a time, small enough to balance the last level of a chain.
+        constexpr size_t BLOCKS_PER_RUN = 256;
+        constexpr uint32_t LEAST_SQUARES_PASSES = 2;
+        constexpr uint32_t HIGH_SEARCH_PASSES = 4;
+
+        struct EndpointsBC1
+        {
+            uint16_t color0;
+            uint16_t color1;
+            uint8_t indices[16];
+            uint32_t error;
+        };
+
+        struct EndpointsAlpha
+        {
+            uint8_t alpha0;
+            uint8_t alpha1;
+            uint8_t indices[16];
+            uint32_t error;
+        };
+
+        uint16_t pack565(const float* color)
+        {
+            const long r = std::clamp(std::lround(color[0] * 31.0f / 255.0f), 0L, 31L);
+            const long g = std::clamp(std::lround(color[1] * 63.0f / 255.0f), 0L, 63L);
+            const long b = std::clamp(std::lround(color[2] * 31.0f / 255.0f), 0L, 31L);
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        // Pixels are fitted against a palette with alpha 255, transparent ones only leave out their error.
+        EndpointsBC1 scoreBC1(const uint8_t* opaque, const bool* transparent, uint16_t first, uint16_t second, bool threeColor)
+        {
+            EndpointsBC1 ret;
+            ret.color0 = threeColor ? std::min(first, second) : std::max(first, second);
+            ret.color1 = threeColor ? std::max(first, second) : std::min(first, second);
+
+            uint8_t palette[4][4];
+            PhyreTextureDecoder::paletteBC1(ret.color0, ret.color1, true, palette);
+            uint32_t errors[16];
+            PhyreBlockEncoder::fitPalette(opaque, palette, ret.color0 > ret.color1 ? 4 : 3, ret.indices, errors);
+
+            ret.error = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (transparent && transparent[i])
+                    ret.indices[i] = 3;
+                else
+                    ret.error += errors[i];
+            }
+            return ret;
+        }
+
+        // Endpoints that minimize the squared error for the indices a fit picked.
+        bool leastSquaresBC1(const uint8_t* opaque, const EndpointsBC1& fit, float* end0, float* end1)
+        {
+            static const float weights4[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+            static const float weights3[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+            const float* weights = fit.color0 > fit.color1 ? weights4 : weights3;
+
+            float aa = 0, ab = 0, bb = 0;
+            float ax[3] = {}, bx[3] = {};
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (fit.color0 <= fit.color1 && fit.indices[i] == 3)
+                    continue;
+                const float alpha = weights[fit.indices[i]];
+                const float beta = 1.0f - alpha;
+                aa += alpha * alpha;
+                ab += alpha * beta;
+                bb += beta * beta;
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    ax[c] += alpha * opaque[i * 4 + c];
+                    bx[c] += beta * opaque[i * 4 + c];
+                }
+            }
+
+            const float det = aa * bb - ab * ab;
+            if (std::fabs(det) < 1e-6f)
+                return false;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                end0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+                end1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+            }
+            return true;
+        }
+
+        EndpointsBC1 encodeColorBC1(const uint8_t* rgba, const bool* transparent, bool threeColor, PhyreBlockEncoder::_eQuality quality)
+        {
+            uint8_t opaque[64];
+            bool mask[16];
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                std::memcpy(opaque + i * 4, rgba + i * 4, 3);
+                opaque[i * 4 + 3] = 255;
+                mask[i] = !transparent || !transparent[i];
+            }
+
+            float mean[3], axis[3];
+            PhyreBlockEncoder::principalAxis(opaque, mask, 3, mean, axis);
+            float low = 0, high = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (!mask[i])
+                    continue;
+                float t = 0;
+                for (uint32_t c = 0; c < 3; c++)
+                    t += (opaque[i * 4 + c] - mean[c]) * axis[c];
+                low = std::min(low, t);
+                high = std::max(high, t);
+            }
+
+            float end0[3], end1[3];
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                end0[c] = mean[c] + axis[c] * high;
+                end1[c] = mean[c] + axis[c] * low;
+            }
+            EndpointsBC1 best = scoreBC1(opaque, transparent, pack565(end0), pack565(end1), threeColor);
+
+            if (quality >= PhyreBlockEncoder::qualityNormal)
+            {
+                for (uint32_t iteration = 0; iteration < LEAST_SQUARES_PASSES && best.error > 0; iteration++)
+                {
+                    if (!leastSquaresBC1(opaque, best, end0, end1))
+                        break;
+                    const EndpointsBC1 candidate = scoreBC1(opaque, transparent, pack565(end0), pack565(end1), threeColor);
+                    if (candidate.error >= best.error)
+                        break;
+                    best = candidate;
+                }
+            }
+
+            // Steps of one in every 565 field of either endpoint, as long as one of them helps.
+            if (quality >= PhyreBlockEncoder::qualityHigh)
+            {
+                static const uint16_t fieldShift[3] = { 11, 5, 0 };
+                static const uint16_t fieldMax[3] = { 31, 63, 31 };
+                bool improved = true;
+                for (uint32_t pass = 0; pass < HIGH_SEARCH_PASSES && improved && best.error > 0; pass++)
+                {
+                    improved = false;
+                    for (uint32_t e = 0; e < 2; e++)
+                    {
+                        for (uint32_t field = 0; field < 3; field++)
+                        {
+                            for (int delta = -1; delta <= 1; delta += 2)
+                            {
+                                uint16_t colors[2] = { best.color0, best.color1 };
+                                const int value = ((colors[e] >> fieldShift[field]) & fieldMax[field]) + delta;
+                                if (value < 0 || value > fieldMax[field])
+                                    continue;
+                                colors[e] = static_cast<uint16_t>((colors[e] & ~(fieldMax[field] << fieldShift[field])) | (value << fieldShift[field]));
+                                const EndpointsBC1 candidate = scoreBC1(opaque, transparent, colors[0], colors[1], threeColor);
+                                if (candidate.error < best.error)
+                                {
+                                    best = candidate;
+                                    improved = true;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            return best;
+        }
+
+        void writeBC1(const EndpointsBC1& fit, uint8_t* dst)
+        {
+            uint32_t indices = 0;
+            for (uint32_t i = 0; i < 16; i++)
+                indices |= static_cast<uint32_t>(fit.indices[i] & 3) << (i * 2);
+            dst[0] = static_cast<uint8_t>(fit.color0);
+            dst[1] = static_cast<uint8_t>(fit.color0 >> 8);
+            dst[2] = static_cast<uint8_t>(fit.color1);
+            dst[3] = static_cast<uint8_t>(fit.color1 >> 8);
+            for (uint32_t b = 0; b < 4; b++)
+                dst[4 + b] = static_cast<uint8_t>(indices >> (b * 8));
+        }
+
+        EndpointsAlpha scoreAlpha(const uint8_t* rgba, uint32_t channel, uint8_t alpha0, uint8_t alpha1)
+        {
+            EndpointsAlpha ret{ alpha0, alpha1, {}, 0 };
+            uint8_t palette[8];
+            PhyreTextureDecoder::paletteAlpha(alpha0, alpha1, palette);
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                uint32_t bestError = UINT32_MAX;
+                for (uint32_t w = 0; w < 8; w++)
+                {
+                    const int diff = static_cast<int>(palette[w]) - rgba[i * 4 + channel];
+                    const uint32_t error = static_cast<uint32_t>(diff * diff);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        ret.indices[i] = static_cast<uint8_t>(w);
+                    }
+                }
+                ret.error += bestError;
+            }
+            return ret;
+        }
+
+        // The BC3 alpha block, BC4 blocks take the values of any other channel.
+        void encodeAlpha(const uint8_t* rgba, uint32_t channel, uint8_t* dst, PhyreBlockEncoder::_eQuality quality)
+        {
+            uint8_t low = 255, high = 0, innerLow = 255, innerHigh = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                const uint8_t alpha = rgba[i * 4 + channel];
+                low = std::min(low, alpha);
+                high = std::max(high, alpha);
+                if (alpha != 0 && alpha != 255)
+                {
+                    innerLow = std::min(innerLow, alpha);
+                    innerHigh = std::max(innerHigh, alpha);
+                }
+            }
+
+            // Eight interpolated values across the range, a block of one value ends up in the six value mode.
+            EndpointsAlpha best = scoreAlpha(rgba, channel, high, low);
+            if (quality >= PhyreBlockEncoder::qualityNormal && best.error > 0)
+            {
+                // Six values between the inner extremes, 0 and 255 are exact in that mode.
+                const EndpointsAlpha candidate = innerLow <= innerHigh ? scoreAlpha(rgba, channel, innerLow, innerHigh) : scoreAlpha(rgba, channel, 0, 0);
+                if (candidate.error < best.error)
+                    best = candidate;
+            }
+            if (quality >= PhyreBlockEncoder::qualityHigh && best.error > 0 && high > low)
+            {
+                // A slightly narrower range can put the interpolated values closer to the pixels.
+                for (int alpha0 = high; alpha0 >= std::max<int>(low + 1, high - 3); alpha0--)
+                {
+                    for (int alpha1 = low; alpha1 <= std::min<int>(alpha0 - 1, low + 3); alpha1++)
+                    {
+                        const EndpointsAlpha candidate = scoreAlpha(rgba, channel, static_cast<uint8_t>(alpha0), static_cast<uint8_t>(alpha1));
+                        if (candidate.error < best.error)
+                            best = candidate;
+                    }
+                }
+            }
+
+            uint64_t indices = 0;
+            for (uint32_t i = 0; i < 16; i++)
+                indices |= static_cast<uint64_t>(best.indices[i] & 7) << (i * 3);
+            dst[0] = best.alpha0;
+            dst[1] = best.alpha1;
+            for (uint32_t b = 0; b < 6; b++)
+                dst[2 + b] = static_cast<uint8_t>(indices >> (b * 8));
+        }
+
+#ifndef PHYRE_ENCODE_SSE2
+        uint32_t fitPaletteScalar(const uint8_t* rgba, const uint8_t (*palette)[4], uint32_t paletteSize, uint8_t* indices, uint32_t* errors)
+        {
+            uint32_t ret = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                uint32_t bestError = UINT32_MAX;
+                for (uint32_t w = 0; w < paletteSize; w++)
+                {
+                    uint32_t error = 0;
+                    for (uint32_t c = 0; c < 4; c++)
+                    {
+                        const int diff = static_cast<int>(palette[w][c]) - rgba[i * 4 + c];
+                        error += static_cast<uint32_t>(diff * diff);
+                    }
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        indices[i] = static_cast<uint8_t>(w);
+                    }
+                }
+                if (errors)
+                    errors[i] = bestError;
+                ret += bestError;
+            }
+            return ret;
+        }
+#else
+        /*
+        * Pixels are widened to 16 bit lanes, two per register. madd squares
+        * and adds the differences in pairs, the pairs of four pixels are
+        * then gathered into one register of their distances.
+        */
+        uint32_t fitPaletteSSE2(const uint8_t* rgba, const uint8_t (*palette)[4], uint32_t paletteSize, uint8_t* indices, uint32_t* errors)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i pixels[8];
+            for (uint32_t g = 0; g < 4; g++)
+            {
+                const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + g * 16));
+                pixels[g * 2] = _mm_unpacklo_epi8(packed, zero);
+                pixels[g * 2 + 1] = _mm_unpackhi_epi8(packed, zero);
+            }
+
+            __m128i best[4], bestIndex[4];
+            for (uint32_t g = 0; g < 4; g++)
+            {
+                best[g] = _mm_set1_epi32(0x7FFFFFFF);
+                bestIndex[g] = zero;
+            }
+
+            for (uint32_t w = 0; w < paletteSize; w++)
+            {
+                int32_t entry;
+                std::memcpy(&entry, palette[w], sizeof(entry));
+                const __m128i color = _mm_unpacklo_epi8(_mm_set1_epi32(entry), zero);
+                const __m128i index = _mm_set1_epi32(static_cast<int>(w));
+                for (uint32_t g = 0; g < 4; g++)
+                {
+                    const __m128i low = _mm_sub_epi16(pixels[g * 2], color);
+                    const __m128i high = _mm_sub_epi16(pixels[g * 2 + 1], color);
+                    const __m128 lowPairs = _mm_castsi128_ps(_mm_madd_epi16(low, low));
+                    const __m128 highPairs = _mm_castsi128_ps(_mm_madd_epi16(high, high));
+                    const __m128i distance = _mm_add_epi32(
+                        _mm_castps_si128(_mm_shuffle_ps(lowPairs, highPairs, _MM_SHUFFLE(2, 0, 2, 0))),
+                        _mm_castps_si128(_mm_shuffle_ps(lowPairs, highPairs, _MM_SHUFFLE(3, 1, 3, 1))));
+
+                    // Strictly less, so ties keep the lower index like the scalar loop.
+                    const __m128i less = _mm_cmplt_epi32(distance, best[g]);
+                    best[g] = _mm_or_si128(_mm_and_si128(less, distance), _mm_andnot_si128(less, best[g]));
+                    bestIndex[g] = _mm_or_si128(_mm_and_si128(less, index), _mm_andnot_si128(less, bestIndex[g]));
+                }
+            }
+
+            uint32_t bestErrors[16], bestIndices[16];
+            for (uint32_t g = 0; g < 4; g++)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(bestErrors + g * 4), best[g]);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(bestIndices + g * 4), bestIndex[g]);
+            }
+
+            uint32_t ret = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                indices[i] = static_cast<uint8_t>(bestIndices[i]);
+                if (errors)
+                    errors[i] = bestErrors[i];
+                ret += bestErrors[i];
+            }
+            return ret;
+        }
+#endif
+
+        // Reads a pixel of an uncompressed source into RGBA order.
+        void readPixel(const char* src, PhyreTextureFormat::_eFormat source, uint8_t* rgba)
+        {
+            const uint8_t* pixel = reinterpret_cast<const uint8_t*>(src);
+            switch (source)
+            {
+            case PhyreTextureFormat::formatARGB8:
+            case PhyreTextureFormat::formatARGB8_SRGB:
+                rgba[0] = pixel[2];
+                rgba[1] = pixel[1];
+                rgba[2] = pixel[0];
+                rgba[3] = pixel[3];
+                break;
+            case PhyreTextureFormat::formatXRGB8:
+                rgba[0] = pixel[2];
+                rgba[1] = pixel[1];
+                rgba[2] = pixel[0];
+                rgba[3] = 255;
+                break;
+            default:
+                std::memcpy(rgba, pixel, 4);
+                break;
+            }
+        }
+    }
+
+    PhyreBlockEncoder::PhyreBlockEncoder(PhyreTextureFormat::_eFormat format, _eQuality quality, unsigned threads)
+        : _format(format)
+        , _quality(quality)
+        , _threads(threads ? threads : PhyreParallel::defaultThreads())
+    {
+        if (!canEncode(format))
+            throw PhyreException(L"No encoder for " + std::wstring(PhyreTextureFormat::traits(format).name, PhyreTextureFormat::traits(format).name + std::strlen(PhyreTextureFormat::traits(format).name)));
+    }
+
+    bool PhyreBlockEncoder::canEncode(PhyreTextureFormat::_eFormat format)
+    {
+        switch (format)
+        {
+        case PhyreTextureFormat::formatDXT1:
+        case PhyreTextureFormat::formatDXT1_SRGB:
+        case PhyreTextureFormat::formatDXT5:
+        case PhyreTextureFormat::formatDXT5_SRGB:
+        case PhyreTextureFormat::formatBC7:
+        case PhyreTextureFormat::formatBC7_SRGB:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool PhyreBlockEncoder::canEncodeFrom(PhyreTextureFormat::_eFormat source)
+    {
+        switch (source)
+        {
+        case PhyreTextureFormat::formatRGBA8:
+        case PhyreTextureFormat::formatRGBA8_SRGB:
+        case PhyreTextureFormat::formatARGB8:
+        case PhyreTextureFormat::formatARGB8_SRGB:
+        case PhyreTextureFormat::formatXRGB8:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    PhyreTextureFormat::_eFormat PhyreBlockEncoder::targetFor(PhyreTextureFormat::_eFormat format, PhyreTextureFormat::_eFormat source)
+    {
+        if (source != PhyreTextureFormat::formatRGBA8_SRGB && source != PhyreTextureFormat::formatARGB8_SRGB)
+            return format;
+
+        switch (format)
+        {
+        case PhyreTextureFormat::formatDXT1:
+            return PhyreTextureFormat::formatDXT1_SRGB;
+        case PhyreTextureFormat::formatDXT5:
+            return PhyreTextureFormat::formatDXT5_SRGB;
+        case PhyreTextureFormat::formatBC7:
+            return PhyreTextureFormat::formatBC7_SRGB;
+        default:
+            return format;
+        }
+    }
+
+    PhyreArena::Buffer PhyreBlockEncoder::encodeChain(const char* data, size_t size, PhyreTextureFormat::_eFormat source,
+        uint32_t width, uint32_t height, uint32_t mipLevels, bool flip, bool pixelExact) const
+    {
+        if (!canEncodeFrom(source))
+            throw PhyreException(L"Only 8 bit RGBA pixels can be encoded");
+
+        struct _tLevel
+        {
+            uint32_t width;
+            uint32_t height;
+            uint32_t blocksWide;
+            uint32_t blocksHigh;
+            size_t source;
+            size_t target;
+            size_t firstBlock;
+        };
+
+        // Levels past 1x1 aren't counted, as in PhyreTextureFormat::chainSize.
+        std::vector<_tLevel> levels;
+        size_t sourceSize = 0, targetSize = 0, blocks = 0;
+        const size_t blockBytes = PhyreTextureFormat::traits(_format).unitSize;
+        for (uint32_t level = 0; level < std::max(mipLevels, 1u) && level < 32; level++)
+        {
+            const uint32_t levelWidth = std::max(width >> level, 1u);
+            const uint32_t levelHeight = std::max(height >> level, 1u);
+            const _tLevel entry{ levelWidth, levelHeight, (levelWidth + 3) / 4, (levelHeight + 3) / 4, sourceSize, targetSize, blocks };
+            levels.push_back(entry);
+            sourceSize += static_cast<size_t>(levelWidth) * levelHeight * 4;
+            targetSize += static_cast<size_t>(entry.blocksWide) * entry.blocksHigh * blockBytes;
+            blocks += static_cast<size_t>(entry.blocksWide) * entry.blocksHigh;
+            if (levelWidth == 1 && levelHeight == 1)
+                break;
+        }
+        if (size < sourceSize)
+            throw PhyreExceptionData(L"DDS data is shorter than its mip chain");
+
+        PhyreArena::Buffer ret = PhyreArena::local().acquire(targetSize);
+        char* const target = ret.data();
+
+        const auto encodeRun = [&](size_t first, size_t last)
+        {
+            size_t level = 0;
+            uint8_t rgba[64];
+            for (size_t block = first; block < last; block++)
+            {
+                while (level + 1 < levels.size() && block >= levels[level + 1].firstBlock)
+                    level++;
+                const _tLevel& entry = levels[level];
+                const size_t local = block - entry.firstBlock;
+                const uint32_t blockX = static_cast<uint32_t>(local % entry.blocksWide);
+                const uint32_t blockY = static_cast<uint32_t>(local / entry.blocksWide);
+
+                // Padding rows repeat the last row of the image. A flipped chain takes the block rows in reverse
+                // and reverses the rows inside each, a pixel exact one takes row y from height - 1 - y.
+                const uint32_t blockRows = std::min(entry.height, 4u);
+                const uint32_t sourceBlockY = flip ? entry.blocksHigh - 1 - blockY : blockY;
+                for (uint32_t r = 0; r < 4; r++)
+                {
+                    uint32_t y = std::min(sourceBlockY * 4 + (flip && r < blockRows ? blockRows - 1 - r : r), entry.height - 1);
+                    if (flip && pixelExact)
+                        y = entry.height - 1 - std::min(blockY * 4 + r, entry.height - 1);
+                    const char* line = data + entry.source + static_cast<size_t>(y) * entry.width * 4;
+                    for (uint32_t c = 0; c < 4; c++)
+                        readPixel(line + static_cast<size_t>(std::min(blockX * 4 + c, entry.width - 1)) * 4, source, rgba + (r * 4 + c) * 4);
+                }
+
+                uint8_t* dst = reinterpret_cast<uint8_t*>(target + entry.target + local * blockBytes);
+                switch (_format)
+                {
+                case PhyreTextureFormat::formatDXT1:
+                case PhyreTextureFormat::formatDXT1_SRGB:
+                    encodeBlockBC1(rgba, dst, _quality, true);
+                    break;
+                case PhyreTextureFormat::formatDXT5:
+                case PhyreTextureFormat::formatDXT5_SRGB:
+                    encodeBlockBC3(rgba, dst, _quality);
+                    break;
+                default:
+                    PhyreBC7::encodeBlock(rgba, dst, _quality >= qualityNormal ? LEAST_SQUARES_PASSES : 0, _quality >= qualityHigh);
+                    break;
+                }
+            }
+        };
+
+        PhyreParallel::forEach((blocks + BLOCKS_PER_RUN - 1) / BLOCKS_PER_RUN, _threads, [&](size_t run)
+        {
+            encodeRun(run * BLOCKS_PER_RUN, std::min(blocks, (run + 1) * BLOCKS_PER_RUN));
+        });
+        return ret;
+    }
+
+    void PhyreBlockEncoder::encodeBlockBC1(const uint8_t* rgba, uint8_t* dst, _eQuality quality, bool punchThrough)
+    {
+        bool transparent[16];
+        uint32_t transparentCount = 0;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            transparent[i] = punchThrough && rgba[i * 4 + 3] < 128;
+            transparentCount += transparent[i] ? 1 : 0;
+        }
+
+        // Equal endpoints select the three color mode, index 3 is transparent black.
+        if (transparentCount == 16)
+        {
+            std::memset(dst, 0, 4);
+            std::memset(dst + 4, 0xFF, 4);
+            return;
+        }
+
+        EndpointsBC1 fit = encodeColorBC1(rgba, transparentCount ? transparent : nullptr, transparentCount != 0, quality);
+        if (!transparentCount && quality >= qualityNormal && fit.error > 0)
+        {
+            // Opaque blocks may still do better with the midpoint of the three color mode.
+            const EndpointsBC1 threeColor = encodeColorBC1(rgba, nullptr, true, quality);
+            if (threeColor.error < fit.error)
+                fit = threeColor;
+        }
+        writeBC1(fit, dst);
+    }
+
+    void PhyreBlockEncoder::encodeBlockBC2(const uint8_t* rgba, uint8_t* dst, _eQuality quality)
+    {
+        // Four bits of alpha per pixel, rounded to the nearest of the 16 steps.
+        for (uint32_t i = 0; i < 8; i++)
+            dst[i] = static_cast<uint8_t>((rgba[i * 8 + 3] + 8) / 17 | ((rgba[i * 8 + 7] + 8) / 17) << 4);
+        writeBC1(encodeColorBC1(rgba, nullptr, false, quality), dst + 8);
+    }
+
+    void PhyreBlockEncoder::encodeBlockBC3(const uint8_t* rgba, uint8_t* dst, _eQuality quality)
+    {
+        encodeAlpha(rgba, 3, dst, quality);
+        // The color block of BC3 is always read in the four color mode.
+        writeBC1(encodeColorBC1(rgba, nullptr, false, quality), dst + 8);
+    }
+
+    void PhyreBlockEncoder::encodeBlockBC4(const uint8_t* rgba, uint32_t channel, uint8_t* dst, _eQuality quality)
+    {
+        encodeAlpha(rgba, channel, dst, quality);
+    }
+
+    uint32_t PhyreBlockEncoder::fitPalette(const uint8_t* rgba, const uint8_t (*palette)[4], uint32_t paletteSize, uint8_t* indices, uint32_t* errors)
+    {
+#ifdef PHYRE_ENCODE_SSE2
+        return fitPaletteSSE2(rgba, palette, paletteSize, indices, errors);
+#else
+        return fitPaletteScalar(rgba, palette, paletteSize, indices, errors);
+#endif
+    }
+
+    uint32_t PhyreBlockEncoder::principalAxis(const uint8_t* rgba, const bool* mask, uint32_t channels, float* mean, float* axis)
+    {
+        uint32_t count = 0;
+        std::fill(mean, mean + channels, 0.0f);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            if (mask && !mask[i])
+                continue;
+            for (uint32_t c = 0; c < channels; c++)
+                mean[c] += rgba[i * 4 + c];
+            count++;
+        }
+
+        // A gray diagonal for blocks without any spread, the endpoints then meet in the mean.
+        std::fill(axis, axis + channels, 1.0f / std::sqrt(static_cast<float>(channels)));
+        if (!count)
+            return 0;
+        for (uint32_t c = 0; c < channels; c++)
+            mean[c] /= static_cast<float>(count);
+
+        float covariance[4][4] = {};
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            if (mask && !mask[i])
+                continue;
+            float diff[4];
+            for (uint32_t c = 0; c < channels; c++)
+                diff[c] = rgba[i * 4 + c] - mean[c];
+            for (uint32_t a = 0; a < channels; a++)
+                for (uint32_t b = 0; b < channels; b++)
+                    covariance[a][b] += diff[a] * diff[b];
+        }
+
+        // Power iteration from the row of the channel that varies most.
+        uint32_t start = 0;
+        for (uint32_t c = 1; c < channels; c++)
+            if (covariance[c][c] > covariance[start][start])
+                start = c;
+        if (covariance[start][start] <= 0.0f)
+            return count;
+
+        float vector[4];
+        for (uint32_t c = 0; c < channels; c++)
+            vector[c] = covariance[start][c];
+        for (uint32_t iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = {};
+            float largest = 0;
+            for (uint32_t a = 0; a < channels; a++)
+            {
+                for (uint32_t b = 0; b < channels; b++)
+                    next[a] += covariance[a][b] * vector[b];
+                largest = std::max(largest, std::fabs(next[a]));
+            }
+            if (largest <= 0.0f)
+                break;
+            for (uint32_t c = 0; c < channels; c++)
+                vector[c] = next[c] / largest;
+        }
+
+        float length = 0;
+        for (uint32_t c = 0; c < channels; c++)
+            length += vector[c] * vector[c];
+        length = std::sqrt(length);
+        if (length > 0.0f)
+            for (uint32_t c = 0; c < channels; c++)
+                axis[c] = vector[c] / length;
+        return count;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "PhyreArena.h"
+#include "PhyreTextureFormat.h"
+
+namespace phyre
+{
+    /*
+    * Compresses 8 bit RGBA pixels to DXT1 (BC1), DXT5 (BC3) and BC7.
+    * Endpoints start on the principal axis of a block and are refined
+    * by least squares, every candidate pair is scored by fitting the 16
+    * pixels to its palette, which runs four pixels at a time on SSE2.
+    * A mip chain is cut into runs of blocks that all cores work on.
+    */
+    class PhyreBlockEncoder
+    {
+    public:
+        enum _eQuality
+        {
+            // Endpoints from the ends of the principal axis.
+            qualityFast,
+            // Least squares refinement of the endpoints.
+            qualityNormal,
+            // Neighbourhood search around the refined endpoints, BC7 also tries two subsets.
+            qualityHigh
+        };
+
+        PhyreBlockEncoder() = delete;
+        // threads 0 uses every core.
+        PhyreBlockEncoder(PhyreTextureFormat::_eFormat format, _eQuality quality = qualityNormal, unsigned threads = 0);
+
+        // DXT1, DXT5 and BC7 with their sRGB variants.
+        static bool canEncode(PhyreTextureFormat::_eFormat format);
+        // RGBA8, ARGB8 and XRGB8 with their sRGB variants.
+        static bool canEncodeFrom(PhyreTextureFormat::_eFormat source);
+        // format, or its sRGB variant for sRGB pixels.
+        static PhyreTextureFormat::_eFormat targetFor(PhyreTextureFormat::_eFormat format, PhyreTextureFormat::_eFormat source);
+
+        PhyreTextureFormat::_eFormat format() const { return _format; }
+        _eQuality quality() const { return _quality; }
+
+        /*
+        * Encodes every level of a chain of source pixels stored top row
+        * first, as in a DDS. With flip the blocks come out in the order
+        * PhyreTextureFlip gives a flipped chain, pixel exact or not, ready
+        * to go into a phyre. size has to cover the whole chain.
+        */
+        PhyreArena::Buffer encodeChain(const char* data, size_t size, PhyreTextureFormat::_eFormat source,
+            uint32_t width, uint32_t height, uint32_t mipLevels, bool flip, bool pixelExact = false) const;
+
+        // Blocks of 16 RGBA8 pixels, row by row. punchThrough makes pixels with alpha below 128 transparent.
+        static void encodeBlockBC1(const uint8_t* rgba, uint8_t* dst, _eQuality quality, bool punchThrough);
+        static void encodeBlockBC2(const uint8_t* rgba, uint8_t* dst, _eQuality quality);
+        static void encodeBlockBC3(const uint8_t* rgba, uint8_t* dst, _eQuality quality);
+        // One BC4 block from channel, BC5 is two of them.
+        static void encodeBlockBC4(const uint8_t* rgba, uint32_t channel, uint8_t* dst, _eQuality quality);
+
+        /*
+        * Assigns each of 16 RGBA8 pixels the palette entry with the least
+        * squared error and returns the sum. errors gets the error of
+        * every pixel, it may be null.
+        */
+        static uint32_t fitPalette(const uint8_t* rgba, const uint8_t (*palette)[4], uint32_t paletteSize, uint8_t* indices, uint32_t* errors);
+
+        /*
+        * Mean and principal axis of the pixels mask selects, all of them
+        * for a null mask, over the first channels channels. The axis has
+        * unit length. Returns the number of pixels selected.
+        */
+        static uint32_t principalAxis(const uint8_t* rgba, const bool* mask, uint32_t channels, float* mean, float* axis);
+
+    protected:
+        PhyreTextureFormat::_eFormat _format;
+        _eQuality _quality;
+        unsigned _threads;
+    };
+}
@@ -0,0 +1,64 @@
+#include <algorithm>
+
+#include "PhyreCatalog.h"
+#include "PhyreContainer.h"
+#include "PhyreMappedFile.h"
+
+namespace phyre
+{
+    namespace
+    {
+        bool recordLess(const PhyreCatalog::_tRecord& a, const PhyreCatalog::_tRecord& b)
+        {
+            if (a.path != b.path)
+                return a.path < b.path;
+            return a.textureIndex < b.textureIndex;
+        }
+    }
+
+    void PhyreCatalog::add(const std::filesystem::path& phyrePath)
+    {
+        const PhyreMappedFile phyreFile(phyrePath);
+        const auto textures = PhyreContainer::ProbeTextures(phyreFile.view());
+
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            const auto& textureInfo = textures[i];
+            _records.push_back({ phyrePath, static_cast<uint32_t>(i), textureInfo.textureFormat,
+                textureInfo.width, textureInfo.height, textureInfo.mipmapCount, textureInfo.dataOffset, textureInfo.dataSize });
+        }
+    }
+
+    std::string PhyreCatalog::csvField(const std::string& text)
+    {
+        if (text.find_first_of(",\"\r\n") == std::string::npos)
+            return text;
+
+        std::string ret = "\"";
+        for (const char c : text)
+        {
+            if (c == '"')
+                ret += '"';
+            ret += c;
+        }
+        ret += '"';
+        return ret;
+    }
+
+    void PhyreCatalog::writeCsv(std::ostream& out) const
+    {
+        std::vector<const _tRecord*> sorted;
+        sorted.reserve(_records.size());
+        for (const auto& record : _records)
+            sorted.push_back(&record);
+        std::sort(sorted.begin(), sorted.end(), [](const _tRecord* a, const _tRecord* b) { return recordLess(*a, *b); });
+
+        out << "path,texture,format,width,height,mipmapCount,dataOffset,dataSize\n";
+        for (const _tRecord* record : sorted)
+        {
+            out << csvField(record->path.u8string()) << ',' << record->textureIndex << ',' << csvField(record->format) << ','
+                << record->width << ',' << record->height << ',' << record->mipmapCount << ','
+                << record->dataOffset << ',' << record->dataSize << '\n';
+        }
+    }
+}
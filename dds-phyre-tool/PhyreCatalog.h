@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace phyre
+{
+    /*
+    * Index of the textures in a set of phyre files, built from headers
+    * only. Files are mapped but their texture data is never read, so a
+    * scan costs about one page per file. Rows are written sorted by path
+    * and texture index, indexes of the same tree compare line by line.
+    */
+    class PhyreCatalog
+    {
+    public:
+        struct _tRecord
+        {
+            std::filesystem::path path;
+            uint32_t textureIndex;
+            // As stored in the file, unknown formats keep their name.
+            std::string format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mipmapCount;
+            uint64_t dataOffset;
+            uint64_t dataSize;
+        };
+
+        // Adds a row for every texture in the file.
+        void add(const std::filesystem::path& phyrePath);
+
+        // In the order the files were added.
+        const std::vector<_tRecord>& records() const { return _records; }
+
+        // Header line, then one line per texture. Paths are UTF-8 and quoted where needed.
+        void writeCsv(std::ostream& out) const;
+        // RFC 4180 quoting, only where a separator, quote or line break needs it.
+        static std::string csvField(const std::string& text);
+
+    private:
+        std::vector<_tRecord> _records;
+    };
+}
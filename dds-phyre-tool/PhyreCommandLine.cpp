@@ -0,0 +1,640 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "PhyreCommandLine.h"
+#include "PhyreBatch.h"
+#include "PhyreCatalog.h"
+#include "PhyreContainer.h"
+#include "PhyreException.h"
+#include "PhyreManifest.h"
+#include "PhyreMappedFile.h"
+#include "PhyreStats.h"
+#include "PhyreStore.h"
+#include "PhyreTextureFlip.h"
+#include "version.h"
+
+#ifndef _WIN32
+#include <atomic>
+#include <csignal>
+
+#include "PhyreDaemon.h"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace phyre
+{
+    namespace
+    {
+#ifdef _WIN32
+        const char* const PROGRAM = "dds-phyre-tool.exe";
+#else
+        const char* const PROGRAM = "dds-phyre-tool";
+#endif
+
+        // ASCII only, enough for extensions and format names.
+        bool equalsNoCase(const std::string& text, const char* expected)
+        {
+            const auto lower = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; };
+            const size_t size = std::strlen(expected);
+            if (text.size() != size)
+                return false;
+            for (size_t i = 0; i < size; i++)
+            {
+                if (lower(text[i]) != lower(expected[i]))
+                    return false;
+            }
+            return true;
+        }
+
+        // One line of the fields the phyre keeps for a texture.
+        std::string describeTexture(const PhyrePlatform::_tTextureInfo& textureInfo)
+        {
+            return "格式 " + textureInfo.textureFormat + ", " + std::to_string(textureInfo.width) + "x" + std::to_string(textureInfo.height)
+                + ", mipmap " + std::to_string(textureInfo.mipmapCount) + ", 最大mipmap级别 " + std::to_string(textureInfo.maxMipmapLevel);
+        }
+
+        // Prints what the conversion spent its time and memory on to stderr once it is done.
+        struct StatsReport
+        {
+            StatsReport(PhyreConsole& console, bool asJson) : console(console), json(asJson) {}
+            ~StatsReport()
+            {
+                console.err(json ? stats.toJson() + "\n" : stats.toText());
+            }
+
+            PhyreConsole& console;
+            PhyreStats stats;
+            PhyreStats::Scope scope{ stats };
+            bool json;
+        };
+
+        /*
+        * Warns on exit when compressed blocks of any format lost precision because --exact-flip could only flip them by
+        * encoding them again, or when BC6H and BC7 blocks kept their rows because the lossless flip can't reorder them.
+        */
+        struct LossyFlipWarning
+        {
+            explicit LossyFlipWarning(PhyreConsole& console) : console(console) {}
+            ~LossyFlipWarning()
+            {
+                if (const uint64_t blocks = PhyreTextureFlip::reencodedBlocks())
+                    console.err("警告: " + std::to_string(blocks) + " 个压缩块无法直接翻转, 已重新压缩, 与原数据有误差\n");
+                if (const uint64_t blocks = PhyreTextureFlip::unflippedBlocks())
+                    console.err("警告: " + std::to_string(blocks) + " 个BC6H/BC7压缩块无法无损翻转, 块内的行保持原顺序, 加上 --exact-flip 可重新压缩这些块\n");
+            }
+
+            PhyreConsole& console;
+        };
+
+#ifndef _WIN32
+        // Set while the daemon runs so SIGINT and SIGTERM stop it like a shutdown request.
+        std::atomic<PhyreDaemon*> runningDaemon{ nullptr };
+
+        void stopDaemon(int)
+        {
+            if (PhyreDaemon* daemon = runningDaemon.load())
+                daemon->stop();
+        }
+#endif
+    }
+
+    PhyreCommandLine::PhyreCommandLine(PhyreConsole& console)
+        : _console(console)
+    {
+    }
+
+    int PhyreCommandLine::run(const std::vector<std::string>& args)
+    {
+        const LossyFlipWarning lossyFlipWarning(_console);
+
+        // --stats, --encode, --quality, --mip, --threads, --store and --exact-flip can go anywhere, the remaining arguments are parsed as before.
+        std::unique_ptr<StatsReport> statsReport;
+        std::string storePath;
+        std::vector<const std::string*> rest;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            const std::string& arg = args[i];
+            const auto invalid = [&]()
+            {
+                _console.err("错误: 无效的选项 - " + arg + "\n");
+                _printUsage();
+                return EXIT_FAILURE;
+            };
+
+            if (i > 0 && (arg == "--stats" || arg == "--stats=json"))
+            {
+                statsReport = std::make_unique<StatsReport>(_console, arg == "--stats=json");
+            }
+            else if (i > 0 && (arg.rfind("--encode=", 0) == 0 || arg.rfind("--quality=", 0) == 0))
+            {
+                if (!_parseEncodeOption(arg))
+                    return invalid();
+            }
+            else if (i > 0 && arg.rfind("--mip=", 0) == 0)
+            {
+                char* end = nullptr;
+                const unsigned long value = std::strtoul(arg.c_str() + 6, &end, 10);
+                if (arg[6] < '0' || arg[6] > '9' || *end != '\0' || value >= 32)
+                    return invalid();
+                _mipLevel = static_cast<uint32_t>(value);
+            }
+            else if (i > 0 && arg.rfind("--threads=", 0) == 0)
+            {
+                char* end = nullptr;
+                const unsigned long value = std::strtoul(arg.c_str() + 10, &end, 10);
+                if (arg[10] < '0' || arg[10] > '9' || *end != '\0' || value > 1024)
+                    return invalid();
+                _writeThreads = static_cast<unsigned>(value);
+                _threadsGiven = true;
+            }
+            else if (i > 0 && arg.rfind("--store=", 0) == 0 && arg.size() > 8)
+            {
+                storePath = arg.substr(8);
+            }
+            else if (i > 0 && arg == "--exact-flip")
+            {
+                _pixelExactFlip = true;
+            }
+            else
+            {
+                rest.push_back(&arg);
+            }
+        }
+        const size_t count = rest.size();
+        const auto optional = [&](size_t index) { return index < count ? rest[index] : nullptr; };
+
+        // stdout carries the converted data, messages only go to stderr.
+        if (count >= 2 && count <= 3 && *rest[1] == "--pipe")
+            return _runPipe(optional(2));
+
+        if (count >= 3 && count <= 4 && *rest[1] == "--catalog")
+            return _runCatalog(fs::u8path(*rest[2]), optional(3));
+
+#ifndef _WIN32
+        // Jobs run side by side in the daemon, each on one thread, so --threads counts workers there.
+        if (count == 3 && *rest[1] == "--daemon")
+            return _runDaemon(*rest[2], _threadsGiven ? _writeThreads : 0);
+#endif
+
+        _console.textStdio();
+        _printBanner();
+
+        if (count >= 4 && count <= 5 && *rest[1] == "--export")
+            return _runExport(*rest[2], fs::u8path(*rest[3]), optional(4));
+
+        if (count != 2)
+        {
+            _console.err("错误: 参数数量不正确\n");
+            _printUsage();
+            return EXIT_FAILURE;
+        }
+
+        std::string input = *rest[1];
+#ifdef _WIN32
+        // Paths dropped onto the exe can arrive quoted.
+        if (input.size() >= 2 && input.front() == '"' && input.back() == '"')
+            input = input.substr(1, input.size() - 2);
+#endif
+
+        const fs::path inputFile = fs::u8path(input);
+        std::error_code error;
+        const fs::file_status inputStatus = fs::status(inputFile, error);
+        if (!fs::exists(inputStatus))
+        {
+            _console.err("错误: 输入文件不存在 - " + input + "\n");
+            return EXIT_FAILURE;
+        }
+
+        std::unique_ptr<PhyreStore> store;
+        try
+        {
+            if (!storePath.empty())
+                store = std::make_unique<PhyreStore>(fs::u8path(storePath));
+        }
+        catch (const std::exception& e)
+        {
+            _console.err(std::string("错误: ") + e.what() + "\n");
+            return EXIT_FAILURE;
+        }
+
+        if (fs::is_directory(inputStatus))
+        {
+            const int ret = _convertDirectory(inputFile, store.get());
+            return store && !_reportStore(*store) ? EXIT_FAILURE : ret;
+        }
+
+        std::unique_ptr<PhyreMappedFile> inputMapping;
+        try
+        {
+            inputMapping = std::make_unique<PhyreMappedFile>(inputFile);
+        }
+        catch (const std::exception& e)
+        {
+            _console.err(std::string("错误: 无法打开输入文件 - ") + e.what() + "\n");
+            return EXIT_FAILURE;
+        }
+
+        if (!isPhyreFile(inputMapping->view()))
+        {
+            _console.err("错误:不是有效的Phyre文件-" + input + "\n");
+            return EXIT_FAILURE;
+        }
+
+        bool success = _convertPhyreToDDS(std::move(*inputMapping), store.get());
+        if (store && !_reportStore(*store))
+            success = false;
+
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    bool PhyreCommandLine::isPhyreFile(const PhyreView& phyre)
+    {
+        if (phyre.size() < 16)
+            return false;
+
+        const char* header = phyre.data();
+        return (std::memcmp(header, "RYHP", 4) == 0 && std::memcmp(header + 12, "11XD", 4) == 0) ||
+            (std::memcmp(header, "PHYR", 4) == 0 && std::memcmp(header + 12, "DX11", 4) == 0);
+    }
+
+    void PhyreCommandLine::_printBanner()
+    {
+        _console.out("DDS Phyre tool v" VERSION_FULL " by ffgriever\n\n");
+    }
+
+    void PhyreCommandLine::_printUsage()
+    {
+        const std::string program = PROGRAM;
+        std::string usage;
+        usage += "用法: " + program + " <输入文件>\n";
+        usage += "示例: " + program + " texture.phyre\n";
+#ifdef _WIN32
+        usage += "或者把文件拖到exe上即可解包\n";
+#endif
+        usage += "输出文件将自动保存为同名的dds\n";
+        usage += "管道模式: " + program + " --pipe < texture.phyre > texture.dds\n";
+        usage += "          " + program + " --pipe 模板.phyre < texture.dds > texture.phyre\n";
+        usage += "目录模式: " + program + " <目录>, 转换目录下所有phyre, 未变化的文件根据清单跳过\n";
+        usage += "索引模式: " + program + " --catalog <目录或文件> [索引.csv], 只读文件头, 不读纹理数据\n";
+        usage += "统计信息: 加上 --stats 或 --stats=json, 各阶段的耗时和内存输出到stderr\n";
+        usage += "压缩编码: 加上 --encode=DXT1|DXT5|BC7 [--quality=fast|normal|high], 管道模式下把RGBA8的dds压缩后写入phyre\n";
+        usage += "导出图像: " + program + " --export <png|rgba> <输入.phyre> [输出], 解码纹理, rgba为无文件头的像素数据\n";
+        usage += "          加上 --mip=N 导出第N级mipmap, 默认为0\n";
+        usage += "多线程:   加上 --threads=N, 单个大纹理转换为dds时用N个线程翻转并写入, 0为全部核心, 默认为1\n";
+        usage += "精确翻转: 加上 --exact-flip, 压缩纹理按像素行精确翻转, 无法直接翻转的块用 --threads 个线程重新压缩, 有误差; 默认按块无损翻转\n";
+        usage += "去重存储: 加上 --store=<目录>, 相同的dds只在目录中存一份, 输出文件为其链接, 重复列表写入 目录/duplicates.csv\n";
+#ifndef _WIN32
+        usage += "守护模式: " + program + " --daemon <套接字路径>, 常驻并在Unix套接字上按行接收JSON请求, 每个请求回复一行\n";
+        usage += "          {\"id\":1,\"op\":\"convert\",\"input\":\"/绝对路径/a.phyre\"}, op还可以是import, export, inspect, ping, shutdown\n";
+        usage += "          --threads=N 为工作线程数, 默认为全部核心\n";
+#endif
+        _console.err(usage);
+    }
+
+    bool PhyreCommandLine::_parseEncodeOption(const std::string& arg)
+    {
+        const std::string value = arg.substr(arg.find('=') + 1);
+        if (arg.rfind("--encode=", 0) == 0)
+        {
+            _encodeFormat = PhyreTextureFormat::fromName(value);
+            return _encodeFormat != PhyreTextureFormat::formatUnknown && PhyreBlockEncoder::canEncode(_encodeFormat);
+        }
+        if (value == "fast")
+            _encodeQuality = PhyreBlockEncoder::qualityFast;
+        else if (value == "normal")
+            _encodeQuality = PhyreBlockEncoder::qualityNormal;
+        else if (value == "high")
+            _encodeQuality = PhyreBlockEncoder::qualityHigh;
+        else
+            return false;
+        return true;
+    }
+
+    bool PhyreCommandLine::_convertPhyreToDDS(PhyreMappedFile&& inputMapping, PhyreStore* store)
+    {
+        try
+        {
+            const fs::path inputPath(inputMapping.path());
+            const fs::path outputPath = inputPath.parent_path() / fs::u8path(inputPath.stem().u8string() + ".dds");
+
+            PhyreContainer phyreFile(std::move(inputMapping));
+            phyreFile.SetWriteThreads(_writeThreads);
+            phyreFile.SetPixelExactFlip(_pixelExactFlip);
+            if (store)
+            {
+                const size_t count = phyreFile.TextureCount();
+                for (size_t t = 0; t < count; t++)
+                {
+                    const fs::path texturePath = PhyreContainer::TexturePath(outputPath, t, count);
+                    store->add(phyreFile.ConvertPhyre2DDS(t).view(), texturePath);
+                    _console.out("转换成功: " + texturePath.u8string() + "\n");
+                }
+                return true;
+            }
+            for (const auto& texturePath : phyreFile.ConvertAllPhyre2DDS(outputPath))
+                _console.out("转换成功: " + texturePath.u8string() + "\n");
+            return true;
+        }
+        catch (const std::exception& e)
+        {
+            _console.err(std::string("转换失败: ") + e.what() + "\n");
+            return false;
+        }
+        catch (...)
+        {
+            _console.err("转换失败: 未知错误\n");
+            return false;
+        }
+    }
+
+    int PhyreCommandLine::_runPipe(const std::string* templatePath)
+    {
+        // Phyre on stdin to DDS on stdout, or with a template phyre the other way round.
+        std::ios_base::sync_with_stdio(false);
+        _console.binaryStdio(true);
+
+        try
+        {
+            if (templatePath)
+            {
+                PhyreContainer phyreFile{ fs::u8path(*templatePath) };
+                phyreFile.SetEncodeFormat(_encodeFormat, _encodeQuality);
+                phyreFile.SetWriteThreads(_writeThreads);
+                phyreFile.SetPixelExactFlip(_pixelExactFlip);
+                phyreFile.StreamDDS2Phyre(std::cin, std::cout);
+                _console.err("找到纹理: " + describeTexture(phyreFile.Document().textureInfo) + "\n");
+                _console.err("替换为纹理: " + describeTexture(phyreFile.ReplacedTexture()) + "\n");
+            }
+            else
+            {
+                PhyreContainer::StreamPhyre2DDS(std::cin, std::cout, 0, _pixelExactFlip);
+            }
+            std::cout.flush();
+            if (!std::cout)
+            {
+                _console.err("转换失败: 无法写入标准输出\n");
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+        catch (const std::exception& e)
+        {
+            _console.err(std::string("转换失败: ") + e.what() + "\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    int PhyreCommandLine::_runExport(const std::string& format, const fs::path& inputPath, const std::string* outputPath)
+    {
+        // One mip level of every texture to PNG or raw RGBA, next to the input unless an output is given.
+        PhyreContainer::_eImageFormat imageFormat;
+        if (equalsNoCase(format, "png"))
+            imageFormat = PhyreContainer::imagePNG;
+        else if (equalsNoCase(format, "rgba"))
+            imageFormat = PhyreContainer::imageRGBA;
+        else
+        {
+            _console.err("错误: 无效的导出格式 - " + format + "\n");
+            return EXIT_FAILURE;
+        }
+
+        try
+        {
+            const fs::path imagePath = outputPath ? fs::u8path(*outputPath)
+                : inputPath.parent_path() / fs::u8path(inputPath.stem().u8string() + (imageFormat == PhyreContainer::imagePNG ? ".png" : ".rgba"));
+            PhyreContainer phyreFile{ inputPath };
+            phyreFile.SetPixelExactFlip(_pixelExactFlip);
+            const size_t count = phyreFile.TextureCount();
+            const std::vector<fs::path> imagePaths = phyreFile.ExportAllTextures(imagePath, imageFormat, _mipLevel);
+            for (size_t i = 0; i < count; i++)
+            {
+                const auto& textureInfo = phyreFile.Document().textures[i];
+                _console.out("导出成功: " + imagePaths[i].u8string() + " (" + std::to_string((std::max)(textureInfo.width >> _mipLevel, 1u)) + "x"
+                    + std::to_string((std::max)(textureInfo.height >> _mipLevel, 1u)) + ")\n");
+            }
+            return EXIT_SUCCESS;
+        }
+        catch (const std::exception& e)
+        {
+            _console.err(std::string("导出失败: ") + e.what() + "\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool PhyreCommandLine::_forEachPhyre(const fs::path& directory, const std::function<void(const fs::directory_entry&)>& visit)
+    {
+        std::error_code walkError;
+        fs::recursive_directory_iterator it(directory, fs::directory_options::skip_permission_denied, walkError);
+        for (; !walkError && it != fs::recursive_directory_iterator(); it.increment(walkError))
+        {
+            std::error_code error;
+            if (it->is_regular_file(error) && equalsNoCase(it->path().extension().u8string(), ".phyre"))
+                visit(*it);
+        }
+
+        if (walkError)
+            _console.err("错误: 无法遍历目录 - " + directory.u8string() + "\n");
+        return !walkError;
+    }
+
+    /*
+    * Converts every phyre below the directory. Files the manifest shows as
+    * converted, with inputs and outputs unchanged since, are skipped. The
+    * rest is converted as a batch, so many reads and writes are in flight
+    * at once where the system can do that.
+    */
+    int PhyreCommandLine::_convertDirectory(const fs::path& directory, PhyreStore* store)
+    {
+        PhyreManifest manifest(directory / ".dds-phyre-manifest");
+        size_t converted = 0, skipped = 0, failed = 0;
+
+        std::vector<PhyreBatch::_tJob> jobs;
+        const bool walked = _forEachPhyre(directory, [&](const fs::directory_entry& entry)
+        {
+            if (manifest.isUpToDate(entry))
+                skipped++;
+            else
+                jobs.push_back({ entry.path(), entry.path().parent_path() / fs::u8path(entry.path().stem().u8string() + ".dds") });
+        });
+
+        PhyreBatch batch;
+        batch.setStore(store);
+        batch.setPixelExactFlip(_pixelExactFlip, _writeThreads);
+        batch.convertPhyre2DDS(jobs, [&](const PhyreBatch::_tResult& result)
+        {
+            for (const auto& texturePath : result.ddsPaths)
+                _console.out("转换成功: " + texturePath.u8string() + "\n");
+            if (result.reencodedBlocks)
+                _console.err("警告: " + result.phyrePath.u8string() + " - " + std::to_string(result.reencodedBlocks) + " 个压缩块翻转时已重新压缩, 与原数据有误差\n");
+
+            bool success = result.error.empty();
+            if (success)
+            {
+                try
+                {
+                    manifest.record(result.phyrePath, result.ddsPaths);
+                }
+                catch (const std::exception& e)
+                {
+                    _console.err(std::string("错误: ") + e.what() + "\n");
+                    success = false;
+                }
+            }
+            else
+            {
+                // The batch keeps its errors wide, the exception converts them to UTF-8.
+                const PhyreException error(result.error);
+                _console.err("转换失败: " + result.phyrePath.u8string() + " - " + static_cast<const std::exception&>(error).what() + "\n");
+            }
+
+            if (success)
+            {
+                converted++;
+            }
+            else
+            {
+                manifest.forget(result.phyrePath);
+                failed++;
+            }
+        });
+
+        // Entries of deleted files are only dropped after a complete walk.
+        if (walked)
+            manifest.prune();
+
+        try
+        {
+            manifest.save();
+        }
+        catch (const std::exception& e)
+        {
+            _console.err(std::string("错误: 无法保存清单 - ") + e.what() + "\n");
+            return EXIT_FAILURE;
+        }
+
+        _console.out("已转换 " + std::to_string(converted) + ", 未变化跳过 " + std::to_string(skipped) + ", 失败 " + std::to_string(failed) + "\n");
+        return failed == 0 && walked ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    int PhyreCommandLine::_runCatalog(const fs::path& input, const std::string* indexPath)
+    {
+        // Index of the textures in a file or below a directory from their headers, as CSV to a file or stdout.
+        PhyreCatalog catalog;
+        size_t failed = 0;
+        const auto add = [&](const fs::path& phyrePath)
+        {
+            try
+            {
+                catalog.add(phyrePath);
+            }
+            catch (const std::exception& e)
+            {
+                _console.err("错误: " + phyrePath.u8string() + " - " + e.what() + "\n");
+                failed++;
+            }
+        };
+
+        std::error_code error;
+        bool walked = true;
+        if (fs::is_directory(input, error))
+            walked = _forEachPhyre(input, [&](const fs::directory_entry& entry) { add(entry.path()); });
+        else
+            add(input);
+
+        std::ofstream indexFile;
+        if (indexPath)
+            indexFile.open(fs::u8path(*indexPath), std::ios::binary);
+        else
+            _console.binaryStdio(false);
+        std::ostream& out = indexPath ? indexFile : std::cout;
+        catalog.writeCsv(out);
+        out.flush();
+        if (!out)
+        {
+            _console.err("错误: 无法写入索引\n");
+            return EXIT_FAILURE;
+        }
+
+        _console.err("已索引 " + std::to_string(catalog.records().size()) + " 个纹理, 失败 " + std::to_string(failed) + "\n");
+        return failed == 0 && walked ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    bool PhyreCommandLine::_reportStore(PhyreStore& store)
+    {
+        // Saves the links, rewrites the duplicate report when they changed and prints what the store saved.
+        const fs::path reportPath = store.root() / "duplicates.csv";
+        const bool changed = store.isChanged();
+        try
+        {
+            store.save();
+        }
+        catch (const std::exception& e)
+        {
+            _console.err(std::string("错误: 无法保存存储链接 - ") + e.what() + "\n");
+            return false;
+        }
+
+        std::error_code error;
+        if (changed || !fs::exists(reportPath, error))
+        {
+            std::ofstream report(reportPath, std::ios::binary | std::ios::trunc);
+            store.writeReport(report);
+            report.close();
+            if (!report)
+            {
+                _console.err("错误: 无法写入重复报告 - " + reportPath.u8string() + "\n");
+                return false;
+            }
+        }
+
+        _console.out("去重存储: " + std::to_string(store.outputCount()) + " 个dds, 新存入 " + std::to_string(store.storedCount()) + " 个, 重复 "
+            + std::to_string(store.duplicates().size()) + " 组, 节省 " + std::to_string(store.savedBytes()) + " 字节, 报告: " + reportPath.u8string() + "\n");
+        return true;
+    }
+
+#ifndef _WIN32
+    int PhyreCommandLine::_runDaemon(const std::string& socketPath, unsigned threads)
+    {
+        // Serves conversions over a Unix socket until it is asked to stop, the setup above is done once for all of them.
+        std::unique_ptr<PhyreDaemon> daemon;
+        try
+        {
+            daemon = std::make_unique<PhyreDaemon>(fs::u8path(socketPath), threads);
+        }
+        catch (const std::exception& e)
+        {
+            _console.err(std::string("错误: ") + e.what() + "\n");
+            return EXIT_FAILURE;
+        }
+
+        // A client that goes away before its response must not end the daemon.
+        std::signal(SIGPIPE, SIG_IGN);
+        runningDaemon = daemon.get();
+        std::signal(SIGINT, stopDaemon);
+        std::signal(SIGTERM, stopDaemon);
+        _console.err("守护模式: 监听 " + socketPath + ", " + std::to_string(daemon->threads()) + " 个线程\n");
+
+        bool success = true;
+        try
+        {
+            daemon->run();
+        }
+        catch (const std::exception& e)
+        {
+            _console.err(std::string("错误: ") + e.what() + "\n");
+            success = false;
+        }
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        runningDaemon = nullptr;
+
+        _console.err("已处理 " + std::to_string(daemon->handledCount()) + " 个请求\n");
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+#endif
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "PhyreBlockEncoder.h"
+#include "PhyreTextureFormat.h"
+#include "PhyreView.h"
+
+namespace phyre
+{
+    class PhyreMappedFile;
+    class PhyreStore;
+
+    /*
+    * Where the command line writes, set up by the front end of each
+    * system. Text is UTF-8, a front end whose console takes something
+    * else converts it.
+    */
+    class PhyreConsole
+    {
+    public:
+        virtual ~PhyreConsole() = default;
+
+        virtual void out(const std::string& text) = 0;
+        virtual void err(const std::string& text) = 0;
+
+        // Before stdout carries data instead of messages, and stdin too when input is set.
+        virtual void binaryStdio(bool input) = 0;
+        // Before the first message goes to stdout.
+        virtual void textStdio() = 0;
+    };
+
+    /*
+    * The modes of dds-phyre-tool: a file or directory to DDS, pipe,
+    * export, catalog and on POSIX systems the daemon. Arguments are
+    * UTF-8, the front ends only convert them and provide the console,
+    * so both systems parse and print the same.
+    */
+    class PhyreCommandLine
+    {
+    public:
+        PhyreCommandLine() = delete;
+        explicit PhyreCommandLine(PhyreConsole& console);
+
+        // args[0] is the program, returns the exit code.
+        int run(const std::vector<std::string>& args);
+
+        // Either byte order, big endian files are swapped when they are parsed.
+        static bool isPhyreFile(const PhyreView& phyre);
+
+    protected:
+        void _printBanner();
+        void _printUsage();
+        // --encode= and --quality=, false if the value isn't known.
+        bool _parseEncodeOption(const std::string& arg);
+
+        bool _convertPhyreToDDS(PhyreMappedFile&& inputMapping, PhyreStore* store);
+        int _runPipe(const std::string* templatePath);
+        int _runExport(const std::string& format, const std::filesystem::path& inputPath, const std::string* outputPath);
+        // Calls visit for every .phyre file below the directory, false if the walk was cut short.
+        bool _forEachPhyre(const std::filesystem::path& directory, const std::function<void(const std::filesystem::directory_entry&)>& visit);
+        int _convertDirectory(const std::filesystem::path& directory, PhyreStore* store);
+        int _runCatalog(const std::filesystem::path& input, const std::string* indexPath);
+        bool _reportStore(PhyreStore& store);
+#ifndef _WIN32
+        int _runDaemon(const std::string& socketPath, unsigned threads);
+#endif
+
+        PhyreConsole& _console;
+
+        // Block compression of RGBA8 DDS files piped into a phyre, off unless --encode is given.
+        PhyreTextureFormat::_eFormat _encodeFormat = PhyreTextureFormat::formatUnknown;
+        PhyreBlockEncoder::_eQuality _encodeQuality = PhyreBlockEncoder::qualityNormal;
+        uint32_t _mipLevel = 0;
+        unsigned _writeThreads = 1;
+        bool _threadsGiven = false;
+        // --exact-flip, compressed blocks are encoded again where that takes it.
+        bool _pixelExactFlip = false;
+    };
+}
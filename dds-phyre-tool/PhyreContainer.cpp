@@ -1,45 +1,361 @@
+#include <algorithm>
 #include <fstream>
 
 #include "PhyreContainer.h"
+#include "PhyreMemoryStream.h"
+#include "PhyrePng.h"
+#include "PhyreRowKernels.h"
+#include "PhyreStats.h"
+#include "PhyreTempFile.h"
 namespace phyre
 {
 	PhyreContainer::PhyreContainer(const std::filesystem::path &phyrePath)
+		: PhyreContainer(PhyreMappedFile(phyrePath))
 	{
-		std::ifstream phyreFile(phyrePath, std::ios::in | std::ios::binary);
-		if (!phyreFile)
-			throw PhyreExceptionIO(L"Cannot open binary file: " + phyrePath.wstring());
-		
-		if (std::filesystem::file_size(phyrePath) < sizeof(_tBasicHeader))
+	}
+	PhyreContainer::PhyreContainer(PhyreMappedFile&& phyreFile)
+		: _phyreFile(new PhyreMappedFile(std::move(phyreFile)))
+	{
+		_open(_phyreFile->view());
+	}
+	PhyreContainer::PhyreContainer(const PhyreView& phyre)
+	{
+		_open(phyre);
+	}
+	void PhyreContainer::_open(const PhyreView& phyre)
+	{
+		if (phyre.size() < sizeof(_tBasicHeader))
 			throw PhyreExceptionData(L"Phyre file too small to be valid");
 
-		_tBasicHeader basicHeader;
-		phyreFile.read(reinterpret_cast<char*>(&basicHeader), sizeof(basicHeader));
-		phyreFile.close();
+		const _tBasicHeader basicHeader = phyre.read<_tBasicHeader>(0);
+		_phyrePlatform = _createPlatform(basicHeader);
+		_parse(phyre);
+	}
+	std::unique_ptr<PhyrePlatform> PhyreContainer::_createPlatform(_tBasicHeader basicHeader)
+	{
+		if (basicHeader.magic != PHYRE_MAGIC && basicHeader.magic != PHYRE_MAGIC_BE)
+			throw PhyreExceptionData(L"Invalid phyre file header");
 
+		// Byte swapping keeps the platform id readable, it is stored as a word.
+		uint32_t platformId = basicHeader.platformId;
 		if (basicHeader.magic == PHYRE_MAGIC_BE)
-			throw PhyreExceptionData(L"Big Endian files are not yet supported");
+			PhyreRowKernels::swapBytes(reinterpret_cast<char*>(&platformId), sizeof(platformId), sizeof(platformId));
 
-		if (basicHeader.magic != PHYRE_MAGIC)
-			throw PhyreExceptionData(L"Invalid phyre file header");
-
-		switch (basicHeader.platformId)
+		switch (platformId)
 		{
 			case _ePlatformId::platformDX11:
-				_phyrePlatform = std::unique_ptr<PhyrePlatform>(new PhyrePlatformDX11);
-				break;
+				return std::unique_ptr<PhyrePlatform>(new PhyrePlatformDX11);
 			default:
 				throw PhyreExceptionData(L"Unsupported phyre platform");
 		}
+	}
+	void PhyreContainer::_readExactly(std::istream& in, PhyreArena::Buffer& data, size_t size)
+	{
+		PhyreStats::Timer timer(PhyreStats::stageRead);
+		const size_t start = data.size();
+		if (size < start)
+			throw PhyreExceptionData(L"Invalid phyre file header");
+		const size_t got = PhyreMemoryStream::append(in, data, size - start);
+		PhyreStats::addRead(PhyreStats::stageRead, got);
+		if (got != size - start)
+			throw PhyreExceptionData(L"Phyre stream ended before the texture data");
+	}
+	void PhyreContainer::_parse(const PhyreView& phyre)
+	{
+		PhyreStats::Timer timer(PhyreStats::stageParse);
+		const bool bigEndian = phyre.read<uint32_t>(0) == PHYRE_MAGIC_BE;
+		PhyreView native = phyre;
+		if (bigEndian)
+		{
+			_nativeData.assign(phyre.data(), phyre.size());
+			_phyrePlatform->swapStructures(_nativeData.data(), _nativeData.size(), true);
+			native = PhyreView(_nativeData.data(), _nativeData.size());
+		}
 
-		if (!_phyrePlatform->isFormatSupported(phyrePath))
+		if (!_phyrePlatform->isFormatSupported(native))
 			throw PhyreExceptionData(L"Unsupported phyre format");
+
+		_document = _phyrePlatform->parseDocument(native);
+		_document.bigEndian = bigEndian;
+	}
+	void PhyreContainer::ConvertPhyre2DDS(const std::filesystem::path& ddsPath)
+	{
+		_phyrePlatform->convertPhyre2DDS(_document, 0, ddsPath);
+	}
+	void PhyreContainer::ConvertPhyre2DDS(size_t textureIndex, const std::filesystem::path& ddsPath)
+	{
+		_phyrePlatform->convertPhyre2DDS(_document, textureIndex, ddsPath);
+	}
+	std::vector<std::filesystem::path> PhyreContainer::ConvertAllPhyre2DDS(const std::filesystem::path& ddsPath)
+	{
+		std::vector<std::filesystem::path> ret;
+		const size_t count = _document.textures.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			const std::filesystem::path texturePath = TexturePath(ddsPath, i, count);
+			_phyrePlatform->convertPhyre2DDS(_document, i, texturePath);
+			ret.push_back(texturePath);
+		}
+		return ret;
+	}
+	std::filesystem::path PhyreContainer::TexturePath(const std::filesystem::path& ddsPath, size_t textureIndex, size_t textureCount)
+	{
+		std::filesystem::path ret = ddsPath;
+		if (textureCount > 1)
+			ret.replace_filename(ddsPath.stem().wstring() + L"_" + std::to_wstring(textureIndex) + ddsPath.extension().wstring());
+		return ret;
+	}
+	size_t PhyreContainer::TextureCount() const
+	{
+		return _document.textures.size();
 	}
 	void PhyreContainer::ConvertPhyre2DDS(const std::filesystem::path& phyrePath, const std::filesystem::path& ddsPath)
 	{
-		_phyrePlatform->convertPhyre2DDS(phyrePath, ddsPath);
+		if (_phyreFile && phyrePath == _phyreFile->path())
+			return ConvertPhyre2DDS(ddsPath);
+
+		// Another file gets a container of its own, it may differ in platform or byte order.
+		PhyreContainer phyreFile(phyrePath);
+		phyreFile.SetStreamBufferSize(_phyrePlatform->getStreamBufferSize());
+		phyreFile.SetWriteThreads(_phyrePlatform->getWriteThreads());
+		phyreFile.SetPixelExactFlip(_phyrePlatform->getPixelExactFlip());
+		phyreFile.ConvertPhyre2DDS(ddsPath);
+		_phyrePlatform->addReencodedBlocks(phyreFile.ReencodedBlocks());
 	}
 	void PhyreContainer::ConvertDDS2Phyre(const std::filesystem::path& ddsPath, const std::filesystem::path& phyrePath)
 	{
-		_phyrePlatform->convertDDS2Phyre(ddsPath, phyrePath);
+		if (!_phyreFile || phyrePath != _phyreFile->path())
+		{
+			PhyreContainer phyreFile(phyrePath);
+			phyreFile.SetStreamBufferSize(_phyrePlatform->getStreamBufferSize());
+			phyreFile.SetAtomicReplace(_atomicReplace);
+			phyreFile.SetEncodeFormat(_phyrePlatform->getEncodeFormat(), _phyrePlatform->getEncodeQuality());
+			phyreFile.SetWriteThreads(_phyrePlatform->getWriteThreads());
+			phyreFile.SetPixelExactFlip(_phyrePlatform->getPixelExactFlip());
+			phyreFile.ConvertDDS2Phyre(ddsPath, phyrePath);
+			_phyrePlatform->addReencodedBlocks(phyreFile.ReencodedBlocks());
+			return;
+		}
+
+		if (_document.bigEndian)
+			return _replaceBigEndian(ddsPath);
+
+		if (_atomicReplace)
+			return _replaceDDS2Phyre(ddsPath);
+
+		// The file can't be truncated while mapped, the document is stale after the patch anyway.
+		const size_t newSize = _phyrePlatform->convertDDS2Phyre(_document, ddsPath, phyrePath);
+		_document = PhyrePlatform::_tDocument{};
+		_phyreFile->close();
+		{
+			PhyreStats::Timer timer(PhyreStats::stageWrite);
+			std::filesystem::resize_file(phyrePath, newSize);
+		}
+
+		*_phyreFile = PhyreMappedFile(phyrePath);
+		_parse(_phyreFile->view());
+	}
+	void PhyreContainer::_replaceDDS2Phyre(const std::filesystem::path& ddsPath)
+	{
+		const std::filesystem::path phyrePath = _phyreFile->path();
+
+		// Everything before the texture data is reused, the converter patches the copy.
+		PhyreTempFile output(phyrePath);
+		output.copyFrom(phyrePath, _phyreFile->view(), std::min(_document.textureInfo.dataOffset, _phyreFile->size()));
+		output.resize(_phyrePlatform->convertDDS2Phyre(_document, ddsPath, output.path()));
+
+		// Windows can't rename over a mapped file.
+		_document = PhyrePlatform::_tDocument{};
+		_phyreFile->close();
+		output.commit();
+
+		*_phyreFile = PhyreMappedFile(phyrePath);
+		_parse(_phyreFile->view());
+	}
+	void PhyreContainer::_replaceBigEndian(const std::filesystem::path& ddsPath)
+	{
+		// The converter works on native structures, they are swapped back in memory and written in one go.
+		const std::filesystem::path phyrePath = _phyreFile->path();
+		const PhyreArena::Buffer phyreData = ConvertDDS2Phyre(PhyreMappedFile(ddsPath).view());
+
+		PhyreTempFile output(phyrePath);
+		output.write(phyreData.view(), 0);
+
+		_document = PhyrePlatform::_tDocument{};
+		_nativeData.reset();
+		_phyreFile->close();
+		output.commit();
+
+		*_phyreFile = PhyreMappedFile(phyrePath);
+		_parse(_phyreFile->view());
+	}
+	void PhyreContainer::ConvertPhyre2DDS(std::ostream& dds, size_t textureIndex)
+	{
+		_phyrePlatform->convertPhyre2DDS(_document, textureIndex, dds);
+	}
+	PhyreArena::Buffer PhyreContainer::ConvertPhyre2DDS(size_t textureIndex)
+	{
+		// Headers plus the payload, the output never has to grow.
+		PhyreArena::Buffer dds;
+		if (textureIndex < _document.textures.size())
+			dds.reserve(256 + _document.textures[textureIndex].dataSize);
+		PhyreMemoryStream ddsStream(std::move(dds));
+		_phyrePlatform->convertPhyre2DDS(_document, textureIndex, ddsStream);
+		return ddsStream.release();
+	}
+	PhyreArena::Buffer PhyreContainer::ConvertDDS2Phyre(const PhyreView& dds)
+	{
+		// Only the part before the texture data is kept, the payload is rewritten from the DDS.
+		const PhyreView& phyre = _document.phyre;
+		const size_t dataOffset = std::min(_document.textureInfo.dataOffset, phyre.size());
+		PhyreArena::Buffer phyreData;
+		phyreData.reserve(dataOffset + dds.size());
+		phyreData.assign(phyre.data(), dataOffset);
+
+		PhyreMemoryStream phyreStream(std::move(phyreData));
+		const size_t newSize = _phyrePlatform->convertDDS2Phyre(_document, dds, phyreStream);
+		phyreData = phyreStream.release();
+		phyreData.resize(newSize);
+		if (_document.bigEndian)
+			_phyrePlatform->swapStructures(phyreData.data(), phyreData.size(), false);
+		return phyreData;
+	}
+	void PhyreContainer::StreamPhyre2DDS(std::istream& phyre, std::ostream& dds, size_t textureIndex, bool pixelExactFlip)
+	{
+		// Headers and namespace first, they tell where the texture data starts.
+		PhyreArena::Buffer prefix;
+		_readExactly(phyre, prefix, sizeof(_tBasicHeader));
+		_tBasicHeader basicHeader = PhyreView(prefix.data(), prefix.size()).read<_tBasicHeader>(0);
+		const std::unique_ptr<PhyrePlatform> platform = _createPlatform(basicHeader);
+		const bool bigEndian = basicHeader.magic == PHYRE_MAGIC_BE;
+		if (bigEndian)
+			PhyreRowKernels::swapBytes(reinterpret_cast<char*>(&basicHeader), sizeof(basicHeader), sizeof(uint32_t));
+
+		_readExactly(phyre, prefix, 0ULL + basicHeader.size + basicHeader.namespaceSize);
+		const size_t payloadOffset = platform->getPayloadOffset(PhyreView(prefix.data(), prefix.size()), bigEndian);
+		_readExactly(phyre, prefix, payloadOffset);
+
+		// The prefix alone parses like a file without texture data.
+		PhyreContainer phyreFile{ PhyreView(prefix.data(), prefix.size()) };
+		phyreFile.SetPixelExactFlip(pixelExactFlip);
+		phyreFile._phyrePlatform->convertPhyre2DDS(phyreFile._document, textureIndex, phyre, dds);
+	}
+	std::vector<PhyrePlatform::_tTextureInfo> PhyreContainer::ProbeTextures(const PhyreView& phyre)
+	{
+		if (phyre.size() < sizeof(_tBasicHeader))
+			throw PhyreExceptionData(L"Phyre file too small to be valid");
+
+		const _tBasicHeader basicHeader = phyre.read<_tBasicHeader>(0);
+		const std::unique_ptr<PhyrePlatform> platform = _createPlatform(basicHeader);
+		const size_t payloadOffset = std::min(platform->getPayloadOffset(phyre, basicHeader.magic == PHYRE_MAGIC_BE), phyre.size());
+
+		// Parsed like a pipe prefix, big endian files only get their structures copied.
+		const PhyreContainer phyreFile{ phyre.sub(0, payloadOffset) };
+		std::vector<PhyrePlatform::_tTextureInfo> ret = phyreFile._document.textures;
+
+		// The prefix has no payloads, they are sized by the same rule as in a full parse.
+		size_t dataOffset = payloadOffset;
+		for (size_t i = 0; i < ret.size(); i++)
+		{
+			PhyrePlatform::_tTextureInfo& textureInfo = ret[i];
+			const size_t remaining = phyre.size() - std::min(dataOffset, phyre.size());
+			textureInfo.dataOffset = dataOffset;
+			textureInfo.dataSize = remaining;
+			if (i + 1 < ret.size())
+				textureInfo.dataSize = static_cast<size_t>(std::min<uint64_t>(remaining,
+					PhyreTextureFormat::chainSize(textureInfo.format, textureInfo.width, textureInfo.height, textureInfo.mipmapCount + 1)));
+			dataOffset += textureInfo.dataSize;
+		}
+		return ret;
+	}
+	size_t PhyreContainer::StreamDDS2Phyre(std::istream& dds, std::ostream& phyre)
+	{
+		return _phyrePlatform->convertDDS2Phyre(_document, dds, phyre);
+	}
+	PhyreTextureDecoder::_tImage PhyreContainer::DecodeTexture(size_t textureIndex, uint32_t mipLevel)
+	{
+		if (textureIndex >= _document.textures.size())
+			throw PhyreExceptionData(L"There is no texture " + std::to_wstring(textureIndex) + L" in the phyre file");
+		const auto& textureInfo = _document.textures[textureIndex];
+		if (mipLevel > textureInfo.mipmapCount || mipLevel >= 32 || (mipLevel > 0
+			&& PhyreTextureFormat::chainSize(textureInfo.format, textureInfo.width, textureInfo.height, mipLevel + 1)
+			== PhyreTextureFormat::chainSize(textureInfo.format, textureInfo.width, textureInfo.height, mipLevel)))
+			throw PhyreExceptionData(L"The texture has no mip level " + std::to_wstring(mipLevel));
+		if (textureInfo.dataOffset >= _document.phyre.size() || textureInfo.dataSize == 0)
+			throw PhyreExceptionData(L"There is no DDS data in the phyre file");
+
+		// The payload keeps the DDS order of the levels, only the rows are stored bottom up.
+		const size_t levelOffset = static_cast<size_t>(mipLevel ? PhyreTextureFormat::chainSize(textureInfo.format, textureInfo.width, textureInfo.height, mipLevel) : 0);
+		if (levelOffset >= textureInfo.dataSize)
+			throw PhyreExceptionData(L"Texture data is shorter than its surface");
+		const size_t dataSize = textureInfo.dataSize - levelOffset;
+		const char* data = _document.phyre.at<char>(textureInfo.dataOffset + levelOffset, dataSize);
+
+		const uint32_t width = textureInfo.width >> mipLevel ? textureInfo.width >> mipLevel : 1;
+		const uint32_t height = textureInfo.height >> mipLevel ? textureInfo.height >> mipLevel : 1;
+		PhyreStats::Timer timer(PhyreStats::stageDecode);
+		return PhyreTextureDecoder().decodeSurface(data, dataSize, textureInfo.format, width, height, _document.bigEndian, true, _phyrePlatform->getPixelExactFlip());
+	}
+	std::vector<std::filesystem::path> PhyreContainer::ExportAllTextures(const std::filesystem::path& imagePath, _eImageFormat format, uint32_t mipLevel)
+	{
+		std::vector<std::filesystem::path> ret;
+		const size_t count = _document.textures.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			const std::filesystem::path texturePath = TexturePath(imagePath, i, count);
+			const PhyreTextureDecoder::_tImage image = DecodeTexture(i, mipLevel);
+
+			PhyreStats::Timer timer(PhyreStats::stageOpen);
+			std::ofstream out(texturePath, std::ios::binary | std::ios::trunc);
+			if (!out)
+				throw PhyreExceptionIO(L"Cannot create " + texturePath.wstring());
+			if (format == imagePNG)
+			{
+				PhyrePng::write(out, image.rgba.data(), image.width, image.height);
+			}
+			else
+			{
+				timer.switchTo(PhyreStats::stageWrite);
+				out.write(image.rgba.data(), image.rgba.size());
+				PhyreStats::addWritten(PhyreStats::stageWrite, image.rgba.size());
+			}
+			out.close();
+			if (!out)
+				throw PhyreExceptionIO(L"Cannot write " + texturePath.wstring());
+			ret.push_back(texturePath);
+		}
+		return ret;
+	}
+	const PhyrePlatform::_tDocument& PhyreContainer::Document() const
+	{
+		return _document;
+	}
+	void PhyreContainer::SetStreamBufferSize(size_t bytes)
+	{
+		_phyrePlatform->setStreamBufferSize(bytes);
+	}
+	void PhyreContainer::SetAtomicReplace(bool enabled)
+	{
+		_atomicReplace = enabled;
+	}
+	void PhyreContainer::SetEncodeFormat(PhyreTextureFormat::_eFormat format, PhyreBlockEncoder::_eQuality quality)
+	{
+		_phyrePlatform->setEncoder(format, quality);
+	}
+	void PhyreContainer::SetWriteThreads(unsigned threads)
+	{
+		_phyrePlatform->setWriteThreads(threads);
+	}
+	void PhyreContainer::SetPixelExactFlip(bool enabled)
+	{
+		_phyrePlatform->setPixelExactFlip(enabled);
+	}
+	uint64_t PhyreContainer::ReencodedBlocks() const
+	{
+		return _phyrePlatform->getReencodedBlocks();
+	}
+	const PhyrePlatform::_tTextureInfo& PhyreContainer::ReplacedTexture() const
+	{
+		return _phyrePlatform->getReplacedTexture();
 	}
 }
\ No newline at end of file
@@ -1,9 +1,16 @@
 #pragma once
 #include <cstdint>
 #include <filesystem>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
 
+#include "PhyreArena.h"
 #include "PhyreException.h"
+#include "PhyreMappedFile.h"
 #include "PhyrePlatformDX11.h"
+#include "PhyreTextureDecoder.h"
 
 namespace phyre
 {
@@ -12,8 +19,82 @@ namespace phyre
 	public:
 		PhyreContainer() = delete;
 		PhyreContainer(const std::filesystem::path &phyrePath);
+		PhyreContainer(PhyreMappedFile&& phyreFile);
+		// Works on the bytes in place, they have to outlive the container.
+		PhyreContainer(const PhyreView& phyre);
+		void ConvertPhyre2DDS(const std::filesystem::path& ddsPath);
 		void ConvertPhyre2DDS(const std::filesystem::path& phyrePath, const std::filesystem::path& ddsPath);
+		void ConvertPhyre2DDS(size_t textureIndex, const std::filesystem::path& ddsPath);
+		/*
+		* Writes every texture of the file. A single texture goes to ddsPath,
+		* several are numbered after it (name_0.dds, name_1.dds, ...).
+		* Returns the files written.
+		*/
+		std::vector<std::filesystem::path> ConvertAllPhyre2DDS(const std::filesystem::path& ddsPath);
+		// Name ConvertAllPhyre2DDS gives the file of a texture.
+		static std::filesystem::path TexturePath(const std::filesystem::path& ddsPath, size_t textureIndex, size_t textureCount);
+		size_t TextureCount() const;
 		void ConvertDDS2Phyre(const std::filesystem::path& ddsPath, const std::filesystem::path& phyrePath);
+
+		// In memory conversions, nothing is read from or written to disk. Results come from the thread's arena.
+		void ConvertPhyre2DDS(std::ostream& dds, size_t textureIndex = 0);
+		PhyreArena::Buffer ConvertPhyre2DDS(size_t textureIndex = 0);
+		// Returns the phyre with the texture replaced, the container keeps the original.
+		PhyreArena::Buffer ConvertDDS2Phyre(const PhyreView& dds);
+
+		/*
+		* Pipe conversions, neither stream has to be seekable. The phyre is
+		* read up to its texture data, the payload is then flipped one mip
+		* level at a time. This container's file is the template for the
+		* phyre written from a DDS.
+		*/
+		static void StreamPhyre2DDS(std::istream& phyre, std::ostream& dds, size_t textureIndex = 0, bool pixelExactFlip = false);
+		size_t StreamDDS2Phyre(std::istream& dds, std::ostream& phyre);
+
+		/*
+		* Texture table of a phyre without touching its texture data, only
+		* headers, namespace, instances and fixups are read. Offsets and
+		* sizes are those in the whole file.
+		*/
+		static std::vector<PhyrePlatform::_tTextureInfo> ProbeTextures(const PhyreView& phyre);
+
+		enum _eImageFormat
+		{
+			imageRGBA,
+			imagePNG,
+		};
+		// One mip level of a texture as 8 bit RGBA, top row first like the DDS.
+		PhyreTextureDecoder::_tImage DecodeTexture(size_t textureIndex = 0, uint32_t mipLevel = 0);
+		/*
+		* Writes one mip level of every texture as an image, raw RGBA rows
+		* without a header or PNG. Files are named like ConvertAllPhyre2DDS
+		* names them. Returns the files written.
+		*/
+		std::vector<std::filesystem::path> ExportAllTextures(const std::filesystem::path& imagePath, _eImageFormat format, uint32_t mipLevel = 0);
+
+		const PhyrePlatform::_tDocument& Document() const;
+		void SetStreamBufferSize(size_t bytes);
+		/*
+		* Builds the converted phyre in a temporary file next to the target
+		* and renames it into place instead of patching the target. Parts
+		* before the texture data are cloned or copied by the kernel where
+		* the filesystem allows it.
+		*/
+		void SetAtomicReplace(bool enabled);
+		// Block compresses 8 bit RGBA DDS files converted into the phyre, formatUnknown copies them as they are.
+		void SetEncodeFormat(PhyreTextureFormat::_eFormat format, PhyreBlockEncoder::_eQuality quality = PhyreBlockEncoder::qualityNormal);
+		// Threads that flip and write one large texture to a DDS file, 0 uses every core, 1 streams it as before.
+		void SetWriteThreads(unsigned threads);
+		/*
+		* Flips compressed textures pixel exact in every conversion and
+		* decode, encoding the blocks that need it again on the write
+		* threads. Off by default, the flip then loses nothing.
+		*/
+		void SetPixelExactFlip(bool enabled);
+		// Blocks the conversions of this container encoded again to flip them.
+		uint64_t ReencodedBlocks() const;
+		// The texture as the last DDS conversion of this container wrote it into its phyre.
+		const PhyrePlatform::_tTextureInfo& ReplacedTexture() const;
 		virtual ~PhyreContainer() = default;
 	protected:
 		static constexpr uint32_t PHYRE_MAGIC = 0x50485952UL;
@@ -30,6 +111,19 @@ namespace phyre
 			platformDX11 = 0x44583131,
 		};
 
+		static std::unique_ptr<PhyrePlatform> _createPlatform(_tBasicHeader basicHeader);
+		// Grows data to size bytes from the stream as they arrive, a short read is an error.
+		static void _readExactly(std::istream& in, PhyreArena::Buffer& data, size_t size);
+		void _open(const PhyreView& phyre);
+		void _parse(const PhyreView& phyre);
+		void _replaceDDS2Phyre(const std::filesystem::path& ddsPath);
+		void _replaceBigEndian(const std::filesystem::path& ddsPath);
+
+		std::unique_ptr<PhyreMappedFile> _phyreFile;
 		std::unique_ptr<PhyrePlatform> _phyrePlatform;
+		// Big endian files are parsed from this copy with native structures.
+		PhyreArena::Buffer _nativeData;
+		PhyrePlatform::_tDocument _document{};
+		bool _atomicReplace = false;
 	};
 }
@@ -0,0 +1,758 @@
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <system_error>
+
+#include "PhyreDaemon.h"
+#include "PhyreCatalog.h"
+#include "PhyreContainer.h"
+#include "PhyreException.h"
+#include "PhyreParallel.h"
+#include "PhyreStats.h"
+#include "PhyreTempFile.h"
+
+namespace fs = std::filesystem;
+
+namespace phyre
+{
+    namespace
+    {
+#ifdef MSG_NOSIGNAL
+        constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+        constexpr int SEND_FLAGS = 0;
+#endif
+        // A client that stops reading its responses is dropped after this, the worker moves on.
+        constexpr time_t SEND_TIMEOUT_SECONDS = 30;
+
+        struct JsonValue
+        {
+            bool isString;
+            // Decoded for strings, the literal otherwise.
+            std::string text;
+            // As it appeared in the request, echoed for the id.
+            std::string raw;
+        };
+
+        using JsonFields = std::map<std::string, JsonValue>;
+
+        void skipSpace(const std::string& text, size_t& pos)
+        {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n'))
+                pos++;
+        }
+
+        void appendUtf8(std::string& out, uint32_t code)
+        {
+            if (code < 0x80)
+            {
+                out += static_cast<char>(code);
+            }
+            else if (code < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        uint32_t parseHex4(const std::string& text, size_t pos)
+        {
+            if (pos + 4 > text.size())
+                throw PhyreExceptionData(L"Truncated escape in request");
+            uint32_t ret = 0;
+            for (size_t i = pos; i < pos + 4; i++)
+            {
+                const char c = text[i];
+                ret <<= 4;
+                if (c >= '0' && c <= '9')
+                    ret |= c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    ret |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    ret |= c - 'A' + 10;
+                else
+                    throw PhyreExceptionData(L"Invalid escape in request");
+            }
+            return ret;
+        }
+
+        // pos is at the opening quote and ends up past the closing one.
+        std::string parseString(const std::string& text, size_t& pos)
+        {
+            std::string ret;
+            for (pos++; pos < text.size(); pos++)
+            {
+                const char c = text[pos];
+                if (c == '"')
+                {
+                    pos++;
+                    return ret;
+                }
+                if (static_cast<unsigned char>(c) < 0x20)
+                    throw PhyreExceptionData(L"Control character in request string");
+                if (c != '\\')
+                {
+                    ret += c;
+                    continue;
+                }
+
+                if (++pos >= text.size())
+                    break;
+                switch (text[pos])
+                {
+                case '"': ret += '"'; break;
+                case '\\': ret += '\\'; break;
+                case '/': ret += '/'; break;
+                case 'b': ret += '\b'; break;
+                case 'f': ret += '\f'; break;
+                case 'n': ret += '\n'; break;
+                case 'r': ret += '\r'; break;
+                case 't': ret += '\t'; break;
+                case 'u':
+                {
+                    uint32_t code = parseHex4(text, pos + 1);
+                    pos += 4;
+                    // Characters beyond the basic plane come as a surrogate pair.
+                    if (code >= 0xD800 && code < 0xDC00 && pos + 2 < text.size() && text[pos + 1] == '\\' && text[pos + 2] == 'u')
+                    {
+                        const uint32_t low = parseHex4(text, pos + 3);
+                        if (low >= 0xDC00 && low < 0xE000)
+                        {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            pos += 6;
+                        }
+                    }
+                    if (code >= 0xD800 && code < 0xE000)
+                        throw PhyreExceptionData(L"Unpaired surrogate in request string");
+                    appendUtf8(ret, code);
+                    break;
+                }
+                default:
+                    throw PhyreExceptionData(L"Invalid escape in request");
+                }
+            }
+            throw PhyreExceptionData(L"Unterminated string in request");
+        }
+
+        // pos is at the opening bracket of an array or object and ends up past the closing one.
+        void skipNested(const std::string& text, size_t& pos)
+        {
+            size_t depth = 0;
+            while (pos < text.size())
+            {
+                const char c = text[pos];
+                if (c == '"')
+                {
+                    parseString(text, pos);
+                    continue;
+                }
+                pos++;
+                if (c == '[' || c == '{')
+                    depth++;
+                else if ((c == ']' || c == '}') && --depth == 0)
+                    return;
+            }
+            throw PhyreExceptionData(L"Unterminated value in request");
+        }
+
+        /*
+        * Requests are flat objects, values are strings, numbers, booleans
+        * or null. id is set as soon as it is read, so a request rejected
+        * further on is still answered with it. Nested values are skipped
+        * until the end for the same reason, then rejected.
+        */
+        JsonFields parseRequest(const std::string& text, std::string& id)
+        {
+            JsonFields ret;
+            bool nested = false;
+            size_t pos = 0;
+            skipSpace(text, pos);
+            if (pos >= text.size() || text[pos] != '{')
+                throw PhyreExceptionData(L"Request is not a JSON object");
+            pos++;
+            skipSpace(text, pos);
+            if (pos < text.size() && text[pos] == '}')
+                pos++;
+            else
+            {
+                for (;;)
+                {
+                    skipSpace(text, pos);
+                    if (pos >= text.size() || text[pos] != '"')
+                        throw PhyreExceptionData(L"Expected a name in request");
+                    std::string name = parseString(text, pos);
+                    skipSpace(text, pos);
+                    if (pos >= text.size() || text[pos] != ':')
+                        throw PhyreExceptionData(L"Expected ':' in request");
+                    pos++;
+                    skipSpace(text, pos);
+
+                    JsonValue value;
+                    const size_t start = pos;
+                    if (pos < text.size() && text[pos] == '"')
+                    {
+                        value.isString = true;
+                        value.text = parseString(text, pos);
+                    }
+                    else if (pos < text.size() && (text[pos] == '[' || text[pos] == '{'))
+                    {
+                        value.isString = false;
+                        skipNested(text, pos);
+                        nested = true;
+                    }
+                    else
+                    {
+                        value.isString = false;
+                        while (pos < text.size() && std::strchr("+-.0123456789Eaeflnrstu", text[pos]) && text[pos] != '\0')
+                            pos++;
+                        value.text = text.substr(start, pos - start);
+                        // strtod alone would take nan and inf as well.
+                        char* end = nullptr;
+                        const bool number = !value.text.empty() && value.text[0] != '+' && value.text.find_first_not_of("+-.0123456789Ee") == std::string::npos
+                            && (std::strtod(value.text.c_str(), &end), *end == '\0');
+                        if (!number && value.text != "true" && value.text != "false" && value.text != "null")
+                            throw PhyreExceptionData(L"Unsupported value in request, only strings, numbers, booleans and null are supported");
+                    }
+                    value.raw = text.substr(start, pos - start);
+                    if (name == "id")
+                        id = value.raw;
+                    ret[std::move(name)] = std::move(value);
+
+                    skipSpace(text, pos);
+                    if (pos < text.size() && text[pos] == ',')
+                    {
+                        pos++;
+                        continue;
+                    }
+                    if (pos < text.size() && text[pos] == '}')
+                    {
+                        pos++;
+                        break;
+                    }
+                    throw PhyreExceptionData(L"Expected ',' or '}' in request");
+                }
+            }
+            skipSpace(text, pos);
+            if (pos != text.size())
+                throw PhyreExceptionData(L"Trailing characters after request");
+            if (nested)
+                throw PhyreExceptionData(L"Unsupported value in request, only strings, numbers, booleans and null are supported");
+            return ret;
+        }
+
+        std::string jsonString(const std::string& text)
+        {
+            std::string ret = "\"";
+            for (const char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    ret += '\\';
+                    ret += c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escape[8];
+                    std::snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+                    ret += escape;
+                }
+                else
+                {
+                    ret += c;
+                }
+            }
+            return ret + "\"";
+        }
+
+        std::string jsonPaths(const std::vector<fs::path>& paths)
+        {
+            std::string ret = "[";
+            for (size_t i = 0; i < paths.size(); i++)
+                ret += (i ? "," : "") + jsonString(paths[i].u8string());
+            return ret + "]";
+        }
+
+        // Null where the field is missing.
+        const std::string* stringField(const JsonFields& fields, const char* name)
+        {
+            auto found = fields.find(name);
+            if (found == fields.end() || found->second.raw == "null")
+                return nullptr;
+            if (!found->second.isString)
+                throw PhyreExceptionData(L"Field is not a string: " + std::wstring(name, name + std::strlen(name)));
+            return &found->second.text;
+        }
+
+        // Empty where the field is missing and not required.
+        fs::path pathField(const JsonFields& fields, const char* name, bool required)
+        {
+            const std::wstring wideName(name, name + std::strlen(name));
+            const std::string* text = stringField(fields, name);
+            if (!text || text->empty())
+            {
+                if (required)
+                    throw PhyreExceptionData(L"Missing field: " + wideName);
+                return fs::path();
+            }
+            fs::path ret = fs::u8path(*text);
+            if (!ret.is_absolute())
+                throw PhyreExceptionData(L"Path is not absolute: " + wideName);
+            return ret;
+        }
+
+        bool flagField(const JsonFields& fields, const char* name)
+        {
+            auto found = fields.find(name);
+            return found != fields.end() && found->second.raw == "true";
+        }
+
+        // Runs one job and returns the fields its response carries after "ok". Fields are only read once the op is known.
+        std::string runJob(const std::string& op, const JsonFields& fields)
+        {
+            if (op == "ping")
+                return std::string();
+
+            if (op == "convert")
+            {
+                const fs::path input = pathField(fields, "input", true);
+                fs::path output = pathField(fields, "output", false);
+                if (output.empty())
+                    output = input.parent_path() / (input.stem().u8string() + ".dds");
+                PhyreContainer phyreFile{ input };
+                phyreFile.SetPixelExactFlip(flagField(fields, "exactFlip"));
+                const std::string outputs = jsonPaths(phyreFile.ConvertAllPhyre2DDS(output));
+                return ",\"outputs\":" + outputs + ",\"reencodedBlocks\":" + std::to_string(phyreFile.ReencodedBlocks());
+            }
+
+            if (op == "import")
+            {
+                const fs::path input = pathField(fields, "input", true);
+                const fs::path output = pathField(fields, "output", true);
+                const fs::path templatePath = pathField(fields, "template", false);
+
+                PhyreTextureFormat::_eFormat format = PhyreTextureFormat::formatUnknown;
+                if (const std::string* name = stringField(fields, "encode"))
+                {
+                    format = PhyreTextureFormat::fromName(*name);
+                    if (format == PhyreTextureFormat::formatUnknown || !PhyreBlockEncoder::canEncode(format))
+                        throw PhyreExceptionData(L"Unknown encode format");
+                }
+                PhyreBlockEncoder::_eQuality quality = PhyreBlockEncoder::qualityNormal;
+                if (const std::string* name = stringField(fields, "quality"))
+                {
+                    if (*name == "fast")
+                        quality = PhyreBlockEncoder::qualityFast;
+                    else if (*name == "high")
+                        quality = PhyreBlockEncoder::qualityHigh;
+                    else if (*name != "normal")
+                        throw PhyreExceptionData(L"Unknown encode quality");
+                }
+
+                // Other clients may be reading the phyre, it is replaced rather than patched.
+                PhyreContainer phyreFile{ templatePath.empty() ? output : templatePath };
+                phyreFile.SetEncodeFormat(format, quality);
+                phyreFile.SetPixelExactFlip(flagField(fields, "exactFlip"));
+                if (templatePath.empty() || templatePath == output)
+                {
+                    phyreFile.SetAtomicReplace(true);
+                    phyreFile.ConvertDDS2Phyre(input, output);
+                }
+                else
+                {
+                    const PhyreArena::Buffer phyreData = phyreFile.ConvertDDS2Phyre(PhyreMappedFile(input).view());
+                    PhyreTempFile file(output);
+                    file.write(phyreData.view(), 0);
+                    file.commit();
+                }
+                return ",\"outputs\":" + jsonPaths({ output }) + ",\"reencodedBlocks\":" + std::to_string(phyreFile.ReencodedBlocks());
+            }
+
+            if (op == "export")
+            {
+                const fs::path input = pathField(fields, "input", true);
+                const std::string* name = stringField(fields, "format");
+                PhyreContainer::_eImageFormat format;
+                if (name && *name == "png")
+                    format = PhyreContainer::imagePNG;
+                else if (name && *name == "rgba")
+                    format = PhyreContainer::imageRGBA;
+                else
+                    throw PhyreExceptionData(L"Export format must be png or rgba");
+
+                uint32_t mipLevel = 0;
+                auto mip = fields.find("mip");
+                if (mip != fields.end())
+                {
+                    char* end = nullptr;
+                    const unsigned long value = std::strtoul(mip->second.text.c_str(), &end, 10);
+                    if (mip->second.isString || mip->second.text.empty() || mip->second.text[0] < '0' || mip->second.text[0] > '9' || *end != '\0' || value >= 32)
+                        throw PhyreExceptionData(L"Invalid mip level");
+                    mipLevel = static_cast<uint32_t>(value);
+                }
+
+                fs::path output = pathField(fields, "output", false);
+                if (output.empty())
+                    output = input.parent_path() / (input.stem().u8string() + (format == PhyreContainer::imagePNG ? ".png" : ".rgba"));
+                PhyreContainer phyreFile{ input };
+                phyreFile.SetPixelExactFlip(flagField(fields, "exactFlip"));
+                return ",\"outputs\":" + jsonPaths(phyreFile.ExportAllTextures(output, format, mipLevel));
+            }
+
+            if (op == "inspect")
+            {
+                const fs::path input = pathField(fields, "input", true);
+                PhyreCatalog catalog;
+                catalog.add(input);
+                std::string ret = ",\"textures\":[";
+                char numbers[160];
+                for (size_t i = 0; i < catalog.records().size(); i++)
+                {
+                    const PhyreCatalog::_tRecord& record = catalog.records()[i];
+                    ret += (i ? ",{\"index\":" : "{\"index\":") + std::to_string(record.textureIndex) + ",\"format\":" + jsonString(record.format);
+                    std::snprintf(numbers, sizeof(numbers), ",\"width\":%u,\"height\":%u,\"mipmaps\":%u,\"dataOffset\":%llu,\"dataSize\":%llu}",
+                        record.width, record.height, record.mipmapCount,
+                        static_cast<unsigned long long>(record.dataOffset), static_cast<unsigned long long>(record.dataSize));
+                    ret += numbers;
+                }
+                return ret + "]";
+            }
+
+            throw PhyreExceptionData(L"Unknown op");
+        }
+
+        void setNonBlocking(int fd, bool enabled)
+        {
+            const int flags = ::fcntl(fd, F_GETFL);
+            ::fcntl(fd, F_SETFL, enabled ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    struct PhyreDaemon::_tConnection
+    {
+        explicit _tConnection(int socket) : fd(socket) {}
+        _tConnection(const _tConnection&) = delete;
+        _tConnection& operator=(const _tConnection&) = delete;
+        ~_tConnection() { ::close(fd); }
+
+        // Responses of several workers go out whole, one after another.
+        void send(std::string line)
+        {
+            line += '\n';
+            std::lock_guard<std::mutex> lock(sendMutex);
+            for (size_t sent = 0; !broken && sent < line.size();)
+            {
+                const ssize_t size = ::send(fd, line.data() + sent, line.size() - sent, SEND_FLAGS);
+                if (size >= 0)
+                    sent += static_cast<size_t>(size);
+                else if (errno != EINTR)
+                {
+                    // The read side sees the end too and drops the connection.
+                    broken = true;
+                    ::shutdown(fd, SHUT_RDWR);
+                }
+            }
+        }
+
+        const int fd;
+        // Start of a request whose line break hasn't arrived, only touched by run.
+        std::string received;
+        std::mutex sendMutex;
+        bool broken = false;
+    };
+
+    PhyreDaemon::PhyreDaemon(const fs::path& socketPath, unsigned threads)
+        : _socketPath(socketPath), _threads(threads ? threads : PhyreParallel::defaultThreads())
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        const std::string& native = _socketPath.native();
+        if (native.empty() || native.size() >= sizeof(address.sun_path))
+            throw PhyreExceptionIO(L"Socket path is empty or too long: " + _socketPath.wstring());
+        std::memcpy(address.sun_path, native.c_str(), native.size() + 1);
+
+        // A socket nobody accepts on was left behind by a daemon that didn't shut down.
+        std::error_code error;
+        if (fs::is_socket(fs::symlink_status(_socketPath, error)))
+        {
+            const int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            const bool listening = probe >= 0 && ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+            if (probe >= 0)
+                ::close(probe);
+            if (listening)
+                throw PhyreExceptionIO(L"A daemon is already listening on " + _socketPath.wstring());
+            fs::remove(_socketPath, error);
+        }
+
+        if (::pipe(_wakeFds) != 0)
+            throw PhyreExceptionIO(L"Cannot create the daemon's wake pipe");
+        setNonBlocking(_wakeFds[0], true);
+        setNonBlocking(_wakeFds[1], true);
+
+        _listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (_listenFd < 0 || ::bind(_listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            const std::wstring message = L"Cannot bind socket: " + _socketPath.wstring();
+            if (_listenFd >= 0)
+                ::close(_listenFd);
+            ::close(_wakeFds[0]);
+            ::close(_wakeFds[1]);
+            throw PhyreExceptionIO(message);
+        }
+        setNonBlocking(_listenFd, true);
+        if (::listen(_listenFd, SOMAXCONN) != 0)
+        {
+            const std::wstring message = L"Cannot listen on socket: " + _socketPath.wstring();
+            ::close(_listenFd);
+            ::unlink(native.c_str());
+            ::close(_wakeFds[0]);
+            ::close(_wakeFds[1]);
+            throw PhyreExceptionIO(message);
+        }
+    }
+
+    PhyreDaemon::~PhyreDaemon()
+    {
+        if (_listenFd >= 0)
+        {
+            ::close(_listenFd);
+            ::unlink(_socketPath.c_str());
+        }
+        ::close(_wakeFds[0]);
+        ::close(_wakeFds[1]);
+    }
+
+    void PhyreDaemon::run()
+    {
+        // Like PhyreParallel, threads that can't be started leave the jobs to the others.
+        for (unsigned i = 0; i < _threads; i++)
+        {
+            try
+            {
+                _workers.emplace_back(&PhyreDaemon::_work, this);
+            }
+            catch (const std::system_error&)
+            {
+                if (_workers.empty())
+                    throw PhyreException(L"Cannot start any daemon worker thread");
+                break;
+            }
+        }
+
+        std::vector<std::shared_ptr<_tConnection>> connections;
+        std::vector<pollfd> fds;
+        int pollError = 0;
+        for (;;)
+        {
+            fds.clear();
+            fds.push_back({ _wakeFds[0], POLLIN, 0 });
+            fds.push_back({ _listenFd, POLLIN, 0 });
+            for (const auto& connection : connections)
+                fds.push_back({ connection->fd, POLLIN, 0 });
+
+            if (::poll(fds.data(), fds.size(), -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                pollError = errno;
+                break;
+            }
+            if (fds[0].revents)
+                break;
+
+            for (size_t i = connections.size(); i-- > 0;)
+            {
+                if (fds[i + 2].revents && !_read(connections[i]))
+                    connections.erase(connections.begin() + i);
+            }
+            if (fds[1].revents & POLLIN)
+                _accept(connections);
+        }
+
+        // Queued jobs are still answered, their connections live until then.
+        connections.clear();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _queued.notify_all();
+        for (auto& worker : _workers)
+            worker.join();
+        _workers.clear();
+
+        ::close(_listenFd);
+        _listenFd = -1;
+        ::unlink(_socketPath.c_str());
+
+        if (pollError)
+            throw PhyreExceptionIO(L"Waiting on the daemon socket failed: " + std::to_wstring(pollError));
+    }
+
+    void PhyreDaemon::stop()
+    {
+        const char wake = 0;
+        (void)!::write(_wakeFds[1], &wake, 1);
+    }
+
+    std::string PhyreDaemon::handle(const std::string& request)
+    {
+        // Echoed as it came, also when the request is rejected after it was read.
+        std::string id;
+        const auto start = [&id]() { return id.empty() ? std::string("{") : "{\"id\":" + id + ","; };
+        std::string ret;
+        try
+        {
+            const JsonFields fields = parseRequest(request, id);
+
+            const std::string* op = stringField(fields, "op");
+            if (!op)
+                throw PhyreExceptionData(L"Missing field: op");
+
+            if (*op == "shutdown")
+            {
+                stop();
+                ret = start() + "\"ok\":true}";
+            }
+            else
+            {
+                PhyreStats stats;
+                std::string result;
+                if (flagField(fields, "stats"))
+                {
+                    PhyreStats::Scope scope(stats);
+                    result = runJob(*op, fields) + ",\"stats\":";
+                    result += stats.toJson();
+                }
+                else
+                {
+                    result = runJob(*op, fields);
+                }
+                ret = start() + "\"ok\":true" + result + "}";
+            }
+        }
+        catch (const std::exception& e)
+        {
+            ret = start() + "\"ok\":false,\"error\":" + jsonString(e.what()) + "}";
+        }
+        _handledCount++;
+        return ret;
+    }
+
+    void PhyreDaemon::_work()
+    {
+        for (;;)
+        {
+            _tJob job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _queued.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+                if (_jobs.empty())
+                    return;
+                job = std::move(_jobs.front());
+                _jobs.pop_front();
+            }
+            try
+            {
+                job.connection->send(handle(job.request));
+            }
+            catch (const std::exception&)
+            {
+                // Out of memory for the response, the client gets nothing for this request.
+            }
+        }
+    }
+
+    void PhyreDaemon::_accept(std::vector<std::shared_ptr<_tConnection>>& connections)
+    {
+        for (;;)
+        {
+            const int fd = ::accept(_listenFd, nullptr, nullptr);
+            if (fd < 0)
+                return;
+            // Some systems pass the listening socket's O_NONBLOCK on, responses are sent blocking.
+            setNonBlocking(fd, false);
+            const timeval timeout{ SEND_TIMEOUT_SECONDS, 0 };
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+            const int on = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+            connections.push_back(std::make_shared<_tConnection>(fd));
+        }
+    }
+
+    bool PhyreDaemon::_read(const std::shared_ptr<_tConnection>& connection)
+    {
+        char buffer[16384];
+        const ssize_t size = ::read(connection->fd, buffer, sizeof(buffer));
+        if (size < 0)
+            return errno == EINTR || errno == EAGAIN;
+        if (size == 0)
+            return false;
+
+        std::string& received = connection->received;
+        received.append(buffer, static_cast<size_t>(size));
+        std::vector<_tJob> jobs;
+        size_t start = 0;
+        bool tooLong = false;
+        for (size_t end; (end = received.find('\n', start)) != std::string::npos; start = end + 1)
+        {
+            if (end - start > MAX_REQUEST_SIZE)
+            {
+                tooLong = true;
+                break;
+            }
+            std::string line = received.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.find_first_not_of(" \t") != std::string::npos)
+                jobs.push_back({ connection, std::move(line) });
+        }
+        received.erase(0, start);
+
+        if (!jobs.empty())
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (auto& job : jobs)
+                    _jobs.push_back(std::move(job));
+            }
+            if (jobs.size() == 1)
+                _queued.notify_one();
+            else
+                _queued.notify_all();
+        }
+
+        if (tooLong || received.size() > MAX_REQUEST_SIZE)
+        {
+            connection->send("{\"ok\":false,\"error\":\"Request line too long\"}");
+            return false;
+        }
+        return true;
+    }
+}
+#endif
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef _WIN32
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace phyre
+{
+    /*
+    * Conversion service on a Unix domain socket for callers that would
+    * otherwise start a process per file. Every line a client sends is a
+    * JSON object and gets one line back, in the order the jobs finish,
+    * with the id of its request:
+    *
+    *   {"id":1,"op":"convert","input":"/a/b.phyre","output":"/a/b.dds"}
+    *   {"id":1,"ok":true,"outputs":["/a/b.dds"],"reencodedBlocks":0}
+    *
+    * convert    input phyre to DDS, output defaults to the input with .dds,
+    *            several textures are numbered as ConvertAllPhyre2DDS does
+    * import     input DDS into the phyre at output, or into a copy of
+    *            template written to output, with optional encode and quality
+    * export     input phyre to images, format png or rgba, optional mip
+    * inspect    texture table of input from its headers
+    * ping       answers ok
+    * shutdown   answers ok, finishes the queued jobs and stops
+    *
+    * Paths are absolute, the service doesn't know the client's working
+    * directory. "exactFlip":true flips pixel exact in convert, import
+    * and export, convert and import answer the blocks that were encoded
+    * again for it as "reencodedBlocks". "stats":true adds the job's
+    * PhyreStats as "stats". A job that fails
+    * answers "ok":false with "error". Jobs run on a fixed set of worker
+    * threads, so their arenas and the schema cache stay warm from one
+    * file to the next.
+    */
+    class PhyreDaemon
+    {
+    public:
+        // Longest request line, a client sending more is disconnected.
+        static constexpr size_t MAX_REQUEST_SIZE = 64 * 1024;
+
+        PhyreDaemon() = delete;
+        // Binds socketPath, a socket left behind by a daemon that is gone is replaced. threads 0 uses every core.
+        PhyreDaemon(const std::filesystem::path& socketPath, unsigned threads = 0);
+        PhyreDaemon(const PhyreDaemon&) = delete;
+        PhyreDaemon& operator=(const PhyreDaemon&) = delete;
+        virtual ~PhyreDaemon();
+
+        // Serves until shutdown or stop, answers the jobs already queued and removes the socket.
+        void run();
+        // Only writes to a pipe, safe to call from a signal handler.
+        void stop();
+
+        // Runs one request and returns its response line without the line break.
+        std::string handle(const std::string& request);
+
+        const std::filesystem::path& socketPath() const { return _socketPath; }
+        unsigned threads() const { return _threads; }
+        size_t handledCount() const { return _handledCount; }
+
+    private:
+        struct _tConnection;
+        struct _tJob
+        {
+            std::shared_ptr<_tConnection> connection;
+            std::string request;
+        };
+
+        void _work();
+        void _accept(std::vector<std::shared_ptr<_tConnection>>& connections);
+        // Queues the complete lines that arrived, false once the connection is closed for reading.
+        bool _read(const std::shared_ptr<_tConnection>& connection);
+
+        std::filesystem::path _socketPath;
+        unsigned _threads;
+        int _listenFd = -1;
+        int _wakeFds[2] = { -1, -1 };
+
+        std::mutex _mutex;
+        std::condition_variable _queued;
+        std::deque<_tJob> _jobs;
+        bool _stopping = false;
+        std::vector<std::thread> _workers;
+        std::atomic<size_t> _handledCount{ 0 };
+    };
+}
+#endif
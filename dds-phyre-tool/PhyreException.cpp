@@ -1,9 +1,58 @@
+#include <cstdint>
+
 #include "PhyreException.h"
 
 namespace phyre
 {
+	namespace
+	{
+		// wchar_t holds UTF-16 on Windows and UTF-32 elsewhere, both end up as UTF-8.
+		std::string toUtf8(const std::wstring& text)
+		{
+			std::string ret;
+			for (size_t i = 0; i < text.size(); i++)
+			{
+				uint32_t c = static_cast<uint32_t>(text[i]);
+				if (sizeof(wchar_t) == 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < text.size())
+				{
+					const uint32_t low = static_cast<uint32_t>(text[i + 1]);
+					if (low >= 0xDC00 && low < 0xE000)
+					{
+						c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+						i++;
+					}
+				}
+
+				if (c < 0x80)
+				{
+					ret += static_cast<char>(c);
+				}
+				else if (c < 0x800)
+				{
+					ret += static_cast<char>(0xC0 | (c >> 6));
+					ret += static_cast<char>(0x80 | (c & 0x3F));
+				}
+				else if (c < 0x10000)
+				{
+					ret += static_cast<char>(0xE0 | (c >> 12));
+					ret += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+					ret += static_cast<char>(0x80 | (c & 0x3F));
+				}
+				else
+				{
+					ret += static_cast<char>(0xF0 | (c >> 18));
+					ret += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+					ret += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+					ret += static_cast<char>(0x80 | (c & 0x3F));
+				}
+			}
+			return ret;
+		}
+	}
+
+	// std::exception::what() carries the same message in UTF-8 for callers without wide output.
 	PhyreException::PhyreException(const std::wstring& msg)
-		: std::runtime_error("")
+		: std::runtime_error(toUtf8(msg))
 		, _msg(msg)
 	{
 	}
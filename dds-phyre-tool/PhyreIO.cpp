@@ -0,0 +1,163 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+
+#include "PhyreIO.h"
+#include "PhyreException.h"
+#include "PhyreStats.h"
+#ifdef __linux__
+#include "PhyreIOUring.h"
+#endif
+
+namespace phyre
+{
+    namespace
+    {
+        // One request after another, each finished before the next one starts.
+        class PhyreIOSynchronous : public PhyreIO
+        {
+        public:
+            virtual const char* name() const override { return "synchronous"; }
+
+            virtual void run(_tRequest* requests, size_t count) override
+            {
+                for (size_t i = 0; i < count; i++)
+                    _transfer(requests[i]);
+            }
+
+        private:
+            static void _transfer(_tRequest& request)
+            {
+                request.done = 0;
+                request.error = 0;
+                while (request.done < request.size)
+                {
+                    char* const buffer = request.buffer + request.done;
+                    const uint64_t offset = request.offset + request.done;
+#ifdef _WIN32
+                    OVERLAPPED overlapped{};
+                    overlapped.Offset = static_cast<DWORD>(offset);
+                    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+                    DWORD transferred = 0;
+                    const DWORD chunk = static_cast<DWORD>(std::min<size_t>(request.size - request.done, 1u << 30));
+                    const BOOL success = request.write ? WriteFile(request.file, buffer, chunk, &transferred, &overlapped)
+                        : ReadFile(request.file, buffer, chunk, &transferred, &overlapped);
+                    if (!success && GetLastError() != ERROR_HANDLE_EOF)
+                    {
+                        request.error = static_cast<int>(GetLastError());
+                        return;
+                    }
+#else
+                    const ssize_t transferred = request.write ? ::pwrite(request.file, buffer, request.size - request.done, static_cast<off_t>(offset))
+                        : ::pread(request.file, buffer, request.size - request.done, static_cast<off_t>(offset));
+                    if (transferred < 0 && errno == EINTR)
+                        continue;
+                    if (transferred < 0)
+                    {
+                        request.error = errno;
+                        return;
+                    }
+#endif
+                    if (transferred == 0)
+                    {
+                        // A write that makes no progress would loop forever.
+                        if (request.write)
+                            request.error = EIO;
+                        return;
+                    }
+                    request.done += static_cast<size_t>(transferred);
+                }
+            }
+        };
+    }
+
+    std::unique_ptr<PhyreIO> PhyreIO::create(unsigned queueDepth)
+    {
+#ifdef __linux__
+        // Kernels without io_uring, or with it disabled or filtered, get the fallback.
+        std::unique_ptr<PhyreIO> ret = PhyreIOUring::create(queueDepth);
+        if (ret)
+            return ret;
+#else
+        (void)queueDepth;
+#endif
+        return createSynchronous();
+    }
+
+    std::unique_ptr<PhyreIO> PhyreIO::createSynchronous()
+    {
+        return std::unique_ptr<PhyreIO>(new PhyreIOSynchronous);
+    }
+
+    bool PhyreIO::registerBuffers(const std::vector<std::pair<char*, size_t>>&)
+    {
+        return false;
+    }
+
+    PhyreIO::_tHandle PhyreIO::openFile(const std::filesystem::path& path, bool write)
+    {
+        PhyreStats::Timer timer(PhyreStats::stageOpen);
+        if (write)
+        {
+            unlinkShared(path);
+            PhyreStats::addWritten(PhyreStats::stageOpen, 0);
+        }
+        else
+            PhyreStats::addRead(PhyreStats::stageOpen, 0);
+#ifdef _WIN32
+        HANDLE fileHandle = write ? CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr)
+            : CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+            throw PhyreExceptionIO((write ? L"Cannot create file: " : L"Cannot open binary file: ") + path.wstring());
+        return fileHandle;
+#else
+        const int fd = write ? ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)
+            : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw PhyreExceptionIO((write ? L"Cannot create file: " : L"Cannot open binary file: ") + path.wstring());
+        return fd;
+#endif
+    }
+
+    void PhyreIO::closeFile(_tHandle file)
+    {
+#ifdef _WIN32
+        CloseHandle(file);
+#else
+        ::close(file);
+#endif
+    }
+
+    uint64_t PhyreIO::fileSize(_tHandle file)
+    {
+#ifdef _WIN32
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx(file, &size))
+            throw PhyreExceptionIO(L"Cannot get file size");
+        return static_cast<uint64_t>(size.QuadPart);
+#else
+        struct stat fileStat {};
+        if (::fstat(file, &fileStat) != 0)
+            throw PhyreExceptionIO(L"Cannot get file size");
+        return static_cast<uint64_t>(fileStat.st_size);
+#endif
+    }
+
+    void PhyreIO::unlinkShared(const std::filesystem::path& path)
+    {
+        // Outputs of a PhyreStore can be hard links to the stored file.
+        std::error_code error;
+        const uintmax_t links = std::filesystem::hard_link_count(path, error);
+        if (!error && links > 1)
+            std::filesystem::remove(path, error);
+    }
+}
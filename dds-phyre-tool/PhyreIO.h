@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace phyre
+{
+    /*
+    * Positioned reads and writes issued in batches. A backend may keep
+    * every request of a batch in flight at once, callers only see whole
+    * batches complete. create picks io_uring on Linux and falls back to
+    * one pread or pwrite after another where it is unavailable, the
+    * callers work the same with either.
+    */
+    class PhyreIO
+    {
+    public:
+#ifdef _WIN32
+        using _tHandle = void*;
+#else
+        using _tHandle = int;
+#endif
+
+        struct _tRequest
+        {
+            _tHandle file;
+            // Written from for writes, the data is never modified then.
+            char* buffer;
+            size_t size;
+            uint64_t offset;
+            bool write;
+            // Bytes transferred, a read comes up short only at the end of the file.
+            size_t done;
+            // 0, or the system error of the first failed attempt.
+            int error;
+        };
+
+        static constexpr unsigned DEFAULT_QUEUE_DEPTH = 64;
+
+        static std::unique_ptr<PhyreIO> create(unsigned queueDepth = DEFAULT_QUEUE_DEPTH);
+        static std::unique_ptr<PhyreIO> createSynchronous();
+
+        virtual ~PhyreIO() = default;
+        virtual const char* name() const = 0;
+
+        // Runs every request, returns once all of them are complete or failed.
+        virtual void run(_tRequest* requests, size_t count) = 0;
+
+        /*
+        * Memory the backend may pin for its whole lifetime, a request that
+        * lies entirely in one of these buffers skips mapping its pages on
+        * every transfer. Replaces the buffers registered before, false if
+        * the backend kept none of them.
+        */
+        virtual bool registerBuffers(const std::vector<std::pair<char*, size_t>>& buffers);
+
+        // Files for requests, opened for reading or created and truncated for writing.
+        static _tHandle openFile(const std::filesystem::path& path, bool write);
+        static void closeFile(_tHandle file);
+        static uint64_t fileSize(_tHandle file);
+        // Removes path if other names link to its data, writing the file then leaves theirs alone.
+        static void unlinkShared(const std::filesystem::path& path);
+    };
+}
@@ -0,0 +1,209 @@
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+
+#include "PhyreIOUring.h"
+#include "PhyreException.h"
+
+namespace phyre
+{
+    namespace
+    {
+        // The kernel takes at most this much per transfer, longer requests continue as short ones.
+        constexpr size_t MAX_TRANSFER = 1u << 30;
+    }
+
+    std::unique_ptr<PhyreIO> PhyreIOUring::create(unsigned queueDepth)
+    {
+        std::unique_ptr<PhyreIOUring> ret(new PhyreIOUring);
+        if (!ret->_setup(std::max(1u, queueDepth)))
+            return nullptr;
+        return std::unique_ptr<PhyreIO>(std::move(ret));
+    }
+
+    PhyreIOUring::~PhyreIOUring()
+    {
+        if (_sqes)
+            ::munmap(_sqes, _sqesSize);
+        if (_cqRing && _cqRing != _sqRing)
+            ::munmap(_cqRing, _cqRingSize);
+        if (_sqRing)
+            ::munmap(_sqRing, _sqRingSize);
+        if (_ringFd >= 0)
+            ::close(_ringFd);
+    }
+
+    bool PhyreIOUring::_setup(unsigned queueDepth)
+    {
+        io_uring_params params{};
+        _ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, queueDepth, &params));
+        if (_ringFd < 0)
+            return false;
+
+        // Completions go to a ring twice the size, requests in flight never overflow it.
+        _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap)
+            _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+        void* sqRing = ::mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED)
+            return false;
+        _sqRing = sqRing;
+
+        void* cqRing = singleMap ? sqRing
+            : ::mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+            return false;
+        _cqRing = cqRing;
+
+        _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return false;
+        _sqes = static_cast<io_uring_sqe*>(sqes);
+
+        char* const sq = static_cast<char*>(_sqRing);
+        _sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        _sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        _sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        _sqEntries = params.sq_entries;
+
+        char* const cq = static_cast<char*>(_cqRing);
+        _cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        _cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        _cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    bool PhyreIOUring::registerBuffers(const std::vector<std::pair<char*, size_t>>& buffers)
+    {
+        if (!_buffers.empty())
+            (void)::syscall(__NR_io_uring_register, _ringFd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        _buffers.clear();
+        if (buffers.empty())
+            return false;
+
+        std::vector<iovec> iovecs;
+        for (const auto& buffer : buffers)
+            iovecs.push_back({ buffer.first, buffer.second });
+
+        // Pinning counts against the locked memory limit, the plain opcodes work without it.
+        if (::syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_BUFFERS, iovecs.data(), static_cast<unsigned>(iovecs.size())) != 0)
+            return false;
+        _buffers = buffers;
+        return true;
+    }
+
+    void PhyreIOUring::run(_tRequest* requests, size_t count)
+    {
+        std::deque<size_t> pending;
+        for (size_t i = 0; i < count; i++)
+        {
+            requests[i].done = 0;
+            requests[i].error = 0;
+            if (requests[i].size)
+                pending.push_back(i);
+        }
+        _iovecs.resize(count);
+
+        unsigned inFlight = 0;
+        while (!pending.empty() || inFlight)
+        {
+            unsigned prepared = 0;
+            while (!pending.empty() && inFlight + prepared < _sqEntries)
+            {
+                _prepare(requests[pending.front()], pending.front());
+                pending.pop_front();
+                prepared++;
+            }
+            inFlight += prepared;
+            _submitAndWait(prepared);
+
+            // The kernel publishes completions with a release store on the tail.
+            unsigned head = *_cqHead;
+            const unsigned tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++, inFlight--)
+            {
+                const io_uring_cqe& cqe = _cqes[head & _cqMask];
+                const size_t index = static_cast<size_t>(cqe.user_data);
+                _tRequest& request = requests[index];
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+                    pending.push_back(index);
+                else if (cqe.res < 0)
+                    request.error = -cqe.res;
+                else if (cqe.res == 0)
+                    request.error = request.write ? EIO : 0;
+                else if ((request.done += static_cast<size_t>(cqe.res)) < request.size)
+                    pending.push_back(index);
+            }
+            __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    void PhyreIOUring::_prepare(const _tRequest& request, size_t index)
+    {
+        const unsigned tail = *_sqTail;
+        const unsigned slot = tail & _sqMask;
+        io_uring_sqe& sqe = _sqes[slot];
+        std::memset(&sqe, 0, sizeof(sqe));
+
+        char* const buffer = request.buffer + request.done;
+        const size_t size = std::min(request.size - request.done, MAX_TRANSFER);
+        sqe.fd = request.file;
+        sqe.off = request.offset + request.done;
+        sqe.user_data = index;
+
+        const auto fixed = std::find_if(_buffers.begin(), _buffers.end(), [&](const std::pair<char*, size_t>& registered)
+        {
+            if (buffer < registered.first || buffer > registered.first + registered.second)
+                return false;
+            return size <= registered.second - static_cast<size_t>(buffer - registered.first);
+        });
+        if (fixed != _buffers.end())
+        {
+            sqe.opcode = request.write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe.addr = reinterpret_cast<uint64_t>(buffer);
+            sqe.len = static_cast<uint32_t>(size);
+            sqe.buf_index = static_cast<uint16_t>(fixed - _buffers.begin());
+        }
+        else
+        {
+            // The vectored opcodes are the ones every io_uring kernel has.
+            _iovecs[index] = { buffer, size };
+            sqe.opcode = request.write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe.addr = reinterpret_cast<uint64_t>(&_iovecs[index]);
+            sqe.len = 1;
+        }
+
+        _sqArray[slot] = slot;
+        __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    void PhyreIOUring::_submitAndWait(unsigned submitted)
+    {
+        for (;;)
+        {
+            const long ret = ::syscall(__NR_io_uring_enter, _ringFd, submitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw PhyreExceptionIO(L"io_uring submission failed");
+            }
+            submitted -= std::min<unsigned>(submitted, static_cast<unsigned>(ret));
+            if (!submitted)
+                return;
+        }
+    }
+}
+#endif
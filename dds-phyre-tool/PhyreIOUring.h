@@ -0,0 +1,65 @@
+#pragma once
+#ifdef __linux__
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sys/uio.h>
+
+#include "PhyreIO.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace phyre
+{
+    /*
+    * io_uring backend, talking to the kernel through the raw system calls
+    * so there is nothing to link. Up to the queue depth of requests are
+    * in flight at a time. Short transfers are resubmitted for the rest,
+    * registered buffers use the fixed buffer opcodes.
+    */
+    class PhyreIOUring : public PhyreIO
+    {
+    public:
+        // Null where the kernel has no io_uring or refuses to set one up.
+        static std::unique_ptr<PhyreIO> create(unsigned queueDepth);
+
+        PhyreIOUring(const PhyreIOUring&) = delete;
+        PhyreIOUring& operator=(const PhyreIOUring&) = delete;
+        virtual ~PhyreIOUring();
+
+        virtual const char* name() const override { return "io_uring"; }
+        virtual void run(_tRequest* requests, size_t count) override;
+        virtual bool registerBuffers(const std::vector<std::pair<char*, size_t>>& buffers) override;
+
+    private:
+        PhyreIOUring() = default;
+
+        bool _setup(unsigned queueDepth);
+        void _prepare(const _tRequest& request, size_t index);
+        // Submits what was prepared and waits for at least one completion.
+        void _submitAndWait(unsigned submitted);
+
+        int _ringFd = -1;
+        void* _sqRing = nullptr;
+        size_t _sqRingSize = 0;
+        void* _cqRing = nullptr;
+        size_t _cqRingSize = 0;
+        io_uring_sqe* _sqes = nullptr;
+        size_t _sqesSize = 0;
+
+        unsigned* _sqTail = nullptr;
+        unsigned _sqMask = 0;
+        unsigned* _sqArray = nullptr;
+        unsigned _sqEntries = 0;
+        unsigned* _cqHead = nullptr;
+        unsigned* _cqTail = nullptr;
+        unsigned _cqMask = 0;
+        io_uring_cqe* _cqes = nullptr;
+
+        std::vector<std::pair<char*, size_t>> _buffers;
+        // Vectored requests need their iovec until they complete, one per request.
+        std::vector<iovec> _iovecs;
+    };
+}
+#endif
@@ -0,0 +1,132 @@
+#include "PhyreLayout.h"
+#include "PhyreException.h"
+
+namespace phyre
+{
+    namespace
+    {
+        // Region of count entries of T at offset, counts are 32 bits wide so the product can't overflow.
+        template<typename T>
+        void checkTable(uint64_t offset, uint64_t count, uint64_t end, const wchar_t* what)
+        {
+            if (offset > end || count * sizeof(T) > end - offset)
+                throw PhyreExceptionData(std::wstring(what) + L" reaches past the end of the phyre data");
+        }
+    }
+
+    PhyreLayout PhyreLayout::validate(const PhyreView& phyre, const _tSizes& sizes)
+    {
+        using _tNamespaceHeader = PhyrePlatform::_tNamespaceHeader;
+        using _tNamespaceClassDescriptor = PhyrePlatform::_tNamespaceClassDescriptor;
+        using _tNamespaceDataMember = PhyrePlatform::_tNamespaceDataMember;
+        using _tInstanceDescriptor = PhyrePlatform::_tInstanceDescriptor;
+        using _tUserFixup = PhyrePlatform::_tUserFixup;
+
+        PhyreLayout ret;
+        ret._phyre = phyre;
+        const uint64_t fileSize = phyre.size();
+
+        // The namespace tables have to be inside the namespace, not just inside the file.
+        checkTable<char>(sizes.namespaceOffset, sizes.namespaceSize, fileSize, L"Namespace");
+        if (sizes.namespaceSize < sizeof(_tNamespaceHeader))
+            throw PhyreExceptionData(L"Namespace too small for its header");
+        ret._namespaceOffset = sizes.namespaceOffset;
+        ret._namespaceSize = sizes.namespaceSize;
+        const uint64_t namespaceEnd = 0ULL + sizes.namespaceOffset + sizes.namespaceSize;
+        ret._namespaceHeader = ret._entry<_tNamespaceHeader>(sizes.namespaceOffset, 0);
+        const _tNamespaceHeader& header = ret._namespaceHeader;
+
+        ret._typeOffset = sizes.namespaceOffset + sizeof(_tNamespaceHeader);
+        checkTable<uint32_t>(ret._typeOffset, header.typeCount, namespaceEnd, L"Type table");
+        ret._classOffset = ret._typeOffset + sizeof(uint32_t) * static_cast<size_t>(header.typeCount);
+        checkTable<_tNamespaceClassDescriptor>(ret._classOffset, header.classCount, namespaceEnd, L"Class table");
+        ret._memberOffset = ret._classOffset + sizeof(_tNamespaceClassDescriptor) * static_cast<size_t>(header.classCount);
+
+        // The string table and the default buffers end the namespace.
+        const uint64_t tailSize = 0ULL + header.stringTableSize + static_cast<uint64_t>(header.defaultBufferCount) * header.defaultBufferSize;
+        if (tailSize > header.size)
+            throw PhyreExceptionData(L"String table reaches past the start of the namespace");
+        const uint64_t stringTableOffset = sizes.namespaceOffset + (header.size - tailSize);
+        checkTable<char>(stringTableOffset, header.stringTableSize, namespaceEnd, L"String table");
+        ret._stringTableOffset = static_cast<size_t>(stringTableOffset);
+
+        // A name is terminated if a null follows it anywhere in the table, so only the last null matters.
+        const char* strings = ret.stringTable();
+        uint64_t terminated = 0;
+        for (uint64_t i = header.stringTableSize; i > 0; i--)
+        {
+            if (strings[i - 1] == 0)
+            {
+                terminated = i;
+                break;
+            }
+        }
+        auto checkName = [terminated](uint32_t offset)
+        {
+            if (offset >= terminated)
+                throw PhyreExceptionData(L"Name outside of namespace string table");
+        };
+
+        for (uint32_t i = 0; i < header.typeCount; i++)
+            checkName(ret.type(i));
+
+        uint64_t memberCount = 0;
+        for (uint32_t i = 0; i < header.classCount; i++)
+        {
+            const _tNamespaceClassDescriptor classDescriptor = ret.classDescriptor(i);
+            checkName(classDescriptor.nameOffset);
+            if (classDescriptor.baseClassId > header.classCount)
+                throw PhyreExceptionData(L"Base class outside of the class table");
+            memberCount += classDescriptor.dataMemberCount;
+        }
+        checkTable<_tNamespaceDataMember>(ret._memberOffset, memberCount, namespaceEnd, L"Member table");
+        ret._memberCount = static_cast<size_t>(memberCount);
+
+        for (size_t i = 0; i < ret._memberCount; i++)
+            checkName(ret.member(i).nameOffset);
+
+        // Instances follow the namespace as its header sizes it.
+        const uint64_t instanceListOffset = 0ULL + sizes.namespaceOffset + header.size;
+        checkTable<_tInstanceDescriptor>(instanceListOffset, sizes.instanceCount, fileSize, L"Instance list");
+        ret._instanceListOffset = static_cast<size_t>(instanceListOffset);
+        ret._instanceCount = sizes.instanceCount;
+        ret._instanceDataOffset = ret._instanceListOffset + sizeof(_tInstanceDescriptor) * sizes.instanceCount;
+        checkTable<char>(ret._instanceDataOffset, sizes.instanceDataSize, fileSize, L"Instance data");
+        ret._instanceDataSize = sizes.instanceDataSize;
+
+        uint64_t instanceEnd = 0;
+        for (size_t i = 0; i < ret._instanceCount; i++)
+        {
+            const _tInstanceDescriptor instance = ret.instance(i);
+            if (instance.classId == 0 || instance.classId > header.classCount)
+                throw PhyreExceptionData(L"Instance of a class outside of the class table");
+            if (static_cast<uint64_t>(instance.count) * instance.objectSize > instance.size || (instance.count && !instance.objectSize))
+                throw PhyreExceptionData(L"Instance objects don't fit the instance");
+            instanceEnd += instance.size;
+        }
+        if (instanceEnd > ret._instanceDataSize)
+            throw PhyreExceptionData(L"Instances reach past the instance data");
+
+        ret._userFixupDataOffset = ret._instanceDataOffset + ret._instanceDataSize;
+        checkTable<char>(ret._userFixupDataOffset, sizes.userFixupDataSize, fileSize, L"User fixup data");
+        ret._userFixupDataSize = sizes.userFixupDataSize;
+        ret._userFixupOffset = ret._userFixupDataOffset + ret._userFixupDataSize;
+        checkTable<_tUserFixup>(ret._userFixupOffset, sizes.userFixupCount, fileSize, L"User fixup table");
+        ret._userFixupCount = sizes.userFixupCount;
+
+        for (size_t i = 0; i < ret._userFixupCount; i++)
+        {
+            const _tUserFixup fixup = ret.userFixup(i);
+            if (fixup.typeId >= header.typeCount)
+                throw PhyreExceptionData(L"User fixup of a type outside of the type table");
+            if (fixup.offset > ret._userFixupDataSize || fixup.size > ret._userFixupDataSize - fixup.offset)
+                throw PhyreExceptionData(L"User fixup reaches past its data");
+        }
+
+        const size_t fixupTablesOffset = ret._userFixupOffset + sizeof(_tUserFixup) * ret._userFixupCount;
+        checkTable<char>(fixupTablesOffset, sizes.fixupTablesSize, fileSize, L"Fixup tables");
+        ret._payloadOffset = fixupTablesOffset + sizes.fixupTablesSize;
+
+        return ret;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "PhyrePlatform.h"
+
+namespace phyre
+{
+    /*
+    * A phyre that passed validate. Every table lies inside the file and
+    * holds as many entries as its count says, every name reference ends
+    * inside the string table, class references resolve, instances fit
+    * the instance data and user fixups fit their data. Only validate
+    * makes layouts, so the accessors index the tables without checking
+    * again. Nothing in a phyre is aligned, entries are copied out rather
+    * than handed out in place. The file has to outlive the layout.
+    */
+    class PhyreLayout
+    {
+    public:
+        // What the platform header says about the file, offsets are from its start.
+        struct _tSizes
+        {
+            size_t namespaceOffset;
+            size_t namespaceSize;
+            size_t instanceCount;
+            size_t instanceDataSize;
+            size_t userFixupDataSize;
+            size_t userFixupCount;
+            // Pointer and array fixups between the user fixups and the texture data, they are skipped.
+            size_t fixupTablesSize;
+        };
+
+        // Checks every offset, count and reference in one pass, throws PhyreExceptionData on the first one that is off.
+        static PhyreLayout validate(const PhyreView& phyre, const _tSizes& sizes);
+
+        const PhyreView& phyre() const { return _phyre; }
+        PhyreView namespaceData() const { return _phyre.sub(_namespaceOffset, _namespaceSize); }
+
+        const PhyrePlatform::_tNamespaceHeader& namespaceHeader() const { return _namespaceHeader; }
+        uint32_t type(size_t index) const { return _entry<uint32_t>(_typeOffset, index); }
+        PhyrePlatform::_tNamespaceClassDescriptor classDescriptor(size_t index) const { return _entry<PhyrePlatform::_tNamespaceClassDescriptor>(_classOffset, index); }
+        // Members of all classes, in class order.
+        PhyrePlatform::_tNamespaceDataMember member(size_t index) const { return _entry<PhyrePlatform::_tNamespaceDataMember>(_memberOffset, index); }
+        size_t memberCount() const { return _memberCount; }
+        const char* stringTable() const { return _phyre.data() + _stringTableOffset; }
+        // Null terminated for every offset the tables refer to.
+        const char* name(uint32_t offset) const { return stringTable() + offset; }
+
+        PhyrePlatform::_tInstanceDescriptor instance(size_t index) const { return _entry<PhyrePlatform::_tInstanceDescriptor>(_instanceListOffset, index); }
+        size_t instanceCount() const { return _instanceCount; }
+        size_t instanceListOffset() const { return _instanceListOffset; }
+        size_t instanceDataOffset() const { return _instanceDataOffset; }
+        size_t instanceDataSize() const { return _instanceDataSize; }
+
+        PhyrePlatform::_tUserFixup userFixup(size_t index) const { return _entry<PhyrePlatform::_tUserFixup>(_userFixupOffset, index); }
+        size_t userFixupCount() const { return _userFixupCount; }
+        size_t userFixupOffset() const { return _userFixupOffset; }
+        PhyreView userFixupData() const { return _phyre.sub(_userFixupDataOffset, _userFixupDataSize); }
+        size_t userFixupDataOffset() const { return _userFixupDataOffset; }
+
+        // Where the first texture payload starts, at most the file size.
+        size_t payloadOffset() const { return _payloadOffset; }
+
+    protected:
+        PhyreLayout() = default;
+
+        template<typename T>
+        T _entry(size_t offset, size_t index) const
+        {
+            T ret;
+            std::memcpy(&ret, _phyre.data() + offset + index * sizeof(T), sizeof(T));
+            return ret;
+        }
+
+        PhyreView _phyre;
+        PhyrePlatform::_tNamespaceHeader _namespaceHeader{};
+        size_t _namespaceOffset = 0;
+        size_t _namespaceSize = 0;
+        size_t _typeOffset = 0;
+        size_t _classOffset = 0;
+        size_t _memberOffset = 0;
+        size_t _memberCount = 0;
+        size_t _stringTableOffset = 0;
+        size_t _instanceListOffset = 0;
+        size_t _instanceCount = 0;
+        size_t _instanceDataOffset = 0;
+        size_t _instanceDataSize = 0;
+        size_t _userFixupDataOffset = 0;
+        size_t _userFixupDataSize = 0;
+        size_t _userFixupOffset = 0;
+        size_t _userFixupCount = 0;
+        size_t _payloadOffset = 0;
+    };
+}
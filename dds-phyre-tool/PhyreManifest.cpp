@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "PhyreManifest.h"
+#include "PhyreMappedFile.h"
+#include "PhyreStats.h"
+#include "PhyreTempFile.h"
+
+namespace fs = std::filesystem;
+
+namespace phyre
+{
+    namespace
+    {
+        const char* const MANIFEST_SIGNATURE = "dds-phyre-manifest 1";
+
+        constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+        constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+        constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+        constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+        constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+        uint64_t rotl(uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        uint64_t read64(const char* data)
+        {
+            uint64_t ret;
+            std::memcpy(&ret, data, sizeof(ret));
+            return ret;
+        }
+
+        uint64_t round(uint64_t acc, uint64_t input)
+        {
+            return rotl(acc + input * PRIME2, 31) * PRIME1;
+        }
+
+        uint64_t mergeRound(uint64_t acc, uint64_t lane)
+        {
+            return (acc ^ round(0, lane)) * PRIME1 + PRIME4;
+        }
+
+        // A write within this window can still be followed by one with the same time stamp.
+        constexpr auto RACY_WINDOW = std::chrono::seconds(2);
+    }
+
+    PhyreManifest::PhyreManifest(const fs::path& manifestPath)
+        : _path(manifestPath)
+        , _root(manifestPath.parent_path())
+    {
+        _load();
+    }
+
+    bool PhyreManifest::isUpToDate(const fs::directory_entry& input)
+    {
+        auto found = _entries.find(_key(input.path()));
+        if (found == _entries.end())
+            return false;
+
+        _tEntry& entry = found->second;
+        entry.visited = true;
+        if (entry.outputs.empty() || !_matches(input, entry.input))
+            return false;
+
+        for (auto& output : entry.outputs)
+        {
+            std::error_code error;
+            const fs::directory_entry file(_root / fs::u8path(output.first), error);
+            if (error || !_matches(file, output.second))
+                return false;
+        }
+        return true;
+    }
+
+    void PhyreManifest::record(const fs::path& input, const std::vector<fs::path>& outputs)
+    {
+        _tEntry entry{};
+        entry.visited = true;
+
+        const auto stat = [](const fs::path& path, _tFile& info)
+        {
+            std::error_code error;
+            const fs::directory_entry file(path, error);
+            if (error || !_stat(file, info))
+                throw PhyreExceptionIO(L"Cannot get file status: " + path.wstring());
+            info.hash = hashFile(path);
+        };
+
+        stat(input, entry.input);
+        for (const auto& output : outputs)
+        {
+            _tFile info{};
+            stat(output, info);
+            entry.outputs.emplace_back(_key(output), info);
+        }
+        _entries[_key(input)] = std::move(entry);
+    }
+
+    void PhyreManifest::forget(const fs::path& input)
+    {
+        _entries.erase(_key(input));
+    }
+
+    void PhyreManifest::prune()
+    {
+        for (auto it = _entries.begin(); it != _entries.end();)
+        {
+            if (it->second.visited)
+                ++it;
+            else
+                it = _entries.erase(it);
+        }
+    }
+
+    void PhyreManifest::save()
+    {
+        // Sorted so that unchanged libraries produce identical manifests.
+        std::vector<const std::pair<const std::string, _tEntry>*> sorted;
+        sorted.reserve(_entries.size());
+        for (const auto& entry : _entries)
+        {
+            if (entry.first.find('\n') == std::string::npos)
+                sorted.push_back(&entry);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+        std::string text = MANIFEST_SIGNATURE;
+        text += '\n';
+        const auto appendLine = [&text](char kind, const _tFile& info, const std::string& path)
+        {
+            char fields[80];
+            std::snprintf(fields, sizeof(fields), "%c\t%" PRIu64 "\t%" PRId64 "\t%016" PRIx64 "\t", kind, info.size, info.modified, info.hash);
+            text += fields;
+            text += path;
+            text += '\n';
+        };
+        for (const auto* entry : sorted)
+        {
+            appendLine('I', entry->second.input, entry->first);
+            for (const auto& output : entry->second.outputs)
+                appendLine('O', output.second, output.first);
+        }
+
+        PhyreTempFile file(_path);
+        file.write(PhyreView(text.data(), text.size()), 0);
+        file.commit();
+    }
+
+    uint64_t PhyreManifest::hash(const PhyreView& data)
+    {
+        const char* p = data.data();
+        const char* const end = p + data.size();
+        uint64_t ret;
+
+        // Four independent lanes over 32 byte stripes, so the multiplies overlap.
+        if (data.size() >= 32)
+        {
+            uint64_t v1 = PRIME1 + PRIME2;
+            uint64_t v2 = PRIME2;
+            uint64_t v3 = 0;
+            uint64_t v4 = 0 - PRIME1;
+            for (; end - p >= 32; p += 32)
+            {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+            }
+            ret = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            ret = mergeRound(ret, v1);
+            ret = mergeRound(ret, v2);
+            ret = mergeRound(ret, v3);
+            ret = mergeRound(ret, v4);
+        }
+        else
+        {
+            ret = PRIME5;
+        }
+        ret += data.size();
+
+        for (; end - p >= 8; p += 8)
+            ret = rotl(ret ^ round(0, read64(p)), 27) * PRIME1 + PRIME4;
+        if (end - p >= 4)
+        {
+            uint32_t word;
+            std::memcpy(&word, p, sizeof(word));
+            ret = rotl(ret ^ (word * PRIME1), 23) * PRIME2 + PRIME3;
+            p += 4;
+        }
+        for (; p < end; p++)
+            ret = rotl(ret ^ (static_cast<uint8_t>(*p) * PRIME5), 11) * PRIME1;
+
+        ret ^= ret >> 33;
+        ret *= PRIME2;
+        ret ^= ret >> 29;
+        ret *= PRIME3;
+        ret ^= ret >> 32;
+        return ret;
+    }
+
+    uint64_t PhyreManifest::hashFile(const fs::path& path)
+    {
+        PhyreMappedFile file(path);
+        PhyreStats::Timer timer(PhyreStats::stageRead);
+        PhyreStats::addRead(PhyreStats::stageRead, file.size(), 0);
+        return hash(file.view());
+    }
+
+    void PhyreManifest::_load()
+    {
+        std::ifstream in(_path, std::ios::binary);
+        std::string line;
+        if (!in || !std::getline(in, line) || line != MANIFEST_SIGNATURE)
+            return;
+
+        _tEntry* current = nullptr;
+        while (std::getline(in, line))
+        {
+            // kind, size, time and hash are tab separated, the path is the rest of the line.
+            const char* fields[5] = { line.c_str() };
+            for (int i = 1; i < 5; i++)
+            {
+                const char* tab = std::strchr(fields[i - 1], '\t');
+                if (!tab)
+                {
+                    _entries.clear();
+                    return;
+                }
+                fields[i] = tab + 1;
+            }
+
+            _tFile info{};
+            info.size = std::strtoull(fields[1], nullptr, 10);
+            info.modified = std::strtoll(fields[2], nullptr, 10);
+            info.hash = std::strtoull(fields[3], nullptr, 16);
+            if (line[0] == 'I')
+            {
+                current = &_entries[fields[4]];
+                *current = { info, {}, false };
+            }
+            else if (line[0] == 'O' && current)
+            {
+                current->outputs.emplace_back(fields[4], info);
+            }
+            else
+            {
+                _entries.clear();
+                return;
+            }
+        }
+    }
+
+    std::string PhyreManifest::_key(const fs::path& path) const
+    {
+        const fs::path relative = path.lexically_relative(_root);
+        if (relative.empty() || *relative.begin() == "..")
+            return path.generic_u8string();
+        return relative.generic_u8string();
+    }
+
+    bool PhyreManifest::_stat(const fs::directory_entry& file, _tFile& info)
+    {
+        std::error_code error;
+        info.size = file.file_size(error);
+        if (error)
+            return false;
+        const auto modified = file.last_write_time(error);
+        if (error)
+            return false;
+
+        // A file written within the same clock tick after this check would look unchanged.
+        const bool racy = fs::file_time_type::clock::now() - modified < RACY_WINDOW;
+        info.modified = racy ? 0 : static_cast<int64_t>(modified.time_since_epoch().count());
+        return true;
+    }
+
+    bool PhyreManifest::_matches(const fs::directory_entry& file, _tFile& recorded)
+    {
+        _tFile current{};
+        if (!_stat(file, current) || current.size != recorded.size)
+            return false;
+        if (current.modified != 0 && current.modified == recorded.modified)
+            return true;
+
+        // Same size but a different time, only the content can tell.
+        try
+        {
+            if (hashFile(file.path()) != recorded.hash)
+                return false;
+        }
+        catch (PhyreException&)
+        {
+            return false;
+        }
+        recorded.modified = current.modified;
+        return true;
+    }
+}
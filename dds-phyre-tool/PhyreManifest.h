@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PhyreView.h"
+
+namespace phyre
+{
+    /*
+    * Record of finished conversions for incremental runs. Each input is
+    * stored with its size, modification time and content hash, together
+    * with the same for every output it produced. An entry is up to date
+    * when a stat of the input and its outputs matches the record. Files
+    * are only hashed when the size matches but the time does not, so a
+    * touched but unchanged file is not converted again.
+    *
+    * Paths are stored relative to the directory of the manifest file.
+    * A manifest that is missing or can't be parsed starts out empty,
+    * which only costs a full conversion.
+    */
+    class PhyreManifest
+    {
+    public:
+        struct _tFile
+        {
+            uint64_t size;
+            // 0 when the time couldn't be trusted, the file is then hashed on the next check.
+            int64_t modified;
+            uint64_t hash;
+        };
+
+        PhyreManifest() = delete;
+        PhyreManifest(const std::filesystem::path& manifestPath);
+
+        /*
+        * True when the input and all of its outputs still match the
+        * record. Times of files that only matched by hash are updated so
+        * the next check is stat only again.
+        */
+        bool isUpToDate(const std::filesystem::directory_entry& input);
+        // Replaces the record of the input, input and outputs are hashed from disk.
+        void record(const std::filesystem::path& input, const std::vector<std::filesystem::path>& outputs);
+        void forget(const std::filesystem::path& input);
+        // Drops inputs that weren't checked or recorded since the manifest was loaded.
+        void prune();
+
+        // Replaces the manifest file on disk, the old one stays intact if this fails.
+        void save();
+
+        size_t size() const { return _entries.size(); }
+
+        // 64 bit content hash, the XXH64 algorithm with seed 0.
+        static uint64_t hash(const PhyreView& data);
+        static uint64_t hashFile(const std::filesystem::path& path);
+
+    protected:
+        struct _tEntry
+        {
+            _tFile input;
+            std::vector<std::pair<std::string, _tFile>> outputs;
+            bool visited;
+        };
+
+        void _load();
+        std::string _key(const std::filesystem::path& path) const;
+        // Size and time of the file, the hash is left to the caller.
+        static bool _stat(const std::filesystem::directory_entry& file, _tFile& info);
+        static bool _matches(const std::filesystem::directory_entry& file, _tFile& recorded);
+
+        std::filesystem::path _path;
+        std::filesystem::path _root;
+        std::unordered_map<std::string, _tEntry> _entries;
+    };
+}
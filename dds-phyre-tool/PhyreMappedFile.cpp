@@ -0,0 +1,140 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <utility>
+
+#include "PhyreMappedFile.h"
+#include "PhyreStats.h"
+
+namespace phyre
+{
+    PhyreMappedFile::PhyreMappedFile(const std::filesystem::path& path)
+        : _path(path)
+    {
+        PhyreStats::Timer timer(PhyreStats::stageOpen);
+        PhyreStats::addRead(PhyreStats::stageOpen, 0);
+#ifdef _WIN32
+        HANDLE fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+            throw PhyreExceptionIO(L"Cannot open binary file: " + path.wstring());
+        _fileHandle = fileHandle;
+        _isOpen = true;
+
+        LARGE_INTEGER fileSize{};
+        if (!GetFileSizeEx(fileHandle, &fileSize))
+        {
+            close();
+            throw PhyreExceptionIO(L"Cannot get file size: " + path.wstring());
+        }
+        _size = static_cast<size_t>(fileSize.QuadPart);
+
+        // Empty files cannot be mapped, an empty view is enough for them.
+        if (_size == 0)
+            return;
+
+        _mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!_mappingHandle)
+        {
+            close();
+            throw PhyreExceptionIO(L"Cannot map file: " + path.wstring());
+        }
+
+        _data = static_cast<const char*>(MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (!_data)
+        {
+            close();
+            throw PhyreExceptionIO(L"Cannot map file: " + path.wstring());
+        }
+#else
+        _fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (_fd < 0)
+            throw PhyreExceptionIO(L"Cannot open binary file: " + path.wstring());
+        _isOpen = true;
+
+        struct stat fileStat {};
+        if (::fstat(_fd, &fileStat) != 0)
+        {
+            close();
+            throw PhyreExceptionIO(L"Cannot get file size: " + path.wstring());
+        }
+        _size = static_cast<size_t>(fileStat.st_size);
+
+        if (_size == 0)
+            return;
+
+        void* mapping = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close();
+            throw PhyreExceptionIO(L"Cannot map file: " + path.wstring());
+        }
+        _data = static_cast<const char*>(mapping);
+#endif
+    }
+
+    PhyreMappedFile::PhyreMappedFile(PhyreMappedFile&& other) noexcept
+    {
+        _swap(other);
+    }
+
+    PhyreMappedFile& PhyreMappedFile::operator=(PhyreMappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            _swap(other);
+        }
+        return *this;
+    }
+
+    PhyreMappedFile::~PhyreMappedFile()
+    {
+        close();
+    }
+
+    void PhyreMappedFile::close()
+    {
+#ifdef _WIN32
+        if (_data)
+            UnmapViewOfFile(_data);
+        if (_mappingHandle)
+            CloseHandle(_mappingHandle);
+        if (_fileHandle)
+            CloseHandle(_fileHandle);
+        _mappingHandle = nullptr;
+        _fileHandle = nullptr;
+#else
+        if (_data)
+            ::munmap(const_cast<char*>(_data), _size);
+        if (_fd >= 0)
+            ::close(_fd);
+        _fd = -1;
+#endif
+        _data = nullptr;
+        _size = 0;
+        _isOpen = false;
+    }
+
+    void PhyreMappedFile::_swap(PhyreMappedFile& other) noexcept
+    {
+        std::swap(_path, other._path);
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        std::swap(_isOpen, other._isOpen);
+#ifdef _WIN32
+        std::swap(_fileHandle, other._fileHandle);
+        std::swap(_mappingHandle, other._mappingHandle);
+#else
+        std::swap(_fd, other._fd);
+#endif
+    }
+}
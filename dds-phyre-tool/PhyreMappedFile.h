@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+#include "PhyreView.h"
+
+namespace phyre
+{
+    /*
+    * Read-only memory mapping of a whole file. One mapping is shared by
+    * probing, parsing and conversion so the file is opened only once and
+    * headers are read in place without seek/read pairs.
+    */
+    class PhyreMappedFile
+    {
+    public:
+        PhyreMappedFile() = delete;
+        PhyreMappedFile(const std::filesystem::path& path);
+        PhyreMappedFile(const PhyreMappedFile&) = delete;
+        PhyreMappedFile& operator=(const PhyreMappedFile&) = delete;
+        PhyreMappedFile(PhyreMappedFile&& other) noexcept;
+        PhyreMappedFile& operator=(PhyreMappedFile&& other) noexcept;
+        virtual ~PhyreMappedFile();
+
+        const std::filesystem::path& path() const { return _path; }
+        PhyreView view() const { return PhyreView(_data, _size); }
+        size_t size() const { return _size; }
+        bool isOpen() const { return _isOpen; }
+
+        // Unmaps the file. Needed before the file can be truncated on Windows.
+        void close();
+
+    private:
+        void _swap(PhyreMappedFile& other) noexcept;
+
+        std::filesystem::path _path;
+        const char* _data = nullptr;
+        size_t _size = 0;
+        bool _isOpen = false;
+#ifdef _WIN32
+        void* _fileHandle = nullptr;
+        void* _mappingHandle = nullptr;
+#else
+        int _fd = -1;
+#endif
+    };
+}
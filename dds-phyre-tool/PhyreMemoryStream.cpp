@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "PhyreMemoryStream.h"
+
+namespace phyre
+{
+    PhyreMemoryBuffer::PhyreMemoryBuffer(PhyreArena::Buffer&& data)
+        : _data(std::move(data))
+        , _size(_data.size())
+    {
+        _reset(0, 0);
+    }
+
+    size_t PhyreMemoryBuffer::size() const
+    {
+        return std::max(_size, static_cast<size_t>(pptr() - _data.data()));
+    }
+
+    PhyreArena::Buffer PhyreMemoryBuffer::release()
+    {
+        _sync();
+        _data.resize(_size);
+        PhyreArena::Buffer ret(std::move(_data));
+        _size = 0;
+        _reset(0, 0);
+        return ret;
+    }
+
+    void PhyreMemoryBuffer::_sync()
+    {
+        _size = size();
+    }
+
+    void PhyreMemoryBuffer::_reserve(size_t size)
+    {
+        if (size <= _data.capacity())
+            return;
+
+        // The bytes written so far move along, the rest of the new block stays uninitialised.
+        const size_t getPosition = gptr() - eback();
+        const size_t putPosition = pptr() - _data.data();
+        _sync();
+        _data.resize(_size);
+        _data.reserve(size);
+        _reset(getPosition, putPosition);
+    }
+
+    void PhyreMemoryBuffer::_reset(size_t getPosition, size_t putPosition)
+    {
+        char* base = _data.data();
+        setg(base, base + getPosition, base + _size);
+        setp(base + putPosition, base + _data.capacity());
+    }
+
+    PhyreMemoryBuffer::int_type PhyreMemoryBuffer::overflow(int_type ch)
+    {
+        if (traits_type::eq_int_type(ch, traits_type::eof()))
+            return traits_type::not_eof(ch);
+
+        _sync();
+        _reserve(_data.capacity() + 1);
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+        return ch;
+    }
+
+    PhyreMemoryBuffer::int_type PhyreMemoryBuffer::underflow()
+    {
+        // Bytes written since the last read become readable.
+        _sync();
+        setg(eback(), gptr(), _data.data() + _size);
+        return gptr() < egptr() ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+    }
+
+    std::streamsize PhyreMemoryBuffer::xsputn(const char* s, std::streamsize count)
+    {
+        if (count <= 0)
+            return 0;
+
+        const size_t length = static_cast<size_t>(count);
+        _reserve(static_cast<size_t>(pptr() - _data.data()) + length);
+        std::memcpy(pptr(), s, length);
+        setp(pptr() + length, epptr());
+        _sync();
+        return count;
+    }
+
+    PhyreMemoryBuffer::pos_type PhyreMemoryBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+    {
+        const bool in = (which & std::ios_base::in) != 0;
+        const bool out = (which & std::ios_base::out) != 0;
+        if ((!in && !out) || (in && out && dir == std::ios_base::cur))
+            return pos_type(off_type(-1));
+
+        _sync();
+        off_type base = 0;
+        if (dir == std::ios_base::cur)
+            base = in ? gptr() - eback() : pptr() - _data.data();
+        else if (dir == std::ios_base::end)
+            base = static_cast<off_type>(_size);
+
+        const off_type position = base + off;
+        if (position < 0 || position > static_cast<off_type>(_size))
+            return pos_type(off_type(-1));
+
+        const size_t getPosition = in ? static_cast<size_t>(position) : gptr() - eback();
+        const size_t putPosition = out ? static_cast<size_t>(position) : pptr() - _data.data();
+        _reset(getPosition, putPosition);
+        return pos_type(position);
+    }
+
+    PhyreMemoryBuffer::pos_type PhyreMemoryBuffer::seekpos(pos_type pos, std::ios_base::openmode which)
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+    PhyreMemoryStream::PhyreMemoryStream(PhyreArena::Buffer&& data)
+        : std::iostream(nullptr)
+        , _buffer(std::move(data))
+    {
+        rdbuf(&_buffer);
+    }
+
+    size_t PhyreMemoryStream::append(std::istream& in, PhyreArena::Buffer& data, size_t size)
+    {
+        const size_t start = data.size();
+        size_t filled = start;
+        while (filled - start < size)
+        {
+            const size_t target = start + std::min(size, filled - start + std::max(filled - start, APPEND_STEP));
+            data.resize(target);
+            in.read(data.data() + filled, static_cast<std::streamsize>(target - filled));
+            filled += static_cast<size_t>(in.gcount());
+            if (filled != target)
+                break;
+        }
+        data.resize(filled);
+        return filled - start;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <iostream>
+#include <streambuf>
+
+#include "PhyreArena.h"
+
+namespace phyre
+{
+    /*
+    * Stream buffer over a growable arena buffer. Reads, writes and seeks
+    * behave like a binary file opened for update, so the converters can
+    * patch a phyre image in memory exactly as they patch one on disk.
+    * Get and put positions are independent, like in std::stringbuf.
+    */
+    class PhyreMemoryBuffer : public std::streambuf
+    {
+    public:
+        explicit PhyreMemoryBuffer(PhyreArena::Buffer&& data = PhyreArena::Buffer());
+        PhyreMemoryBuffer(const PhyreMemoryBuffer&) = delete;
+        PhyreMemoryBuffer& operator=(const PhyreMemoryBuffer&) = delete;
+
+        // Bytes written so far, or the initial data if it is longer.
+        size_t size() const;
+
+        // Hands the contents over, the buffer is empty afterwards.
+        PhyreArena::Buffer release();
+
+    protected:
+        virtual int_type overflow(int_type ch) override;
+        virtual int_type underflow() override;
+        virtual std::streamsize xsputn(const char* s, std::streamsize count) override;
+        virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+        virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+    private:
+        void _sync();
+        void _reserve(size_t size);
+        void _reset(size_t getPosition, size_t putPosition);
+
+        PhyreArena::Buffer _data;
+        size_t _size = 0;
+    };
+
+    class PhyreMemoryStream : public std::iostream
+    {
+    public:
+        explicit PhyreMemoryStream(PhyreArena::Buffer&& data = PhyreArena::Buffer());
+
+        size_t size() const { return _buffer.size(); }
+        PhyreArena::Buffer release() { return _buffer.release(); }
+
+        /*
+        * Appends up to size bytes from in to data, returns how many came.
+        * Sizes read from a stream can't be trusted, so data grows in steps
+        * as the bytes arrive instead of to size up front.
+        */
+        static size_t append(std::istream& in, PhyreArena::Buffer& data, size_t size);
+        // First step append grows a buffer by, later steps double what it holds.
+        static constexpr size_t APPEND_STEP = 1024 * 1024;
+
+    private:
+        PhyreMemoryBuffer _buffer;
+    };
+}
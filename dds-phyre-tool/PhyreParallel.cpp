@@ -0,0 +1,41 @@
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "PhyreParallel.h"
+
+namespace phyre
+{
+    unsigned PhyreParallel::defaultThreads()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void PhyreParallel::forEach(size_t count, unsigned threads, const std::function<void(size_t)>& job)
+    {
+        std::atomic<size_t> next{ 0 };
+        const auto worker = [&]()
+        {
+            for (size_t index = next++; index < count; index = next++)
+                job(index);
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < std::min<size_t>(threads ? threads : defaultThreads(), count); t++)
+        {
+            try
+            {
+                workers.emplace_back(worker);
+            }
+            catch (const std::system_error&)
+            {
+                break;
+            }
+        }
+        worker();
+        for (auto& thread : workers)
+            thread.join();
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+namespace phyre
+{
+    /*
+    * Runs a job for every index below count on worker threads and the
+    * calling thread. Indices are handed out one at a time from a shared
+    * counter, so callers group their work into runs worth a thread each.
+    * Threads that can't be started leave more runs to the others. The
+    * job must not throw.
+    */
+    class PhyreParallel
+    {
+    public:
+        // Every core, at least one.
+        static unsigned defaultThreads();
+
+        // threads 0 uses defaultThreads.
+        static void forEach(size_t count, unsigned threads, const std::function<void(size_t)>& job);
+    };
+}
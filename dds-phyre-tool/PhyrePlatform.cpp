@@ -1,51 +1,53 @@
 #include "PhyrePlatform.h"
+#include "PhyreArena.h"
+#include "PhyreLayout.h"
+#include "PhyreSchema.h"
+#include "PhyreMappedFile.h"
+#include "PhyreMemoryStream.h"
 #include "PhyreException.h"
+#include "PhyreStats.h"
+#include "PhyreParallel.h"
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
 
 namespace phyre
 {
-    PhyrePlatform::_tClassData PhyrePlatform::_findClass(const _tNamespaceHeader* header, const _tNamespaceClassDescriptor* classes, const _tNamespaceDataMember* members, const char* stringTable, const std::string& className)
+    namespace
     {
-        _tClassData ret{};
-        for (size_t i = 0, totalMembers = 0; i < header->classCount; i++)
+        // Closes a PhyreIO file when the conversion is left, errors included.
+        struct PhyreFileHandle
         {
-            if (&stringTable[classes[i].nameOffset] == className)
-            {
-                ret.classStart = &classes[i];
-                ret.memberStart = &members[totalMembers];
-                break;
-            }
-            totalMembers += classes[i].dataMemberCount;
-        }
-        return ret;
-    }
+            explicit PhyreFileHandle(PhyreIO::_tHandle file) : handle(file) {}
+            PhyreFileHandle(const PhyreFileHandle&) = delete;
+            PhyreFileHandle& operator=(const PhyreFileHandle&) = delete;
+            ~PhyreFileHandle() { PhyreIO::closeFile(handle); }
 
-    const PhyrePlatform::_tNamespaceDataMember* PhyrePlatform::_findMember(const _tNamespaceDataMember* membersStart, size_t memberCount, const char* stringTable, const std::string& memberName)
-    {
-        for (size_t i = 0; i < memberCount; i++)
-        {
-            if (&stringTable[membersStart[i].nameOffset] == memberName)
-                return &membersStart[i];
-        }
-        return nullptr;
+            PhyreIO::_tHandle handle;
+        };
     }
 
-    PhyrePlatform::_tTextureMembers PhyrePlatform::_getTextureMembers(const _tNamespaceHeader* header, const _tNamespaceClassDescriptor* classes, const _tNamespaceDataMember* members, const char* stringTable)
+    PhyrePlatform::_tTextureMembers PhyrePlatform::_getTextureMembers(const PhyreSchema& schema)
     {
         _tTextureMembers ret;
-        auto classBaseData = _findClass(header, classes, members, stringTable, "PTexture2DBase");
-        if (!classBaseData.classStart || !classBaseData.memberStart)
+        const uint32_t classBaseId = schema.findClassId("PTexture2DBase");
+        if (!classBaseId)
             throw PhyreExceptionData(L"Can't find width and height. PTexture2DBase not found.");
 
-        auto classCommonData = _findClass(header, classes, members, stringTable, "PTextureCommonBase");
-        if (!classCommonData.classStart || !classCommonData.memberStart)
+        const uint32_t classCommonId = schema.findClassId("PTextureCommonBase");
+        if (!classCommonId)
             throw PhyreExceptionData(L"Can't find mipmap info. PTextureCommonBase not found.");
 
-        auto heightMember = _findMember(classBaseData.memberStart, classBaseData.classStart->dataMemberCount, stringTable, "m_height");
-        auto widthMember = _findMember(classBaseData.memberStart, classBaseData.classStart->dataMemberCount, stringTable, "m_width");
-        auto mipmapMember = _findMember(classCommonData.memberStart, classCommonData.classStart->dataMemberCount, stringTable, "m_mipmapCount");
-        auto mipmapMaxMember = _findMember(classCommonData.memberStart, classCommonData.classStart->dataMemberCount, stringTable, "m_maxMipLevel");
-        auto textureFlagsMember = _findMember(classCommonData.memberStart, classCommonData.classStart->dataMemberCount, stringTable, "m_textureFlags");
+        auto heightMember = schema.findMember(classBaseId, "m_height");
+        auto widthMember = schema.findMember(classBaseId, "m_width");
+        auto mipmapMember = schema.findMember(classCommonId, "m_mipmapCount");
+        auto mipmapMaxMember = schema.findMember(classCommonId, "m_maxMipLevel");
+        auto textureFlagsMember = schema.findMember(classCommonId, "m_textureFlags");
 
         if (!heightMember || !widthMember)
             throw PhyreExceptionData(L"Can't find width and height members.");
@@ -61,183 +63,561 @@ namespace phyre
         return ret;
     }
 
-    size_t PhyrePlatform::_getInstanceStartRelative(std::fstream& phyreFile, size_t instanceOffset, const _tNamespaceClassDescriptor* classes, const char* stringTable, size_t instanceCount, const std::string& className)
+    std::vector<PhyrePlatform::_tTextureInstance> PhyrePlatform::_getTextureInstances(const PhyreLayout& layout, const PhyreSchema& schema)
     {
-        phyreFile.seekg(instanceOffset, std::ios::beg);
-        _tInstanceDescriptor instanceDescriptor{};
-        size_t textureInstanceId = std::numeric_limits<size_t>::max();
-        size_t textureInstanceStart = 0;
+        const size_t instanceCount = layout.instanceCount();
+        const uint32_t texture2DId = schema.findClassId("PTexture2D");
+        const uint32_t texture2DBaseId = schema.findClassId("PTexture2DBase");
+        std::vector<_tTextureInstance> ret;
+        size_t instanceStart = 0;
 
+        // Objects of an instance come first, one objectSize apart, its arrays follow them.
         for (size_t i = 0; i < instanceCount; i++)
         {
-            phyreFile.read(reinterpret_cast<char*>(&instanceDescriptor), sizeof(instanceDescriptor));
-            if (std::string(&stringTable[classes[instanceDescriptor.classId - 1].nameOffset]) == className)
-            {
-                textureInstanceId = i;
-                break;
-            }
-            textureInstanceStart += instanceDescriptor.size;
+            const _tInstanceDescriptor instance = layout.instance(i);
+            const bool isTexture = (texture2DId && instance.classId == texture2DId) ||
+                (texture2DBaseId && schema.isA(instance.classId, texture2DBaseId));
+            for (uint32_t object = 0; isTexture && object < instance.count; object++)
+                ret.push_back({ instance.classId, instanceStart + static_cast<size_t>(object) * instance.objectSize });
+            instanceStart += instance.size;
         }
 
-        if (textureInstanceId == std::numeric_limits<size_t>::max())
-            throw PhyreExceptionData(std::wstring(className.begin(), className.end()) + L" instance not found");
+        if (ret.empty())
+            throw PhyreExceptionData(L"PTexture2D instance not found");
 
-        return textureInstanceStart;
+        return ret;
     }
 
-    PhyrePlatform::_tDDS_HEADER PhyrePlatform::prepareDDSHeader(const std::string& format, uint32_t width, uint32_t height, uint32_t mipmaps, bool useDX10)
+    void PhyrePlatform::convertPhyre2DDS(const _tDocument& document, size_t textureIndex, const std::filesystem::path& ddsPath)
     {
-        _tDDS_HEADER header{};
-        header.dwWidth = width;
-        header.dwHeight = height;
-        header.dwMipMapCount = mipmaps + 1;
-        header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+        if (_writeThreads != 1 && textureIndex < document.textures.size() && document.textures[textureIndex].dataSize >= PARALLEL_WRITE_MIN_SIZE
+            && document.textures[textureIndex].dataOffset < document.phyre.size())
+        {
+            // The header is built first, but only written once the payload is complete.
+            const PhyreTextureFlip flip = _textureFlip(document, textureIndex);
+            PhyreMemoryStream header;
+            const auto& textureInfo = _writeDDSHeader(document, textureIndex, header);
+            const PhyreArena::Buffer headerData = header.release();
+            const char* data = document.phyre.at<char>(textureInfo.dataOffset, textureInfo.dataSize);
 
-        if (mipmaps > 0)
+            PhyreFileHandle ddsFile(PhyreIO::openFile(ddsPath, true));
+            _writeFlippedAt(ddsFile.handle, headerData.size(), data, textureInfo.dataSize, flip);
+
+            PhyreIO::_tRequest request{ ddsFile.handle, const_cast<char*>(headerData.data()), headerData.size(), 0, true, 0, 0 };
+            PhyreStats::Timer timer(PhyreStats::stageWrite);
+            PhyreIO::createSynchronous()->run(&request, 1);
+            if (request.error || request.done != request.size)
+                throw PhyreExceptionIO(L"Cannot write file: " + ddsPath.wstring());
+            return;
+        }
+
+        // A texture that can't be converted must not truncate an existing DDS.
+        _textureFlip(document, textureIndex);
+        if (document.textures[textureIndex].dataOffset >= document.phyre.size() || document.textures[textureIndex].dataSize == 0)
+            throw PhyreExceptionData(L"There is no DDS data in the phyre file");
+
+        std::ofstream ddsFile;
         {
-            header.dwFlags |= DDSD_MIPMAPCOUNT;
-            header.dwCaps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+            PhyreStats::Timer timer(PhyreStats::stageOpen);
+            PhyreIO::unlinkShared(ddsPath);
+            ddsFile.open(ddsPath, std::ios::out | std::ios::trunc | std::ios::binary);
+            PhyreStats::addWritten(PhyreStats::stageOpen, 0);
         }
+        if (!ddsFile)
+            throw PhyreExceptionIO(L"Cannot write file: " + ddsPath.wstring());
 
-        if (format == "BC7" && useDX10)
+        convertPhyre2DDS(document, textureIndex, ddsFile);
+    }
+
+    size_t PhyrePlatform::convertDDS2Phyre(const _tDocument& document, const std::filesystem::path& ddsPath, const std::filesystem::path& phyrePath)
+    {
+        std::fstream phyreFile;
         {
-            header.ddspf.dwFlags = DDPF_FOURCC;
-            header.ddspf.dwFourCC = DDSFCC_DX10;
-            header.dwPitchOrLinearSize = std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * 16;
+            PhyreStats::Timer timer(PhyreStats::stageOpen);
+            phyreFile.open(phyrePath, std::ios::in | std::ios::out | std::ios::binary);
+            PhyreStats::addWritten(PhyreStats::stageOpen, 0);
         }
-        else if (format == "DXT5" || format == "DXT3" || format == "DXT1" || format == "BC5" || format == "BC7")
+        if (!phyreFile)
+            throw PhyreExceptionIO(L"Cannot open binary file for writing: " + phyrePath.wstring());
+
+        PhyreMappedFile ddsMapping(ddsPath);
+        return convertDDS2Phyre(document, ddsMapping.view(), phyreFile);
+    }
+
+    PhyrePlatform::_tDDSInfo PhyrePlatform::_parseDDS(const PhyreView& dds)
+    {
+        if (dds.size() < sizeof(_tDDS_HEADER))
+            throw PhyreExceptionData(L"File too small to be a proper DDS file");
+
+        _tDDSInfo info{};
+        info.header = dds.read<_tDDS_HEADER>(0);
+        info.dataOffset = sizeof(_tDDS_HEADER);
+
+        // Formats without a legacy pixel format carry a DX10 header before the data.
+        const bool hasDX10Header = (info.header.ddspf.dwFlags & PhyreTextureFormat::DDPF_FOURCC) && info.header.ddspf.dwFourCC == PhyreTextureFormat::DDSFCC_DX10;
+        if (hasDX10Header)
         {
-            header.ddspf.dwFlags = DDPF_FOURCC;
-            header.ddspf.dwRBitMask = 0;
-            header.ddspf.dwGBitMask = 0;
-            header.ddspf.dwBBitMask = 0;
-            header.ddspf.dwABitMask = 0;
+            info.dx10Header = dds.read<_tDDS_HEADER_DXT10>(info.dataOffset);
+            info.dataOffset += sizeof(_tDDS_HEADER_DXT10);
+        }
 
-            if (format == "DXT5")
-            {
-                header.ddspf.dwFourCC = DDSFCC_DXT5;
-                header.dwPitchOrLinearSize = std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * 16;
-            }
-            else if (format == "DXT3")
+        info.format = getDDSFormat(info.header, hasDX10Header ? &info.dx10Header : nullptr);
+        return info;
+    }
+
+    void PhyrePlatform::setStreamBufferSize(size_t bytes)
+    {
+        _streamBufferSize = bytes;
+    }
+
+    size_t PhyrePlatform::getStreamBufferSize() const
+    {
+        return _streamBufferSize;
+    }
+
+    void PhyrePlatform::setWriteThreads(unsigned threads)
+    {
+        _writeThreads = threads;
+    }
+
+    unsigned PhyrePlatform::getWriteThreads() const
+    {
+        return _writeThreads;
+    }
+
+    const PhyrePlatform::_tTextureInfo& PhyrePlatform::getReplacedTexture() const
+    {
+        return _replacedTexture;
+    }
+
+    void PhyrePlatform::setPixelExactFlip(bool enabled)
+    {
+        _pixelExactFlip = enabled;
+    }
+
+    bool PhyrePlatform::getPixelExactFlip() const
+    {
+        return _pixelExactFlip;
+    }
+
+    uint64_t PhyrePlatform::getReencodedBlocks() const
+    {
+        return _reencodedBlocks.load(std::memory_order_relaxed);
+    }
+
+    void PhyrePlatform::addReencodedBlocks(uint64_t blocks)
+    {
+        _reencodedBlocks.fetch_add(blocks, std::memory_order_relaxed);
+    }
+
+    void PhyrePlatform::setEncoder(PhyreTextureFormat::_eFormat format, PhyreBlockEncoder::_eQuality quality)
+    {
+        if (format != PhyreTextureFormat::formatUnknown && !PhyreBlockEncoder::canEncode(format))
+            throw PhyreException(L"Textures can only be encoded to DXT1, DXT5 and BC7");
+        _encodeFormat = format;
+        _encodeQuality = quality;
+    }
+
+    PhyreTextureFormat::_eFormat PhyrePlatform::getEncodeFormat() const
+    {
+        return _encodeFormat;
+    }
+
+    PhyreBlockEncoder::_eQuality PhyrePlatform::getEncodeQuality() const
+    {
+        return _encodeQuality;
+    }
+
+    bool PhyrePlatform::_willEncode(PhyreTextureFormat::_eFormat ddsFormat) const
+    {
+        return _encodeFormat != PhyreTextureFormat::formatUnknown && PhyreBlockEncoder::canEncodeFrom(ddsFormat);
+    }
+
+    PhyreArena::Buffer PhyrePlatform::_encodePayload(_tDDSInfo& ddsInfo, const char* data, size_t dataSize)
+    {
+        if (!_willEncode(ddsInfo.format))
+            return PhyreArena::Buffer();
+
+        PhyreStats::Timer timer(PhyreStats::stageEncode);
+        const PhyreBlockEncoder encoder(PhyreBlockEncoder::targetFor(_encodeFormat, ddsInfo.format), _encodeQuality);
+        PhyreArena::Buffer ret = encoder.encodeChain(data, dataSize, ddsInfo.format,
+            ddsInfo.header.dwWidth, ddsInfo.header.dwHeight, ddsInfo.header.dwMipMapCount, true, _pixelExactFlip);
+        PhyreStats::addRead(PhyreStats::stageEncode, PhyreTextureFormat::chainSize(ddsInfo.format,
+            ddsInfo.header.dwWidth, ddsInfo.header.dwHeight, ddsInfo.header.dwMipMapCount), 0);
+
+        ddsInfo.format = encoder.format();
+        return ret;
+    }
+
+    void PhyrePlatform::_writeFlipped(std::ostream& out, const char* data, size_t dataSize, const PhyreTextureFlip& flip)
+    {
+        // Levels are contiguous, a truncated payload is flipped up to the last complete level.
+        const auto& surfaces = flip.surfaces();
+        size_t surfaceCount = 0;
+        size_t flippedSize = 0;
+        for (const auto& surface : surfaces)
+        {
+            const size_t surfaceSize = surface.rowPitch * surface.rowCount;
+            if (surfaceSize > dataSize - flippedSize)
+                break;
+            flippedSize += surfaceSize;
+            surfaceCount++;
+        }
+
+        // Rows may only be split between blocks, the window holds at least one.
+        const size_t unitSize = flip.unitSize();
+        size_t windowSize = _streamBufferSize ? std::min(_streamBufferSize, flippedSize) : flippedSize;
+        windowSize = std::max(windowSize, unitSize) / unitSize * unitSize;
+
+        // Reading the source is part of the flip, it comes from a mapping or a buffer.
+        PhyreStats::Timer timer(PhyreStats::stageFlip);
+        PhyreStats::addRead(PhyreStats::stageFlip, dataSize, 0);
+
+        if (flippedSize > 0)
+        {
+            PhyreArena::Buffer window = PhyreArena::local().acquire(windowSize);
+            size_t used = 0;
+
+            for (size_t s = 0; s < surfaceCount; s++)
             {
-                header.ddspf.dwFourCC = DDSFCC_DXT3;
-                header.dwPitchOrLinearSize = std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * 16;
+                const auto& surface = surfaces[s];
+                if (flip.reencodes(surface))
+                {
+                    // Encoding blocks again is the slow part, the whole level is flipped at once on the write threads.
+                    timer.switchTo(PhyreStats::stageWrite);
+                    out.write(window.data(), used);
+                    PhyreStats::addWritten(PhyreStats::stageWrite, used);
+                    timer.switchTo(PhyreStats::stageFlip);
+                    used = 0;
+
+                    const size_t surfaceSize = surface.rowPitch * surface.rowCount;
+                    PhyreArena::Buffer level = PhyreArena::local().acquire(surfaceSize);
+                    flip.flipSurface(level.data(), data + surface.offset, surface);
+                    timer.switchTo(PhyreStats::stageWrite);
+                    out.write(level.data(), surfaceSize);
+                    PhyreStats::addWritten(PhyreStats::stageWrite, surfaceSize);
+                    timer.switchTo(PhyreStats::stageFlip);
+                    continue;
+                }
+
+                for (size_t y = 0; y < surface.rowCount; y++)
+                {
+                    size_t offset = 0;
+                    while (offset < surface.rowPitch)
+                    {
+                        const size_t chunk = std::min(surface.rowPitch - offset, windowSize - used);
+                        flip.flipRow(window.data() + used, data + surface.offset, y, offset, chunk, surface);
+                        used += chunk;
+                        offset += chunk;
+
+                        if (used == windowSize)
+                        {
+                            timer.switchTo(PhyreStats::stageWrite);
+                            out.write(window.data(), used);
+                            PhyreStats::addWritten(PhyreStats::stageWrite, used);
+                            timer.switchTo(PhyreStats::stageFlip);
+                            used = 0;
+                        }
+                    }
+                }
             }
-            else if (format == "DXT1")
+
+            timer.switchTo(PhyreStats::stageWrite);
+            if (used > 0)
             {
-                header.ddspf.dwFourCC = DDSFCC_DXT1;
-                header.dwPitchOrLinearSize = std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * 8;
+                out.write(window.data(), used);
+                PhyreStats::addWritten(PhyreStats::stageWrite, used);
             }
-            else if (format == "BC5")
+        }
+
+        // Whatever follows the flipped surfaces is passed straight from the source.
+        timer.switchTo(PhyreStats::stageWrite);
+        if (dataSize > flippedSize)
+        {
+            out.write(data + flippedSize, dataSize - flippedSize);
+            PhyreStats::addWritten(PhyreStats::stageWrite, dataSize - flippedSize);
+        }
+
+        if (!out)
+            throw PhyreExceptionIO(L"Cannot write texture data");
+    }
+
+    size_t PhyrePlatform::_streamFlipped(std::istream& in, std::ostream& out, const PhyreTextureFlip& flip, size_t limit)
+    {
+        PhyreStats::Timer timer(PhyreStats::stageRead);
+        PhyreArena::Buffer buffer;
+        size_t consumed = 0;
+        for (size_t level = 0; level < flip.surfaces().size() && consumed < limit; level++)
+        {
+            const PhyreTextureFlip levelFlip = flip.level(level);
+            const size_t levelSize = std::min(levelFlip.flippedSize(), limit - consumed);
+            // The level size comes from the phyre header, the buffer grows only as far as the stream delivers.
+            buffer.resize(0);
+            const size_t got = PhyreMemoryStream::append(in, buffer, levelSize);
+            PhyreStats::addRead(PhyreStats::stageRead, got);
+
+            // A short level is written as it came, like the tail of a truncated file.
+            _writeFlipped(out, buffer.data(), got, levelFlip);
+            consumed += got;
+            if (got < levelSize)
+                return consumed;
+        }
+
+        buffer.resize(std::max<size_t>(buffer.capacity(), 64 * 1024));
+        while (consumed < limit && in)
+        {
+            timer.switchTo(PhyreStats::stageRead);
+            in.read(buffer.data(), std::min(buffer.size(), limit - consumed));
+            const size_t got = static_cast<size_t>(in.gcount());
+            PhyreStats::addRead(PhyreStats::stageRead, got);
+            timer.switchTo(PhyreStats::stageWrite);
+            out.write(buffer.data(), got);
+            PhyreStats::addWritten(PhyreStats::stageWrite, got);
+            consumed += got;
+        }
+
+        if (!out)
+            throw PhyreExceptionIO(L"Cannot write texture data");
+        return consumed;
+    }
+
+    void PhyrePlatform::_writeFlippedAt(PhyreIO::_tHandle file, uint64_t offset, const char* data, size_t dataSize, const PhyreTextureFlip& flip)
+    {
+        struct _tSlice
+        {
+            size_t surface;
+            size_t firstRow;
+            size_t rowCount;
+        };
+
+        // Complete levels are cut into runs of rows, the rest of the payload is one more slice copied as it is.
+        const auto& surfaces = flip.surfaces();
+        const size_t sliceSize = _streamBufferSize ? _streamBufferSize : DEFAULT_STREAM_BUFFER_SIZE;
+        std::vector<_tSlice> slices;
+        size_t flippedSize = 0;
+        size_t surfaceCount = 0;
+        for (const auto& surface : surfaces)
+        {
+            const size_t surfaceSize = surface.rowPitch * surface.rowCount;
+            if (surfaceSize > dataSize - flippedSize)
+                break;
+            // Levels whose blocks are encoded again take far longer per byte, they are cut into small runs.
+            const size_t rowsPerSlice = flip.reencodes(surface) ? 16 : std::max<size_t>(1, sliceSize / std::max<size_t>(surface.rowPitch, 1));
+            for (size_t row = 0; row < surface.rowCount; row += rowsPerSlice)
+                slices.push_back({ surfaceCount, row, std::min(rowsPerSlice, surface.rowCount - row) });
+            flippedSize += surfaceSize;
+            surfaceCount++;
+        }
+        if (dataSize > flippedSize)
+            slices.push_back({ surfaceCount, 0, 0 });
+
+        // Flips and writes overlap on the workers, the wall time goes to the write stage.
+        PhyreStats::Timer timer(PhyreStats::stageWrite);
+        PhyreStats::addRead(PhyreStats::stageFlip, dataSize, 0);
+
+        const std::unique_ptr<PhyreIO> io = PhyreIO::createSynchronous();
+        std::atomic<bool> failed{ false };
+        std::mutex failureLock;
+        std::exception_ptr failure;
+        PhyreParallel::forEach(slices.size(), _writeThreads, [&](size_t index)
+        {
+            if (failed)
+                return;
+            try
             {
-                header.ddspf.dwFourCC = DDSFCC_BC5U;
-                header.dwPitchOrLinearSize = std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * 16;
+                const _tSlice& slice = slices[index];
+                PhyreArena::Buffer window;
+                PhyreIO::_tRequest request{ file, nullptr, 0, 0, true, 0, 0 };
+                if (slice.surface == surfaceCount)
+                {
+                    request.buffer = const_cast<char*>(data + flippedSize);
+                    request.size = dataSize - flippedSize;
+                    request.offset = offset + flippedSize;
+                }
+                else
+                {
+                    const auto& surface = surfaces[slice.surface];
+                    window = PhyreArena::local().acquire(slice.rowCount * surface.rowPitch);
+                    for (size_t y = 0; y < slice.rowCount; y++)
+                        flip.flipRow(window.data() + y * surface.rowPitch, data + surface.offset, slice.firstRow + y, 0, surface.rowPitch, surface);
+                    request.buffer = window.data();
+                    request.size = window.size();
+                    request.offset = offset + surface.offset + slice.firstRow * surface.rowPitch;
+                }
+
+                io->run(&request, 1);
+                if (request.error || request.done != request.size)
+                    throw PhyreExceptionIO(L"Cannot write texture data");
             }
-            else if (format == "BC7")
+            catch (...)
             {
-                header.ddspf.dwFourCC = DDSFCC_BC7;
-                header.dwPitchOrLinearSize = std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * 16;
+                std::lock_guard<std::mutex> lock(failureLock);
+                if (!failure)
+                    failure = std::current_exception();
+                failed = true;
             }
+        });
+        if (failure)
+            std::rethrow_exception(failure);
+        PhyreStats::addWritten(PhyreStats::stageWrite, dataSize, slices.size());
+    }
+
+    PhyrePlatform::_tDDSInfo PhyrePlatform::_readDDS(std::istream& dds)
+    {
+        PhyreStats::Timer timer(PhyreStats::stageRead);
+        char header[sizeof(_tDDS_HEADER) + sizeof(_tDDS_HEADER_DXT10)];
+        dds.read(header, sizeof(_tDDS_HEADER));
+        PhyreStats::addRead(PhyreStats::stageRead, static_cast<size_t>(dds.gcount()));
+        if (static_cast<size_t>(dds.gcount()) < sizeof(_tDDS_HEADER))
+            throw PhyreExceptionData(L"File too small to be a proper DDS file");
+
+        size_t headerSize = sizeof(_tDDS_HEADER);
+        const _tDDS_HEADER legacy = PhyreView(header, headerSize).read<_tDDS_HEADER>(0);
+        if ((legacy.ddspf.dwFlags & PhyreTextureFormat::DDPF_FOURCC) && legacy.ddspf.dwFourCC == PhyreTextureFormat::DDSFCC_DX10)
+        {
+            dds.read(header + headerSize, sizeof(_tDDS_HEADER_DXT10));
+            headerSize += static_cast<size_t>(dds.gcount());
+            PhyreStats::addRead(PhyreStats::stageRead, static_cast<size_t>(dds.gcount()));
         }
-        else if (format == "ARGB8")
+        return _parseDDS(PhyreView(header, headerSize));
+    }
+
+    PhyrePlatform::_tDDS_HEADER PhyrePlatform::prepareDDSHeader(PhyreTextureFormat::_eFormat format, uint32_t width, uint32_t height, uint32_t mipmaps)
+    {
+        if (format == PhyreTextureFormat::formatUnknown)
+            throw PhyreException(L"Unsupported format");
+
+        const auto& traits = PhyreTextureFormat::traits(format);
+        _tDDS_HEADER header{};
+        header.dwWidth = width;
+        header.dwHeight = height;
+        header.dwMipMapCount = mipmaps + 1;
+        header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+
+        if (mipmaps > 0)
         {
-            header.dwFlags |= DDSD_PITCH;
-            header.ddspf.dwFlags = DDPF_ALPHAPIXELS | DDPF_RGB;
-            header.ddspf.dwRGBBitCount = 32;
-            header.ddspf.dwRBitMask = 0x00FF0000;
-            header.ddspf.dwGBitMask = 0x0000FF00;
-            header.ddspf.dwBBitMask = 0x000000FF;
-            header.ddspf.dwABitMask = 0xFF000000;
-            header.dwPitchOrLinearSize = width * 4;
+            header.dwFlags |= DDSD_MIPMAPCOUNT;
+            header.dwCaps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
         }
-        else if (format == "RGBA8")
+
+        if (PhyreTextureFormat::isBlockCompressed(format))
         {
-            header.dwFlags |= DDSD_PITCH;
-            header.ddspf.dwFlags = DDPF_ALPHAPIXELS | DDPF_RGB;
-            header.ddspf.dwRGBBitCount = 32;
-            header.ddspf.dwRBitMask = 0x000000FF;
-            header.ddspf.dwGBitMask = 0x0000FF00;
-            header.ddspf.dwBBitMask = 0x00FF0000;
-            header.ddspf.dwABitMask = 0xFF000000;
-            header.dwPitchOrLinearSize = width * 4;
+            header.dwFlags |= DDSD_LINEARSIZE;
+            header.dwPitchOrLinearSize = static_cast<uint32_t>(PhyreTextureFormat::surfaceSize(format, width, height));
         }
-        else if (format == "A8")
+        else
         {
             header.dwFlags |= DDSD_PITCH;
-            header.ddspf.dwFlags = DDPF_ALPHA;
-            header.ddspf.dwRGBBitCount = 8;
-            header.ddspf.dwABitMask = 0xFF;
-            header.dwPitchOrLinearSize = width;
+            header.dwPitchOrLinearSize = width * traits.unitSize;
         }
-        else if (format == "L8")
+
+        header.ddspf.dwRGBBitCount = 0;
+        header.ddspf.dwRBitMask = 0;
+        header.ddspf.dwGBitMask = 0;
+        header.ddspf.dwBBitMask = 0;
+        header.ddspf.dwABitMask = 0;
+
+        if (traits.dx10)
         {
-            header.dwFlags |= DDSD_PITCH;
-            header.ddspf.dwFlags = DDPF_LUMINANCE;
-            header.ddspf.dwRGBBitCount = 8;
-            header.ddspf.dwRBitMask = 0xFF;
-            header.dwPitchOrLinearSize = width;
+            header.ddspf.dwFlags = PhyreTextureFormat::DDPF_FOURCC;
+            header.ddspf.dwFourCC = PhyreTextureFormat::DDSFCC_DX10;
+        }
+        else if (traits.fourCC)
+        {
+            header.ddspf.dwFlags = PhyreTextureFormat::DDPF_FOURCC;
+            header.ddspf.dwFourCC = traits.fourCC;
+        }
+        else
+        {
+            header.ddspf.dwFlags = traits.pixelFlags;
+            header.ddspf.dwRGBBitCount = traits.rgbBitCount;
+            header.ddspf.dwRBitMask = traits.rBitMask;
+            header.ddspf.dwGBitMask = traits.gBitMask;
+            header.ddspf.dwBBitMask = traits.bBitMask;
+            header.ddspf.dwABitMask = traits.aBitMask;
+        }
+        return header;
+    }
+
+    const PhyrePlatform::_tTextureInfo& PhyrePlatform::_checkTexture(const _tDocument& document, size_t textureIndex)
+    {
+        if (textureIndex >= document.textures.size())
+            throw PhyreException(L"No such texture in the phyre file");
+        const auto& textureInfo = document.textures[textureIndex];
+
+        if (textureInfo.format == PhyreTextureFormat::formatUnknown)
+            throw PhyreException(L"Unsupported format: " + std::wstring(textureInfo.textureFormat.begin(), textureInfo.textureFormat.end()));
+        return textureInfo;
+    }
+
+    PhyreTextureFlip PhyrePlatform::_textureFlip(const _tDocument& document, size_t textureIndex)
+    {
+        const auto& textureInfo = _checkTexture(document, textureIndex);
+        return _newFlip(textureInfo.format, textureInfo.width, textureInfo.height, textureInfo.mipmapCount + 1, false, document.bigEndian);
+    }
+
+    PhyreTextureFlip PhyrePlatform::_newFlip(PhyreTextureFormat::_eFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool swapRedBlue, bool swapBytes)
+    {
+        PhyreTextureFlip ret(format, width, height, mipLevels, swapRedBlue, swapBytes);
+        ret.setPixelExact(_pixelExactFlip, _writeThreads);
+        ret.setReencodeCounter(&_reencodedBlocks);
+        return ret;
+    }
+
+    const PhyrePlatform::_tTextureInfo& PhyrePlatform::_writeDDSHeader(const _tDocument& document, size_t textureIndex, std::ostream& dds)
+    {
+        const auto& textureInfo = _checkTexture(document, textureIndex);
+        auto ddsHeader = prepareDDSHeader(textureInfo.format, textureInfo.width, textureInfo.height, textureInfo.mipmapCount);
+
+        PhyreStats::Timer timer(PhyreStats::stageWrite);
+        if (ddsHeader.ddspf.dwFourCC == PhyreTextureFormat::DDSFCC_DX10)
+        {
+            _tDDS_HEADER_DXT10 dx10Header = prepareDX10Header(textureInfo.format);
+
+            dds.write(reinterpret_cast<char*>(&ddsHeader), sizeof(ddsHeader));
+            dds.write(reinterpret_cast<char*>(&dx10Header), sizeof(dx10Header));
+            PhyreStats::addWritten(PhyreStats::stageWrite, sizeof(ddsHeader) + sizeof(dx10Header), 2);
         }
         else
         {
-            throw PhyreException(L"Unsupported format: " + std::wstring(format.begin(), format.end()));
+            dds.write(reinterpret_cast<char*>(&ddsHeader), sizeof(ddsHeader));
+            PhyreStats::addWritten(PhyreStats::stageWrite, sizeof(ddsHeader));
         }
+        return textureInfo;
+    }
+
+    PhyrePlatform::_tDDS_HEADER_DXT10 PhyrePlatform::prepareDX10Header(PhyreTextureFormat::_eFormat format)
+    {
+        _tDDS_HEADER_DXT10 header{};
+        header.dxgiFormat = PhyreTextureFormat::traits(format).dxgiFormat;
+        header.resourceDimension = 3;
+        header.arraySize = 1;
         return header;
     }
 
-    const std::string PhyrePlatform::getDDSFormat(const _tDDS_HEADER& ddsHeader)
+    PhyreTextureFormat::_eFormat PhyrePlatform::getDDSFormat(const _tDDS_HEADER& ddsHeader, const _tDDS_HEADER_DXT10* dx10Header)
     {
-        std::string ret;
-        if (ddsHeader.ddspf.dwFlags & DDPF_FOURCC)
+        const auto& pf = ddsHeader.ddspf;
+        PhyreTextureFormat::_eFormat ret = PhyreTextureFormat::formatUnknown;
+        if (pf.dwFlags & PhyreTextureFormat::DDPF_FOURCC)
         {
-            switch (ddsHeader.ddspf.dwFourCC)
-            {
-            case DDSFCC_DXT1: ret = "DXT1"; break;
-            case DDSFCC_DXT3: ret = "DXT3"; break;
-            case DDSFCC_DXT5: ret = "DXT5"; break;
-            case DDSFCC_BC5U: ret = "BC5"; break;
-            case DDSFCC_BC7: ret = "BC7"; break;
-            case DDSFCC_DX10: ret = "DX10"; break;
-            }
+            if (pf.dwFourCC == PhyreTextureFormat::DDSFCC_DX10)
+                ret = dx10Header ? PhyreTextureFormat::fromDXGI(dx10Header->dxgiFormat) : PhyreTextureFormat::formatUnknown;
+            else
+                ret = PhyreTextureFormat::fromFourCC(pf.dwFourCC);
         }
         else
         {
-            if (ddsHeader.ddspf.dwFlags & DDPF_ALPHAPIXELS && ddsHeader.ddspf.dwFlags & DDPF_RGB)
-            {
-                if (ddsHeader.ddspf.dwRGBBitCount == 32)
-                {
-                    if (ddsHeader.ddspf.dwRBitMask == 0x000000FF &&
-                        ddsHeader.ddspf.dwGBitMask == 0x0000FF00 &&
-                        ddsHeader.ddspf.dwBBitMask == 0x00FF0000 &&
-                        ddsHeader.ddspf.dwABitMask == 0xFF000000)
-                    {
-                        ret = "RGBA8";
-                    }
-                    else if (ddsHeader.ddspf.dwRBitMask == 0x00FF0000 &&
-                        ddsHeader.ddspf.dwGBitMask == 0x0000FF00 &&
-                        ddsHeader.ddspf.dwBBitMask == 0x000000FF &&
-                        ddsHeader.ddspf.dwABitMask == 0xFF000000)
-                    {
-                        ret = "ARGB8";
-                    }
-                }
-            }
-            else if (ddsHeader.ddspf.dwFlags & DDPF_ALPHA) ret = "A8";
-            else if (ddsHeader.ddspf.dwFlags & DDPF_LUMINANCE) ret = "L8";
+            ret = PhyreTextureFormat::fromMasks(pf.dwFlags, pf.dwRGBBitCount, pf.dwRBitMask, pf.dwGBitMask, pf.dwBBitMask, pf.dwABitMask);
         }
-        if (ret.empty()) throw PhyreExceptionData(L"Unsupported or not recognized DDS format");
+        if (ret == PhyreTextureFormat::formatUnknown) throw PhyreExceptionData(L"Unsupported or not recognized DDS format");
         return ret;
     }
 
-    uint32_t PhyrePlatform::getBufferSizeByFormat(const std::string& format, uint32_t width, uint32_t height)
+    uint32_t PhyrePlatform::getBufferSizeByFormat(PhyreTextureFormat::_eFormat format, uint32_t width, uint32_t height)
     {
-        if (format == "DXT5" || format == "DXT3" || format == "BC5" || format == "BC7")
-            return std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * 16;
-        else if (format == "DXT1")
-            return std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * 8;
-        else if (format == "ARGB8" || format == "RGBA8")
-            return width * height * 4;
-        else if (format == "A8" || format == "L8")
-            return width * height;
-        return 0;
+        if (format == PhyreTextureFormat::formatUnknown)
+            return 0;
+        return static_cast<uint32_t>(PhyreTextureFormat::surfaceSize(format, width, height));
     }
 }
\ No newline at end of file
@@ -1,20 +1,28 @@
 #pragma once
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <filesystem>
-#include <fstream>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include <istream>
+
+#include "PhyreArena.h"
+#include "PhyreBlockEncoder.h"
+#include "PhyreIO.h"
+#include "PhyreView.h"
+#include "PhyreTextureFlip.h"
+#include "PhyreTextureFormat.h"
 
 namespace phyre
 {
+    class PhyreLayout;
+    class PhyreSchema;
+
     class PhyrePlatform
     {
     public:
-        virtual ~PhyrePlatform() = default;
-        virtual bool isFormatSupported(const std::filesystem::path& phyrePath) = 0;
-        virtual void convertPhyre2DDS(const std::filesystem::path& phyrePath, const std::filesystem::path& ddsPath) = 0;
-        virtual void convertDDS2Phyre(const std::filesystem::path& ddsPath, const std::filesystem::path& phyrePath) = 0;
-
-    protected:
         struct _tNamespaceHeader
         {
             uint32_t magic;
@@ -81,7 +89,8 @@ namespace phyre
 
         struct _tTextureInfo
         {
-            uint32_t format;
+            uint32_t classId;
+            PhyreTextureFormat::_eFormat format;
             uint8_t memoryType;
             uint32_t mipmapCount;
             uint32_t maxMipmapLevel;
@@ -92,36 +101,121 @@ namespace phyre
             std::string textureFormat;
             size_t fixupOffset;
             size_t fixupDataOffset;
+            size_t fixupIndex;
             size_t textureInfoOffset;
             size_t dataOffset;
+            size_t dataSize;
         };
 
-        enum _eDDS_FOURCC
+        /*
+        * Parsed view of a phyre file. Pointers and views refer to the
+        * data the document was parsed from, which has to outlive it.
+        * The tables aren't aligned in the file, the document keeps
+        * copies of the ones it needs and the schema has the rest.
+        * textures lists every texture object in instance order,
+        * textureInfo is the first of them. Big endian files are parsed
+        * from a copy with their structures swapped to native order.
+        */
+        struct _tDocument
         {
-            DDSFCC_DXT5 = 0x35545844,
-            DDSFCC_DXT3 = 0x33545844,
-            DDSFCC_DXT1 = 0x31545844,
-            DDSFCC_BC5U = 0x55354342,
-            DDSFCC_ATI2 = 0x32495441,
-            DDSFCC_BC7 = 0x20374342,
-            DDSFCC_DX10 = 0x30315844
+            PhyreView phyre;
+            PhyreView platformHeader;
+            _tNamespaceHeader namespaceHeader;
+            const char* stringTable;
+            std::shared_ptr<const PhyreSchema> schema;
+            std::vector<_tInstanceDescriptor> instances;
+            size_t instanceCount;
+            size_t instanceDataOffset;
+            std::vector<_tUserFixup> userFixups;
+            size_t userFixupCount;
+            PhyreView userFixupData;
+            _tTextureInfo textureInfo;
+            std::vector<_tTextureInfo> textures;
+            bool bigEndian;
         };
 
-        enum _eDXGI_FORMAT
-        {
-            DXGI_FORMAT_BC7_UNORM = 98,
-            DXGI_FORMAT_BC7_UNORM_SRGB = 99
-        };
+        virtual ~PhyrePlatform() = default;
+        virtual bool isFormatSupported(const PhyreView& phyre) = 0;
+        virtual _tDocument parseDocument(const PhyreView& phyre) = 0;
 
-        enum _eDDSPF_FLAGS
-        {
-            DDPF_ALPHAPIXELS = 0x1,
-            DDPF_ALPHA = 0x2,
-            DDPF_FOURCC = 0x4,
-            DDPF_RGB = 0x40,
-            DDPF_YUV = 0x200,
-            DDPF_LUMINANCE = 0x20000
-        };
+        /*
+        * Byte swaps the header, namespace tables, instance descriptors,
+        * instance data and user fixup table of a phyre image, to native
+        * order or back. Strings, array fixups and payloads are left alone.
+        */
+        virtual void swapStructures(char* data, size_t size, bool toNative) = 0;
+
+        /*
+        * The stream overloads do the conversion and touch nothing but the
+        * streams and views they are given, so they work on memory buffers
+        * as well as on files. The path overloads only open the files.
+        */
+        virtual void convertPhyre2DDS(const _tDocument& document, size_t textureIndex, std::ostream& dds) = 0;
+        void convertPhyre2DDS(const _tDocument& document, size_t textureIndex, const std::filesystem::path& ddsPath);
+
+        // phyre holds a copy of the document bytes up to the texture data, the texture is patched in
+        // place. Returns the new size the phyre has to be truncated to.
+        virtual size_t convertDDS2Phyre(const _tDocument& document, const PhyreView& dds, std::iostream& phyre) = 0;
+        size_t convertDDS2Phyre(const _tDocument& document, const std::filesystem::path& ddsPath, const std::filesystem::path& phyrePath);
+        // The texture as the last conversion from a DDS wrote it, for reporting what was replaced.
+        const _tTextureInfo& getReplacedTexture() const;
+
+        /*
+        * Pipe variants, no stream has to be seekable. The document is
+        * parsed from the part of the phyre before the texture data, the
+        * payload is read from the stream one mip level at a time since
+        * a level can't be flipped before its last row has arrived.
+        * getPayloadOffset tells how much of the phyre that part is, head
+        * has to hold the platform header and the namespace header.
+        */
+        virtual size_t getPayloadOffset(const PhyreView& head, bool bigEndian) = 0;
+        virtual void convertPhyre2DDS(const _tDocument& document, size_t textureIndex, std::istream& payload, std::ostream& dds) = 0;
+        // Returns the size of the phyre written.
+        virtual size_t convertDDS2Phyre(const _tDocument& document, std::istream& dds, std::ostream& phyre) = 0;
+
+        /*
+        * Upper bound of the scratch memory used while copying texture
+        * payloads. Rows are gathered from the mapped source into a window
+        * of this size and written out once it fills up, so peak memory no
+        * longer depends on the texture size. 0 means the whole payload.
+        */
+        static constexpr size_t DEFAULT_STREAM_BUFFER_SIZE = 4 * 1024 * 1024;
+        void setStreamBufferSize(size_t bytes);
+        size_t getStreamBufferSize() const;
+
+        /*
+        * Block compresses DDS files with 8 bit RGBA pixels on their way
+        * into a phyre, the texture format follows. Other DDS formats are
+        * copied as before. formatUnknown turns encoding off.
+        */
+        void setEncoder(PhyreTextureFormat::_eFormat format, PhyreBlockEncoder::_eQuality quality);
+        PhyreTextureFormat::_eFormat getEncodeFormat() const;
+        PhyreBlockEncoder::_eQuality getEncodeQuality() const;
+
+        /*
+        * Threads the path overload of convertPhyre2DDS flips and writes a
+        * payload with. Payloads of at least PARALLEL_WRITE_MIN_SIZE bytes
+        * are cut into slices, whole mip levels or runs of rows of a level,
+        * and every slice is written at its final offset in the DDS file.
+        * The header goes in after the last slice. 1 writes through a
+        * stream as before, 0 uses every core.
+        */
+        static constexpr size_t PARALLEL_WRITE_MIN_SIZE = 16 * 1024 * 1024;
+        void setWriteThreads(unsigned threads);
+        unsigned getWriteThreads() const;
+
+        /*
+        * Flips compressed textures pixel exact both ways, see
+        * PhyreTextureFlip. Blocks that need encoding again are flipped on
+        * the write threads. Off by default, the flip then loses nothing.
+        */
+        void setPixelExactFlip(bool enabled);
+        bool getPixelExactFlip() const;
+        // Blocks the flips of this platform encoded again so far.
+        uint64_t getReencodedBlocks() const;
+        void addReencodedBlocks(uint64_t blocks);
+
+    protected:
 
         enum _eDDS_FLAGS
         {
@@ -144,7 +238,7 @@ namespace phyre
 
         struct _tDDS_PIXELFORMAT {
             uint32_t dwSize = sizeof(_tDDS_PIXELFORMAT);
-            uint32_t dwFlags = DDPF_FOURCC;
+            uint32_t dwFlags = PhyreTextureFormat::DDPF_FOURCC;
             uint32_t dwFourCC = 0;
             uint32_t dwRGBBitCount = 32;
             uint32_t dwRBitMask = 0x000000FF;
@@ -179,43 +273,84 @@ namespace phyre
             uint32_t miscFlags2;
         };
 
-        struct _tClassData
+        struct _tDDSInfo
         {
-            const _tNamespaceClassDescriptor* classStart;
-            const _tNamespaceDataMember* memberStart;
+            _tDDS_HEADER header;
+            _tDDS_HEADER_DXT10 dx10Header;
+            PhyreTextureFormat::_eFormat format;
+            size_t dataOffset;
         };
 
-        virtual _tClassData _findClass(const _tNamespaceHeader* header,
-            const _tNamespaceClassDescriptor* classes,
-            const _tNamespaceDataMember* members,
-            const char* stringTable,
-            const std::string& className);
-
-        virtual const _tNamespaceDataMember* _findMember(const _tNamespaceDataMember* membersStart,
-            size_t memberCount,
-            const char* stringTable,
-            const std::string& memberName);
-
-        virtual _tTextureMembers _getTextureMembers(const _tNamespaceHeader* header,
-            const _tNamespaceClassDescriptor* classes,
-            const _tNamespaceDataMember* members,
-            const char* stringTable);
-
-        virtual size_t _getInstanceStartRelative(std::fstream& phyreFile,
-            size_t instanceOffset,
-            const _tNamespaceClassDescriptor* classes,
-            const char* stringTable,
-            size_t instanceCount,
-            const std::string& className);
-
-        virtual _tDDS_HEADER prepareDDSHeader(const std::string& format,
+        // Reads the legacy header and the DX10 one if the pixel format says it follows.
+        _tDDSInfo _parseDDS(const PhyreView& dds);
+
+        virtual _tTextureMembers _getTextureMembers(const PhyreSchema& schema);
+
+        struct _tTextureInstance
+        {
+            uint32_t classId;
+            size_t offset;
+        };
+
+        // Every object of a texture class, offsets are relative to the start of the instance data.
+        virtual std::vector<_tTextureInstance> _getTextureInstances(const PhyreLayout& layout, const PhyreSchema& schema);
+
+        // Legacy header for the format, the pixel format says DX10 if a _tDDS_HEADER_DXT10 has to follow.
+        virtual _tDDS_HEADER prepareDDSHeader(PhyreTextureFormat::_eFormat format,
             uint32_t width,
             uint32_t height,
-            uint32_t mipmaps,
-            bool useDX10 = false);
+            uint32_t mipmaps);
+        _tDDS_HEADER_DXT10 prepareDX10Header(PhyreTextureFormat::_eFormat format);
+        // Throws unless textureIndex is a texture in a format that can be converted.
+        const _tTextureInfo& _checkTexture(const _tDocument& document, size_t textureIndex);
+        // Validates the texture and writes the DDS headers for it.
+        const _tTextureInfo& _writeDDSHeader(const _tDocument& document, size_t textureIndex, std::ostream& dds);
+        // Validates the texture and builds its flip, before anything is written for it.
+        PhyreTextureFlip _textureFlip(const _tDocument& document, size_t textureIndex);
+        // A flip with the pixel exact setting, its blocks encoded again count for this platform.
+        PhyreTextureFlip _newFlip(PhyreTextureFormat::_eFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool swapRedBlue, bool swapBytes);
+
+        // Writes every mip level of data flipped upside down followed by the untouched remainder.
+        void _writeFlipped(std::ostream& out, const char* data, size_t dataSize, const PhyreTextureFlip& flip);
+
+        /*
+        * Same for a payload read from a stream, one level is buffered at a
+        * time. At most limit bytes are consumed, the bytes past the last
+        * level are copied as they are. Returns the bytes written.
+        */
+        size_t _streamFlipped(std::istream& in, std::ostream& out, const PhyreTextureFlip& flip, size_t limit);
+
+        /*
+        * Same as _writeFlipped on _writeThreads threads, with the output at
+        * offset in file. Slices are at most a stream buffer each, they are
+        * flipped into the arena of the thread that takes them and written
+        * with one positioned write.
+        */
+        void _writeFlippedAt(PhyreIO::_tHandle file, uint64_t offset, const char* data, size_t dataSize, const PhyreTextureFlip& flip);
+
+        // Reads the legacy and, if present, the DX10 header from the start of a DDS stream.
+        _tDDSInfo _readDDS(std::istream& dds);
+
+        /*
+        * Encodes the mip chain of data, already flipped for the phyre, if
+        * an encoder is set and takes the DDS format. ddsInfo then describes
+        * the encoded chain. Returns an empty buffer if there is nothing to do.
+        */
+        PhyreArena::Buffer _encodePayload(_tDDSInfo& ddsInfo, const char* data, size_t dataSize);
+        // Whether _encodePayload would encode a DDS of this format.
+        bool _willEncode(PhyreTextureFormat::_eFormat ddsFormat) const;
+
+        size_t _streamBufferSize = DEFAULT_STREAM_BUFFER_SIZE;
+        PhyreTextureFormat::_eFormat _encodeFormat = PhyreTextureFormat::formatUnknown;
+        PhyreBlockEncoder::_eQuality _encodeQuality = PhyreBlockEncoder::qualityNormal;
+        unsigned _writeThreads = 1;
+        bool _pixelExactFlip = false;
+        std::atomic<uint64_t> _reencodedBlocks{ 0 };
+        _tTextureInfo _replacedTexture{};
 
-        const std::string getDDSFormat(const _tDDS_HEADER& ddsHeader);
-        uint32_t getBufferSizeByFormat(const std::string& format,
+        // dx10Header is only read when the pixel format says DX10.
+        PhyreTextureFormat::_eFormat getDDSFormat(const _tDDS_HEADER& ddsHeader, const _tDDS_HEADER_DXT10* dx10Header);
+        uint32_t getBufferSizeByFormat(PhyreTextureFormat::_eFormat format,
             uint32_t width,
             uint32_t height);
     };
@@ -1,38 +1,35 @@
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <algorithm>
+#include <limits>
 #include <vector>
 
 #include "PhyrePlatformDX11.h"
+#include "PhyreArena.h"
+#include "PhyreMemoryStream.h"
+#include "PhyreRowKernels.h"
+#include "PhyreLayout.h"
+#include "PhyreSchema.h"
+#include "PhyreStats.h"
 #include "PhyreException.h"
 
 namespace phyre
 {
-    PhyrePlatform::_tTextureInfo PhyrePlatformDX11::_getTextureInfo(const _tNamespaceHeader* header, const _tNamespaceClassDescriptor* classes, const _tNamespaceDataMember* members, const char* stringTable, std::fstream& phyreFile, const size_t textureInfoStart)
+    PhyrePlatform::_tTextureInfo PhyrePlatformDX11::_getTextureInfo(const PhyreSchema& schema, const PhyreView& phyre, const size_t textureInfoStart)
     {
         _tTextureInfo textureInfo{};
-        textureInfo.textureMembers = _getTextureMembers(header, classes, members, stringTable);
+        textureInfo.textureMembers = _getTextureMembers(schema);
 
-        phyreFile.seekg(textureInfoStart + textureInfo.textureMembers.widthOffset, std::ios::beg);
-        phyreFile.read(reinterpret_cast<char*>(&textureInfo.width), sizeof(textureInfo.width));
-
-        phyreFile.seekg(textureInfoStart + textureInfo.textureMembers.heightOffset, std::ios::beg);
-        phyreFile.read(reinterpret_cast<char*>(&textureInfo.height), sizeof(textureInfo.height));
-
-        phyreFile.seekg(textureInfoStart + textureInfo.textureMembers.mipmapCountOffset, std::ios::beg);
-        phyreFile.read(reinterpret_cast<char*>(&textureInfo.mipmapCount), sizeof(textureInfo.mipmapCount));
-
-        phyreFile.seekg(textureInfoStart + textureInfo.textureMembers.maxMipmapLeveOffset, std::ios::beg);
-        phyreFile.read(reinterpret_cast<char*>(&textureInfo.maxMipmapLevel), sizeof(textureInfo.maxMipmapLevel));
-
-        phyreFile.seekg(textureInfoStart + textureInfo.textureMembers.textureFlagsOffset, std::ios::beg);
-        phyreFile.read(reinterpret_cast<char*>(&textureInfo.textureFlags), sizeof(textureInfo.textureFlags));
+        textureInfo.width = phyre.read<uint32_t>(textureInfoStart + textureInfo.textureMembers.widthOffset);
+        textureInfo.height = phyre.read<uint32_t>(textureInfoStart + textureInfo.textureMembers.heightOffset);
+        textureInfo.mipmapCount = phyre.read<uint32_t>(textureInfoStart + textureInfo.textureMembers.mipmapCountOffset);
+        textureInfo.maxMipmapLevel = phyre.read<uint32_t>(textureInfoStart + textureInfo.textureMembers.maxMipmapLeveOffset);
+        textureInfo.textureFlags = phyre.read<uint32_t>(textureInfoStart + textureInfo.textureMembers.textureFlagsOffset);
 
         return textureInfo;
     }
 
-    void PhyrePlatformDX11::_setTextureInfo(const _tTextureInfo& textureInfo, std::fstream& phyreFile, const size_t textureInfoStart)
+    void PhyrePlatformDX11::_setTextureInfo(const _tTextureInfo& textureInfo, std::iostream& phyreFile, const size_t textureInfoStart)
     {
         phyreFile.seekp(textureInfoStart + textureInfo.textureMembers.widthOffset, std::ios::beg);
         phyreFile.write(reinterpret_cast<const char*>(&textureInfo.width), sizeof(textureInfo.width));
@@ -50,44 +47,49 @@ namespace phyre
         phyreFile.write(reinterpret_cast<const char*>(&textureInfo.textureFlags), sizeof(textureInfo.textureFlags));
     }
 
-    PhyrePlatform::_tTextureInfo PhyrePlatformDX11::_setTextureFormat(const _tTextureInfo& textureInfo, std::fstream& phyreFile, const std::string& newFormat)
+    PhyrePlatform::_tTextureInfo PhyrePlatformDX11::_setTextureFormat(const _tDocument& document, std::iostream& phyreFile, const std::string& newFormat)
     {
+        const _tTextureInfo& textureInfo = document.textureInfo;
         _tTextureInfo ret = textureInfo;
-        _tDX11Header dx11Header{};
-        phyreFile.seekg(0, std::ios::beg);
-        phyreFile.read(reinterpret_cast<char*>(&dx11Header), sizeof(dx11Header));
-
+        _tDX11Header dx11Header = document.platformHeader.read<_tDX11Header>(0);
+
+        // Everything that gets shifted is copied out of the mapping before the first write.
+        // A format name of the same length shifts nothing, the data after the fixups stays as it is.
+        const uint32_t newFixupSize = static_cast<uint32_t>(newFormat.size()) + 1;
+        uint32_t newFixupDataSize = newFixupSize;
+        for (size_t i = 0; i < document.userFixupCount; i++)
+            newFixupDataSize += i == textureInfo.fixupIndex ? 0 : document.userFixups[i].size;
+        const bool isShifted = newFixupDataSize != dx11Header.userFixupDataSize;
         size_t remainingDataOffset = textureInfo.fixupDataOffset + dx11Header.userFixupDataSize + sizeof(_tUserFixup) * dx11Header.userFixupCount;
         size_t remainingDataSize = textureInfo.dataOffset - remainingDataOffset;
-        std::unique_ptr<char[]> remainingDataBuffer(new char[remainingDataSize]);
-        phyreFile.seekg(remainingDataOffset, std::ios::beg);
-        phyreFile.read(remainingDataBuffer.get(), remainingDataSize);
-
-        std::unique_ptr<char[]> userFixupBuffer(new char[dx11Header.userFixupDataSize]);
-        phyreFile.seekg(textureInfo.fixupDataOffset, std::ios::beg);
-        phyreFile.read(userFixupBuffer.get(), dx11Header.userFixupDataSize);
-
-        std::vector<_tUserFixup> fixupEntries(dx11Header.userFixupCount);
-        phyreFile.seekg(textureInfo.fixupOffset, std::ios::beg);
+        const char* remainingData = document.phyre.at<char>(remainingDataOffset, remainingDataSize);
+        PhyreArena& arena = PhyreArena::local();
+        PhyreArena::Buffer remainingDataBuffer;
+        if (isShifted)
+        {
+            remainingDataBuffer = arena.acquire(remainingDataSize);
+            remainingDataBuffer.assign(remainingData, remainingDataSize);
+        }
 
-        for (auto& fixupEntry : fixupEntries)
-            phyreFile.read(reinterpret_cast<char*>(&fixupEntry), sizeof(fixupEntry));
+        PhyreArena::Buffer userFixupBuffer = arena.acquire(document.userFixupData.size());
+        userFixupBuffer.assign(document.userFixupData.data(), document.userFixupData.size());
+        std::vector<_tUserFixup> fixupEntries(document.userFixups);
 
         uint32_t totalFixupDataSize = 0;
         size_t entryCounter = 0;
         phyreFile.seekp(textureInfo.fixupDataOffset, std::ios::beg);
         for (auto& fixupEntry : fixupEntries)
         {
-            if (entryCounter == 1)
+            if (entryCounter == textureInfo.fixupIndex)
             {
                 phyreFile.write(newFormat.c_str(), newFormat.size() + 1);
                 fixupEntry.offset = totalFixupDataSize;
-                fixupEntry.size = static_cast<uint32_t>(newFormat.size()) + 1;
+                fixupEntry.size = newFixupSize;
                 totalFixupDataSize += fixupEntry.size;
             }
             else
             {
-                phyreFile.write(&userFixupBuffer[fixupEntry.offset], fixupEntry.size);
+                phyreFile.write(userFixupBuffer.data() + fixupEntry.offset, fixupEntry.size);
                 fixupEntry.offset = totalFixupDataSize;
                 totalFixupDataSize += fixupEntry.size;
             }
@@ -97,7 +99,8 @@ namespace phyre
         for (const auto& fixupEntry : fixupEntries)
             phyreFile.write(reinterpret_cast<const char*>(&fixupEntry), sizeof(fixupEntry));
 
-        phyreFile.write(remainingDataBuffer.get(), remainingDataSize);
+        if (isShifted)
+            phyreFile.write(remainingDataBuffer.data(), remainingDataSize);
 
         int delta = totalFixupDataSize - dx11Header.userFixupDataSize;
         dx11Header.userFixupDataSize = totalFixupDataSize;
@@ -110,80 +113,104 @@ namespace phyre
         return ret;
     }
 
-    PhyrePlatform::_tTextureInfo PhyrePlatformDX11::_getPhyreInfo(std::fstream& phyreFile, const size_t filesize)
+    PhyrePlatform::_tDocument PhyrePlatformDX11::_getPhyreInfo(const PhyreView& phyre)
     {
-        if (filesize < sizeof(_tDX11Header))
+        if (phyre.size() < sizeof(_tDX11Header))
             throw PhyreExceptionData(L"File too small to be dx11 platform type");
 
-        _tDX11Header dx11Header{};
-        phyreFile.read(reinterpret_cast<char*>(&dx11Header), sizeof(dx11Header));
+        const _tDX11Header dx11Header = phyre.read<_tDX11Header>(0);
 
         if (
             dx11Header.platformId != PLATFORMID || dx11Header.size != sizeof(dx11Header) ||
-            filesize < 0ULL + dx11Header.size + dx11Header.namespaceSize
+            phyre.size() < 0ULL + dx11Header.size + dx11Header.namespaceSize
             )
             throw PhyreExceptionData(L"Size too small to fit namespace");
 
-        std::unique_ptr<char[]> namespaceBuffer(new char[dx11Header.namespaceSize]);
-
-        phyreFile.seekg(dx11Header.size, std::ios::beg);
-        phyreFile.read(namespaceBuffer.get(), dx11Header.namespaceSize);
-
-        const _tNamespaceHeader* namespaceHeader = reinterpret_cast<_tNamespaceHeader*>(namespaceBuffer.get());
-
-        const size_t stringTableStart = static_cast<size_t>(namespaceHeader->size) - namespaceHeader->stringTableSize - static_cast<size_t>(namespaceHeader->defaultBufferCount) * namespaceHeader->defaultBufferSize;
-        const char* stringTable = &namespaceBuffer[stringTableStart];
-
-        const _tNamespaceClassDescriptor* classDescriptors = reinterpret_cast<_tNamespaceClassDescriptor*>(&namespaceBuffer[sizeof(_tNamespaceHeader) + sizeof(uint32_t) * namespaceHeader->typeCount]);
-
-        const _tNamespaceDataMember* memberDescriptors = reinterpret_cast<_tNamespaceDataMember*>(&namespaceBuffer[sizeof(_tNamespaceHeader) + sizeof(uint32_t) * namespaceHeader->typeCount] + sizeof(_tNamespaceClassDescriptor) * namespaceHeader->classCount);
-
-        const uint32_t* typeDescriptors = reinterpret_cast<uint32_t*>(&namespaceBuffer[sizeof(_tNamespaceHeader)]);
-
-        size_t textureInstanceStart = _getInstanceStartRelative(phyreFile, 0ULL + dx11Header.size + namespaceHeader->size, classDescriptors, stringTable, dx11Header.instanceListCount, "PTexture2D");
-
-        const size_t textureInfoStart = 0ULL + dx11Header.size + namespaceHeader->size + dx11Header.instanceListCount * sizeof(_tInstanceDescriptor) + textureInstanceStart;
-        auto textureInfo = _getTextureInfo(namespaceHeader, classDescriptors, memberDescriptors, stringTable, phyreFile, textureInfoStart);
-        textureInfo.textureInfoOffset = textureInfoStart;
-
-        std::unique_ptr<char[]> userFixupBuffer(new char[dx11Header.userFixupDataSize]);
-        textureInfo.fixupDataOffset = 0ULL + dx11Header.size + namespaceHeader->size + dx11Header.instanceListCount * sizeof(_tInstanceDescriptor) + dx11Header.totalDataSize;
-        phyreFile.seekg(textureInfo.fixupDataOffset, std::ios::beg);
-        phyreFile.read(userFixupBuffer.get(), dx11Header.userFixupDataSize);
-
-        _tUserFixup userFixup{};
-        textureInfo.fixupOffset = 0ULL + dx11Header.size + namespaceHeader->size + dx11Header.instanceListCount * sizeof(_tInstanceDescriptor) + dx11Header.totalDataSize + dx11Header.userFixupDataSize;
-        phyreFile.seekg(textureInfo.fixupOffset + sizeof(_tUserFixup), std::ios::beg);
-        phyreFile.read(reinterpret_cast<char*>(&userFixup), sizeof(userFixup));
-
-        if (userFixup.typeId >= namespaceHeader->typeCount || std::string(&stringTable[typeDescriptors[userFixup.typeId]]) != "PTextureFormatBase")
+        // Everything past the header is checked once here, the tables are read without checks from then on.
+        PhyreLayout::_tSizes sizes{};
+        sizes.namespaceOffset = dx11Header.size;
+        sizes.namespaceSize = dx11Header.namespaceSize;
+        sizes.instanceCount = dx11Header.instanceListCount;
+        sizes.instanceDataSize = dx11Header.totalDataSize;
+        sizes.userFixupDataSize = dx11Header.userFixupDataSize;
+        sizes.userFixupCount = dx11Header.userFixupCount;
+        sizes.fixupTablesSize = 0ULL + dx11Header.pointerArrayFixupSize + dx11Header.pointerFixupSize + dx11Header.arrayFixupSize;
+        const PhyreLayout layout = PhyreLayout::validate(phyre, sizes);
+
+        _tDocument document{};
+        document.phyre = phyre;
+        document.platformHeader = phyre.sub(0, sizeof(_tDX11Header));
+        document.namespaceHeader = layout.namespaceHeader();
+        document.stringTable = layout.stringTable();
+        document.schema = PhyreSchema::get(layout);
+        const PhyreSchema& schema = *document.schema;
+
+        document.instanceCount = layout.instanceCount();
+        document.instances.reserve(document.instanceCount);
+        for (size_t i = 0; i < document.instanceCount; i++)
+            document.instances.push_back(layout.instance(i));
+        document.instanceDataOffset = layout.instanceDataOffset();
+
+        const std::vector<_tTextureInstance> textureInstances = _getTextureInstances(layout, schema);
+
+        const size_t fixupDataOffset = layout.userFixupDataOffset();
+        document.userFixupData = layout.userFixupData();
+        const size_t fixupOffset = layout.userFixupOffset();
+        document.userFixupCount = layout.userFixupCount();
+        document.userFixups.reserve(document.userFixupCount);
+        for (size_t i = 0; i < document.userFixupCount; i++)
+            document.userFixups.push_back(layout.userFixup(i));
+
+        // Every texture object takes the next format fixup, in instance order.
+        std::vector<size_t> formatFixups;
+        for (size_t i = 0; i < document.userFixupCount; i++)
+            if (schema.typeName(document.userFixups[i].typeId) == "PTextureFormatBase")
+                formatFixups.push_back(i);
+
+        if (formatFixups.size() < textureInstances.size())
             throw PhyreExceptionData(L"Texture format not found");
 
-        textureInfo.textureFormat = &userFixupBuffer[userFixup.offset];
+        size_t dataOffset = layout.payloadOffset();
 
-        size_t dataOffset = 0ULL + dx11Header.size + namespaceHeader->size + dx11Header.instanceListCount * sizeof(_tInstanceDescriptor)
-            + dx11Header.totalDataSize
-            + dx11Header.userFixupDataSize + sizeof(_tUserFixup) * dx11Header.userFixupCount
-            + dx11Header.pointerArrayFixupSize + dx11Header.pointerFixupSize + dx11Header.arrayFixupSize;
-
-        textureInfo.dataOffset = dataOffset;
+        // Payloads follow each other, the last one or one of unknown size runs to the end of the file.
+        for (size_t i = 0; i < textureInstances.size(); i++)
+        {
+            const size_t textureInfoStart = document.instanceDataOffset + textureInstances[i].offset;
+            auto textureInfo = _getTextureInfo(schema, phyre, textureInfoStart);
+            textureInfo.classId = textureInstances[i].classId;
+            textureInfo.textureInfoOffset = textureInfoStart;
+            textureInfo.fixupDataOffset = fixupDataOffset;
+            textureInfo.fixupOffset = fixupOffset;
+            textureInfo.fixupIndex = formatFixups[i];
+            textureInfo.textureFormat = document.userFixupData.string(document.userFixups[textureInfo.fixupIndex].offset);
+            textureInfo.format = PhyreTextureFormat::fromName(textureInfo.textureFormat);
+
+            const size_t remaining = phyre.size() - std::min(dataOffset, phyre.size());
+            textureInfo.dataOffset = dataOffset;
+            textureInfo.dataSize = remaining;
+            const bool isLast = i + 1 == textureInstances.size() || textureInfo.format == PhyreTextureFormat::formatUnknown;
+            if (!isLast)
+                textureInfo.dataSize = static_cast<size_t>(std::min<uint64_t>(remaining,
+                    PhyreTextureFormat::chainSize(textureInfo.format, textureInfo.width, textureInfo.height, textureInfo.mipmapCount + 1)));
+
+            document.textures.push_back(textureInfo);
+            dataOffset += textureInfo.dataSize;
+            if (isLast)
+                break;
+        }
+        document.textureInfo = document.textures.front();
 
-        return textureInfo;
+        return document;
     }
 
-    bool PhyrePlatformDX11::isFormatSupported(const std::filesystem::path& phyrePath)
+    bool PhyrePlatformDX11::isFormatSupported(const PhyreView& phyre)
     {
-        std::ifstream phyreFile(phyrePath, std::ios::in | std::ios::binary);
-        if (!phyreFile)
-            throw PhyreExceptionIO(L"Cannot open binary file: " + phyrePath.wstring());
-
-        const size_t filesize = std::filesystem::file_size(phyrePath);
+        const size_t filesize = phyre.size();
 
         if (filesize < sizeof(_tDX11Header))
             return false;
 
-        _tDX11Header dx11Header{};
-        phyreFile.read(reinterpret_cast<char*>(&dx11Header), sizeof(dx11Header));
+        const _tDX11Header dx11Header = phyre.read<_tDX11Header>(0);
 
         if (
             dx11Header.platformId != PLATFORMID || dx11Header.size != sizeof(dx11Header) ||
@@ -194,144 +221,125 @@ namespace phyre
         return true;
     }
 
-    void PhyrePlatformDX11::convertPhyre2DDS(const std::filesystem::path& phyrePath, const std::filesystem::path& ddsPath)
+    PhyrePlatform::_tDocument PhyrePlatformDX11::parseDocument(const PhyreView& phyre)
     {
-        std::fstream phyreFile(phyrePath, std::ios::in | std::ios::binary);
-        if (!phyreFile)
-            throw PhyreExceptionIO(L"Cannot open binary file: " + phyrePath.wstring());
-
-        const size_t filesize = std::filesystem::file_size(phyrePath);
-        auto textureInfo = _getPhyreInfo(phyreFile, filesize);
-
-        if (textureInfo.dataOffset >= filesize)
-            throw PhyreExceptionData(L"There is no DDS data in the phyre file");
-
-        bool useDX10 = (textureInfo.textureFormat == "BC7");
-        auto ddsHeader = prepareDDSHeader(textureInfo.textureFormat, textureInfo.width, textureInfo.height, textureInfo.mipmapCount, useDX10);
-
-        std::ofstream ddsFile(ddsPath, std::ios::out | std::ios::trunc | std::ios::binary);
-        if (!ddsFile)
-            throw PhyreExceptionIO(L"Cannot write file: " + ddsPath.wstring());
-
-        size_t dataSize = filesize - textureInfo.dataOffset;
-        std::vector<char> dataBuffer(dataSize);
-        phyreFile.seekg(textureInfo.dataOffset, std::ios::beg);
-        phyreFile.read(dataBuffer.data(), dataSize);
-
-        uint32_t rowPitch = 0;
-        if (ddsHeader.dwFlags & DDSD_PITCH) {
-            rowPitch = ddsHeader.dwPitchOrLinearSize;
-        }
-        else if (ddsHeader.dwFlags & DDSD_LINEARSIZE) {
-            rowPitch = ddsHeader.dwPitchOrLinearSize / ddsHeader.dwHeight;
-        }
+        return _getPhyreInfo(phyre);
+    }
 
-        if (rowPitch > 0) {
-            uint32_t height = ddsHeader.dwHeight;
-            std::vector<char> rowBuffer(rowPitch);
-            for (uint32_t y = 0; y < height / 2; y++) {
-                char* topRow = dataBuffer.data() + y * rowPitch;
-                char* bottomRow = dataBuffer.data() + (height - 1 - y) * rowPitch;
-                std::memcpy(rowBuffer.data(), topRow, rowPitch);
-                std::memcpy(topRow, bottomRow, rowPitch);
-                std::memcpy(bottomRow, rowBuffer.data(), rowPitch);
-            }
-        }
+    void PhyrePlatformDX11::swapStructures(char* data, size_t size, bool toNative)
+    {
+        const PhyreView phyre(data, size);
 
-        if (useDX10)
+        // Counts are taken in native order, before the swap or after it.
+        auto native = [toNative](auto value)
         {
-            _tDDS_HEADER_DXT10 dx10Header{};
-            dx10Header.dxgiFormat = DXGI_FORMAT_BC7_UNORM;
-            dx10Header.resourceDimension = 3;
-            dx10Header.arraySize = 1;
-
-            ddsFile.write(reinterpret_cast<char*>(&ddsHeader), sizeof(ddsHeader));
-            ddsFile.write(reinterpret_cast<char*>(&dx10Header), sizeof(dx10Header));
-        }
-        else
+            if (toNative)
+                PhyreRowKernels::swapBytes(reinterpret_cast<char*>(&value), sizeof(value), sizeof(uint32_t));
+            return value;
+        };
+        auto swapWords = [&phyre, data](size_t offset, size_t count)
         {
-            ddsFile.write(reinterpret_cast<char*>(&ddsHeader), sizeof(ddsHeader));
-        }
-
-        ddsFile.write(dataBuffer.data(), dataSize);
+            phyre.at<uint32_t>(offset, count);
+            PhyreRowKernels::swapBytes(data + offset, count * sizeof(uint32_t), sizeof(uint32_t));
+        };
+
+        const _tDX11Header dx11Header = native(phyre.read<_tDX11Header>(0));
+        if (dx11Header.size != sizeof(dx11Header))
+            throw PhyreExceptionData(L"Unsupported phyre format");
+
+        const size_t namespaceOffset = dx11Header.size;
+        const _tNamespaceHeader namespaceHeader = native(phyre.read<_tNamespaceHeader>(namespaceOffset));
+        const size_t typeOffset = namespaceOffset + sizeof(_tNamespaceHeader);
+        const size_t classOffset = typeOffset + sizeof(uint32_t) * namespaceHeader.typeCount;
+        const size_t memberOffset = classOffset + sizeof(_tNamespaceClassDescriptor) * namespaceHeader.classCount;
+
+        size_t memberCount = 0;
+        for (uint32_t i = 0; i < namespaceHeader.classCount; i++)
+            memberCount += native(phyre.read<_tNamespaceClassDescriptor>(classOffset + i * sizeof(_tNamespaceClassDescriptor))).dataMemberCount;
+
+        const size_t instanceListOffset = 0ULL + dx11Header.size + namespaceHeader.size;
+        const size_t instanceDataOffset = instanceListOffset + sizeof(_tInstanceDescriptor) * dx11Header.instanceListCount;
+        const size_t fixupOffset = instanceDataOffset + dx11Header.totalDataSize + dx11Header.userFixupDataSize;
+
+        swapWords(0, sizeof(_tDX11Header) / sizeof(uint32_t));
+        swapWords(namespaceOffset, sizeof(_tNamespaceHeader) / sizeof(uint32_t));
+        swapWords(typeOffset, namespaceHeader.typeCount);
+        swapWords(classOffset, sizeof(_tNamespaceClassDescriptor) / sizeof(uint32_t) * namespaceHeader.classCount);
+        swapWords(memberOffset, sizeof(_tNamespaceDataMember) / sizeof(uint32_t) * memberCount);
+        swapWords(instanceListOffset, sizeof(_tInstanceDescriptor) / sizeof(uint32_t) * dx11Header.instanceListCount);
+
+        // Only 32 bit members are read from objects, the instance data is swapped as 32 bit words.
+        swapWords(instanceDataOffset, dx11Header.totalDataSize / sizeof(uint32_t));
+        swapWords(fixupOffset, sizeof(_tUserFixup) / sizeof(uint32_t) * dx11Header.userFixupCount);
     }
 
-    void PhyrePlatformDX11::convertDDS2Phyre(const std::filesystem::path& ddsPath, const std::filesystem::path& phyrePath)
+    void PhyrePlatformDX11::convertPhyre2DDS(const _tDocument& document, size_t textureIndex, std::ostream& dds)
     {
-        std::fstream phyreFile(phyrePath, std::ios::in | std::ios::out | std::ios::binary);
-        if (!phyreFile)
-            throw PhyreExceptionIO(L"Cannot open binary file for writing: " + phyrePath.wstring());
-
-        const size_t filesize = std::filesystem::file_size(phyrePath);
-        auto textureInfo = _getPhyreInfo(phyreFile, filesize);
-
-        if (textureInfo.dataOffset >= filesize)
-            throw PhyreExceptionData(L"There is no DDS data in the phyre file");
+        const PhyreView& phyre = document.phyre;
+        if (textureIndex < document.textures.size())
+        {
+            const auto& textureInfo = document.textures[textureIndex];
+            if (textureInfo.dataOffset >= phyre.size() || textureInfo.dataSize == 0)
+                throw PhyreExceptionData(L"There is no DDS data in the phyre file");
+        }
 
-        std::wcout << L"Found texture" << std::endl;
-        std::wcout << L"format:                " << textureInfo.textureFormat.c_str() << std::endl;
-        std::wcout << L"width:                " << textureInfo.width << std::endl;
-        std::wcout << L"height:                " << textureInfo.height << std::endl;
-        std::wcout << L"mipmaps:            " << textureInfo.mipmapCount << std::endl;
-        std::wcout << L"max mipmap level:        " << textureInfo.maxMipmapLevel << std::endl;
+        // Nothing is written before the texture is known to convert.
+        const PhyreTextureFlip flip = _textureFlip(document, textureIndex);
+        const auto& textureInfo = _writeDDSHeader(document, textureIndex, dds);
 
-        std::fstream ddsFile(ddsPath, std::ios::in | std::ios::binary);
-        if (!ddsFile)
-            throw PhyreExceptionIO(L"Cannot open binary file: " + ddsPath.wstring());
+        size_t dataSize = textureInfo.dataSize;
+        const char* data = phyre.at<char>(textureInfo.dataOffset, dataSize);
+        _writeFlipped(dds, data, dataSize, flip);
+    }
 
-        const size_t ddsfilesize = std::filesystem::file_size(ddsPath);
+    void PhyrePlatformDX11::convertPhyre2DDS(const _tDocument& document, size_t textureIndex, std::istream& payload, std::ostream& dds)
+    {
+        const PhyreTextureFlip flip = _textureFlip(document, textureIndex);
 
-        if (ddsfilesize < sizeof(_tDDS_HEADER))
-            throw PhyreExceptionData(L"File too small to be a proper DDS file");
+        // Payloads before this one are skipped, their sizes follow from their formats.
+        for (size_t i = 0; i < textureIndex; i++)
+        {
+            const auto& skipped = document.textures[i];
+            if (skipped.format == PhyreTextureFormat::formatUnknown)
+                throw PhyreException(L"Unsupported format: " + std::wstring(skipped.textureFormat.begin(), skipped.textureFormat.end()));
+            PhyreStats::Timer timer(PhyreStats::stageRead);
+            payload.ignore(static_cast<std::streamsize>(PhyreTextureFormat::chainSize(skipped.format, skipped.width, skipped.height, skipped.mipmapCount + 1)));
+            PhyreStats::addRead(PhyreStats::stageRead, static_cast<uint64_t>(payload.gcount()));
+        }
 
-        _tDDS_HEADER ddsHeader{};
-        ddsFile.read(reinterpret_cast<char*>(&ddsHeader), sizeof(ddsHeader));
+        _writeDDSHeader(document, textureIndex, dds);
 
-        const std::string ddsTextureFormat = getDDSFormat(ddsHeader);
-        std::wcout << L"Replacing with texture" << std::endl;
-        std::wcout << L"format:                " << ddsTextureFormat.c_str() << std::endl;
-        std::wcout << L"width:                " << ddsHeader.dwWidth << std::endl;
-        std::wcout << L"height:                " << ddsHeader.dwHeight << std::endl;
-        std::wcout << L"mipmaps:            " << ddsHeader.dwMipMapCount << std::endl;
+        // Only the last texture owns the rest of the stream.
+        const bool isLast = textureIndex + 1 == document.textures.size();
+        if (_streamFlipped(payload, dds, flip, isLast ? std::numeric_limits<size_t>::max() : flip.flippedSize()) == 0)
+            throw PhyreExceptionData(L"There is no DDS data in the phyre file");
+    }
 
-        if (textureInfo.textureFormat != ddsTextureFormat)
-            textureInfo = _setTextureFormat(textureInfo, phyreFile, ddsTextureFormat);
+    size_t PhyrePlatformDX11::_patchPhyre(const _tDocument& document, const _tDDSInfo& ddsInfo, std::iostream& phyreFile)
+    {
+        auto textureInfo = document.textureInfo;
+        PhyreStats::Timer timer(PhyreStats::stageWrite);
 
-        size_t dataSize = ddsfilesize - sizeof(ddsHeader);
-        std::vector<char> dataBuffer(dataSize);
-        ddsFile.seekg(sizeof(ddsHeader), std::ios::beg);
-        ddsFile.read(dataBuffer.data(), dataSize);
+        // Payloads are packed back to back, a resized texture would overwrite the ones after it.
+        if (document.textures.size() > 1)
+            throw PhyreException(L"Replacing textures in files with several textures is not supported");
 
-        uint32_t rowPitch = 0;
-        if (ddsHeader.dwFlags & DDSD_PITCH) {
-            rowPitch = ddsHeader.dwPitchOrLinearSize;
-        }
-        else if (ddsHeader.dwFlags & DDSD_LINEARSIZE) {
-            rowPitch = ddsHeader.dwPitchOrLinearSize / ddsHeader.dwHeight;
-        }
+        const _tDDS_HEADER& ddsHeader = ddsInfo.header;
+        const PhyreTextureFormat::_eFormat ddsFormat = ddsInfo.format;
 
-        if (rowPitch > 0) {
-            uint32_t height = ddsHeader.dwHeight;
-            std::vector<char> rowBuffer(rowPitch);
-            for (uint32_t y = 0; y < height / 2; y++) {
-                char* topRow = dataBuffer.data() + y * rowPitch;
-                char* bottomRow = dataBuffer.data() + (height - 1 - y) * rowPitch;
-                std::memcpy(rowBuffer.data(), topRow, rowPitch);
-                std::memcpy(topRow, bottomRow, rowPitch);
-                std::memcpy(bottomRow, rowBuffer.data(), rowPitch);
-            }
+        // ARGB8 and RGBA8 are swizzled while copying, the phyre keeps its format and fixup table.
+        if (textureInfo.format != ddsFormat && !PhyreTextureFormat::isRedBlueSwap(ddsFormat, textureInfo.format))
+        {
+            textureInfo = _setTextureFormat(document, phyreFile, PhyreTextureFormat::traits(ddsFormat).name);
+            textureInfo.format = ddsFormat;
+            textureInfo.textureFormat = PhyreTextureFormat::traits(ddsFormat).name;
         }
 
-        phyreFile.seekp(textureInfo.dataOffset, std::ios::beg);
-        phyreFile.write(dataBuffer.data(), dataSize);
-
-        const auto phyreEnd = phyreFile.tellp();
-
         _tDX11Header dx11Header{};
         phyreFile.seekg(0, std::ios::beg);
         phyreFile.read(reinterpret_cast<char*>(&dx11Header), sizeof(dx11Header));
 
-        dx11Header.maxTextureBufferSize = getBufferSizeByFormat(ddsTextureFormat, ddsHeader.dwWidth, ddsHeader.dwHeight);
+        dx11Header.maxTextureBufferSize = getBufferSizeByFormat(ddsFormat, ddsHeader.dwWidth, ddsHeader.dwHeight);
         phyreFile.seekp(0, std::ios::beg);
         phyreFile.write(reinterpret_cast<char*>(&dx11Header), sizeof(dx11Header));
 
@@ -343,7 +351,114 @@ namespace phyre
         newTextureInfo.maxMipmapLevel = fixedMipmapCount;
         _setTextureInfo(newTextureInfo, phyreFile, textureInfo.textureInfoOffset);
 
-        phyreFile.close();
-        std::filesystem::resize_file(phyrePath, phyreEnd);
+        if (!phyreFile)
+            throw PhyreExceptionIO(L"Cannot write phyre data");
+
+        _replacedTexture = newTextureInfo;
+
+        return textureInfo.dataOffset;
+    }
+
+    size_t PhyrePlatformDX11::convertDDS2Phyre(const _tDocument& document, const PhyreView& dds, std::iostream& phyreFile)
+    {
+        if (document.textureInfo.dataOffset >= document.phyre.size())
+            throw PhyreExceptionData(L"There is no DDS data in the phyre file");
+
+        _tDDSInfo ddsInfo = _parseDDS(dds);
+        size_t dataSize = dds.size() - ddsInfo.dataOffset;
+        const char* data = dds.at<char>(ddsInfo.dataOffset, dataSize);
+
+        // Encoded blocks come out in flipped order, they go in as they are.
+        const PhyreArena::Buffer encoded = _encodePayload(ddsInfo, data, dataSize);
+        const size_t payloadOffset = _patchPhyre(document, ddsInfo, phyreFile);
+        if (!encoded.empty())
+        {
+            PhyreStats::Timer timer(PhyreStats::stageWrite);
+            phyreFile.seekp(payloadOffset, std::ios::beg);
+            phyreFile.write(encoded.data(), encoded.size());
+            PhyreStats::addWritten(PhyreStats::stageWrite, encoded.size());
+            if (!phyreFile)
+                throw PhyreExceptionIO(L"Cannot write texture data");
+            return static_cast<size_t>(phyreFile.tellp());
+        }
+
+        const bool swapRedBlue = PhyreTextureFormat::isRedBlueSwap(ddsInfo.format, document.textureInfo.format);
+        const PhyreTextureFlip flip = _newFlip(ddsInfo.format, ddsInfo.header.dwWidth, ddsInfo.header.dwHeight, ddsInfo.header.dwMipMapCount, swapRedBlue, document.bigEndian);
+
+        phyreFile.seekp(payloadOffset, std::ios::beg);
+        _writeFlipped(phyreFile, data, dataSize, flip);
+
+        return static_cast<size_t>(phyreFile.tellp());
+    }
+
+    size_t PhyrePlatformDX11::convertDDS2Phyre(const _tDocument& document, std::istream& dds, std::ostream& phyre)
+    {
+        _tDDSInfo ddsInfo = _readDDS(dds);
+
+        // The encoder needs the whole chain, it is read before anything is written.
+        PhyreArena::Buffer encoded;
+        if (_willEncode(ddsInfo.format))
+        {
+            const size_t chainSize = static_cast<size_t>(PhyreTextureFormat::chainSize(ddsInfo.format,
+                ddsInfo.header.dwWidth, ddsInfo.header.dwHeight, ddsInfo.header.dwMipMapCount));
+            PhyreArena::Buffer chain;
+            {
+                PhyreStats::Timer timer(PhyreStats::stageRead);
+                PhyreStats::addRead(PhyreStats::stageRead, PhyreMemoryStream::append(dds, chain, chainSize));
+            }
+            encoded = _encodePayload(ddsInfo, chain.data(), chain.size());
+        }
+
+        // Everything before the payload is patched in memory, then written in one go.
+        const PhyreView& source = document.phyre;
+        const size_t prefixSize = std::min(document.textureInfo.dataOffset, source.size());
+        PhyreArena::Buffer prefixSource = PhyreArena::local().acquire(prefixSize);
+        prefixSource.assign(source.data(), prefixSize);
+        PhyreMemoryStream prefix(std::move(prefixSource));
+        const size_t payloadOffset = _patchPhyre(document, ddsInfo, prefix);
+
+        PhyreArena::Buffer prefixData = prefix.release();
+        prefixData.resize(payloadOffset);
+        if (document.bigEndian)
+            swapStructures(prefixData.data(), prefixData.size(), false);
+        {
+            PhyreStats::Timer timer(PhyreStats::stageWrite);
+            phyre.write(prefixData.data(), prefixData.size());
+            PhyreStats::addWritten(PhyreStats::stageWrite, prefixData.size());
+        }
+
+        if (!encoded.empty())
+        {
+            PhyreStats::Timer timer(PhyreStats::stageWrite);
+            phyre.write(encoded.data(), encoded.size());
+            PhyreStats::addWritten(PhyreStats::stageWrite, encoded.size());
+            if (!phyre)
+                throw PhyreExceptionIO(L"Cannot write texture data");
+            return payloadOffset + encoded.size();
+        }
+
+        const bool swapRedBlue = PhyreTextureFormat::isRedBlueSwap(ddsInfo.format, document.textureInfo.format);
+        const PhyreTextureFlip flip = _newFlip(ddsInfo.format, ddsInfo.header.dwWidth, ddsInfo.header.dwHeight, ddsInfo.header.dwMipMapCount, swapRedBlue, document.bigEndian);
+        return payloadOffset + _streamFlipped(dds, phyre, flip, std::numeric_limits<size_t>::max());
+    }
+
+    size_t PhyrePlatformDX11::getPayloadOffset(const PhyreView& head, bool bigEndian)
+    {
+        _tDX11Header dx11Header = head.read<_tDX11Header>(0);
+        if (bigEndian)
+            PhyreRowKernels::swapBytes(reinterpret_cast<char*>(&dx11Header), sizeof(dx11Header), sizeof(uint32_t));
+        if (dx11Header.platformId != PLATFORMID || dx11Header.size != sizeof(dx11Header))
+            throw PhyreExceptionData(L"Unsupported phyre format");
+
+        _tNamespaceHeader namespaceHeader = head.read<_tNamespaceHeader>(dx11Header.size);
+        if (bigEndian)
+            PhyreRowKernels::swapBytes(reinterpret_cast<char*>(&namespaceHeader), sizeof(namespaceHeader), sizeof(uint32_t));
+
+        // Same sum as PhyreLayout::validate makes, every term is at most 32 bits wide.
+        return 0ULL + dx11Header.size + namespaceHeader.size
+            + sizeof(_tInstanceDescriptor) * dx11Header.instanceListCount
+            + dx11Header.totalDataSize
+            + dx11Header.userFixupDataSize + sizeof(_tUserFixup) * dx11Header.userFixupCount
+            + dx11Header.pointerArrayFixupSize + dx11Header.pointerFixupSize + dx11Header.arrayFixupSize;
     }
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #pragma once
+#include <iostream>
+
 #include "PhyrePlatform.h"
 
 namespace phyre
@@ -43,19 +45,37 @@ namespace phyre
 		* phyre is also self describing, so we can get offset of all
 		* members from namespace definition.
 		*/
-		_tTextureInfo _getTextureInfo (const _tNamespaceHeader* header, const  _tNamespaceClassDescriptor* classes, const _tNamespaceDataMember* members, const char* stringTable, std::fstream& phyreFile, const size_t textureInfoStart);
-		void _setTextureInfo(const _tTextureInfo& textureInfo, std::fstream& phyreFile, const size_t textureInfoStart);
-		_tTextureInfo _setTextureFormat(const _tTextureInfo& textureInfo, std::fstream& phyreFile, const std::string& newFormat);
-		_tTextureInfo _getPhyreInfo(std::fstream& phyreFile, const size_t filesize);
+		_tTextureInfo _getTextureInfo (const PhyreSchema& schema, const PhyreView& phyre, const size_t textureInfoStart);
+		void _setTextureInfo(const _tTextureInfo& textureInfo, std::iostream& phyreFile, const size_t textureInfoStart);
+		_tTextureInfo _setTextureFormat(const _tDocument& document, std::iostream& phyreFile, const std::string& newFormat);
+		_tDocument _getPhyreInfo(const PhyreView& phyre);
+
+		// Rewrites format, sizes and mipmaps for the DDS, returns where the payload has to go.
+		size_t _patchPhyre(const _tDocument& document, const _tDDSInfo& ddsInfo, std::iostream& phyreFile);
+
+		// Inherited via PhyrePlatform
+		virtual bool isFormatSupported(const PhyreView& phyre) override;
+
+		// Inherited via PhyrePlatform
+		virtual _tDocument parseDocument(const PhyreView& phyre) override;
+
+		// Inherited via PhyrePlatform
+		virtual void swapStructures(char* data, size_t size, bool toNative) override;
+
+		// Inherited via PhyrePlatform
+		virtual void convertPhyre2DDS(const _tDocument& document, size_t textureIndex, std::ostream& dds) override;
+
+		// Inherited via PhyrePlatform
+		virtual size_t convertDDS2Phyre(const _tDocument& document, const PhyreView& dds, std::iostream& phyre) override;
 
 		// Inherited via PhyrePlatform
-		virtual bool isFormatSupported(const std::filesystem::path& phyrePath) override;
+		virtual size_t getPayloadOffset(const PhyreView& head, bool bigEndian) override;
 
 		// Inherited via PhyrePlatform
-		virtual void convertPhyre2DDS(const std::filesystem::path& phyrePath, const std::filesystem::path& ddsPath) override;
+		virtual void convertPhyre2DDS(const _tDocument& document, size_t textureIndex, std::istream& payload, std::ostream& dds) override;
 
 		// Inherited via PhyrePlatform
-		virtual void convertDDS2Phyre(const std::filesystem::path& ddsPath, const std::filesystem::path& phyrePath) override;
+		virtual size_t convertDDS2Phyre(const _tDocument& document, std::istream& dds, std::ostream& phyre) override;
 	};
 
 }
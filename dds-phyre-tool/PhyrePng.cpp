@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "PhyrePng.h"
+#include "PhyreException.h"
+#include "PhyreStats.h"
+
+namespace phyre
+{
+    namespace
+    {
+        constexpr uint32_t WINDOW_SIZE = 32768;
+        constexpr uint32_t HASH_BITS = 15;
+        constexpr uint32_t MIN_MATCH = 3;
+        constexpr uint32_t MAX_MATCH = 258;
+
+        const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        // Deflate packs bits from the least significant end, Huffman codes go in most significant bit first.
+        class BitWriter
+        {
+        public:
+            BitWriter(uint8_t* data) : _data(data) {}
+
+            void bits(uint32_t value, uint32_t count)
+            {
+                _buffer |= static_cast<uint64_t>(value) << _count;
+                _count += count;
+                while (_count >= 8)
+                {
+                    _data[_pos++] = static_cast<uint8_t>(_buffer);
+                    _buffer >>= 8;
+                    _count -= 8;
+                }
+            }
+
+            void code(uint32_t value, uint32_t length)
+            {
+                uint32_t reversed = 0;
+                for (uint32_t i = 0; i < length; i++)
+                    reversed |= ((value >> i) & 1u) << (length - 1 - i);
+                bits(reversed, length);
+            }
+
+            // Fixed Huffman code of a literal or length symbol.
+            void symbol(uint32_t value)
+            {
+                if (value < 144)
+                    code(0x30 + value, 8);
+                else if (value < 256)
+                    code(0x190 + value - 144, 9);
+                else if (value < 280)
+                    code(value - 256, 7);
+                else
+                    code(0xC0 + value - 280, 8);
+            }
+
+            void match(uint32_t length, uint32_t distance)
+            {
+                const uint32_t lengthCode = static_cast<uint32_t>(std::upper_bound(lengthBase, lengthBase + 29, length) - lengthBase - 1);
+                symbol(257 + lengthCode);
+                bits(length - lengthBase[lengthCode], lengthExtra[lengthCode]);
+
+                const uint32_t distanceCode = static_cast<uint32_t>(std::upper_bound(distanceBase, distanceBase + 30, distance) - distanceBase - 1);
+                code(distanceCode, 5);
+                bits(distance - distanceBase[distanceCode], distanceExtra[distanceCode]);
+            }
+
+            size_t finish()
+            {
+                if (_count > 0)
+                    _data[_pos++] = static_cast<uint8_t>(_buffer);
+                _buffer = 0;
+                _count = 0;
+                return _pos;
+            }
+
+        private:
+            uint8_t* _data;
+            size_t _pos = 0;
+            uint64_t _buffer = 0;
+            uint32_t _count = 0;
+        };
+
+        uint32_t hash(const uint8_t* data)
+        {
+            return ((data[0] << 16 | data[1] << 8 | data[2]) * 2654435761u) >> (32 - HASH_BITS);
+        }
+
+        uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+        {
+            const int p = a + b - c;
+            const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+        }
+
+        void writeBigEndian(char* dst, uint32_t value)
+        {
+            for (uint32_t i = 0; i < 4; i++)
+                dst[i] = static_cast<char>(value >> (24 - i * 8));
+        }
+    }
+
+    uint32_t PhyrePng::crc32(const char* data, size_t size, uint32_t crc)
+    {
+        static const std::vector<uint32_t> table = []()
+        {
+            std::vector<uint32_t> ret(256);
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (uint32_t k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                ret[n] = c;
+            }
+            return ret;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    uint32_t PhyrePng::adler32(const char* data, size_t size, uint32_t adler)
+    {
+        // The sums are reduced every 5552 bytes, the most that can't overflow 32 bits.
+        uint32_t a = adler & 0xFFFF, b = adler >> 16;
+        while (size > 0)
+        {
+            const size_t run = std::min<size_t>(size, 5552);
+            for (size_t i = 0; i < run; i++)
+            {
+                a += static_cast<uint8_t>(data[i]);
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += run;
+            size -= run;
+        }
+        return b << 16 | a;
+    }
+
+    PhyreArena::Buffer PhyrePng::_filter(const uint8_t* rgba, uint32_t width, uint32_t height)
+    {
+        const size_t pitch = static_cast<size_t>(width) * 4;
+        PhyreArena::Buffer ret = PhyreArena::local().acquire((pitch + 1) * height);
+        std::vector<uint8_t> candidates(pitch * 5);
+        const std::vector<uint8_t> zero(pitch, 0);
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const uint8_t* row = rgba + y * pitch;
+            const uint8_t* above = y ? row - pitch : zero.data();
+
+            // None, Sub, Up, Average and Paeth, the left neighbour of the first pixel is zero.
+            for (size_t i = 0; i < pitch; i++)
+            {
+                const uint8_t left = i >= 4 ? row[i - 4] : 0;
+                const uint8_t upperLeft = i >= 4 ? above[i - 4] : 0;
+                candidates[i] = row[i];
+                candidates[pitch + i] = static_cast<uint8_t>(row[i] - left);
+                candidates[pitch * 2 + i] = static_cast<uint8_t>(row[i] - above[i]);
+                candidates[pitch * 3 + i] = static_cast<uint8_t>(row[i] - ((left + above[i]) >> 1));
+                candidates[pitch * 4 + i] = static_cast<uint8_t>(row[i] - paeth(left, above[i], upperLeft));
+            }
+
+            uint32_t best = 0;
+            uint64_t bestSum = UINT64_MAX;
+            for (uint32_t filter = 0; filter < 5; filter++)
+            {
+                uint64_t sum = 0;
+                for (size_t i = 0; i < pitch; i++)
+                    sum += static_cast<uint64_t>(std::abs(static_cast<int8_t>(candidates[pitch * filter + i])));
+                if (sum < bestSum)
+                {
+                    bestSum = sum;
+                    best = filter;
+                }
+            }
+
+            char* out = ret.data() + y * (pitch + 1);
+            out[0] = static_cast<char>(best);
+            std::memcpy(out + 1, candidates.data() + pitch * best, pitch);
+        }
+        return ret;
+    }
+
+    PhyreArena::Buffer PhyrePng::_deflate(const uint8_t* data, size_t size)
+    {
+        // No symbol takes more than 9 bits, plus the zlib header, block header, end of block and checksum.
+        PhyreArena::Buffer ret = PhyreArena::local().acquire(size + size / 8 + 16);
+        uint8_t* out = reinterpret_cast<uint8_t*>(ret.data());
+        out[0] = 0x78;
+        out[1] = 0x01;
+
+        std::vector<int64_t> head(size_t(1) << HASH_BITS, -1);
+        std::vector<int64_t> previous(WINDOW_SIZE, -1);
+        const auto insert = [&](size_t pos)
+        {
+            const uint32_t h = hash(data + pos);
+            previous[pos % WINDOW_SIZE] = head[h];
+            head[h] = static_cast<int64_t>(pos);
+        };
+
+        // One final block with the fixed codes.
+        BitWriter writer(out + 2);
+        writer.bits(1, 1);
+        writer.bits(1, 2);
+
+        size_t pos = 0;
+        while (pos < size)
+        {
+            uint32_t bestLength = 0, bestDistance = 0;
+            if (pos + MIN_MATCH <= size)
+            {
+                const uint32_t limit = static_cast<uint32_t>(std::min<size_t>(MAX_MATCH, size - pos));
+                int64_t candidate = head[hash(data + pos)];
+                for (uint32_t chain = 0; chain < MAX_CHAIN && candidate >= 0 && pos - static_cast<size_t>(candidate) <= WINDOW_SIZE; chain++)
+                {
+                    const uint8_t* a = data + pos;
+                    const uint8_t* b = data + candidate;
+                    uint32_t length = 0;
+                    while (length < limit && a[length] == b[length])
+                        length++;
+                    if (length > bestLength)
+                    {
+                        bestLength = length;
+                        bestDistance = static_cast<uint32_t>(pos - static_cast<size_t>(candidate));
+                        if (length == limit)
+                            break;
+                    }
+                    candidate = previous[static_cast<size_t>(candidate) % WINDOW_SIZE];
+                }
+                insert(pos);
+            }
+
+            if (bestLength >= MIN_MATCH)
+            {
+                writer.match(bestLength, bestDistance);
+                for (size_t i = pos + 1; i < pos + bestLength && i + MIN_MATCH <= size; i++)
+                    insert(i);
+                pos += bestLength;
+            }
+            else
+            {
+                writer.symbol(data[pos]);
+                pos++;
+            }
+        }
+        writer.symbol(256);
+
+        size_t used = 2 + writer.finish();
+        writeBigEndian(ret.data() + used, adler32(reinterpret_cast<const char*>(data), size));
+        ret.resize(used + 4);
+        return ret;
+    }
+
+    void PhyrePng::_writeChunk(std::ostream& out, const char* type, const char* data, size_t size)
+    {
+        char header[8];
+        writeBigEndian(header, static_cast<uint32_t>(size));
+        std::memcpy(header + 4, type, 4);
+        char footer[4];
+        writeBigEndian(footer, crc32(data, size, crc32(type, 4)));
+
+        out.write(header, sizeof(header));
+        out.write(data, size);
+        out.write(footer, sizeof(footer));
+        PhyreStats::addWritten(PhyreStats::stageWrite, size + 12, 3);
+    }
+
+    void PhyrePng::write(std::ostream& out, const char* rgba, uint32_t width, uint32_t height)
+    {
+        if (!width || !height)
+            throw PhyreExceptionData(L"Images without pixels can't be written as PNG");
+
+        PhyreStats::Timer timer(PhyreStats::stageEncode);
+        PhyreArena::Buffer filtered = _filter(reinterpret_cast<const uint8_t*>(rgba), width, height);
+        const PhyreArena::Buffer compressed = _deflate(reinterpret_cast<const uint8_t*>(filtered.data()), filtered.size());
+        filtered.reset();
+
+        // 8 bit RGBA, no interlacing.
+        char header[13] = {};
+        writeBigEndian(header, width);
+        writeBigEndian(header + 4, height);
+        header[8] = 8;
+        header[9] = 6;
+
+        timer.switchTo(PhyreStats::stageWrite);
+        static const char signature[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1A', '\n' };
+        out.write(signature, sizeof(signature));
+        PhyreStats::addWritten(PhyreStats::stageWrite, sizeof(signature));
+        _writeChunk(out, "IHDR", header, sizeof(header));
+        for (size_t offset = 0; offset < compressed.size(); offset += CHUNK_SIZE)
+            _writeChunk(out, "IDAT", compressed.data() + offset, std::min(CHUNK_SIZE, compressed.size() - offset));
+        _writeChunk(out, "IEND", nullptr, 0);
+
+        if (!out)
+            throw PhyreExceptionIO(L"Cannot write PNG data");
+    }
+}
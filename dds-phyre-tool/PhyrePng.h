@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "PhyreArena.h"
+
+namespace phyre
+{
+    /*
+    * Writes 8 bit RGBA images as PNG without an external zlib. Each row
+    * gets the filter with the smallest sum of residuals and the filtered
+    * rows are deflated with the fixed Huffman codes and a hash chain
+    * match finder. That is a fraction of the work of a dynamic Huffman
+    * encoder and still far smaller than the raw pixels.
+    */
+    class PhyrePng
+    {
+    public:
+        static void write(std::ostream& out, const char* rgba, uint32_t width, uint32_t height);
+
+        static uint32_t crc32(const char* data, size_t size, uint32_t crc = 0);
+        static uint32_t adler32(const char* data, size_t size, uint32_t adler = 1);
+
+    protected:
+        // Candidates compared for every position, more find longer matches but cost time.
+        static constexpr uint32_t MAX_CHAIN = 16;
+        // Compressed data per IDAT chunk.
+        static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+        static PhyreArena::Buffer _filter(const uint8_t* rgba, uint32_t width, uint32_t height);
+        // zlib stream of data.
+        static PhyreArena::Buffer _deflate(const uint8_t* data, size_t size);
+        static void _writeChunk(std::ostream& out, const char* type, const char* data, size_t size);
+    };
+}
@@ -0,0 +1,291 @@
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PHYRE_ROW_AVX2
+#define PHYRE_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PHYRE_ROW_AVX2
+#define PHYRE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PHYRE_ROW_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "PhyreRowKernels.h"
+
+namespace phyre
+{
+    namespace
+    {
+        uint32_t swapRedBlue(uint32_t pixel)
+        {
+            return (pixel & 0xFF00FF00) | ((pixel >> 16) & 0xFF) | ((pixel & 0xFF) << 16);
+        }
+
+        // Handles whatever is left after the vector loops, pixel by pixel.
+        void copyRowScalar(char* dst, const char* src, size_t size, bool swap)
+        {
+            if (!swap)
+            {
+                std::memmove(dst, src, size);
+                return;
+            }
+            for (size_t i = 0; i + 4 <= size; i += 4)
+            {
+                uint32_t pixel;
+                std::memcpy(&pixel, src + i, sizeof(pixel));
+                pixel = swapRedBlue(pixel);
+                std::memcpy(dst + i, &pixel, sizeof(pixel));
+            }
+        }
+
+        void swapBytes16Scalar(char* data, size_t size)
+        {
+            for (size_t i = 0; i + 2 <= size; i += 2)
+                std::swap(data[i], data[i + 1]);
+        }
+
+        void swapBytes32Scalar(char* data, size_t size)
+        {
+            for (size_t i = 0; i + 4 <= size; i += 4)
+            {
+                std::swap(data[i], data[i + 3]);
+                std::swap(data[i + 1], data[i + 2]);
+            }
+        }
+
+        void swapRowsScalar(char* first, char* second, size_t size, bool swap)
+        {
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4)
+            {
+                uint32_t a, b;
+                std::memcpy(&a, first + i, sizeof(a));
+                std::memcpy(&b, second + i, sizeof(b));
+                if (swap)
+                {
+                    a = swapRedBlue(a);
+                    b = swapRedBlue(b);
+                }
+                std::memcpy(first + i, &b, sizeof(b));
+                std::memcpy(second + i, &a, sizeof(a));
+            }
+            for (; i < size; i++)
+                std::swap(first[i], second[i]);
+        }
+
+#ifdef PHYRE_ROW_SSE2
+        __m128i swapRedBlueSSE2(__m128i pixels)
+        {
+            const __m128i greenAlpha = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+            const __m128i low = _mm_set1_epi32(0xFF);
+            const __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 16), low);
+            const __m128i blue = _mm_slli_epi32(_mm_and_si128(pixels, low), 16);
+            return _mm_or_si128(_mm_and_si128(pixels, greenAlpha), _mm_or_si128(red, blue));
+        }
+
+        void copyRowSSE2(char* dst, const char* src, size_t size, bool swap)
+        {
+            if (!swap)
+            {
+                std::memmove(dst, src, size);
+                return;
+            }
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16)
+            {
+                const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), swapRedBlueSSE2(pixels));
+            }
+            copyRowScalar(dst + i, src + i, size - i, swap);
+        }
+
+        void swapRowsSSE2(char* first, char* second, size_t size, bool swap)
+        {
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i));
+                if (swap)
+                {
+                    a = swapRedBlueSSE2(a);
+                    b = swapRedBlueSSE2(b);
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(first + i), b);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(second + i), a);
+            }
+            swapRowsScalar(first + i, second + i, size - i, swap);
+        }
+
+        __m128i swapBytes16SSE2(__m128i words)
+        {
+            return _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+        }
+
+        void swapBytes16SSE2(char* data, size_t size)
+        {
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16)
+            {
+                const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), swapBytes16SSE2(words));
+            }
+            swapBytes16Scalar(data + i, size - i);
+        }
+
+        void swapBytes32SSE2(char* data, size_t size)
+        {
+            // Swapping the halves of each word first leaves a 16 bit swap.
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                words = _mm_shufflehi_epi16(_mm_shufflelo_epi16(words, 0xB1), 0xB1);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), swapBytes16SSE2(words));
+            }
+            swapBytes32Scalar(data + i, size - i);
+        }
+#endif
+
+#ifdef PHYRE_ROW_AVX2
+        PHYRE_TARGET_AVX2 __m256i swapRedBlueAVX2(__m256i pixels)
+        {
+            const __m256i order = _mm256_setr_epi8(
+                2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+            return _mm256_shuffle_epi8(pixels, order);
+        }
+
+        PHYRE_TARGET_AVX2 void copyRowAVX2(char* dst, const char* src, size_t size, bool swap)
+        {
+            if (!swap)
+            {
+                std::memmove(dst, src, size);
+                return;
+            }
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32)
+            {
+                const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), swapRedBlueAVX2(pixels));
+            }
+            copyRowScalar(dst + i, src + i, size - i, swap);
+        }
+
+        PHYRE_TARGET_AVX2 void swapRowsAVX2(char* first, char* second, size_t size, bool swap)
+        {
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + i));
+                if (swap)
+                {
+                    a = swapRedBlueAVX2(a);
+                    b = swapRedBlueAVX2(b);
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(first + i), b);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(second + i), a);
+            }
+            swapRowsScalar(first + i, second + i, size - i, swap);
+        }
+
+        PHYRE_TARGET_AVX2 void swapBytesAVX2(char* data, size_t size, const __m256i order)
+        {
+            for (size_t i = 0; i + 32 <= size; i += 32)
+            {
+                const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_shuffle_epi8(words, order));
+            }
+        }
+
+        PHYRE_TARGET_AVX2 void swapBytes16AVX2(char* data, size_t size)
+        {
+            const __m256i order = _mm256_setr_epi8(
+                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+            swapBytesAVX2(data, size, order);
+            const size_t done = size / 32 * 32;
+            swapBytes16Scalar(data + done, size - done);
+        }
+
+        PHYRE_TARGET_AVX2 void swapBytes32AVX2(char* data, size_t size)
+        {
+            const __m256i order = _mm256_setr_epi8(
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+            swapBytesAVX2(data, size, order);
+            const size_t done = size / 32 * 32;
+            swapBytes32Scalar(data + done, size - done);
+        }
+
+        bool hasAVX2()
+        {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+                return false;
+
+            // The OS has to save the upper halves of the registers as well.
+            __cpuid(info, 1);
+            const int osxsaveAVX = (1 << 27) | (1 << 28);
+            if ((info[2] & osxsaveAVX) != osxsaveAVX || (_xgetbv(0) & 6) != 6)
+                return false;
+
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+    }
+
+    const PhyreRowKernels::_tKernels& PhyreRowKernels::_kernels()
+    {
+        static const _tKernels kernels = []()
+        {
+#ifdef PHYRE_ROW_AVX2
+            if (hasAVX2())
+                return _tKernels{ levelAVX2, copyRowAVX2, swapRowsAVX2, swapBytes16AVX2, swapBytes32AVX2 };
+#endif
+#ifdef PHYRE_ROW_SSE2
+            return _tKernels{ levelSSE2, copyRowSSE2, swapRowsSSE2, swapBytes16SSE2, swapBytes32SSE2 };
+#else
+            return _tKernels{ levelScalar, copyRowScalar, swapRowsScalar, swapBytes16Scalar, swapBytes32Scalar };
+#endif
+        }();
+        return kernels;
+    }
+
+    void PhyreRowKernels::copyRow(char* dst, const char* src, size_t size, bool swapRedBlue)
+    {
+        _kernels().copyRow(dst, src, size, swapRedBlue);
+    }
+
+    void PhyreRowKernels::swapRows(char* first, char* second, size_t size, bool swapRedBlue)
+    {
+        _kernels().swapRows(first, second, size, swapRedBlue);
+    }
+
+    void PhyreRowKernels::swapBytes(char* data, size_t size, size_t wordSize)
+    {
+        if (wordSize == 2)
+            _kernels().swapBytes16(data, size);
+        else if (wordSize == 4)
+            _kernels().swapBytes32(data, size);
+    }
+
+    PhyreRowKernels::_eLevel PhyreRowKernels::level()
+    {
+        return _kernels().level;
+    }
+}
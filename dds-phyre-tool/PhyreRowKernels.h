@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+
+namespace phyre
+{
+    /*
+    * Row kernels for uncompressed 8 and 32 bit pixels. Every kernel can
+    * swap the red and blue channels of 32 bit pixels on the way, which
+    * turns ARGB8 rows into RGBA8 rows and back without a second pass.
+    * The SSE2 or AVX2 implementation is picked once from the running
+    * CPU, the scalar one is used everywhere else. The same dispatch
+    * serves the byte swap used for big endian files.
+    */
+    class PhyreRowKernels
+    {
+    public:
+        enum _eLevel
+        {
+            levelScalar,
+            levelSSE2,
+            levelAVX2
+        };
+
+        // Copies size bytes, dst may be equal to src. With swapRedBlue size must be a multiple of 4.
+        static void copyRow(char* dst, const char* src, size_t size, bool swapRedBlue);
+
+        // Exchanges two rows of size bytes in place, without scratch memory.
+        static void swapRows(char* first, char* second, size_t size, bool swapRedBlue);
+
+        // Reverses the bytes of every 2 or 4 byte word in place, other word sizes are left alone.
+        static void swapBytes(char* data, size_t size, size_t wordSize);
+
+        static _eLevel level();
+
+    protected:
+        typedef void (*_tCopyRow)(char* dst, const char* src, size_t size, bool swapRedBlue);
+        typedef void (*_tSwapRows)(char* first, char* second, size_t size, bool swapRedBlue);
+        typedef void (*_tSwapBytes)(char* data, size_t size);
+
+        struct _tKernels
+        {
+            _eLevel level;
+            _tCopyRow copyRow;
+            _tSwapRows swapRows;
+            _tSwapBytes swapBytes16;
+            _tSwapBytes swapBytes32;
+        };
+
+        static const _tKernels& _kernels();
+    };
+}
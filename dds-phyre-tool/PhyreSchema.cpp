@@ -0,0 +1,147 @@
+#include <cstring>
+#include <mutex>
+
+#include "PhyreSchema.h"
+#include "PhyreException.h"
+#include "PhyreLayout.h"
+
+namespace phyre
+{
+    namespace
+    {
+        // One entry per game build is the common case, the cap only guards odd batches.
+        constexpr size_t CACHE_CAPACITY = 16;
+
+        std::mutex cacheMutex;
+        std::unordered_map<uint64_t, std::shared_ptr<const PhyreSchema>> cache;
+
+        const std::string emptyName;
+    }
+
+    PhyreSchema::PhyreSchema(const PhyreLayout& layout)
+    {
+        const PhyreView namespaceData = layout.namespaceData();
+        _namespaceData.assign(namespaceData.data(), namespaceData.data() + namespaceData.size());
+        const PhyrePlatform::_tNamespaceHeader& header = layout.namespaceHeader();
+
+        _typeNames.reserve(header.typeCount);
+        for (uint32_t i = 0; i < header.typeCount; i++)
+            _typeNames.emplace_back(layout.name(layout.type(i)));
+
+        _members.reserve(layout.memberCount());
+        for (size_t i = 0; i < layout.memberCount(); i++)
+            _members.push_back(layout.member(i));
+
+        _classes.resize(header.classCount);
+        _classIndex.reserve(header.classCount);
+        for (size_t i = 0, memberStart = 0; i < _classes.size(); i++)
+        {
+            _tClass& classData = _classes[i];
+            classData.descriptor = layout.classDescriptor(i);
+            classData.name = layout.name(classData.descriptor.nameOffset);
+            classData.memberStart = memberStart;
+            classData.memberIndex.reserve(classData.descriptor.dataMemberCount);
+            for (uint32_t m = 0; m < classData.descriptor.dataMemberCount; m++)
+                classData.memberIndex.emplace(layout.name(_members[memberStart + m].nameOffset), m);
+            memberStart += classData.descriptor.dataMemberCount;
+
+            // First definition wins, like the linear scan it replaces.
+            _classIndex.emplace(classData.name, static_cast<uint32_t>(i + 1));
+        }
+    }
+
+    std::shared_ptr<const PhyreSchema> PhyreSchema::get(const PhyreLayout& layout)
+    {
+        const PhyreView namespaceData = layout.namespaceData();
+        const uint64_t hash = _hash(namespaceData);
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            auto cached = cache.find(hash);
+            if (cached != cache.end() &&
+                cached->second->_namespaceData.size() == namespaceData.size() &&
+                std::memcmp(cached->second->_namespaceData.data(), namespaceData.data(), namespaceData.size()) == 0)
+                return cached->second;
+        }
+
+        std::shared_ptr<const PhyreSchema> schema(new PhyreSchema(layout));
+
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (cache.size() >= CACHE_CAPACITY)
+            cache.clear();
+        cache[hash] = schema;
+        return schema;
+    }
+
+    void PhyreSchema::clearCache()
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cache.clear();
+    }
+
+    uint64_t PhyreSchema::_hash(const PhyreView& data)
+    {
+        // FNV-1a over 64 bit words, the tail is folded in byte by byte.
+        uint64_t hash = 0xCBF29CE484222325ULL ^ data.size();
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            std::memcpy(&word, data.data() + i, sizeof(word));
+            hash = (hash ^ word) * 0x100000001B3ULL;
+        }
+        for (; i < data.size(); i++)
+            hash = (hash ^ static_cast<uint8_t>(data.data()[i])) * 0x100000001B3ULL;
+        return hash;
+    }
+
+    uint32_t PhyreSchema::findClassId(const std::string& className) const
+    {
+        auto found = _classIndex.find(className);
+        return found == _classIndex.end() ? 0 : found->second;
+    }
+
+    const PhyrePlatform::_tNamespaceClassDescriptor* PhyreSchema::findClass(uint32_t classId) const
+    {
+        if (classId == 0 || classId > _classes.size())
+            return nullptr;
+        return &_classes[classId - 1].descriptor;
+    }
+
+    const PhyrePlatform::_tNamespaceDataMember* PhyreSchema::findMember(uint32_t classId, const std::string& memberName) const
+    {
+        if (classId == 0 || classId > _classes.size())
+            return nullptr;
+
+        const _tClass& classData = _classes[classId - 1];
+        auto found = classData.memberIndex.find(memberName);
+        if (found == classData.memberIndex.end())
+            return nullptr;
+        return &_members[classData.memberStart + found->second];
+    }
+
+    bool PhyreSchema::isA(uint32_t classId, uint32_t baseClassId) const
+    {
+        // A broken namespace may loop, a chain can't be longer than the class count.
+        for (size_t depth = 0; classId != 0 && classId <= _classes.size() && depth <= _classes.size(); depth++)
+        {
+            if (classId == baseClassId)
+                return true;
+            classId = _classes[classId - 1].descriptor.baseClassId;
+        }
+        return false;
+    }
+
+    const std::string& PhyreSchema::className(uint32_t classId) const
+    {
+        if (classId == 0 || classId > _classes.size())
+            return emptyName;
+        return _classes[classId - 1].name;
+    }
+
+    const std::string& PhyreSchema::typeName(uint32_t typeId) const
+    {
+        if (typeId >= _typeNames.size())
+            return emptyName;
+        return _typeNames[typeId];
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PhyrePlatform.h"
+
+namespace phyre
+{
+    /*
+    * Hashed index over the class, member and type names of a namespace.
+    * Files from the same game build carry identical namespaces, so built
+    * indexes are cached by a hash of the namespace bytes and shared. The
+    * index owns copies of everything it returns and outlives the file.
+    */
+    class PhyreLayout;
+
+    class PhyreSchema
+    {
+    public:
+        PhyreSchema() = delete;
+
+        // Returns the cached index for these namespace bytes, building it on first use.
+        static std::shared_ptr<const PhyreSchema> get(const PhyreLayout& layout);
+        static void clearCache();
+
+        // Class ids are 1 based as in instance descriptors, 0 means not found.
+        uint32_t findClassId(const std::string& className) const;
+        const PhyrePlatform::_tNamespaceClassDescriptor* findClass(uint32_t classId) const;
+        const PhyrePlatform::_tNamespaceDataMember* findMember(uint32_t classId, const std::string& memberName) const;
+
+        // True for the class itself and everything derived from it.
+        bool isA(uint32_t classId, uint32_t baseClassId) const;
+
+        const std::string& className(uint32_t classId) const;
+        const std::string& typeName(uint32_t typeId) const;
+        size_t classCount() const { return _classes.size(); }
+
+    protected:
+        struct _tClass
+        {
+            PhyrePlatform::_tNamespaceClassDescriptor descriptor;
+            std::string name;
+            size_t memberStart;
+            std::unordered_map<std::string, uint32_t> memberIndex;
+        };
+
+        // The layout is validated, the tables are read without checks.
+        PhyreSchema(const PhyreLayout& layout);
+
+        static uint64_t _hash(const PhyreView& data);
+
+        std::vector<char> _namespaceData;
+        std::vector<_tClass> _classes;
+        std::vector<PhyrePlatform::_tNamespaceDataMember> _members;
+        std::vector<std::string> _typeNames;
+        std::unordered_map<std::string, uint32_t> _classIndex;
+    };
+}
@@ -0,0 +1,169 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <cstdio>
+
+#include "PhyreStats.h"
+
+namespace phyre
+{
+    thread_local PhyreStats* PhyreStats::_current = nullptr;
+    thread_local PhyreStats::Timer* PhyreStats::_activeTimer = nullptr;
+
+    PhyreStats::Scope::Scope(PhyreStats& stats)
+        : _previous(_current)
+    {
+        _current = &stats;
+    }
+
+    PhyreStats::Scope::~Scope()
+    {
+        _current = _previous;
+    }
+
+    PhyreStats::Timer::Timer(_eStage stage)
+        : _stats(_current)
+        , _stage(stage)
+    {
+        if (!_stats)
+            return;
+
+        // The enclosing timer stops while this one runs and restarts when it ends.
+        _start = std::chrono::steady_clock::now();
+        _parent = _activeTimer;
+        if (_parent)
+            _parent->_stop();
+        _activeTimer = this;
+    }
+
+    PhyreStats::Timer::~Timer()
+    {
+        if (!_stats)
+            return;
+
+        _stop();
+        _activeTimer = _parent;
+        if (_parent)
+            _parent->_start = std::chrono::steady_clock::now();
+    }
+
+    void PhyreStats::Timer::switchTo(_eStage stage)
+    {
+        if (!_stats)
+            return;
+
+        _stop();
+        _stage = stage;
+    }
+
+    void PhyreStats::Timer::_stop()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        _stats->_stages[_stage].nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(now - _start).count();
+        _start = now;
+    }
+
+    void PhyreStats::addRead(_eStage stage, uint64_t bytes, uint64_t calls)
+    {
+        if (!_current)
+            return;
+        _current->_stages[stage].bytesRead += bytes;
+        _current->_stages[stage].readCalls += calls;
+    }
+
+    void PhyreStats::addWritten(_eStage stage, uint64_t bytes, uint64_t calls)
+    {
+        if (!_current)
+            return;
+        _current->_stages[stage].bytesWritten += bytes;
+        _current->_stages[stage].writeCalls += calls;
+    }
+
+    void PhyreStats::addAllocated(uint64_t bytes)
+    {
+        if (!_current || !bytes)
+            return;
+        _current->_allocatedBytes += bytes;
+        _current->_allocations++;
+    }
+
+    uint64_t PhyreStats::totalNanoseconds() const
+    {
+        uint64_t ret = 0;
+        for (const auto& stage : _stages)
+            ret += stage.nanoseconds;
+        return ret;
+    }
+
+    const char* PhyreStats::stageName(_eStage stage)
+    {
+        static const char* const names[stageCount] = { "open", "parse", "read", "flip", "encode", "decode", "write" };
+        return names[stage];
+    }
+
+    uint64_t PhyreStats::peakResidentBytes()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters{};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return counters.PeakWorkingSetSize;
+        return 0;
+#else
+        struct rusage usage {};
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    std::string PhyreStats::toText() const
+    {
+        char line[160];
+        std::string ret;
+        std::snprintf(line, sizeof(line), "%-8s %12s %14s %14s %8s %8s\n", "stage", "ms", "bytes read", "bytes written", "reads", "writes");
+        ret += line;
+        for (int i = 0; i < stageCount; i++)
+        {
+            const _tStage& entry = _stages[i];
+            std::snprintf(line, sizeof(line), "%-8s %12.3f %14llu %14llu %8llu %8llu\n", stageName(static_cast<_eStage>(i)), entry.nanoseconds / 1e6,
+                static_cast<unsigned long long>(entry.bytesRead), static_cast<unsigned long long>(entry.bytesWritten),
+                static_cast<unsigned long long>(entry.readCalls), static_cast<unsigned long long>(entry.writeCalls));
+            ret += line;
+        }
+        std::snprintf(line, sizeof(line), "%-8s %12.3f\nallocated %llu bytes in %llu buffers, peak RSS %llu bytes\n", "total", totalNanoseconds() / 1e6,
+            static_cast<unsigned long long>(_allocatedBytes), static_cast<unsigned long long>(_allocations),
+            static_cast<unsigned long long>(peakResidentBytes()));
+        ret += line;
+        return ret;
+    }
+
+    std::string PhyreStats::toJson() const
+    {
+        char field[256];
+        std::string ret = "{\"stages\":{";
+        for (int i = 0; i < stageCount; i++)
+        {
+            const _tStage& entry = _stages[i];
+            std::snprintf(field, sizeof(field), "%s\"%s\":{\"ns\":%llu,\"bytesRead\":%llu,\"bytesWritten\":%llu,\"readCalls\":%llu,\"writeCalls\":%llu}",
+                i ? "," : "", stageName(static_cast<_eStage>(i)), static_cast<unsigned long long>(entry.nanoseconds),
+                static_cast<unsigned long long>(entry.bytesRead), static_cast<unsigned long long>(entry.bytesWritten),
+                static_cast<unsigned long long>(entry.readCalls), static_cast<unsigned long long>(entry.writeCalls));
+            ret += field;
+        }
+        std::snprintf(field, sizeof(field), "},\"totalNs\":%llu,\"allocatedBytes\":%llu,\"allocations\":%llu,\"peakRssBytes\":%llu}",
+            static_cast<unsigned long long>(totalNanoseconds()), static_cast<unsigned long long>(_allocatedBytes),
+            static_cast<unsigned long long>(_allocations), static_cast<unsigned long long>(peakResidentBytes()));
+        ret += field;
+        return ret;
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace phyre
+{
+    /*
+    * Counters for the conversions running on one thread, split by stage:
+    * wall time, bytes and I/O calls in each direction, and the large
+    * buffers allocated on the way. Nothing is collected unless a Scope is
+    * active, instrumented code then only checks a thread local pointer.
+    * Timers nest, time spent in an inner stage isn't counted in the outer
+    * one, so the stage times add up to the total.
+    */
+    class PhyreStats
+    {
+    public:
+        enum _eStage
+        {
+            stageOpen,
+            stageParse,
+            stageRead,
+            stageFlip,
+            stageEncode,
+            stageDecode,
+            stageWrite,
+            stageCount
+        };
+
+        struct _tStage
+        {
+            uint64_t nanoseconds;
+            uint64_t bytesRead;
+            uint64_t bytesWritten;
+            uint64_t readCalls;
+            uint64_t writeCalls;
+        };
+
+        // Collects everything on this thread into stats until it is destroyed.
+        class Scope
+        {
+        public:
+            explicit Scope(PhyreStats& stats);
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+            ~Scope();
+
+        private:
+            PhyreStats* _previous;
+        };
+
+        // Charges the wall time until it is destroyed to a stage.
+        class Timer
+        {
+        public:
+            explicit Timer(_eStage stage);
+            Timer(const Timer&) = delete;
+            Timer& operator=(const Timer&) = delete;
+            ~Timer();
+
+            // The time from here on goes to another stage.
+            void switchTo(_eStage stage);
+
+        private:
+            void _stop();
+
+            PhyreStats* _stats;
+            Timer* _parent = nullptr;
+            _eStage _stage;
+            std::chrono::steady_clock::time_point _start;
+        };
+
+        static PhyreStats* current() { return _current; }
+
+        /*
+        * Calls are the reads and writes issued to streams and the system,
+        * reads from memory count bytes only. In the open stage they count
+        * the files opened for reading and for writing.
+        */
+        static void addRead(_eStage stage, uint64_t bytes, uint64_t calls = 1);
+        static void addWritten(_eStage stage, uint64_t bytes, uint64_t calls = 1);
+        static void addAllocated(uint64_t bytes);
+
+        const _tStage& stage(_eStage stage) const { return _stages[stage]; }
+        uint64_t totalNanoseconds() const;
+        uint64_t allocatedBytes() const { return _allocatedBytes; }
+        uint64_t allocations() const { return _allocations; }
+
+        static const char* stageName(_eStage stage);
+        // Peak resident set of the whole process, 0 where it can't be queried.
+        static uint64_t peakResidentBytes();
+
+        std::string toText() const;
+        std::string toJson() const;
+
+    private:
+        static thread_local PhyreStats* _current;
+        static thread_local Timer* _activeTimer;
+
+        _tStage _stages[stageCount] = {};
+        uint64_t _allocatedBytes = 0;
+        uint64_t _allocations = 0;
+    };
+}
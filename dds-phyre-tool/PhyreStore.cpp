@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "PhyreStore.h"
+#include "PhyreCatalog.h"
+#include "PhyreException.h"
+#include "PhyreManifest.h"
+#include "PhyreMappedFile.h"
+#include "PhyreStats.h"
+#include "PhyreTempFile.h"
+
+namespace fs = std::filesystem;
+
+namespace phyre
+{
+    namespace
+    {
+        const char* const LINKS_SIGNATURE = "dds-phyre-store 1";
+
+        std::string hexHash(uint64_t hash)
+        {
+            char text[17];
+            std::snprintf(text, sizeof(text), "%016" PRIx64, hash);
+            return text;
+        }
+    }
+
+    PhyreStore::PhyreStore(const fs::path& root)
+    {
+        // Absolute, so the links and the report name the same files whatever the working directory.
+        std::error_code error;
+        _root = fs::absolute(root, error).lexically_normal();
+        if (!error)
+            fs::create_directories(_root, error);
+        if (error || !fs::is_directory(_root, error))
+            throw PhyreExceptionIO(L"Cannot create store directory: " + root.wstring());
+        _load();
+    }
+
+    PhyreStore::_eLink PhyreStore::add(const PhyreView& dds, const fs::path& outputPath)
+    {
+        std::error_code error;
+        const fs::path output = fs::absolute(outputPath, error).lexically_normal();
+        if (error)
+            throw PhyreExceptionIO(L"Cannot resolve output path: " + outputPath.wstring());
+        const uint64_t hash = PhyreManifest::hash(dds);
+        _outputCount++;
+
+        auto found = _objects.find(hash);
+        bool stored = found != _objects.end();
+        if (!stored)
+        {
+            _tObject object{ hash, dds.size(), _objectPath(hash), {} };
+            if (fs::exists(object.path, error))
+            {
+                stored = true;
+            }
+            else
+            {
+                fs::create_directories(object.path.parent_path(), error);
+                if (error)
+                    throw PhyreExceptionIO(L"Cannot create store directory: " + object.path.parent_path().wstring());
+                _writeFile(object.path, dds);
+                _storedCount++;
+            }
+            found = _objects.emplace(hash, std::move(object)).first;
+        }
+
+        // 64 bits make a collision unlikely, not impossible. A stored file that no longer has its hash was damaged and is replaced.
+        _tObject& object = found->second;
+        if (stored && !_matches(object.path, dds))
+        {
+            if (_isIntact(object.path, hash))
+            {
+                _writeFile(outputPath, dds);
+                _relink(output, nullptr);
+                return linkCopy;
+            }
+            _writeFile(object.path, dds);
+            _storedCount++;
+            stored = false;
+        }
+
+        const _eLink ret = _link(object.path, dds, outputPath);
+        if (stored && ret != linkCopy)
+            _savedBytes += dds.size();
+        _relink(output, &object);
+        return ret;
+    }
+
+    std::vector<const PhyreStore::_tObject*> PhyreStore::duplicates() const
+    {
+        std::vector<const _tObject*> ret;
+        for (const auto& object : _objects)
+        {
+            if (object.second.outputs.size() > 1)
+                ret.push_back(&object.second);
+        }
+        return ret;
+    }
+
+    void PhyreStore::writeReport(std::ostream& out) const
+    {
+        out << "hash,size,copies,stored,output\n";
+        for (const _tObject* object : duplicates())
+        {
+            std::vector<fs::path> outputs = object->outputs;
+            std::sort(outputs.begin(), outputs.end());
+            for (const auto& output : outputs)
+            {
+                out << hexHash(object->hash) << ',' << object->size << ',' << outputs.size() << ','
+                    << PhyreCatalog::csvField(object->path.u8string()) << ',' << PhyreCatalog::csvField(output.u8string()) << '\n';
+            }
+        }
+    }
+
+    void PhyreStore::save()
+    {
+        if (!_changed)
+            return;
+
+        std::string text = LINKS_SIGNATURE;
+        text += '\n';
+        for (const auto& link : _links)
+        {
+            const std::string path = link.first.u8string();
+            if (path.find('\n') != std::string::npos)
+                continue;
+            char fields[48];
+            std::snprintf(fields, sizeof(fields), "%016" PRIx64 "\t%" PRIu64 "\t", link.second, _objects.at(link.second).size);
+            text += fields;
+            text += path;
+            text += '\n';
+        }
+
+        PhyreTempFile file(_root / "links");
+        file.write(PhyreView(text.data(), text.size()), 0);
+        file.commit();
+        _changed = false;
+    }
+
+    void PhyreStore::_load()
+    {
+        std::ifstream in(_root / "links", std::ios::binary);
+        std::string line;
+        if (!in || !std::getline(in, line) || line != LINKS_SIGNATURE)
+            return;
+
+        // Outputs that were removed since are dropped, which the links file has to be saved for.
+        bool dropped = false;
+        while (std::getline(in, line))
+        {
+            // hash and size are tab separated, the output is the rest of the line.
+            const char* fields[3] = { line.c_str() };
+            for (int i = 1; i < 3; i++)
+            {
+                const char* tab = std::strchr(fields[i - 1], '\t');
+                if (!tab)
+                    break;
+                fields[i] = tab + 1;
+            }
+            if (!fields[2])
+            {
+                dropped = true;
+                break;
+            }
+
+            const fs::path output = fs::u8path(fields[2]);
+            std::error_code error;
+            if (!fs::exists(output, error))
+            {
+                dropped = true;
+                continue;
+            }
+            const uint64_t hash = std::strtoull(fields[0], nullptr, 16);
+            const uint64_t size = std::strtoull(fields[1], nullptr, 10);
+            auto found = _objects.emplace(hash, _tObject{ hash, size, _objectPath(hash), {} }).first;
+            _relink(output, &found->second);
+        }
+        _changed = dropped;
+    }
+
+    void PhyreStore::_relink(const fs::path& output, _tObject* object)
+    {
+        const auto found = _links.find(output);
+        const bool linked = found != _links.end();
+        if (linked)
+        {
+            if (object && found->second == object->hash)
+                return;
+            auto& outputs = _objects.at(found->second).outputs;
+            outputs.erase(std::remove(outputs.begin(), outputs.end(), output), outputs.end());
+            _links.erase(found);
+        }
+        if (object)
+        {
+            object->outputs.push_back(output);
+            _links.emplace(output, object->hash);
+        }
+        _changed = _changed || linked || object;
+    }
+
+    fs::path PhyreStore::_objectPath(uint64_t hash) const
+    {
+        const std::string name = hexHash(hash);
+        return _root / name.substr(0, 2) / (name + ".dds");
+    }
+
+    bool PhyreStore::_matches(const fs::path& path, const PhyreView& dds)
+    {
+        try
+        {
+            const PhyreMappedFile stored(path);
+            PhyreStats::addRead(PhyreStats::stageRead, stored.size(), 0);
+            return stored.size() == dds.size() && std::memcmp(stored.view().data(), dds.data(), dds.size()) == 0;
+        }
+        catch (PhyreException&)
+        {
+            return false;
+        }
+    }
+
+    bool PhyreStore::_isIntact(const fs::path& path, uint64_t hash)
+    {
+        try
+        {
+            return PhyreManifest::hashFile(path) == hash;
+        }
+        catch (PhyreException&)
+        {
+            return false;
+        }
+    }
+
+    void PhyreStore::_writeFile(const fs::path& path, const PhyreView& data)
+    {
+        PhyreTempFile file(path);
+        file.write(data, 0);
+        file.commit();
+    }
+
+    PhyreStore::_eLink PhyreStore::_link(const fs::path& objectPath, const PhyreView& dds, const fs::path& outputPath)
+    {
+        // An output linked by an earlier run is left as it is.
+        std::error_code error;
+        if (fs::equivalent(objectPath, outputPath, error))
+            return linkHard;
+
+        {
+            PhyreTempFile output(outputPath);
+            if (output.cloneFrom(objectPath))
+            {
+                output.commit();
+                return linkClone;
+            }
+        }
+
+        // Linked under another name first, the rename then replaces the output in one step.
+        fs::path linkPath = outputPath;
+        linkPath += L".link";
+        {
+            PhyreStats::Timer timer(PhyreStats::stageWrite);
+            fs::remove(linkPath, error);
+            fs::create_hard_link(objectPath, linkPath, error);
+            if (!error)
+            {
+                fs::rename(linkPath, outputPath, error);
+                if (!error)
+                    return linkHard;
+                fs::remove(linkPath, error);
+            }
+        }
+
+        _writeFile(outputPath, dds);
+        return linkCopy;
+    }
+}
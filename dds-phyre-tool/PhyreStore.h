@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "PhyreView.h"
+
+namespace phyre
+{
+    /*
+    * Content addressed store for converted DDS files. A DDS is keyed by
+    * the hash of all of its bytes, the header carries format, size and
+    * mip count along with the payload, and is kept once as
+    * <root>/<first two digits>/<hash>.dds. Outputs become clones of the
+    * stored file where the filesystem shares extents, hard links where
+    * it doesn't, and copies only where neither works, across volumes for
+    * one. A hash match is confirmed byte by byte before it is linked, a
+    * DDS that only shares the hash is written as a file of its own and
+    * a stored file that was changed since is stored again.
+    *
+    * Which output refers to which stored file is kept in <root>/links
+    * with absolute paths, so the duplicate report covers every run that
+    * used the store and not only the current one. Outputs that are gone
+    * are dropped from it when the store is opened.
+    * Outputs are added one at a time, the store is not thread safe.
+    */
+    class PhyreStore
+    {
+    public:
+        enum _eLink
+        {
+            linkClone,
+            linkHard,
+            linkCopy,
+        };
+
+        struct _tObject
+        {
+            uint64_t hash;
+            uint64_t size;
+            std::filesystem::path path;
+            // Absolute paths of the outputs linked to it, by this run or earlier ones.
+            std::vector<std::filesystem::path> outputs;
+        };
+
+        PhyreStore() = delete;
+        // Creates root if it doesn't exist, files and links of earlier runs are reused.
+        PhyreStore(const std::filesystem::path& root);
+
+        // Stores dds unless the store holds it already and makes outputPath refer to the stored file.
+        _eLink add(const PhyreView& dds, const std::filesystem::path& outputPath);
+
+        const std::filesystem::path& root() const { return _root; }
+        size_t outputCount() const { return _outputCount; }
+        // Files written to the store.
+        size_t storedCount() const { return _storedCount; }
+        // Bytes of outputs linked to a file the store already held instead of being written.
+        uint64_t savedBytes() const { return _savedBytes; }
+
+        // Stored files more than one output is linked to, by hash.
+        std::vector<const _tObject*> duplicates() const;
+        // Whether links changed since the store was opened.
+        bool isChanged() const { return _changed; }
+
+        // Replaces the links file when links changed, the old one stays intact if this fails.
+        void save();
+
+        /*
+        * Header line, then one line per output of every duplicate: hash,
+        * size, outputs of the hash, stored file and output. Duplicates
+        * are sorted by hash, their outputs by path.
+        */
+        void writeReport(std::ostream& out) const;
+
+    protected:
+        void _load();
+        // Links output to object, nullptr only drops the link it had.
+        void _relink(const std::filesystem::path& output, _tObject* object);
+        std::filesystem::path _objectPath(uint64_t hash) const;
+        // Whether the file at path holds exactly dds.
+        static bool _matches(const std::filesystem::path& path, const PhyreView& dds);
+        // Whether the file at path still has the hash it is stored under.
+        static bool _isIntact(const std::filesystem::path& path, uint64_t hash);
+        // Writes a new file and renames it over path, links to the old one keep their data.
+        static void _writeFile(const std::filesystem::path& path, const PhyreView& data);
+        static _eLink _link(const std::filesystem::path& objectPath, const PhyreView& dds, const std::filesystem::path& outputPath);
+
+        std::filesystem::path _root;
+        std::map<uint64_t, _tObject> _objects;
+        // Hash each output is linked to.
+        std::map<std::filesystem::path, uint64_t> _links;
+        bool _changed = false;
+        size_t _outputCount = 0;
+        size_t _storedCount = 0;
+        uint64_t _savedBytes = 0;
+    };
+}
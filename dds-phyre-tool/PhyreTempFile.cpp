@@ -0,0 +1,205 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <random>
+#include <string>
+
+#include "PhyreTempFile.h"
+#include "PhyreStats.h"
+
+namespace phyre
+{
+    PhyreTempFile::PhyreTempFile(const std::filesystem::path& target)
+        : _target(target)
+    {
+        PhyreStats::Timer timer(PhyreStats::stageOpen);
+        PhyreStats::addWritten(PhyreStats::stageOpen, 0);
+        std::random_device random;
+
+        // The name only has to be unique in the target directory, creation fails on a clash.
+        for (int attempt = 0; attempt < 16; attempt++)
+        {
+            _path = target;
+            _path += L".tmp" + std::to_wstring(random() & 0xFFFFFF);
+#ifdef _WIN32
+            HANDLE fileHandle = CreateFileW(_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (fileHandle != INVALID_HANDLE_VALUE)
+            {
+                _fileHandle = fileHandle;
+                return;
+            }
+            if (GetLastError() != ERROR_FILE_EXISTS)
+                break;
+#else
+            _fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (_fd >= 0)
+            {
+                // The replacement keeps the permissions of the file it replaces.
+                struct stat targetStat {};
+                if (::stat(target.c_str(), &targetStat) == 0)
+                    (void)::fchmod(_fd, targetStat.st_mode & 07777);
+                return;
+            }
+            if (errno != EEXIST)
+                break;
+#endif
+        }
+        throw PhyreExceptionIO(L"Cannot create temporary file next to: " + target.wstring());
+    }
+
+    PhyreTempFile::~PhyreTempFile()
+    {
+        _close();
+        if (!_committed)
+        {
+            std::error_code error;
+            std::filesystem::remove(_path, error);
+        }
+    }
+
+    bool PhyreTempFile::cloneFrom(const std::filesystem::path& source)
+    {
+#ifdef __linux__
+        PhyreStats::Timer timer(PhyreStats::stageWrite);
+        const int sourceFd = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        if (sourceFd < 0)
+            return false;
+
+        // A clone shares every extent, the regions written later are the only new blocks.
+        const bool cloned = ::ioctl(_fd, FICLONE, sourceFd) == 0;
+        ::close(sourceFd);
+        if (cloned)
+            PhyreStats::addWritten(PhyreStats::stageWrite, 0);
+        return cloned;
+#else
+        (void)source;
+        return false;
+#endif
+    }
+
+    void PhyreTempFile::copyFrom(const std::filesystem::path& source, const PhyreView& sourceData, size_t length)
+    {
+        if (length > sourceData.size())
+            throw PhyreExceptionData(L"Copy past the end of the source file");
+        if (cloneFrom(source))
+            return;
+
+        PhyreStats::Timer timer(PhyreStats::stageWrite);
+        size_t copied = 0;
+#ifdef __linux__
+        const int sourceFd = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        if (sourceFd >= 0)
+        {
+            loff_t sourceOffset = 0;
+            loff_t targetOffset = 0;
+            while (copied < length)
+            {
+                const ssize_t count = ::copy_file_range(sourceFd, &sourceOffset, _fd, &targetOffset, length - copied, 0);
+                if (count <= 0)
+                    break;
+                copied += static_cast<size_t>(count);
+                PhyreStats::addWritten(PhyreStats::stageWrite, static_cast<uint64_t>(count));
+            }
+            ::close(sourceFd);
+        }
+#else
+        (void)source;
+#endif
+        _write(sourceData.data() + copied, length - copied, copied);
+    }
+
+    void PhyreTempFile::write(const PhyreView& data, size_t offset)
+    {
+        _write(data.data(), data.size(), offset);
+    }
+
+    void PhyreTempFile::resize(size_t size)
+    {
+        PhyreStats::Timer timer(PhyreStats::stageWrite);
+        std::filesystem::resize_file(_path, size);
+    }
+
+    void PhyreTempFile::commit()
+    {
+        PhyreStats::Timer timer(PhyreStats::stageWrite);
+#ifdef _WIN32
+        if (!FlushFileBuffers(_fileHandle))
+            throw PhyreExceptionIO(L"Cannot flush file: " + _path.wstring());
+#else
+        if (::fsync(_fd) != 0)
+            throw PhyreExceptionIO(L"Cannot flush file: " + _path.wstring());
+#endif
+        _close();
+
+        std::error_code error;
+        std::filesystem::rename(_path, _target, error);
+        if (error)
+            throw PhyreExceptionIO(L"Cannot replace file: " + _target.wstring());
+        _committed = true;
+
+#ifndef _WIN32
+        // The rename itself only survives a crash once the directory is flushed too.
+        const std::filesystem::path directory = _target.has_parent_path() ? _target.parent_path() : std::filesystem::path(".");
+        const int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directoryFd >= 0)
+        {
+            (void)::fsync(directoryFd);
+            ::close(directoryFd);
+        }
+#endif
+    }
+
+    void PhyreTempFile::_close()
+    {
+#ifdef _WIN32
+        if (_fileHandle)
+            CloseHandle(_fileHandle);
+        _fileHandle = nullptr;
+#else
+        if (_fd >= 0)
+            ::close(_fd);
+        _fd = -1;
+#endif
+    }
+
+    void PhyreTempFile::_write(const char* data, size_t size, size_t offset)
+    {
+        PhyreStats::Timer timer(PhyreStats::stageWrite);
+        while (size > 0)
+        {
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(offset) >> 32);
+            DWORD written = 0;
+            const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+            if (!WriteFile(_fileHandle, data, chunk, &written, &overlapped) || written == 0)
+                throw PhyreExceptionIO(L"Cannot write file: " + _path.wstring());
+#else
+            const ssize_t written = ::pwrite(_fd, data, size, static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                throw PhyreExceptionIO(L"Cannot write file: " + _path.wstring());
+#endif
+            PhyreStats::addWritten(PhyreStats::stageWrite, static_cast<uint64_t>(written));
+            data += written;
+            size -= static_cast<size_t>(written);
+            offset += static_cast<size_t>(written);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+#include "PhyreView.h"
+
+namespace phyre
+{
+    /*
+    * Temporary file next to a target that replaces the target only once
+    * it is complete. The output is flushed to disk and renamed over the
+    * target, so a crash leaves either the old or the new file, never a
+    * half written one. An uncommitted file is removed again.
+    */
+    class PhyreTempFile
+    {
+    public:
+        PhyreTempFile() = delete;
+        PhyreTempFile(const std::filesystem::path& target);
+        PhyreTempFile(const PhyreTempFile&) = delete;
+        PhyreTempFile& operator=(const PhyreTempFile&) = delete;
+        virtual ~PhyreTempFile();
+
+        const std::filesystem::path& path() const { return _path; }
+
+        /*
+        * Fills the file with at least the first length bytes of source.
+        * Where the filesystem can share extents the whole source is
+        * cloned without copying, otherwise the kernel copies the range,
+        * and only as a last resort it is written from sourceData.
+        */
+        void copyFrom(const std::filesystem::path& source, const PhyreView& sourceData, size_t length);
+        // Shares every extent of source, false where the filesystem can't and nothing was done.
+        bool cloneFrom(const std::filesystem::path& source);
+
+        void write(const PhyreView& data, size_t offset);
+        void resize(size_t size);
+
+        // Flushes the file to disk and renames it over the target.
+        void commit();
+
+    private:
+        void _close();
+        void _write(const char* data, size_t size, size_t offset);
+
+        std::filesystem::path _target;
+        std::filesystem::path _path;
+        bool _committed = false;
+#ifdef _WIN32
+        void* _fileHandle = nullptr;
+#else
+        int _fd = -1;
+#endif
+    };
+}
@@ -0,0 +1,459 @@
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PHYRE_DECODE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "PhyreTextureDecoder.h"
+#include "PhyreBC7.h"
+#include "PhyreException.h"
+#include "PhyreParallel.h"
+#include "PhyreRowKernels.h"
+
+namespace phyre
+{
+    namespace
+    {
+        // Rows a thread takes at a time, in blocks for block formats.
+        constexpr uint32_t BLOCK_ROWS_PER_RUN = 16;
+        constexpr uint32_t ROWS_PER_RUN = 64;
+
+        uint16_t readWord(const uint8_t* src)
+        {
+            return static_cast<uint16_t>(src[0] | (src[1] << 8));
+        }
+
+        uint8_t expand(uint32_t value, uint32_t bits)
+        {
+            return static_cast<uint8_t>((value << (8 - bits)) | (value >> (2 * bits - 8)));
+        }
+
+        uint8_t narrow(uint16_t value)
+        {
+            return static_cast<uint8_t>((value * 255u + 32767u) / 65535u);
+        }
+
+#ifdef PHYRE_DECODE_SSE2
+        /*
+        * Each row of indices is spread over four lanes, one per pixel.
+        * Multiplying by 64, 16, 4 and 1 lines the two bits of every pixel
+        * up for a single shift, the palette entry is then selected by
+        * comparing the lanes against each index.
+        */
+        void expandColor(const uint8_t (*palette)[4], uint32_t indices, uint8_t* rgba)
+        {
+            const __m128i scale = _mm_setr_epi32(64, 16, 4, 1);
+            const __m128i mask = _mm_set1_epi32(3);
+            __m128i entries[4];
+            for (uint32_t k = 0; k < 4; k++)
+            {
+                int32_t entry;
+                std::memcpy(&entry, palette[k], sizeof(entry));
+                entries[k] = _mm_set1_epi32(entry);
+            }
+
+            for (uint32_t r = 0; r < 4; r++)
+            {
+                const __m128i row = _mm_set1_epi32(static_cast<int>((indices >> (r * 8)) & 0xFF));
+                const __m128i lanes = _mm_and_si128(_mm_srli_epi32(_mm_mullo_epi16(row, scale), 6), mask);
+                __m128i pixels = _mm_setzero_si128();
+                for (uint32_t k = 0; k < 4; k++)
+                    pixels = _mm_or_si128(pixels, _mm_and_si128(_mm_cmpeq_epi32(lanes, _mm_set1_epi32(static_cast<int>(k))), entries[k]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + r * 16), pixels);
+            }
+        }
+#else
+        void expandColor(const uint8_t (*palette)[4], uint32_t indices, uint8_t* rgba)
+        {
+            for (uint32_t i = 0; i < 16; i++)
+                std::memcpy(rgba + i * 4, palette[(indices >> (i * 2)) & 3], 4);
+        }
+#endif
+
+        void decodeColor(const uint8_t* src, uint8_t* rgba, bool threeColor)
+        {
+            uint8_t palette[4][4];
+            PhyreTextureDecoder::paletteBC1(readWord(src), readWord(src + 2), threeColor, palette);
+            uint32_t indices;
+            std::memcpy(&indices, src + 4, sizeof(indices));
+            expandColor(palette, indices, rgba);
+        }
+
+        void expandChannel(const uint8_t* src, const uint8_t* palette, uint8_t* rgba, uint32_t channel)
+        {
+            uint64_t indices = 0;
+            for (uint32_t b = 0; b < 6; b++)
+                indices |= static_cast<uint64_t>(src[2 + b]) << (b * 8);
+            for (uint32_t i = 0; i < 16; i++)
+                rgba[i * 4 + channel] = palette[(indices >> (i * 3)) & 7];
+        }
+
+        // BC3 alpha and BC4 blocks, the values go to one channel of every pixel.
+        void decodeChannel(const uint8_t* src, uint8_t* rgba, uint32_t channel)
+        {
+            uint8_t palette[8];
+            PhyreTextureDecoder::paletteAlpha(src[0], src[1], palette);
+            expandChannel(src, palette, rgba, channel);
+        }
+
+        // Signed BC4 blocks, -1 to 1 comes out as 0 to 255. -128 reads as -127, both are -1.
+        void decodeChannelSigned(const uint8_t* src, uint8_t* rgba, uint32_t channel)
+        {
+            const int32_t alpha0 = std::max<int32_t>(static_cast<int8_t>(src[0]), -127);
+            const int32_t alpha1 = std::max<int32_t>(static_cast<int8_t>(src[1]), -127);
+            float values[8] = { static_cast<float>(alpha0), static_cast<float>(alpha1) };
+            if (alpha0 > alpha1)
+            {
+                for (int32_t k = 1; k <= 6; k++)
+                    values[k + 1] = ((7 - k) * alpha0 + k * alpha1) / 7.0f;
+            }
+            else
+            {
+                for (int32_t k = 1; k <= 4; k++)
+                    values[k + 1] = ((5 - k) * alpha0 + k * alpha1) / 5.0f;
+                values[6] = -127.0f;
+                values[7] = 127.0f;
+            }
+
+            uint8_t palette[8];
+            for (uint32_t k = 0; k < 8; k++)
+                palette[k] = static_cast<uint8_t>((values[k] + 127.0f) * 255.0f / 254.0f + 0.5f);
+            expandChannel(src, palette, rgba, channel);
+        }
+
+        void decodeBlock(PhyreTextureFormat::_eFormat format, const uint8_t* src, uint8_t* rgba)
+        {
+            switch (format)
+            {
+            case PhyreTextureFormat::formatDXT1:
+            case PhyreTextureFormat::formatDXT1_SRGB:
+                PhyreTextureDecoder::decodeBlockBC1(src, rgba);
+                break;
+            case PhyreTextureFormat::formatDXT3:
+            case PhyreTextureFormat::formatDXT3_SRGB:
+                PhyreTextureDecoder::decodeBlockBC2(src, rgba);
+                break;
+            case PhyreTextureFormat::formatDXT5:
+            case PhyreTextureFormat::formatDXT5_SRGB:
+                PhyreTextureDecoder::decodeBlockBC3(src, rgba);
+                break;
+            case PhyreTextureFormat::formatBC4:
+                PhyreTextureDecoder::decodeBlockBC4(src, rgba, 0);
+                break;
+            case PhyreTextureFormat::formatBC5:
+                PhyreTextureDecoder::decodeBlockBC5(src, rgba);
+                break;
+            case PhyreTextureFormat::formatBC4S:
+                PhyreTextureDecoder::decodeBlockBC4S(src, rgba, 0);
+                break;
+            case PhyreTextureFormat::formatBC5S:
+                PhyreTextureDecoder::decodeBlockBC5S(src, rgba);
+                break;
+            default:
+                PhyreBC7::decodeBlock(src, rgba);
+                break;
+            }
+        }
+
+        // One row of pixels, 16 bit words are in native order by now.
+        void decodeRow(PhyreTextureFormat::_eFormat format, const uint8_t* src, uint8_t* dst, uint32_t width)
+        {
+            switch (format)
+            {
+            case PhyreTextureFormat::formatRGBA8:
+            case PhyreTextureFormat::formatRGBA8_SRGB:
+                PhyreRowKernels::copyRow(reinterpret_cast<char*>(dst), reinterpret_cast<const char*>(src), width * 4u, false);
+                return;
+            case PhyreTextureFormat::formatARGB8:
+            case PhyreTextureFormat::formatARGB8_SRGB:
+                PhyreRowKernels::copyRow(reinterpret_cast<char*>(dst), reinterpret_cast<const char*>(src), width * 4u, true);
+                return;
+            case PhyreTextureFormat::formatXRGB8:
+                PhyreRowKernels::copyRow(reinterpret_cast<char*>(dst), reinterpret_cast<const char*>(src), width * 4u, true);
+                for (uint32_t x = 0; x < width; x++)
+                    dst[x * 4 + 3] = 255;
+                return;
+            default:
+                break;
+            }
+
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint8_t* pixel = dst + x * 4;
+                switch (format)
+                {
+                case PhyreTextureFormat::formatA8:
+                    pixel[0] = pixel[1] = pixel[2] = 0;
+                    pixel[3] = src[x];
+                    break;
+                case PhyreTextureFormat::formatL8:
+                    pixel[0] = pixel[1] = pixel[2] = src[x];
+                    pixel[3] = 255;
+                    break;
+                case PhyreTextureFormat::formatLA8:
+                    pixel[0] = pixel[1] = pixel[2] = src[x * 2];
+                    pixel[3] = src[x * 2 + 1];
+                    break;
+                case PhyreTextureFormat::formatRG8:
+                    pixel[0] = src[x * 2];
+                    pixel[1] = src[x * 2 + 1];
+                    pixel[2] = 0;
+                    pixel[3] = 255;
+                    break;
+                case PhyreTextureFormat::formatL16:
+                    pixel[0] = pixel[1] = pixel[2] = narrow(readWord(src + x * 2));
+                    pixel[3] = 255;
+                    break;
+                case PhyreTextureFormat::formatRG16:
+                    pixel[0] = narrow(readWord(src + x * 4));
+                    pixel[1] = narrow(readWord(src + x * 4 + 2));
+                    pixel[2] = 0;
+                    pixel[3] = 255;
+                    break;
+                case PhyreTextureFormat::formatRGBA16:
+                    for (uint32_t c = 0; c < 4; c++)
+                        pixel[c] = narrow(readWord(src + x * 8 + c * 2));
+                    break;
+                case PhyreTextureFormat::formatRGB565:
+                {
+                    const uint16_t word = readWord(src + x * 2);
+                    pixel[0] = expand(word >> 11, 5);
+                    pixel[1] = expand((word >> 5) & 63, 6);
+                    pixel[2] = expand(word & 31, 5);
+                    pixel[3] = 255;
+                    break;
+                }
+                case PhyreTextureFormat::formatARGB1555:
+                {
+                    const uint16_t word = readWord(src + x * 2);
+                    pixel[0] = expand((word >> 10) & 31, 5);
+                    pixel[1] = expand((word >> 5) & 31, 5);
+                    pixel[2] = expand(word & 31, 5);
+                    pixel[3] = (word & 0x8000) ? 255 : 0;
+                    break;
+                }
+                default:
+                {
+                    const uint16_t word = readWord(src + x * 2);
+                    pixel[0] = static_cast<uint8_t>(((word >> 8) & 15) * 17);
+                    pixel[1] = static_cast<uint8_t>(((word >> 4) & 15) * 17);
+                    pixel[2] = static_cast<uint8_t>((word & 15) * 17);
+                    pixel[3] = static_cast<uint8_t>((word >> 12) * 17);
+                    break;
+                }
+                }
+            }
+        }
+    }
+
+    PhyreTextureDecoder::PhyreTextureDecoder(unsigned threads)
+        : _threads(threads ? threads : PhyreParallel::defaultThreads())
+    {
+    }
+
+    bool PhyreTextureDecoder::canDecode(PhyreTextureFormat::_eFormat format)
+    {
+        switch (format)
+        {
+        case PhyreTextureFormat::formatDXT1:
+        case PhyreTextureFormat::formatDXT1_SRGB:
+        case PhyreTextureFormat::formatDXT3:
+        case PhyreTextureFormat::formatDXT3_SRGB:
+        case PhyreTextureFormat::formatDXT5:
+        case PhyreTextureFormat::formatDXT5_SRGB:
+        case PhyreTextureFormat::formatBC4:
+        case PhyreTextureFormat::formatBC4S:
+        case PhyreTextureFormat::formatBC5:
+        case PhyreTextureFormat::formatBC5S:
+        case PhyreTextureFormat::formatBC7:
+        case PhyreTextureFormat::formatBC7_SRGB:
+        case PhyreTextureFormat::formatARGB8:
+        case PhyreTextureFormat::formatARGB8_SRGB:
+        case PhyreTextureFormat::formatXRGB8:
+        case PhyreTextureFormat::formatRGBA8:
+        case PhyreTextureFormat::formatRGBA8_SRGB:
+        case PhyreTextureFormat::formatRGB565:
+        case PhyreTextureFormat::formatARGB1555:
+        case PhyreTextureFormat::formatARGB4444:
+        case PhyreTextureFormat::formatA8:
+        case PhyreTextureFormat::formatL8:
+        case PhyreTextureFormat::formatRG8:
+        case PhyreTextureFormat::formatLA8:
+        case PhyreTextureFormat::formatL16:
+        case PhyreTextureFormat::formatRG16:
+        case PhyreTextureFormat::formatRGBA16:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    PhyreTextureDecoder::_tImage PhyreTextureDecoder::decodeSurface(const char* data, size_t size, PhyreTextureFormat::_eFormat format,
+        uint32_t width, uint32_t height, bool bigEndian, bool flip, bool pixelExact) const
+    {
+        const PhyreTextureFormat::_tTraits& traits = PhyreTextureFormat::traits(format);
+        if (!canDecode(format))
+            throw PhyreException(L"No decoder for " + std::wstring(traits.name, traits.name + std::strlen(traits.name)));
+        if (size < PhyreTextureFormat::surfaceSize(format, width, height))
+            throw PhyreExceptionData(L"Texture data is shorter than its surface");
+
+        _tImage ret{ width, height, PhyreArena::local().acquire(static_cast<size_t>(width) * height * 4) };
+        uint8_t* const target = reinterpret_cast<uint8_t*>(ret.rgba.data());
+        const uint8_t* const source = reinterpret_cast<const uint8_t*>(data);
+        const size_t targetPitch = static_cast<size_t>(width) * 4;
+
+        if (PhyreTextureFormat::isBlockCompressed(format))
+        {
+            const uint32_t blocksWide = (width + 3) / 4;
+            const uint32_t blocksHigh = (height + 3) / 4;
+            // Flipped surfaces have their block rows in reverse and the rows inside each reversed, padding included, like
+            // PhyreTextureFlip does. Row y of a pixel exact one is row height - 1 - y of the image, with the padding below it.
+            const uint32_t blockRows = std::min(height, 4u);
+            // BC4 and BC5 leave the channels they don't hold alone.
+            const uint8_t fill[4] = { 0, 0, 0, 255 };
+            PhyreParallel::forEach((blocksHigh + BLOCK_ROWS_PER_RUN - 1) / BLOCK_ROWS_PER_RUN, _threads, [&](size_t run)
+            {
+                uint8_t rgba[64];
+                const uint32_t last = std::min(blocksHigh, static_cast<uint32_t>(run + 1) * BLOCK_ROWS_PER_RUN);
+                for (uint32_t blockY = static_cast<uint32_t>(run) * BLOCK_ROWS_PER_RUN; blockY < last; blockY++)
+                {
+                    const uint8_t* block = source + static_cast<size_t>(blockY) * blocksWide * traits.unitSize;
+                    for (uint32_t blockX = 0; blockX < blocksWide; blockX++, block += traits.unitSize)
+                    {
+                        for (uint32_t i = 0; i < 16; i++)
+                            std::memcpy(rgba + i * 4, fill, 4);
+                        decodeBlock(format, block, rgba);
+
+                        const size_t columns = std::min(4u, width - blockX * 4);
+                        for (uint32_t r = 0; r < 4; r++)
+                        {
+                            uint32_t y = blockY * 4 + r;
+                            if (flip && pixelExact)
+                                y = y < height ? height - 1 - y : height;
+                            else if (flip)
+                                y = (blocksHigh - 1 - blockY) * 4 + (r < blockRows ? blockRows - 1 - r : r);
+                            if (y < height)
+                                std::memcpy(target + y * targetPitch + blockX * 16, rgba + r * 16, columns * 4);
+                        }
+                    }
+                }
+            });
+            return ret;
+        }
+
+        const size_t sourcePitch = static_cast<size_t>(width) * traits.unitSize;
+        const uint32_t wordSize = PhyreTextureFormat::wordSize(format);
+        const auto targetRow = [&](uint32_t y) { return target + (flip ? height - 1 - y : y) * targetPitch; };
+        PhyreParallel::forEach((height + ROWS_PER_RUN - 1) / ROWS_PER_RUN, _threads, [&](size_t run)
+        {
+            // Big endian rows are swapped into scratch memory first, the mapped source stays untouched.
+            PhyreArena::Buffer scratch;
+            if (bigEndian && wordSize > 1)
+                scratch = PhyreArena::local().acquire(sourcePitch);
+
+            const uint32_t last = std::min(height, static_cast<uint32_t>(run + 1) * ROWS_PER_RUN);
+            for (uint32_t y = static_cast<uint32_t>(run) * ROWS_PER_RUN; y < last; y++)
+            {
+                const uint8_t* row = source + y * sourcePitch;
+                if (!scratch.empty())
+                {
+                    std::memcpy(scratch.data(), row, sourcePitch);
+                    PhyreRowKernels::swapBytes(scratch.data(), sourcePitch, wordSize);
+                    row = reinterpret_cast<const uint8_t*>(scratch.data());
+                }
+                decodeRow(format, row, targetRow(y), width);
+            }
+        });
+        return ret;
+    }
+
+    void PhyreTextureDecoder::decodeBlockBC1(const uint8_t* src, uint8_t* rgba)
+    {
+        decodeColor(src, rgba, true);
+    }
+
+    void PhyreTextureDecoder::decodeBlockBC2(const uint8_t* src, uint8_t* rgba)
+    {
+        decodeColor(src + 8, rgba, false);
+        for (uint32_t i = 0; i < 16; i++)
+            rgba[i * 4 + 3] = static_cast<uint8_t>(((src[i / 2] >> ((i & 1) * 4)) & 15) * 17);
+    }
+
+    void PhyreTextureDecoder::decodeBlockBC3(const uint8_t* src, uint8_t* rgba)
+    {
+        decodeColor(src + 8, rgba, false);
+        decodeChannel(src, rgba, 3);
+    }
+
+    void PhyreTextureDecoder::decodeBlockBC4(const uint8_t* src, uint8_t* rgba, uint32_t channel)
+    {
+        decodeChannel(src, rgba, channel);
+    }
+
+    void PhyreTextureDecoder::decodeBlockBC5(const uint8_t* src, uint8_t* rgba)
+    {
+        decodeChannel(src, rgba, 0);
+        decodeChannel(src + 8, rgba, 1);
+    }
+
+    void PhyreTextureDecoder::decodeBlockBC4S(const uint8_t* src, uint8_t* rgba, uint32_t channel)
+    {
+        decodeChannelSigned(src, rgba, channel);
+    }
+
+    void PhyreTextureDecoder::decodeBlockBC5S(const uint8_t* src, uint8_t* rgba)
+    {
+        decodeChannelSigned(src, rgba, 0);
+        decodeChannelSigned(src + 8, rgba, 1);
+    }
+
+    void PhyreTextureDecoder::paletteBC1(uint16_t color0, uint16_t color1, bool threeColor, uint8_t (*palette)[4])
+    {
+        const uint16_t colors[2] = { color0, color1 };
+        for (uint32_t e = 0; e < 2; e++)
+        {
+            palette[e][0] = expand(colors[e] >> 11, 5);
+            palette[e][1] = expand((colors[e] >> 5) & 63, 6);
+            palette[e][2] = expand(colors[e] & 31, 5);
+            palette[e][3] = 255;
+        }
+
+        const bool transparent = threeColor && color0 <= color1;
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            const uint32_t a = palette[0][c], b = palette[1][c];
+            if (!transparent)
+            {
+                palette[2][c] = static_cast<uint8_t>((2 * a + b + 1) / 3);
+                palette[3][c] = static_cast<uint8_t>((a + 2 * b + 1) / 3);
+            }
+            else
+            {
+                palette[2][c] = static_cast<uint8_t>((a + b + 1) / 2);
+                palette[3][c] = 0;
+            }
+        }
+        palette[2][3] = 255;
+        palette[3][3] = transparent ? 0 : 255;
+    }
+
+    void PhyreTextureDecoder::paletteAlpha(uint8_t alpha0, uint8_t alpha1, uint8_t* palette)
+    {
+        palette[0] = alpha0;
+        palette[1] = alpha1;
+        if (alpha0 > alpha1)
+        {
+            for (uint32_t k = 1; k <= 6; k++)
+                palette[k + 1] = static_cast<uint8_t>(((7 - k) * alpha0 + k * alpha1 + 3) / 7);
+        }
+        else
+        {
+            for (uint32_t k = 1; k <= 4; k++)
+                palette[k + 1] = static_cast<uint8_t>(((5 - k) * alpha0 + k * alpha1 + 2) / 5);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "PhyreArena.h"
+#include "PhyreTextureFormat.h"
+
+namespace phyre
+{
+    /*
+    * Decodes surfaces to 8 bit RGBA, top row first. DXT color blocks are
+    * expanded from their palettes four pixels at a time on SSE2, 32 bit
+    * pixels go through the row kernels. A surface is cut into runs of
+    * rows that all cores work on. Channels a format lacks read as
+    * Direct3D samples them: BC4, BC5 and RG16 only fill red and green,
+    * L8, L16 and LA8 are gray. 16 bit channels are rounded to 8 bits,
+    * signed BC4 and BC5 map -1 to 1 onto 0 to 255.
+    */
+    class PhyreTextureDecoder
+    {
+    public:
+        struct _tImage
+        {
+            uint32_t width;
+            uint32_t height;
+            PhyreArena::Buffer rgba;
+        };
+
+        // threads 0 uses every core.
+        explicit PhyreTextureDecoder(unsigned threads = 0);
+
+        static bool canDecode(PhyreTextureFormat::_eFormat format);
+
+        /*
+        * Decodes one surface of data. bigEndian reads the words the way a
+        * big endian phyre stores them, flip undoes the flip of a phyre
+        * payload: rows bottom up, for BC formats whole block rows with the
+        * padding flipped along, or with pixelExact the padding rows of the
+        * last block row below the image. size has to cover the surface.
+        */
+        _tImage decodeSurface(const char* data, size_t size, PhyreTextureFormat::_eFormat format,
+            uint32_t width, uint32_t height, bool bigEndian, bool flip, bool pixelExact = false) const;
+
+        // Blocks into 16 RGBA8 pixels, row by row. BC4 and BC5 write the channels they hold and leave the rest.
+        static void decodeBlockBC1(const uint8_t* src, uint8_t* rgba);
+        static void decodeBlockBC2(const uint8_t* src, uint8_t* rgba);
+        static void decodeBlockBC3(const uint8_t* src, uint8_t* rgba);
+        static void decodeBlockBC4(const uint8_t* src, uint8_t* rgba, uint32_t channel);
+        static void decodeBlockBC5(const uint8_t* src, uint8_t* rgba);
+        // Signed blocks write -1 to 1 as 0 to 255.
+        static void decodeBlockBC4S(const uint8_t* src, uint8_t* rgba, uint32_t channel);
+        static void decodeBlockBC5S(const uint8_t* src, uint8_t* rgba);
+
+        /*
+        * Palettes as the hardware builds them. BC1 gets 4 RGBA8 entries,
+        * threeColor allows the mode with a transparent entry that DXT1
+        * picks when color0 isn't above color1. The alpha block gets 8 values.
+        */
+        static void paletteBC1(uint16_t color0, uint16_t color1, bool threeColor, uint8_t (*palette)[4]);
+        static void paletteAlpha(uint8_t alpha0, uint8_t alpha1, uint8_t* palette);
+
+    protected:
+        unsigned _threads;
+    };
+}
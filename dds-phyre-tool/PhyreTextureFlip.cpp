@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PHYRE_FLIP_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "PhyreTextureFlip.h"
+#include "PhyreArena.h"
+#include "PhyreBC6H.h"
+#include "PhyreBC7.h"
+#include "PhyreBlockEncoder.h"
+#include "PhyreParallel.h"
+#include "PhyreRowKernels.h"
+#include "PhyreException.h"
+#include "PhyreTextureDecoder.h"
+
+namespace phyre
+{
+    namespace
+    {
+        std::atomic<uint64_t> reencoded{ 0 };
+        std::atomic<uint64_t> unflipped{ 0 };
+
+        // Block rows flipSurface hands to a thread at a time.
+        constexpr size_t BLOCK_ROWS_PER_RUN = 16;
+
+        /*
+        * Every BC format stores the rows of a block as equally sized bit
+        * fields inside a 64 bit word: one byte per row for color indices,
+        * 12 bits for interpolated alpha and 16 bits for explicit alpha.
+        * Flipping a block is reversing the first rows fields of each word.
+        */
+        constexpr uint64_t fieldMask(uint32_t first, uint32_t width, uint32_t field)
+        {
+            return ((1ULL << width) - 1) << (first + field * width);
+        }
+
+        uint64_t flipFields(uint64_t value, uint32_t first, uint32_t width, uint32_t rows)
+        {
+            uint64_t ret = value;
+            for (uint32_t r = 0; r < rows; r++)
+            {
+                const uint64_t field = (value >> (first + r * width)) & ((1ULL << width) - 1);
+                const uint32_t to = first + (rows - 1 - r) * width;
+                ret = (ret & ~fieldMask(to, width, 0)) | (field << to);
+            }
+            return ret;
+        }
+
+#ifdef PHYRE_FLIP_SSE2
+        // Full four row flip of both 64 bit lanes, constant shifts only.
+        template<uint32_t first, uint32_t width>
+        __m128i flipFields4(__m128i value)
+        {
+            const uint64_t fields = fieldMask(first, width, 0) | fieldMask(first, width, 1) | fieldMask(first, width, 2) | fieldMask(first, width, 3);
+            const __m128i keep = _mm_set1_epi64x(static_cast<long long>(~fields));
+            const __m128i field0 = _mm_set1_epi64x(static_cast<long long>(fieldMask(first, width, 0)));
+            const __m128i field1 = _mm_set1_epi64x(static_cast<long long>(fieldMask(first, width, 1)));
+            const __m128i field2 = _mm_set1_epi64x(static_cast<long long>(fieldMask(first, width, 2)));
+            const __m128i field3 = _mm_set1_epi64x(static_cast<long long>(fieldMask(first, width, 3)));
+
+            __m128i ret = _mm_and_si128(value, keep);
+            ret = _mm_or_si128(ret, _mm_and_si128(_mm_srli_epi64(value, width * 3), field0));
+            ret = _mm_or_si128(ret, _mm_and_si128(_mm_srli_epi64(value, width), field1));
+            ret = _mm_or_si128(ret, _mm_and_si128(_mm_slli_epi64(value, width), field2));
+            ret = _mm_or_si128(ret, _mm_and_si128(_mm_slli_epi64(value, width * 3), field3));
+            return ret;
+        }
+#endif
+
+        /*
+        * Flips 64 bit words in place or into dst, even words have their rows at loFirst,
+        * odd ones at hiFirst. 8 byte formats use the same layout for both,
+        * so two blocks go through a vector at once.
+        */
+        template<uint32_t loFirst, uint32_t loWidth, uint32_t hiFirst, uint32_t hiWidth>
+        void flipWords(char* dst, const char* src, size_t words, uint32_t rows)
+        {
+            size_t i = 0;
+#ifdef PHYRE_FLIP_SSE2
+            if (rows == 4)
+            {
+                const __m128i loLane = _mm_set_epi32(0, 0, -1, -1);
+                for (; i + 2 <= words; i += 2)
+                {
+                    const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 8));
+                    __m128i ret = flipFields4<loFirst, loWidth>(value);
+                    if (loFirst != hiFirst || loWidth != hiWidth)
+                        ret = _mm_or_si128(_mm_and_si128(loLane, ret), _mm_andnot_si128(loLane, flipFields4<hiFirst, hiWidth>(value)));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 8), ret);
+                }
+            }
+#endif
+            for (; i < words; i++)
+            {
+                uint64_t value;
+                std::memcpy(&value, src + i * 8, sizeof(value));
+                value = (i & 1) ? flipFields(value, hiFirst, hiWidth, rows) : flipFields(value, loFirst, loWidth, rows);
+                std::memcpy(dst + i * 8, &value, sizeof(value));
+            }
+        }
+    }
+
+    PhyreTextureFlip::PhyreTextureFlip(PhyreTextureFormat::_eFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool swapRedBlue, bool swapBytes)
+    {
+        if (format == PhyreTextureFormat::formatUnknown)
+            throw PhyreException(L"Unsupported format");
+
+        const auto& traits = PhyreTextureFormat::traits(format);
+        switch (format)
+        {
+        case PhyreTextureFormat::formatDXT1:
+        case PhyreTextureFormat::formatDXT1_SRGB:
+            _kernel = kernelBC1;
+            break;
+        case PhyreTextureFormat::formatDXT3:
+        case PhyreTextureFormat::formatDXT3_SRGB:
+            _kernel = kernelBC2;
+            break;
+        case PhyreTextureFormat::formatDXT5:
+        case PhyreTextureFormat::formatDXT5_SRGB:
+            _kernel = kernelBC3;
+            break;
+        case PhyreTextureFormat::formatBC4:
+            _kernel = kernelBC4;
+            break;
+        case PhyreTextureFormat::formatBC4S:
+            _kernel = kernelBC4S;
+            break;
+        case PhyreTextureFormat::formatBC5:
+            _kernel = kernelBC5;
+            break;
+        case PhyreTextureFormat::formatBC5S:
+            _kernel = kernelBC5S;
+            break;
+        case PhyreTextureFormat::formatBC7:
+        case PhyreTextureFormat::formatBC7_SRGB:
+            _kernel = kernelBC7;
+            break;
+        case PhyreTextureFormat::formatBC6H:
+            _kernel = kernelBC6H;
+            break;
+        case PhyreTextureFormat::formatBC6HS:
+            _kernel = kernelBC6HS;
+            break;
+        default:
+            _kernel = kernelCopy;
+            break;
+        }
+        _unitSize = traits.unitSize;
+        const bool blockCompressed = PhyreTextureFormat::isBlockCompressed(format);
+
+        if (swapRedBlue && _unitSize != 4)
+            throw PhyreException(L"Red and blue can only be swapped in 32 bit formats");
+        _swapRedBlue = swapRedBlue;
+        _swapWordSize = swapBytes ? PhyreTextureFormat::wordSize(format) : 1;
+
+        for (uint32_t level = 0; level < std::max(1u, mipLevels) && level < 32; level++)
+        {
+            const uint32_t levelWidth = std::max(1u, width >> level);
+            const uint32_t levelHeight = std::max(1u, height >> level);
+
+            _tSurface surface{};
+            surface.offset = _flippedSize;
+            if (blockCompressed)
+            {
+                surface.rowPitch = static_cast<size_t>((levelWidth + traits.blockSize - 1) / traits.blockSize) * _unitSize;
+                surface.rowCount = (levelHeight + traits.blockSize - 1) / traits.blockSize;
+                surface.blockRows = std::min(levelHeight, traits.blockSize);
+                if (levelHeight > traits.blockSize && levelHeight % traits.blockSize)
+                    surface.paddingRows = traits.blockSize - levelHeight % traits.blockSize;
+            }
+            else
+            {
+                surface.rowPitch = static_cast<size_t>(levelWidth) * _unitSize;
+                surface.rowCount = levelHeight;
+                surface.blockRows = 1;
+            }
+            _surfaces.push_back(surface);
+            _flippedSize += surface.rowPitch * surface.rowCount;
+
+            // Anything the header claims past 1x1 isn't a mip level.
+            if (levelWidth == 1 && levelHeight == 1)
+                break;
+        }
+    }
+
+    void PhyreTextureFlip::setPixelExact(bool enabled, unsigned threads)
+    {
+        _pixelExact = enabled;
+        _threads = threads;
+    }
+
+    bool PhyreTextureFlip::reencodes(const _tSurface& surface) const
+    {
+        return _pixelExact && (surface.paddingRows || _kernel == kernelBC6H || _kernel == kernelBC6HS || _kernel == kernelBC7);
+    }
+
+    void PhyreTextureFlip::flipRow(char* dst, const char* rows, size_t y, size_t offset, size_t size, const _tSurface& surface) const
+    {
+        if (!_pixelExact || !surface.paddingRows)
+        {
+            _flipRow(dst, rows + (surface.rowCount - 1 - y) * surface.rowPitch + offset, size, surface);
+            return;
+        }
+
+        // Pixel row Y comes from row height - 1 - Y, the padding below the image repeats the row above it.
+        const size_t height = surface.rowCount * 4 - surface.paddingRows;
+        const char* sources[4];
+        uint32_t sourceRows[4];
+        for (uint32_t r = 0; r < 4; r++)
+        {
+            const size_t from = height - 1 - std::min(y * 4 + r, height - 1);
+            sources[r] = rows + from / 4 * surface.rowPitch + offset;
+            sourceRows[r] = static_cast<uint32_t>(from % 4);
+        }
+        _mergeRow(dst, sources, sourceRows, size / _unitSize);
+    }
+
+    void PhyreTextureFlip::_flipRow(char* dst, const char* src, size_t size, const _tSurface& surface) const
+    {
+        const size_t blocks = size / _unitSize;
+        switch (_kernel)
+        {
+        case kernelBC1: _flipBC1(dst, src, blocks, surface.blockRows); break;
+        case kernelBC2: _flipBC2(dst, src, blocks, surface.blockRows); break;
+        case kernelBC3: _flipBC3(dst, src, blocks, surface.blockRows); break;
+        case kernelBC4:
+        case kernelBC4S: _flipBC4(dst, src, blocks, surface.blockRows); break;
+        case kernelBC5:
+        case kernelBC5S: _flipBC5(dst, src, blocks, surface.blockRows); break;
+        case kernelBC6H: _flipBC6H(dst, src, blocks, surface.blockRows, false); break;
+        case kernelBC6HS: _flipBC6H(dst, src, blocks, surface.blockRows, true); break;
+        case kernelBC7: _flipBC7(dst, src, blocks, surface.blockRows); break;
+        default:
+            PhyreRowKernels::copyRow(dst, src, size, _swapRedBlue);
+            PhyreRowKernels::swapBytes(dst, size, _swapWordSize);
+            break;
+        }
+    }
+
+    void PhyreTextureFlip::flipSurface(char* dst, const char* rows, const _tSurface& surface) const
+    {
+        PhyreParallel::forEach((surface.rowCount + BLOCK_ROWS_PER_RUN - 1) / BLOCK_ROWS_PER_RUN, _threads, [&](size_t run)
+        {
+            const size_t last = std::min(surface.rowCount, (run + 1) * BLOCK_ROWS_PER_RUN);
+            for (size_t y = run * BLOCK_ROWS_PER_RUN; y < last; y++)
+                flipRow(dst + y * surface.rowPitch, rows, y, 0, surface.rowPitch, surface);
+        });
+    }
+
+    void PhyreTextureFlip::flipInPlace(char* data, size_t size) const
+    {
+        // Block rows are exchanged through a small buffer, a multiple of every block size.
+        char scratch[4096];
+
+        for (const auto& surface : _surfaces)
+        {
+            if (surface.offset > size || surface.rowPitch * surface.rowCount > size - surface.offset)
+                break;
+
+            char* rows = data + surface.offset;
+            if (reencodes(surface))
+            {
+                // Block rows can be built from two others and are flipped on several threads, they read from a copy.
+                const size_t surfaceSize = surface.rowPitch * surface.rowCount;
+                PhyreArena::Buffer copy = PhyreArena::local().acquire(surfaceSize);
+                std::memcpy(copy.data(), rows, surfaceSize);
+                flipSurface(rows, copy.data(), surface);
+                continue;
+            }
+
+            for (size_t y = 0; y < surface.rowCount / 2; y++)
+            {
+                char* top = rows + y * surface.rowPitch;
+                char* bottom = rows + (surface.rowCount - 1 - y) * surface.rowPitch;
+                if (_kernel == kernelCopy)
+                {
+                    PhyreRowKernels::swapRows(top, bottom, surface.rowPitch, _swapRedBlue);
+                    PhyreRowKernels::swapBytes(top, surface.rowPitch, _swapWordSize);
+                    PhyreRowKernels::swapBytes(bottom, surface.rowPitch, _swapWordSize);
+                    continue;
+                }
+
+                for (size_t offset = 0; offset < surface.rowPitch; offset += sizeof(scratch))
+                {
+                    const size_t chunk = std::min(sizeof(scratch), surface.rowPitch - offset);
+                    _flipRow(scratch, top + offset, chunk, surface);
+                    _flipRow(top + offset, bottom + offset, chunk, surface);
+                    std::memcpy(bottom + offset, scratch, chunk);
+                }
+            }
+
+            // The middle row stays where it is but still needs its blocks or pixels flipped.
+            if (surface.rowCount % 2)
+            {
+                char* middle = rows + surface.rowCount / 2 * surface.rowPitch;
+                _flipRow(middle, middle, surface.rowPitch, surface);
+            }
+        }
+    }
+
+    PhyreTextureFlip PhyreTextureFlip::level(size_t index) const
+    {
+        PhyreTextureFlip ret(*this);
+        ret._surfaces.clear();
+        ret._flippedSize = 0;
+        if (index < _surfaces.size())
+        {
+            _tSurface surface = _surfaces[index];
+            surface.offset = 0;
+            ret._surfaces.push_back(surface);
+            ret._flippedSize = surface.rowPitch * surface.rowCount;
+        }
+        return ret;
+    }
+
+    uint64_t PhyreTextureFlip::reencodedBlocks()
+    {
+        return reencoded.load(std::memory_order_relaxed);
+    }
+
+    uint64_t PhyreTextureFlip::unflippedBlocks()
+    {
+        return unflipped.load(std::memory_order_relaxed);
+    }
+
+    void PhyreTextureFlip::_countInexact(uint64_t blocks) const
+    {
+        if (!_pixelExact)
+        {
+            unflipped.fetch_add(blocks, std::memory_order_relaxed);
+            return;
+        }
+        reencoded.fetch_add(blocks, std::memory_order_relaxed);
+        if (_reencodeCounter)
+            _reencodeCounter->fetch_add(blocks, std::memory_order_relaxed);
+    }
+
+    void PhyreTextureFlip::_mergeRow(char* dst, const char* const* sources, const uint32_t* sourceRows, size_t blocks) const
+    {
+        const bool isSigned = _kernel == kernelBC4S || _kernel == kernelBC5S || _kernel == kernelBC6HS;
+        for (size_t i = 0; i < blocks; i++)
+        {
+            const size_t at = i * _unitSize;
+            uint8_t* const out = reinterpret_cast<uint8_t*>(dst + at);
+            if (_kernel == kernelBC6H || _kernel == kernelBC6HS)
+            {
+                int32_t values[16][3];
+                int32_t merged[16][3];
+                for (uint32_t r = 0; r < 4; r++)
+                {
+                    if (r == 0 || sources[r] != sources[r - 1])
+                        PhyreBC6H::decodeBlock(reinterpret_cast<const uint8_t*>(sources[r] + at), isSigned, values);
+                    std::memcpy(merged[r * 4], values[sourceRows[r] * 4], sizeof(values[0]) * 4);
+                }
+                PhyreBC6H::encodeBlock(merged, isSigned, out);
+                continue;
+            }
+
+            // Signed BC4 endpoints order and interpolate like unsigned ones offset by 128, up to rounding.
+            const auto decode = [&](const char* source, uint8_t* rgba)
+            {
+                uint8_t block[16];
+                std::memcpy(block, source + at, _unitSize);
+                if (isSigned)
+                {
+                    for (size_t half = 0; half < _unitSize; half += 8)
+                    {
+                        block[half] ^= 0x80;
+                        block[half + 1] ^= 0x80;
+                    }
+                }
+                switch (_kernel)
+                {
+                case kernelBC1: PhyreTextureDecoder::decodeBlockBC1(block, rgba); break;
+                case kernelBC2: PhyreTextureDecoder::decodeBlockBC2(block, rgba); break;
+                case kernelBC3: PhyreTextureDecoder::decodeBlockBC3(block, rgba); break;
+                case kernelBC4:
+                case kernelBC4S: PhyreTextureDecoder::decodeBlockBC4(block, rgba, 0); break;
+                case kernelBC5:
+                case kernelBC5S: PhyreTextureDecoder::decodeBlockBC5(block, rgba); break;
+                default: PhyreBC7::decodeBlock(block, rgba); break;
+                }
+            };
+
+            uint8_t pixels[64] = {};
+            uint8_t merged[64];
+            for (uint32_t r = 0; r < 4; r++)
+            {
+                if (r == 0 || sources[r] != sources[r - 1])
+                    decode(sources[r], pixels);
+                std::memcpy(merged + r * 16, pixels + sourceRows[r] * 16, 16);
+            }
+
+            switch (_kernel)
+            {
+            case kernelBC1: PhyreBlockEncoder::encodeBlockBC1(merged, out, PhyreBlockEncoder::qualityHigh, true); break;
+            case kernelBC2: PhyreBlockEncoder::encodeBlockBC2(merged, out, PhyreBlockEncoder::qualityHigh); break;
+            case kernelBC3: PhyreBlockEncoder::encodeBlockBC3(merged, out, PhyreBlockEncoder::qualityHigh); break;
+            case kernelBC4:
+            case kernelBC4S: PhyreBlockEncoder::encodeBlockBC4(merged, 0, out, PhyreBlockEncoder::qualityHigh); break;
+            case kernelBC5:
+            case kernelBC5S:
+                PhyreBlockEncoder::encodeBlockBC4(merged, 0, out, PhyreBlockEncoder::qualityHigh);
+                PhyreBlockEncoder::encodeBlockBC4(merged, 1, out + 8, PhyreBlockEncoder::qualityHigh);
+                break;
+            default: PhyreBC7::encodeBlock(merged, out, PhyreBC7::FLIP_REFINEMENTS, true); break;
+            }
+            if (isSigned)
+            {
+                for (size_t half = 0; half < _unitSize; half += 8)
+                {
+                    out[half] ^= 0x80;
+                    out[half + 1] ^= 0x80;
+                }
+            }
+        }
+        _countInexact(blocks);
+    }
+
+    void PhyreTextureFlip::_flipBC1(char* dst, const char* src, size_t blocks, uint32_t rows)
+    {
+        // Two 16 bit colors, then one index byte per row.
+        flipWords<32, 8, 32, 8>(dst, src, blocks, rows);
+    }
+
+    void PhyreTextureFlip::_flipBC2(char* dst, const char* src, size_t blocks, uint32_t rows)
+    {
+        // 16 bits of explicit alpha per row followed by a BC1 color block.
+        flipWords<0, 16, 32, 8>(dst, src, blocks * 2, rows);
+    }
+
+    void PhyreTextureFlip::_flipBC3(char* dst, const char* src, size_t blocks, uint32_t rows)
+    {
+        // Two alpha endpoints and 12 index bits per row, then a BC1 color block.
+        flipWords<16, 12, 32, 8>(dst, src, blocks * 2, rows);
+    }
+
+    void PhyreTextureFlip::_flipBC4(char* dst, const char* src, size_t blocks, uint32_t rows)
+    {
+        flipWords<16, 12, 16, 12>(dst, src, blocks, rows);
+    }
+
+    void PhyreTextureFlip::_flipBC5(char* dst, const char* src, size_t blocks, uint32_t rows)
+    {
+        // Red and green are two BC4 blocks.
+        _flipBC4(dst, src, blocks * 2, rows);
+    }
+
+    void PhyreTextureFlip::_flipBC6H(char* dst, const char* src, size_t blocks, uint32_t rows, bool isSigned) const
+    {
+        uint64_t inexact = 0;
+        for (size_t i = 0; i < blocks; i++)
+        {
+            if (!PhyreBC6H::flipBlock(reinterpret_cast<uint8_t*>(dst) + i * PhyreBC6H::BLOCK_SIZE,
+                reinterpret_cast<const uint8_t*>(src) + i * PhyreBC6H::BLOCK_SIZE, rows, isSigned, _pixelExact))
+                inexact++;
+        }
+        if (inexact)
+            _countInexact(inexact);
+    }
+
+    void PhyreTextureFlip::_flipBC7(char* dst, const char* src, size_t blocks, uint32_t rows) const
+    {
+        uint64_t inexact = 0;
+        for (size_t i = 0; i < blocks; i++)
+        {
+            if (!PhyreBC7::flipBlock(reinterpret_cast<uint8_t*>(dst) + i * PhyreBC7::BLOCK_SIZE,
+                reinterpret_cast<const uint8_t*>(src) + i * PhyreBC7::BLOCK_SIZE, rows, _pixelExact))
+                inexact++;
+        }
+        if (inexact)
+            _countInexact(inexact);
+    }
+}
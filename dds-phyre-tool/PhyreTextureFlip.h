@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PhyreTextureFormat.h"
+
+namespace phyre
+{
+    /*
+    * Vertical flip of a texture payload, mip level by mip level. Block
+    * compressed surfaces are flipped as block rows, and the pixel rows
+    * inside every block are reordered by rewriting the index bits of the
+    * block. Levels shorter than a block only have their valid rows
+    * reversed. The flip loses nothing and undoes itself: BC6H and BC7
+    * blocks that can't be rearranged exactly keep their rows as stored,
+    * unflippedBlocks counts them, and levels taller than a block whose
+    * height isn't a multiple of 4 flip their padding rows along, which
+    * puts them above the image.
+    * A pixel exact flip puts row y at height - 1 - y on every level with
+    * the padding below the image. It decodes the blocks that need it and
+    * encodes them again with some loss, on several threads through
+    * flipSurface, and counts them in reencodedBlocks.
+    * 32 bit pixels can have red and blue swapped in the same pass, and
+    * uncompressed words can be byte swapped for big endian files after
+    * that.
+    */
+    class PhyreTextureFlip
+    {
+    public:
+        struct _tSurface
+        {
+            size_t offset;
+            size_t rowPitch;
+            size_t rowCount;
+            uint32_t blockRows;
+            // Padding rows of the last block row of a level taller than a block, 0 on others.
+            uint32_t paddingRows;
+        };
+
+        PhyreTextureFlip() = delete;
+        PhyreTextureFlip(PhyreTextureFormat::_eFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool swapRedBlue = false, bool swapBytes = false);
+
+        const std::vector<_tSurface>& surfaces() const { return _surfaces; }
+        // Bytes per block or pixel, rows may only be split on this boundary.
+        size_t unitSize() const { return _unitSize; }
+        // Total size of all mip levels, anything past it is not touched.
+        size_t flippedSize() const { return _flippedSize; }
+
+        // Off by default. Blocks are encoded again on threads threads where flipSurface is used, 0 uses every core.
+        void setPixelExact(bool enabled, unsigned threads = 1);
+        bool pixelExact() const { return _pixelExact; }
+        // Blocks this flip encodes again are added to counter as well, it has to outlive the flip.
+        void setReencodeCounter(std::atomic<uint64_t>* counter) { _reencodeCounter = counter; }
+        // Whether flipping the surface encodes blocks again, those are worth flipSurface.
+        bool reencodes(const _tSurface& surface) const;
+
+        /*
+        * Writes size bytes from offset of row y of the flipped surface,
+        * rows is the surface as it is stored. dst may not overlap it.
+        */
+        void flipRow(char* dst, const char* rows, size_t y, size_t offset, size_t size, const _tSurface& surface) const;
+        // The whole surface, runs of rows are split across the threads of setPixelExact. dst may not overlap rows.
+        void flipSurface(char* dst, const char* rows, const _tSurface& surface) const;
+
+        // Flips every complete level of data in place, anything past them is left alone. Only levels that are encoded again go through a copy.
+        void flipInPlace(char* data, size_t size) const;
+
+        // The same flip restricted to one mip level, which starts at offset 0.
+        PhyreTextureFlip level(size_t index) const;
+
+        // Blocks of every pixel exact flip in the process that could only be flipped by encoding them again, with some loss.
+        static uint64_t reencodedBlocks();
+        // Blocks of every other flip in the process that kept their rows because they can't be flipped without loss.
+        static uint64_t unflippedBlocks();
+
+    protected:
+        enum _eKernel
+        {
+            kernelCopy,
+            kernelBC1,
+            kernelBC2,
+            kernelBC3,
+            kernelBC4,
+            kernelBC4S,
+            kernelBC5,
+            kernelBC5S,
+            kernelBC6H,
+            kernelBC6HS,
+            kernelBC7
+        };
+
+        // Copies size bytes of one row, reordering the rows inside every block.
+        void _flipRow(char* dst, const char* src, size_t size, const _tSurface& surface) const;
+        // Encodes blocks again, pixel row r of each comes from row sourceRows[r] of the block at the same column in sources[r].
+        void _mergeRow(char* dst, const char* const* sources, const uint32_t* sourceRows, size_t blocks) const;
+        // Blocks that weren't flipped exactly, encoded again when pixel exact and kept as they are otherwise.
+        void _countInexact(uint64_t blocks) const;
+
+        static void _flipBC1(char* dst, const char* src, size_t blocks, uint32_t rows);
+        static void _flipBC2(char* dst, const char* src, size_t blocks, uint32_t rows);
+        static void _flipBC3(char* dst, const char* src, size_t blocks, uint32_t rows);
+        static void _flipBC4(char* dst, const char* src, size_t blocks, uint32_t rows);
+        static void _flipBC5(char* dst, const char* src, size_t blocks, uint32_t rows);
+        void _flipBC6H(char* dst, const char* src, size_t blocks, uint32_t rows, bool isSigned) const;
+        void _flipBC7(char* dst, const char* src, size_t blocks, uint32_t rows) const;
+
+        _eKernel _kernel = kernelCopy;
+        bool _swapRedBlue = false;
+        size_t _swapWordSize = 1;
+        size_t _unitSize = 1;
+        size_t _flippedSize = 0;
+        std::vector<_tSurface> _surfaces;
+        bool _pixelExact = false;
+        unsigned _threads = 1;
+        std::atomic<uint64_t>* _reencodeCounter = nullptr;
+    };
+}
@@ -0,0 +1,342 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace phyre
+{
+    /*
+    * Compile-time description of every texture format the tool knows:
+    * the phyre format string, the DXGI format, the legacy DDS pixel
+    * format (FourCC or masks) and the block layout. Formats are resolved
+    * from their name once, everything after that works on the enum.
+    */
+    class PhyreTextureFormat
+    {
+    public:
+        enum _eFormat
+        {
+            formatDXT1,
+            formatDXT1_SRGB,
+            formatDXT3,
+            formatDXT3_SRGB,
+            formatDXT5,
+            formatDXT5_SRGB,
+            formatBC4,
+            formatBC4S,
+            formatBC5,
+            formatBC5S,
+            formatBC6H,
+            formatBC6HS,
+            formatBC7,
+            formatBC7_SRGB,
+            formatARGB8,
+            formatARGB8_SRGB,
+            formatXRGB8,
+            formatRGBA8,
+            formatRGBA8_SRGB,
+            formatRGB10A2,
+            formatRGB565,
+            formatARGB1555,
+            formatARGB4444,
+            formatA8,
+            formatL8,
+            formatRG8,
+            formatLA8,
+            formatL16,
+            formatRG16,
+            formatRGBA16,
+            formatR16F,
+            formatRG16F,
+            formatRGBA16F,
+            formatR32F,
+            formatRG32F,
+            formatRGB32F,
+            formatRGBA32F,
+            formatRG11B10F,
+            formatRGB9E5,
+            formatCount,
+            formatUnknown = formatCount
+        };
+
+        enum _eDDS_FOURCC
+        {
+            DDSFCC_DXT5 = 0x35545844,
+            DDSFCC_DXT3 = 0x33545844,
+            DDSFCC_DXT1 = 0x31545844,
+            DDSFCC_ATI1 = 0x31495441,
+            DDSFCC_BC4U = 0x55344342,
+            DDSFCC_BC4S = 0x53344342,
+            DDSFCC_BC5U = 0x55354342,
+            DDSFCC_BC5S = 0x53354342,
+            DDSFCC_ATI2 = 0x32495441,
+            DDSFCC_BC7 = 0x20374342,
+            DDSFCC_DX10 = 0x30315844,
+            // D3DFORMAT values stored as FourCC by legacy writers.
+            DDSFCC_A16B16G16R16 = 36,
+            DDSFCC_R16F = 111,
+            DDSFCC_G16R16F = 112,
+            DDSFCC_A16B16G16R16F = 113,
+            DDSFCC_R32F = 114,
+            DDSFCC_G32R32F = 115,
+            DDSFCC_A32B32G32R32F = 116
+        };
+
+        enum _eDXGI_FORMAT
+        {
+            DXGI_FORMAT_UNKNOWN = 0,
+            DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+            DXGI_FORMAT_R32G32B32_FLOAT = 6,
+            DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+            DXGI_FORMAT_R16G16B16A16_UNORM = 11,
+            DXGI_FORMAT_R32G32_FLOAT = 16,
+            DXGI_FORMAT_R10G10B10A2_UNORM = 24,
+            DXGI_FORMAT_R11G11B10_FLOAT = 26,
+            DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+            DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+            DXGI_FORMAT_R16G16_FLOAT = 34,
+            DXGI_FORMAT_R16G16_UNORM = 35,
+            DXGI_FORMAT_R32_FLOAT = 41,
+            DXGI_FORMAT_R8G8_UNORM = 49,
+            DXGI_FORMAT_R16_FLOAT = 54,
+            DXGI_FORMAT_R16_UNORM = 56,
+            DXGI_FORMAT_R8_UNORM = 61,
+            DXGI_FORMAT_A8_UNORM = 65,
+            DXGI_FORMAT_R9G9B9E5_SHAREDEXP = 67,
+            DXGI_FORMAT_BC1_UNORM = 71,
+            DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+            DXGI_FORMAT_BC2_UNORM = 74,
+            DXGI_FORMAT_BC2_UNORM_SRGB = 75,
+            DXGI_FORMAT_BC3_UNORM = 77,
+            DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+            DXGI_FORMAT_BC4_UNORM = 80,
+            DXGI_FORMAT_BC4_SNORM = 81,
+            DXGI_FORMAT_BC5_UNORM = 83,
+            DXGI_FORMAT_BC5_SNORM = 84,
+            DXGI_FORMAT_B5G6R5_UNORM = 85,
+            DXGI_FORMAT_B5G5R5A1_UNORM = 86,
+            DXGI_FORMAT_B8G8R8A8_UNORM = 87,
+            DXGI_FORMAT_B8G8R8X8_UNORM = 88,
+            DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
+            DXGI_FORMAT_BC6H_UF16 = 95,
+            DXGI_FORMAT_BC6H_SF16 = 96,
+            DXGI_FORMAT_BC7_UNORM = 98,
+            DXGI_FORMAT_BC7_UNORM_SRGB = 99,
+            DXGI_FORMAT_B4G4R4A4_UNORM = 115
+        };
+
+        enum _eDDSPF_FLAGS
+        {
+            DDPF_ALPHAPIXELS = 0x1,
+            DDPF_ALPHA = 0x2,
+            DDPF_FOURCC = 0x4,
+            DDPF_RGB = 0x40,
+            DDPF_YUV = 0x200,
+            DDPF_LUMINANCE = 0x20000
+        };
+
+        struct _tTraits
+        {
+            _eFormat format;
+            const char* name;
+            uint32_t dxgiFormat;
+            // Legacy FourCC, or pixel format flags with bit count and masks, 0 if there is none.
+            uint32_t fourCC;
+            uint32_t pixelFlags;
+            uint32_t rgbBitCount;
+            uint32_t rBitMask;
+            uint32_t gBitMask;
+            uint32_t bBitMask;
+            uint32_t aBitMask;
+            // Pixels per block side, 1 for uncompressed formats.
+            uint32_t blockSize;
+            // Bytes per block, or per pixel for uncompressed formats.
+            uint32_t unitSize;
+            // Written with a DX10 header extension instead of the legacy pixel format.
+            bool dx10;
+        };
+
+        static constexpr _tTraits _table[formatCount] =
+        {
+            { formatDXT1, "DXT1", DXGI_FORMAT_BC1_UNORM, DDSFCC_DXT1, 0, 0, 0, 0, 0, 0, 4, 8, false },
+            { formatDXT1_SRGB, "DXT1_SRGB", DXGI_FORMAT_BC1_UNORM_SRGB, 0, 0, 0, 0, 0, 0, 0, 4, 8, true },
+            { formatDXT3, "DXT3", DXGI_FORMAT_BC2_UNORM, DDSFCC_DXT3, 0, 0, 0, 0, 0, 0, 4, 16, false },
+            { formatDXT3_SRGB, "DXT3_SRGB", DXGI_FORMAT_BC2_UNORM_SRGB, 0, 0, 0, 0, 0, 0, 0, 4, 16, true },
+            { formatDXT5, "DXT5", DXGI_FORMAT_BC3_UNORM, DDSFCC_DXT5, 0, 0, 0, 0, 0, 0, 4, 16, false },
+            { formatDXT5_SRGB, "DXT5_SRGB", DXGI_FORMAT_BC3_UNORM_SRGB, 0, 0, 0, 0, 0, 0, 0, 4, 16, true },
+            { formatBC4, "BC4", DXGI_FORMAT_BC4_UNORM, DDSFCC_BC4U, 0, 0, 0, 0, 0, 0, 4, 8, false },
+            { formatBC4S, "BC4S", DXGI_FORMAT_BC4_SNORM, DDSFCC_BC4S, 0, 0, 0, 0, 0, 0, 4, 8, false },
+            { formatBC5, "BC5", DXGI_FORMAT_BC5_UNORM, DDSFCC_BC5U, 0, 0, 0, 0, 0, 0, 4, 16, false },
+            { formatBC5S, "BC5S", DXGI_FORMAT_BC5_SNORM, DDSFCC_BC5S, 0, 0, 0, 0, 0, 0, 4, 16, false },
+            { formatBC6H, "BC6H", DXGI_FORMAT_BC6H_UF16, 0, 0, 0, 0, 0, 0, 0, 4, 16, true },
+            { formatBC6HS, "BC6HS", DXGI_FORMAT_BC6H_SF16, 0, 0, 0, 0, 0, 0, 0, 4, 16, true },
+            { formatBC7, "BC7", DXGI_FORMAT_BC7_UNORM, DDSFCC_BC7, 0, 0, 0, 0, 0, 0, 4, 16, true },
+            { formatBC7_SRGB, "BC7_SRGB", DXGI_FORMAT_BC7_UNORM_SRGB, 0, 0, 0, 0, 0, 0, 0, 4, 16, true },
+            { formatARGB8, "ARGB8", DXGI_FORMAT_B8G8R8A8_UNORM, 0, DDPF_RGB | DDPF_ALPHAPIXELS, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000, 1, 4, false },
+            { formatARGB8_SRGB, "ARGB8_SRGB", DXGI_FORMAT_B8G8R8A8_UNORM_SRGB, 0, 0, 0, 0, 0, 0, 0, 1, 4, true },
+            { formatXRGB8, "XRGB8", DXGI_FORMAT_B8G8R8X8_UNORM, 0, DDPF_RGB, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0, 1, 4, false },
+            { formatRGBA8, "RGBA8", DXGI_FORMAT_R8G8B8A8_UNORM, 0, DDPF_RGB | DDPF_ALPHAPIXELS, 32, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000, 1, 4, false },
+            { formatRGBA8_SRGB, "RGBA8_SRGB", DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 0, 0, 0, 0, 0, 0, 0, 1, 4, true },
+            { formatRGB10A2, "RGB10A2", DXGI_FORMAT_R10G10B10A2_UNORM, 0, DDPF_RGB | DDPF_ALPHAPIXELS, 32, 0x000003FF, 0x000FFC00, 0x3FF00000, 0xC0000000, 1, 4, false },
+            { formatRGB565, "RGB565", DXGI_FORMAT_B5G6R5_UNORM, 0, DDPF_RGB, 16, 0xF800, 0x07E0, 0x001F, 0, 1, 2, false },
+            { formatARGB1555, "ARGB1555", DXGI_FORMAT_B5G5R5A1_UNORM, 0, DDPF_RGB | DDPF_ALPHAPIXELS, 16, 0x7C00, 0x03E0, 0x001F, 0x8000, 1, 2, false },
+            { formatARGB4444, "ARGB4444", DXGI_FORMAT_B4G4R4A4_UNORM, 0, DDPF_RGB | DDPF_ALPHAPIXELS, 16, 0x0F00, 0x00F0, 0x000F, 0xF000, 1, 2, false },
+            { formatA8, "A8", DXGI_FORMAT_A8_UNORM, 0, DDPF_ALPHA, 8, 0, 0, 0, 0xFF, 1, 1, false },
+            { formatL8, "L8", DXGI_FORMAT_R8_UNORM, 0, DDPF_LUMINANCE, 8, 0xFF, 0, 0, 0, 1, 1, false },
+            { formatRG8, "RG8", DXGI_FORMAT_R8G8_UNORM, 0, 0, 0, 0, 0, 0, 0, 1, 2, true },
+            { formatLA8, "LA8", DXGI_FORMAT_R8G8_UNORM, 0, DDPF_LUMINANCE | DDPF_ALPHAPIXELS, 16, 0x00FF, 0, 0, 0xFF00, 1, 2, false },
+            { formatL16, "L16", DXGI_FORMAT_R16_UNORM, 0, DDPF_LUMINANCE, 16, 0xFFFF, 0, 0, 0, 1, 2, false },
+            { formatRG16, "RG16", DXGI_FORMAT_R16G16_UNORM, 0, DDPF_RGB, 32, 0x0000FFFF, 0xFFFF0000, 0, 0, 1, 4, false },
+            { formatRGBA16, "RGBA16", DXGI_FORMAT_R16G16B16A16_UNORM, DDSFCC_A16B16G16R16, 0, 0, 0, 0, 0, 0, 1, 8, false },
+            { formatR16F, "R16F", DXGI_FORMAT_R16_FLOAT, DDSFCC_R16F, 0, 0, 0, 0, 0, 0, 1, 2, false },
+            { formatRG16F, "RG16F", DXGI_FORMAT_R16G16_FLOAT, DDSFCC_G16R16F, 0, 0, 0, 0, 0, 0, 1, 4, false },
+            { formatRGBA16F, "RGBA16F", DXGI_FORMAT_R16G16B16A16_FLOAT, DDSFCC_A16B16G16R16F, 0, 0, 0, 0, 0, 0, 1, 8, false },
+            { formatR32F, "R32F", DXGI_FORMAT_R32_FLOAT, DDSFCC_R32F, 0, 0, 0, 0, 0, 0, 1, 4, false },
+            { formatRG32F, "RG32F", DXGI_FORMAT_R32G32_FLOAT, DDSFCC_G32R32F, 0, 0, 0, 0, 0, 0, 1, 8, false },
+            { formatRGB32F, "RGB32F", DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, 0, 0, 0, 0, 0, 1, 12, true },
+            { formatRGBA32F, "RGBA32F", DXGI_FORMAT_R32G32B32A32_FLOAT, DDSFCC_A32B32G32R32F, 0, 0, 0, 0, 0, 0, 1, 16, false },
+            { formatRG11B10F, "RG11B10F", DXGI_FORMAT_R11G11B10_FLOAT, 0, 0, 0, 0, 0, 0, 0, 1, 4, true },
+            { formatRGB9E5, "RGB9E5", DXGI_FORMAT_R9G9B9E5_SHAREDEXP, 0, 0, 0, 0, 0, 0, 0, 1, 4, true },
+        };
+
+        static constexpr const _tTraits& traits(_eFormat format)
+        {
+            return _table[format];
+        }
+
+        static constexpr _eFormat fromName(std::string_view name)
+        {
+            for (const auto& entry : _table)
+                if (name == entry.name)
+                    return entry.format;
+            return formatUnknown;
+        }
+
+        static constexpr _eFormat fromDXGI(uint32_t dxgiFormat)
+        {
+            for (const auto& entry : _table)
+                if (entry.dxgiFormat == dxgiFormat)
+                    return entry.format;
+            return formatUnknown;
+        }
+
+        static constexpr _eFormat fromFourCC(uint32_t fourCC)
+        {
+            // Older writers use the ATI names for BC4 and BC5.
+            if (fourCC == DDSFCC_ATI1)
+                return formatBC4;
+            if (fourCC == DDSFCC_ATI2)
+                return formatBC5;
+            for (const auto& entry : _table)
+                if (entry.fourCC && entry.fourCC == fourCC)
+                    return entry.format;
+            return formatUnknown;
+        }
+
+        /*
+        * Matches an uncompressed legacy pixel format. Masks are compared
+        * where the format defines them, so an alpha or luminance header
+        * with leftover color masks is still recognized.
+        */
+        static constexpr _eFormat fromMasks(uint32_t pixelFlags, uint32_t rgbBitCount, uint32_t rBitMask, uint32_t gBitMask, uint32_t bBitMask, uint32_t aBitMask)
+        {
+            const uint32_t typeFlags = DDPF_RGB | DDPF_LUMINANCE | DDPF_ALPHA | DDPF_YUV;
+            for (const auto& entry : _table)
+            {
+                if (!entry.pixelFlags)
+                    continue;
+                if ((entry.pixelFlags & typeFlags) != (pixelFlags & typeFlags) || entry.rgbBitCount != rgbBitCount)
+                    continue;
+                if ((entry.rBitMask && entry.rBitMask != rBitMask) ||
+                    (entry.gBitMask && entry.gBitMask != gBitMask) ||
+                    (entry.bBitMask && entry.bBitMask != bBitMask) ||
+                    (entry.aBitMask && entry.aBitMask != aBitMask))
+                    continue;
+                if ((entry.pixelFlags & DDPF_RGB) && (entry.aBitMask != 0) != ((pixelFlags & DDPF_ALPHAPIXELS) != 0))
+                    continue;
+                return entry.format;
+            }
+            return formatUnknown;
+        }
+
+        static constexpr bool isBlockCompressed(_eFormat format)
+        {
+            return traits(format).blockSize > 1;
+        }
+
+        // Bytes of one surface of the given size.
+        static constexpr uint64_t surfaceSize(_eFormat format, uint32_t width, uint32_t height)
+        {
+            const _tTraits& entry = traits(format);
+            const uint64_t columns = (static_cast<uint64_t>(width) + entry.blockSize - 1) / entry.blockSize;
+            const uint64_t rows = (static_cast<uint64_t>(height) + entry.blockSize - 1) / entry.blockSize;
+            return (columns ? columns : 1) * (rows ? rows : 1) * entry.unitSize;
+        }
+
+        // Bytes of a mip chain, levels the header claims past 1x1 aren't counted.
+        static constexpr uint64_t chainSize(_eFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
+        {
+            uint64_t ret = 0;
+            for (uint32_t level = 0; level < (mipLevels ? mipLevels : 1) && level < 32; level++)
+            {
+                const uint32_t levelWidth = width >> level ? width >> level : 1;
+                const uint32_t levelHeight = height >> level ? height >> level : 1;
+                ret += surfaceSize(format, levelWidth, levelHeight);
+                if (levelWidth == 1 && levelHeight == 1)
+                    break;
+            }
+            return ret;
+        }
+
+        /*
+        * Size of the words big endian platforms store byte swapped: the
+        * packed pixel for 32 bit packed formats, the channel for 16 and
+        * 32 bit channels. Byte channels and BC blocks aren't swapped.
+        */
+        static constexpr uint32_t wordSize(_eFormat format)
+        {
+            switch (format)
+            {
+            case formatRGB565:
+            case formatARGB1555:
+            case formatARGB4444:
+            case formatL16:
+            case formatRG16:
+            case formatRGBA16:
+            case formatR16F:
+            case formatRG16F:
+            case formatRGBA16F:
+                return 2;
+            case formatARGB8:
+            case formatARGB8_SRGB:
+            case formatXRGB8:
+            case formatRGBA8:
+            case formatRGBA8_SRGB:
+            case formatRGB10A2:
+            case formatR32F:
+            case formatRG32F:
+            case formatRGB32F:
+            case formatRGBA32F:
+            case formatRG11B10F:
+            case formatRGB9E5:
+                return 4;
+            default:
+                return 1;
+            }
+        }
+
+        // True if the formats only differ in the order of red and blue.
+        static constexpr bool isRedBlueSwap(_eFormat from, _eFormat to)
+        {
+            return (from == formatARGB8 && to == formatRGBA8) || (from == formatRGBA8 && to == formatARGB8) ||
+                (from == formatARGB8_SRGB && to == formatRGBA8_SRGB) || (from == formatRGBA8_SRGB && to == formatARGB8_SRGB);
+        }
+    };
+
+    static_assert([]()
+    {
+        for (uint32_t i = 0; i < PhyreTextureFormat::formatCount; i++)
+            if (PhyreTextureFormat::_table[i].format != static_cast<PhyreTextureFormat::_eFormat>(i))
+                return false;
+        return true;
+    }(), "Texture format table must be ordered by _eFormat");
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "PhyreException.h"
+
+namespace phyre
+{
+    /*
+    * Non-owning, read-only window over phyre bytes. Every access is
+    * checked against the end of the view so a truncated file produces an
+    * exception instead of a stray read. Nothing in the file is aligned,
+    * structures are copied out with read.
+    */
+    class PhyreView
+    {
+    public:
+        PhyreView() = default;
+        PhyreView(const char* data, size_t size)
+            : _data(data)
+            , _size(size)
+        {
+        }
+
+        const char* data() const { return _data; }
+        size_t size() const { return _size; }
+
+        bool contains(size_t offset, size_t length) const
+        {
+            return offset <= _size && length <= _size - offset;
+        }
+
+        template<typename T>
+        const T* at(size_t offset, size_t count = 1) const
+        {
+            if (count > std::numeric_limits<size_t>::max() / sizeof(T) || !contains(offset, sizeof(T) * count))
+                throw PhyreExceptionData(L"Read past the end of phyre data");
+            return reinterpret_cast<const T*>(_data + offset);
+        }
+
+        template<typename T>
+        T read(size_t offset) const
+        {
+            T ret;
+            std::memcpy(&ret, at<T>(offset), sizeof(T));
+            return ret;
+        }
+
+        PhyreView sub(size_t offset, size_t length) const
+        {
+            return PhyreView(at<char>(offset, length), length);
+        }
+
+        // Null terminated string starting at offset, terminator must be inside the view.
+        const char* string(size_t offset) const
+        {
+            if (offset >= _size || !std::memchr(_data + offset, 0, _size - offset))
+                throw PhyreExceptionData(L"Unterminated string in phyre data");
+            return _data + offset;
+        }
+
+    private:
+        const char* _data = nullptr;
+        size_t _size = 0;
+    };
+}
@@ -0,0 +1,24 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PhyreCommandLine.h"
+
+/*
+* Command line front end for Linux and other POSIX systems. Arguments
+* and output are already UTF-8, and nothing is set up that the chosen
+* mode doesn't use.
+*/
+
+class PosixConsole : public phyre::PhyreConsole {
+public:
+    void out(const std::string& text) override { std::cout << text; }
+    void err(const std::string& text) override { std::cerr << text; }
+    void binaryStdio(bool) override {}
+    void textStdio() override {}
+};
+
+int main(int argc, char* argv[]) {
+    PosixConsole console;
+    return phyre::PhyreCommandLine(console).run(std::vector<std::string>(argv, argv + argc));
+}